@@ -38,7 +38,9 @@
 #include <simd/memory.h>
 
 #pragma GCC diagnostic push
+#ifdef __cplusplus
 #pragma GCC diagnostic ignored "-Wold-style-cast"
+#endif
 
 INLINE NOTNULL(1, 3) void int16_to_float_na(const int16_t *data,
                                             size_t length, float *res) {
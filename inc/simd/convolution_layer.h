@@ -0,0 +1,79 @@
+/*! @file convolution_layer.h
+ *  @brief Multi-channel 2D convolution layer lowered to matrix multiplication.
+ *  @author Markovtsev Vadim <v.markovtsev@samsung.com>
+ *  @version 1.0
+ *
+ *  @section Notes
+ *  This code partially conforms to <a href="http://google-styleguide.googlecode.com/svn/trunk/cppguide.xml">Google C++ Style Guide</a>.
+ *
+ *  @section Copyright
+ *  Copyright © 2013 Samsung R&D Institute Russia
+ *
+ *  @section License
+ *  Licensed to the Apache Software Foundation (ASF) under one
+ *  or more contributor license agreements.  See the NOTICE file
+ *  distributed with this work for additional information
+ *  regarding copyright ownership.  The ASF licenses this file
+ *  to you under the Apache License, Version 2.0 (the
+ *  "License"); you may not use this file except in compliance
+ *  with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an
+ *  "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ *  KIND, either express or implied.  See the License for the
+ *  specific language governing permissions and limitations
+ *  under the License.
+ */
+
+#ifndef INC_SIMD_CONVOLUTION_LAYER_H_
+#define INC_SIMD_CONVOLUTION_LAYER_H_
+
+#include <stddef.h>
+#include <simd/common.h>
+#include <simd/attributes.h>
+
+SIMD_API_BEGIN
+
+/// @brief Calculates the output size of convolution_layer() along one
+/// dimension.
+/// @param size The input width or height.
+/// @param kernelSize The size of the square kernel.
+/// @param stride The step between the adjacent kernel applications.
+/// @param padding The number of zeros added to each side of the input.
+/// @return (size + 2 * padding - kernelSize) / stride + 1.
+int convolution_layer_output_size(int size, int kernelSize, int stride,
+                                  int padding);
+
+/// @brief Applies a convolutional layer (as in CNNs, that is,
+/// cross-correlation of every input channel with the corresponding kernel,
+/// summed over the input channels) to a multi-channel plane.
+/// @param simd Value indicating whether to use SIMD acceleration or not.
+/// @param input The input planes in channels x height x width format.
+/// @param channels The number of input channels.
+/// @param width The width of the input planes.
+/// @param height The height of the input planes.
+/// @param weights The kernels in kernelSize x kernelSize x channels x
+/// outChannels format.
+/// @param bias The values added to each output channel. May be NULL.
+/// @param outChannels The number of output channels.
+/// @param kernelSize The size of the square kernels.
+/// @param stride The step between the adjacent kernel applications.
+/// @param padding The number of zeros added to each side of the input.
+/// @param output The output planes in outChannels x outHeight x outWidth
+/// format, see convolution_layer_output_size().
+/// @details The input is lowered with im2col band by band, so that the
+/// temporary matrix fits into the cache, and every band is multiplied by
+/// the weights with matrix_multiply(). The bias is added while the band
+/// result is scattered to the output planes.
+void convolution_layer(int simd, const float *input, int channels,
+                       int width, int height, const float *weights,
+                       const float *bias, int outChannels, int kernelSize,
+                       int stride, int padding, float *output)
+    NOTNULL(2, 6, 12);
+
+SIMD_API_END
+
+#endif  // INC_SIMD_CONVOLUTION_LAYER_H_
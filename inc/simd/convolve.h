@@ -101,6 +101,20 @@ void convolve_simd(int simd,
                    const float *__restrict h, size_t hLength,
                    float *__restrict result) NOTNULL(2, 4, 6);
 
+/// @brief The same as convolve_simd() in double precision.
+/// @param simd Value indicating whether to use SIMD acceleration or not.
+/// @param x The first signal (long one).
+/// @param xLength The length of the first array in double-s.
+/// @param h The second signal (short one).
+/// @param hLength The length of the second array in double-s.
+/// @param result The resulting signal of length xLength + hLength - 1.
+/// @note There are no FFT based double precision counterparts, since FFTF
+/// provides only single precision transforms.
+void convolve_simd_double(int simd,
+                          const double *__restrict x, size_t xLength,
+                          const double *__restrict h, size_t hLength,
+                          double *__restrict result) NOTNULL(2, 4, 6);
+
 typedef struct ConvolutionHandle ConvolutionHandle;
 
 /// @brief Prepares for the calculation of linear convolution of two signals
@@ -0,0 +1,123 @@
+/*! @file convolve2D.h
+ *  @brief Two dimensional convolution of planes.
+ *  @author Markovtsev Vadim <v.markovtsev@samsung.com>
+ *  @version 1.0
+ *
+ *  @section Notes
+ *  This code partially conforms to <a href="http://google-styleguide.googlecode.com/svn/trunk/cppguide.xml">Google C++ Style Guide</a>.
+ *
+ *  @section Copyright
+ *  Copyright © 2013 Samsung R&D Institute Russia
+ *
+ *  @section License
+ *  Licensed to the Apache Software Foundation (ASF) under one
+ *  or more contributor license agreements.  See the NOTICE file
+ *  distributed with this work for additional information
+ *  regarding copyright ownership.  The ASF licenses this file
+ *  to you under the Apache License, Version 2.0 (the
+ *  "License"); you may not use this file except in compliance
+ *  with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an
+ *  "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ *  KIND, either express or implied.  See the License for the
+ *  specific language governing permissions and limitations
+ *  under the License.
+ */
+
+#ifndef INC_SIMD_CONVOLVE2D_H_
+#define INC_SIMD_CONVOLVE2D_H_
+
+#include <simd/common.h>
+#include <simd/attributes.h>
+#include <simd/convolve_structs.h>
+#include <simd/wavelet_types.h>
+
+SIMD_API_BEGIN
+
+/// @brief Calculates the two dimensional convolution of a plane with
+/// a small kernel directly.
+/// @param simd Value indicating whether to use SIMD acceleration or not.
+/// @param src The source plane, stored in row-major format.
+/// @param srcStride The stride (the actual width) of src in float-s.
+/// @param width The width of the plane.
+/// @param height The height of the plane.
+/// @param kernel The convolution kernel, stored in row-major format.
+/// @param kernelWidth The width of the kernel.
+/// @param kernelHeight The height of the kernel.
+/// @param ext The way the plane is extended beyond its borders.
+/// @param dst The resulting plane of size width x height.
+/// @param dstStride The stride of dst in float-s.
+/// @details The kernel's anchor is (kernelWidth / 2, kernelHeight / 2),
+/// so the result is not shifted for odd kernel sizes.
+/// @note src and dst may NOT be the same arrays.
+void convolve2D_simd(int simd, const float *src, int srcStride,
+                     int width, int height,
+                     const float *kernel, int kernelWidth, int kernelHeight,
+                     ExtensionType ext, float *dst, int dstStride)
+    NOTNULL(2, 6, 10);
+
+/// @brief Calculates the two dimensional convolution of a plane with
+/// a separable kernel, that is, with the outer product of columnKernel
+/// and rowKernel.
+/// @param simd Value indicating whether to use SIMD acceleration or not.
+/// @param src The source plane, stored in row-major format.
+/// @param srcStride The stride (the actual width) of src in float-s.
+/// @param width The width of the plane.
+/// @param height The height of the plane.
+/// @param rowKernel The horizontal 1D kernel.
+/// @param rowKernelLength The length of rowKernel.
+/// @param columnKernel The vertical 1D kernel.
+/// @param columnKernelLength The length of columnKernel.
+/// @param ext The way the plane is extended beyond its borders.
+/// @param dst The resulting plane of size width x height.
+/// @param dstStride The stride of dst in float-s.
+/// @note src and dst may be the same arrays.
+void convolve2D_separable(int simd, const float *src, int srcStride,
+                          int width, int height,
+                          const float *rowKernel, int rowKernelLength,
+                          const float *columnKernel, int columnKernelLength,
+                          ExtensionType ext, float *dst, int dstStride)
+    NOTNULL(2, 6, 8, 11);
+
+typedef struct Convolution2DHandle Convolution2DHandle;
+
+/// @brief Prepares for the calculation of two dimensional convolution of
+/// planes of the specified size with the specified kernel using
+/// the best method.
+/// @param width The width of the planes.
+/// @param height The height of the planes.
+/// @param kernel The convolution kernel, stored in row-major format.
+/// @param kernelWidth The width of the kernel.
+/// @param kernelHeight The height of the kernel.
+/// @param ext The way the planes are extended beyond their borders.
+/// @return The handle for convolve2D().
+/// @details Separable (rank 1) kernels are detected and applied as two
+/// 1D passes, large non-separable ones are applied in the frequency domain,
+/// the rest are applied directly.
+Convolution2DHandle convolve2D_initialize(int width, int height,
+                                          const float *kernel,
+                                          int kernelWidth, int kernelHeight,
+                                          ExtensionType ext) NOTNULL(3);
+
+/// @brief Calculates the two dimensional convolution of a plane using
+/// the best method.
+/// @param handle The structure obtained from convolve2D_initialize().
+/// @param src The source plane, stored in row-major format.
+/// @param srcStride The stride (the actual width) of src in float-s.
+/// @param dst The resulting plane.
+/// @param dstStride The stride of dst in float-s.
+/// @note src and dst may NOT be the same arrays.
+void convolve2D(Convolution2DHandle handle, const float *src, int srcStride,
+                float *dst, int dstStride) NOTNULL(2, 4);
+
+/// @brief Frees any resources allocated by convolve2D_initialize().
+/// @param handle The structure obtained from convolve2D_initialize().
+void convolve2D_finalize(Convolution2DHandle handle);
+
+SIMD_API_END
+
+#endif  // INC_SIMD_CONVOLVE2D_H_
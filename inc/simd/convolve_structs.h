@@ -33,6 +33,7 @@
 
 #include <stddef.h>
 #include <simd/common.h>
+#include <simd/wavelet_types.h>
 
 SIMD_API_BEGIN
 
@@ -57,6 +58,17 @@ struct ConvolutionFFTHandle {
   int reverse;
 };
 
+struct CrossCorrelationBatchHandle {
+  void *fft_plan;
+  void *fft_inverse_plan;
+  int *M;
+  int x_length;
+  int h_length;
+  int batch_size;
+  float **inputs;
+  float *H;
+};
+
 typedef enum {
   kConvolutionAlgorithmBruteForce,
   kConvolutionAlgorithmFFT,
@@ -73,6 +85,50 @@ struct ConvolutionHandle {
   } handle;
 };
 
+typedef enum {
+  kConvolution2DAlgorithmDirect,
+  kConvolution2DAlgorithmSeparable,
+  kConvolution2DAlgorithmFFT
+} Convolution2DAlgorithm;
+
+struct Convolution2DHandle {
+  Convolution2DAlgorithm algorithm;
+  int width;
+  int height;
+  int kernel_width;
+  int kernel_height;
+  ExtensionType extension;
+  /// The kernel (direct) or its row and column factors (separable)
+  float *kernel;
+  float *row_kernel;
+  float *column_kernel;
+  /// The frequency domain method's plans, buffer and kernel spectrum
+  void *fft_plan;
+  void *fft_inverse_plan;
+  float *fft_boiler_plate;
+  float *K;
+  int *dims;
+};
+
+struct CrossCorrelation2DHandle {
+  Convolution2DAlgorithm algorithm;
+  int width;
+  int height;
+  int template_width;
+  int template_height;
+  int normalized;
+  /// The template, centred if normalized is set
+  float *templ;
+  /// The Euclidean norm of templ
+  float template_norm;
+  /// The frequency domain method's plans, buffer and template spectrum
+  void *fft_plan;
+  void *fft_inverse_plan;
+  float *fft_boiler_plate;
+  float *T;
+  int *dims;
+};
+
 SIMD_API_END
 
 #endif  // INC_SIMD_CONVOLVE_STRUCTS_H_
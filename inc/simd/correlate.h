@@ -107,6 +107,19 @@ void cross_correlate_simd(int simd,
                           const float *__restrict h, size_t hLength,
                           float *__restrict result) NOTNULL(2, 4, 6);
 
+/// @brief The same as cross_correlate_simd() in double precision.
+/// @param simd Value indicating whether to use SIMD acceleration or not.
+/// @param x The first signal (long one).
+/// @param xLength The length of the first array in double-s.
+/// @param h The second signal (short one).
+/// @param hLength The length of the second array in double-s.
+/// @param result The resulting signal of length xLength + hLength - 1.
+/// @note result, x and h may NOT be the same arrays.
+void cross_correlate_simd_double(int simd,
+                                 const double *__restrict x, size_t xLength,
+                                 const double *__restrict h, size_t hLength,
+                                 double *__restrict result) NOTNULL(2, 4, 6);
+
 typedef struct ConvolutionHandle CrossCorrelationHandle;
 
 /// @brief Prepares for the calculation of cross-correlation of
@@ -134,6 +147,43 @@ void cross_correlate(CrossCorrelationHandle handle,
 /// cross_correlate_overlap_initialize().
 void cross_correlate_finalize(CrossCorrelationHandle handle);
 
+typedef struct CrossCorrelationBatchHandle CrossCorrelationBatchHandle;
+
+/// @brief Prepares for the calculation of cross-correlation of the same
+/// template with many signals of the same length.
+/// @param xLength The length of each signal in float-s.
+/// @param h The template (short one). Its spectrum is calculated here once.
+/// @param hLength The length of the template in float-s.
+/// @param batchSize The number of signals transformed by a single FFT call.
+/// @return The handle for cross_correlate_batch().
+CrossCorrelationBatchHandle cross_correlate_batch_initialize(
+    size_t xLength, const float *h, size_t hLength, size_t batchSize)
+    NOTNULL(2);
+
+/// @brief Calculates the cross-correlation of the template passed to
+/// cross_correlate_batch_initialize() with each of the signals using
+/// the FFT method.
+/// @param handle The structure obtained from
+/// cross_correlate_batch_initialize().
+/// @param x The array of signals, xLength float-s each.
+/// @param count The number of signals in x.
+/// @param results The array of resulting signals of length
+/// xLength + hLength - 1 each. It may be NULL if only the maximums are needed.
+/// @param maxValues The maximal value of each resulting signal. May be NULL.
+/// @param maxLags The lag of each maximal value, that is, the offset of
+/// the template relative to the signal, in the range
+/// [-(hLength - 1), xLength - 1]. May be NULL.
+void cross_correlate_batch(CrossCorrelationBatchHandle handle,
+                           const float *const *x, size_t count,
+                           float *const *results,
+                           float *maxValues, int *maxLags) NOTNULL(2);
+
+/// @brief Frees any resources allocated by
+/// cross_correlate_batch_initialize().
+/// @param handle The structure obtained from
+/// cross_correlate_batch_initialize().
+void cross_correlate_batch_finalize(CrossCorrelationBatchHandle handle);
+
 SIMD_API_END
 
 #endif  // INC_SIMD_CORRELATE_H_
@@ -0,0 +1,98 @@
+/*! @file correlate2D.h
+ *  @brief Two dimensional cross-correlation (template matching) of planes.
+ *  @author Markovtsev Vadim <v.markovtsev@samsung.com>
+ *  @version 1.0
+ *
+ *  @section Notes
+ *  This code partially conforms to <a href="http://google-styleguide.googlecode.com/svn/trunk/cppguide.xml">Google C++ Style Guide</a>.
+ *
+ *  @section Copyright
+ *  Copyright © 2013 Samsung R&D Institute Russia
+ *
+ *  @section License
+ *  Licensed to the Apache Software Foundation (ASF) under one
+ *  or more contributor license agreements.  See the NOTICE file
+ *  distributed with this work for additional information
+ *  regarding copyright ownership.  The ASF licenses this file
+ *  to you under the Apache License, Version 2.0 (the
+ *  "License"); you may not use this file except in compliance
+ *  with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an
+ *  "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ *  KIND, either express or implied.  See the License for the
+ *  specific language governing permissions and limitations
+ *  under the License.
+ */
+
+#ifndef INC_SIMD_CORRELATE2D_H_
+#define INC_SIMD_CORRELATE2D_H_
+
+#include <simd/common.h>
+#include <simd/attributes.h>
+#include <simd/convolve_structs.h>
+
+SIMD_API_BEGIN
+
+/// @brief Calculates the two dimensional cross-correlation of a plane with
+/// a template directly, only at the positions where the template fits
+/// entirely inside the plane.
+/// @param simd Value indicating whether to use SIMD acceleration or not.
+/// @param src The source plane, stored in row-major format.
+/// @param srcStride The stride (the actual width) of src in float-s.
+/// @param width The width of the plane.
+/// @param height The height of the plane.
+/// @param templ The template, stored in row-major format.
+/// @param templateWidth The width of the template.
+/// @param templateHeight The height of the template.
+/// @param dst The resulting plane of size (width - templateWidth + 1) x
+/// (height - templateHeight + 1), dst[y][x] = sum(templ[i][j] *
+/// src[y + i][x + j]).
+/// @param dstStride The stride of dst in float-s.
+void cross_correlate2D_simd(int simd, const float *src, int srcStride,
+                            int width, int height, const float *templ,
+                            int templateWidth, int templateHeight,
+                            float *dst, int dstStride) NOTNULL(2, 6, 9);
+
+typedef struct CrossCorrelation2DHandle CrossCorrelation2DHandle;
+
+/// @brief Prepares for the template matching in planes of the specified
+/// size using the best method.
+/// @param width The width of the planes.
+/// @param height The height of the planes.
+/// @param templ The template, stored in row-major format.
+/// @param templateWidth The width of the template.
+/// @param templateHeight The height of the template.
+/// @param normalized If not zero, cross_correlate2D() calculates
+/// the zero-mean normalized cross-correlation (ZNCC) instead of the plain one.
+/// @return The handle for cross_correlate2D().
+CrossCorrelation2DHandle cross_correlate2D_initialize(
+    int width, int height, const float *templ,
+    int templateWidth, int templateHeight, int normalized) NOTNULL(3);
+
+/// @brief Calculates the two dimensional cross-correlation of a plane with
+/// the template using the best method.
+/// @param handle The structure obtained from cross_correlate2D_initialize().
+/// @param src The source plane, stored in row-major format.
+/// @param srcStride The stride (the actual width) of src in float-s.
+/// @param dst The resulting plane of size (width - templateWidth + 1) x
+/// (height - templateHeight + 1).
+/// @param dstStride The stride of dst in float-s.
+/// @details If the handle is normalized, the results are in [-1, 1];
+/// the windows with zero variance yield 0. The local means and energies are
+/// obtained from the summed-area tables of src.
+/// @note src and dst may NOT be the same arrays.
+void cross_correlate2D(CrossCorrelation2DHandle handle,
+                       const float *src, int srcStride,
+                       float *dst, int dstStride) NOTNULL(2, 4);
+
+/// @brief Frees any resources allocated by cross_correlate2D_initialize().
+/// @param handle The structure obtained from cross_correlate2D_initialize().
+void cross_correlate2D_finalize(CrossCorrelation2DHandle handle);
+
+SIMD_API_END
+
+#endif  // INC_SIMD_CORRELATE2D_H_
@@ -0,0 +1,185 @@
+/*! @file linalg.h
+ *  @brief Dense linear algebra: triangular solves and factorizations.
+ *  @author Markovtsev Vadim <v.markovtsev@samsung.com>
+ *  @version 1.0
+ *
+ *  @section Notes
+ *  This code partially conforms to <a href="http://google-styleguide.googlecode.com/svn/trunk/cppguide.xml">Google C++ Style Guide</a>.
+ *
+ *  @section Copyright
+ *  Copyright © 2013 Samsung R&D Institute Russia
+ *
+ *  @section License
+ *  Licensed to the Apache Software Foundation (ASF) under one
+ *  or more contributor license agreements.  See the NOTICE file
+ *  distributed with this work for additional information
+ *  regarding copyright ownership.  The ASF licenses this file
+ *  to you under the Apache License, Version 2.0 (the
+ *  "License"); you may not use this file except in compliance
+ *  with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an
+ *  "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ *  KIND, either express or implied.  See the License for the
+ *  specific language governing permissions and limitations
+ *  under the License.
+ */
+
+
+#ifndef INC_SIMD_LINALG_H_
+#define INC_SIMD_LINALG_H_
+
+#include <stddef.h>
+#include <simd/common.h>
+#include <simd/attributes.h>
+
+SIMD_API_BEGIN
+
+/// @brief Solves a triangular system with several right hand sides,
+/// op(T) X = alpha * B or X op(T) = alpha * B, where op(T) is T or its
+/// transpose. All matrices are in row-major format.
+/// @param simd Value which indicates whether to use SIMD acceleration or not.
+/// @param right Value which indicates whether op(T) is on the right of X.
+/// @param lower Value which indicates whether T is lower triangular
+/// (otherwise, it is upper triangular). The other triangle is not read.
+/// @param transT Value which indicates whether op(T) is the transposed T.
+/// @param unitDiagonal Value which indicates whether the diagonal of T
+/// consists of ones. If it is set, the diagonal is not read.
+/// @param m The number of rows in B.
+/// @param n The number of columns in B.
+/// @param alpha The scale of B.
+/// @param t The triangular matrix, m x m (n x n if right is set).
+/// @param ldt The distance between the adjacent rows of t, in float-s.
+/// @param b The right hand sides, m x n, which are overwritten by X.
+/// @param ldb The distance between the adjacent rows of b, in float-s.
+/// @details The diagonal blocks are solved directly and the rest of B is
+/// updated with matrix_gemm(), so most of the work is done by the
+/// SIMD and multi-threaded matrix multiplication.
+void linalg_trsm(int simd, int right, int lower, int transT,
+                 int unitDiagonal, size_t m, size_t n, float alpha,
+                 const float *t, size_t ldt, float *b, size_t ldb)
+    NOTNULL(9, 11);
+
+/// @brief Solves a triangular system op(T) x = b, where op(T) is T or its
+/// transpose.
+/// @param simd Value which indicates whether to use SIMD acceleration or not.
+/// @param lower Value which indicates whether T is lower triangular
+/// (otherwise, it is upper triangular). The other triangle is not read.
+/// @param transT Value which indicates whether op(T) is the transposed T.
+/// @param unitDiagonal Value which indicates whether the diagonal of T
+/// consists of ones. If it is set, the diagonal is not read.
+/// @param n The size of the system.
+/// @param t The triangular matrix, n x n, in row-major format.
+/// @param ldt The distance between the adjacent rows of t, in float-s.
+/// @param x The right hand side of length n, which is overwritten by
+/// the solution.
+void linalg_trsv(int simd, int lower, int transT, int unitDiagonal,
+                 size_t n, const float *t, size_t ldt, float *x)
+    NOTNULL(6, 8);
+
+/// @brief Calculates the Cholesky factorization A = L L^T of a symmetric
+/// positive definite matrix.
+/// @param simd Value which indicates whether to use SIMD acceleration or not.
+/// @param a The matrix, n x n, in row-major format. Only the lower triangle
+/// is read. On success, the lower triangle is overwritten by L and
+/// the strictly upper one is zeroed.
+/// @param n The size of the matrix.
+/// @param lda The distance between the adjacent rows of a, in float-s.
+/// @return 0 on success; otherwise, the (one-based) order of the leading
+/// minor which is not positive definite, and a is partially overwritten.
+/// @details The blocked right-looking algorithm is used: the trailing
+/// matrix is updated with matrix_gemm().
+int linalg_cholesky(int simd, float *a, size_t n, size_t lda) NOTNULL(2);
+
+/// @brief Solves A X = B, given the Cholesky factorization of A.
+/// @param simd Value which indicates whether to use SIMD acceleration or not.
+/// @param l The factor L calculated by linalg_cholesky().
+/// @param n The size of the system.
+/// @param ldl The distance between the adjacent rows of l, in float-s.
+/// @param b The right hand sides, n x nrhs, which are overwritten by X.
+/// @param nrhs The number of right hand sides (the number of columns in b).
+/// @param ldb The distance between the adjacent rows of b, in float-s.
+void linalg_cholesky_solve(int simd, const float *l, size_t n, size_t ldl,
+                           float *b, size_t nrhs, size_t ldb) NOTNULL(2, 5);
+
+/// @brief Calculates the LU factorization with partial pivoting,
+/// P A = L U, of a square matrix.
+/// @param simd Value which indicates whether to use SIMD acceleration or not.
+/// @param a The matrix, n x n, in row-major format. It is overwritten by
+/// L (below the diagonal, the unit diagonal is not stored) and U.
+/// @param n The size of the matrix.
+/// @param lda The distance between the adjacent rows of a, in float-s.
+/// @param pivots The row interchanges of length n: row i was swapped with
+/// row pivots[i], for i = 0, 1, ..., n - 1 in that order.
+/// @return 0 on success; otherwise, the (one-based) index of the first
+/// zero pivot. The factorization is completed anyway, but U is singular.
+/// @details The blocked right-looking algorithm is used: the trailing
+/// matrix is updated with matrix_gemm().
+int linalg_lu(int simd, float *a, size_t n, size_t lda, int *pivots)
+    NOTNULL(2, 5);
+
+/// @brief Solves A X = B, given the LU factorization of A.
+/// @param simd Value which indicates whether to use SIMD acceleration or not.
+/// @param lu The factors calculated by linalg_lu().
+/// @param n The size of the system.
+/// @param ldlu The distance between the adjacent rows of lu, in float-s.
+/// @param pivots The row interchanges calculated by linalg_lu().
+/// @param b The right hand sides, n x nrhs, which are overwritten by X.
+/// @param nrhs The number of right hand sides (the number of columns in b).
+/// @param ldb The distance between the adjacent rows of b, in float-s.
+void linalg_lu_solve(int simd, const float *lu, size_t n, size_t ldlu,
+                     const int *pivots, float *b, size_t nrhs, size_t ldb)
+    NOTNULL(2, 5, 6);
+
+/// @brief Calculates the Cholesky factorizations of a batch of matrices.
+/// @param simd Value which indicates whether to use SIMD acceleration or not.
+/// @param a The matrices, n x n each, which follow each other.
+/// @param n The size of the matrices.
+/// @param count The number of matrices.
+/// @param info The results of linalg_cholesky() for each matrix.
+/// @details The matrices are split between the OpenMP threads.
+void linalg_cholesky_batch(int simd, float *a, size_t n, size_t count,
+                           int *info) NOTNULL(2, 5);
+
+/// @brief Solves a batch of systems, given their Cholesky factorizations.
+/// @param simd Value which indicates whether to use SIMD acceleration or not.
+/// @param l The factors calculated by linalg_cholesky_batch().
+/// @param n The size of the systems.
+/// @param count The number of systems.
+/// @param b The right hand sides, n x nrhs each, which follow each other.
+/// They are overwritten by the solutions.
+/// @param nrhs The number of right hand sides of each system.
+void linalg_cholesky_solve_batch(int simd, const float *l, size_t n,
+                                 size_t count, float *b, size_t nrhs)
+    NOTNULL(2, 5);
+
+/// @brief Calculates the LU factorizations of a batch of matrices.
+/// @param simd Value which indicates whether to use SIMD acceleration or not.
+/// @param a The matrices, n x n each, which follow each other.
+/// @param n The size of the matrices.
+/// @param count The number of matrices.
+/// @param pivots The row interchanges, n for each matrix.
+/// @param info The results of linalg_lu() for each matrix.
+/// @details The matrices are split between the OpenMP threads.
+void linalg_lu_batch(int simd, float *a, size_t n, size_t count,
+                     int *pivots, int *info) NOTNULL(2, 5, 6);
+
+/// @brief Solves a batch of systems, given their LU factorizations.
+/// @param simd Value which indicates whether to use SIMD acceleration or not.
+/// @param lu The factors calculated by linalg_lu_batch().
+/// @param n The size of the systems.
+/// @param count The number of systems.
+/// @param pivots The row interchanges calculated by linalg_lu_batch().
+/// @param b The right hand sides, n x nrhs each, which follow each other.
+/// They are overwritten by the solutions.
+/// @param nrhs The number of right hand sides of each system.
+void linalg_lu_solve_batch(int simd, const float *lu, size_t n, size_t count,
+                           const int *pivots, float *b, size_t nrhs)
+    NOTNULL(2, 5, 6);
+
+SIMD_API_END
+
+#endif  // INC_SIMD_LINALG_H_
@@ -32,11 +32,97 @@
 #define INC_SIMD_MATRIX_H_
 
 #include <stddef.h>
+#include <stdint.h>
 #include <simd/common.h>
 #include <simd/attributes.h>
 
 SIMD_API_BEGIN
 
+/// @brief The memory layout of a batch of same-shaped matrices.
+typedef enum {
+  /// @brief The matrices follow each other: element (i, j) of matrix n
+  /// is at [n * w * h + i * w + j].
+  kMatrixBatchLayoutContiguous,
+  /// @brief The matrices are interleaved (structure of arrays): element
+  /// (i, j) of matrix n is at [(i * w + j) * count + n].
+  kMatrixBatchLayoutInterleaved
+} MatrixBatchLayout;
+
+/// @brief How the quantization scales map onto the resulting matrix.
+typedef enum {
+  /// @brief A single scale for the whole matrix.
+  kQuantizationScalePerTensor,
+  /// @brief A scale for every row (e.g., per sample).
+  kQuantizationScalePerRow,
+  /// @brief A scale for every column (e.g., per output channel).
+  kQuantizationScalePerColumn
+} QuantizationScaleType;
+
+/// @brief The 16-bit floating point formats.
+typedef enum {
+  /// @brief IEEE 754 binary16: 5 exponent bits, 10 mantissa bits.
+  kHalfFloatIEEE,
+  /// @brief bfloat16, the upper half of float: 8 exponent bits,
+  /// 7 mantissa bits.
+  kHalfFloatBFloat16
+} HalfFloatType;
+
+/// @brief The element-wise functions applied to the result of
+/// matrix_gemm_activate().
+typedef enum {
+  /// @brief f(x) = x.
+  kActivationIdentity,
+  /// @brief f(x) = max(x, 0).
+  kActivationRelu,
+  /// @brief f(x) = tanh(x).
+  kActivationTanh,
+  /// @brief f(x) = 1 / (1 + exp(-x)).
+  kActivationSigmoid
+} ActivationFunction;
+
+/// @brief The element-wise operations of matrix_broadcast().
+typedef enum {
+  kMatrixOperationAdd,
+  kMatrixOperationSub,
+  kMatrixOperationMul,
+  kMatrixOperationDiv
+} MatrixOperation;
+
+/// @brief Whether a vector holds one value per row or one value per column
+/// of a matrix.
+typedef enum {
+  /// @brief The vector of length h, element i corresponds to row i.
+  kMatrixPerRow,
+  /// @brief The vector of length w, element j corresponds to column j.
+  kMatrixPerColumn
+} MatrixDirection;
+
+/// @brief The reductions of matrix_reduce().
+typedef enum {
+  kMatrixReductionSum,
+  kMatrixReductionMean,
+  kMatrixReductionMin,
+  kMatrixReductionMax,
+  /// @brief The Euclidean norm.
+  kMatrixReductionNorm2
+} MatrixReduction;
+
+/// @brief Sparse matrix in the compressed sparse row (CSR) format.
+typedef struct {
+  /// @brief The number of columns.
+  size_t width;
+  /// @brief The number of rows.
+  size_t height;
+  /// @brief The non-zero elements, row by row.
+  float *values;
+  /// @brief The column of each element in values.
+  int *columns;
+  /// @brief height + 1 offsets in values: row i occupies
+  /// [row_offsets[i], row_offsets[i + 1]). The first offset is 0 and
+  /// the last one is the number of non-zeros.
+  size_t *row_offsets;
+} SparseMatrix;
+
 /// @brief Sums two matrices.
 /// @param simd Value which indicates whether to use SIMD acceleration or not.
 /// @param m1 The first matrix.
@@ -55,6 +141,63 @@ void matrix_add(int simd, const float *m1, const float *m2,
 /// @param res The resulting matrix of the same size.
 void matrix_sub(int simd, const float *m1, const float *m2,
                 size_t w, size_t h, float *res) NOTNULL(2,3,6);
+
+/// @brief Applies an element-wise operation to a matrix and a vector which
+/// is repeated along the rows or the columns: res[i][j] = m[i][j] op v[j]
+/// (per column) or res[i][j] = m[i][j] op v[i] (per row).
+/// @param simd Value which indicates whether to use SIMD acceleration or not.
+/// @param op The operation.
+/// @param direction Whether v holds a value per row or per column.
+/// @param m The matrix in row-major format.
+/// @param w The width of the matrix (the number of columns).
+/// @param h The height of the matrix (the number of rows).
+/// @param stride The distance between the adjacent rows of m, in float-s.
+/// @param v The vector of length h (per row) or w (per column).
+/// @param res The resulting matrix of the same size. It may be m.
+/// @param resStride The distance between the adjacent rows of res,
+/// in float-s.
+/// @note On NEON the division is the multiplication by the refined
+/// reciprocal, so it may differ from the exact quotient in the last bit.
+void matrix_broadcast(int simd, MatrixOperation op,
+                      MatrixDirection direction, const float *m,
+                      size_t w, size_t h, size_t stride, const float *v,
+                      float *res, size_t resStride) NOTNULL(4,8,9);
+
+/// @brief Reduces every row or every column of a matrix to a single value.
+/// @param simd Value which indicates whether to use SIMD acceleration or not.
+/// @param op The reduction.
+/// @param direction kMatrixPerRow to reduce each row, kMatrixPerColumn to
+/// reduce each column.
+/// @param m The matrix in row-major format.
+/// @param w The width of the matrix (the number of columns).
+/// @param h The height of the matrix (the number of rows).
+/// @param stride The distance between the adjacent rows of m, in float-s.
+/// @param res The resulting vector of length h (per row) or w (per column).
+/// @details The columns are reduced by streaming the rows into a vector of
+/// the partial results, so m is always read contiguously. The norms are
+/// accumulated in double precision. The minimum and the maximum skip
+/// NaN-s; if there are only NaN-s, they are INFINITY and -INFINITY.
+void matrix_reduce(int simd, MatrixReduction op, MatrixDirection direction,
+                   const float *m, size_t w, size_t h, size_t stride,
+                   float *res) NOTNULL(4,8);
+
+/// @brief Finds the maximal element of every row or every column of
+/// a matrix.
+/// @param simd Value which indicates whether to use SIMD acceleration or not.
+/// @param direction kMatrixPerRow to search each row, kMatrixPerColumn to
+/// search each column.
+/// @param m The matrix in row-major format.
+/// @param w The width of the matrix (the number of columns).
+/// @param h The height of the matrix (the number of rows).
+/// @param stride The distance between the adjacent rows of m, in float-s.
+/// @param res The resulting vector of length h (the column indices of
+/// the maximums) or w (the row indices of the maximums). The first index
+/// wins the ties. NaN-s are skipped; if there are only NaN-s, the index
+/// is -1.
+/// @pre w and h are less than 2^24.
+void matrix_argmax(int simd, MatrixDirection direction, const float *m,
+                   size_t w, size_t h, size_t stride, int *res)
+    NOTNULL(3,7);
 /// @brief Multiplies two matrices.
 /// @param simd Value which indicates whether to use SIMD acceleration or not.
 /// @param m1 The first matrix in row-major format.
@@ -84,10 +227,433 @@ void matrix_multiply(int simd, const float *m1, const float *m2,
 /// @param res The resulting matrix, of size h2 x h1.
 /// @pre w1 must be equal to w2.
 /// @note This function typically performs 10% faster than matrix_multiply().
+/// The transposed operand can be obtained with matrix_transpose().
 void matrix_multiply_transposed(int simd, const float *m1, const float *m2,
                                 size_t w1, size_t h1, size_t w2, size_t h2,
                                 float *res) NOTNULL(2,3,8);
 
+/// @brief The same as matrix_multiply() in double precision.
+/// @param simd Value which indicates whether to use SIMD acceleration or not.
+/// @param m1 The first matrix in row-major format.
+/// @param m2 The seconds matrix in row-major format.
+/// @param w1 The width of the first matrix (the number of columns).
+/// @param h1 The height of the first matrix (the number of rows).
+/// @param w2 The width of the second matrix (the number of columns).
+/// @param h2 The height of the second matrix (the number of rows).
+/// @param res The resulting matrix, of size w2 x h1.
+/// @pre w1 must be equal to h2.
+/// @note 32-bit NEON has no double precision vectors, so on ARM the
+/// calculation is scalar.
+void matrix_multiply_double(int simd, const double *m1, const double *m2,
+                            size_t w1, size_t h1, size_t w2, size_t h2,
+                            double *res) NOTNULL(2,3,8);
+
+/// @brief The same as matrix_multiply_transposed() in double precision.
+/// @param simd Value which indicates whether to use SIMD acceleration or not.
+/// @param m1 The first matrix in row-major format.
+/// @param m2 The seconds matrix in row-major format.
+/// @param w1 The width of the first matrix (the number of columns).
+/// @param h1 The height of the first matrix (the number of rows).
+/// @param w2 The width of the second (transposed) matrix
+/// (the number of columns).
+/// @param h2 The height of the second (transposed) matrix
+/// (the number of rows).
+/// @param res The resulting matrix, of size h2 x h1.
+/// @pre w1 must be equal to w2.
+/// @note 32-bit NEON has no double precision vectors, so on ARM the
+/// calculation is scalar.
+void matrix_multiply_transposed_double(int simd, const double *m1,
+                                       const double *m2, size_t w1,
+                                       size_t h1, size_t w2, size_t h2,
+                                       double *res) NOTNULL(2,3,8);
+
+/// @brief General matrix multiplication, C = alpha * op(A) * op(B) +
+/// beta * C, where op(X) is X or its transpose. All matrices are in
+/// row-major format and may be the views into larger ones.
+/// @param simd Value which indicates whether to use SIMD acceleration or not.
+/// @param transA Value which indicates whether op(A) is the transposed A.
+/// @param transB Value which indicates whether op(B) is the transposed B.
+/// @param M The number of rows in op(A) and C.
+/// @param N The number of columns in op(B) and C.
+/// @param K The number of columns in op(A) and rows in op(B).
+/// @param alpha The scale of the product.
+/// @param A The first matrix, M x K (K x M if transA is set).
+/// @param lda The distance between the adjacent rows of A, in float-s.
+/// @param B The second matrix, K x N (N x K if transB is set).
+/// @param ldb The distance between the adjacent rows of B, in float-s.
+/// @param beta The scale of the initial C. If it is zero, C is not read.
+/// @param C The resulting matrix, M x N.
+/// @param ldc The distance between the adjacent rows of C, in float-s.
+/// @note The scaling and the accumulation are fused into the stores of
+/// the multiplication kernel, so no extra passes over C are made.
+void matrix_gemm(int simd, int transA, int transB,
+                 size_t M, size_t N, size_t K, float alpha,
+                 const float *A, size_t lda, const float *B, size_t ldb,
+                 float beta, float *C, size_t ldc) NOTNULL(8,10,13);
+
+/// @brief The same as matrix_gemm(), B being stored in a 16-bit floating
+/// point format.
+/// @param simd Value which indicates whether to use SIMD acceleration or not.
+/// @param type The format of B.
+/// @param transA Value which indicates whether op(A) is the transposed A.
+/// @param transB Value which indicates whether op(B) is the transposed B.
+/// @param M The number of rows in op(A) and C.
+/// @param N The number of columns in op(B) and C.
+/// @param K The number of columns in op(A) and rows in op(B).
+/// @param alpha The scale of the product.
+/// @param A The first matrix, M x K (K x M if transA is set).
+/// @param lda The distance between the adjacent rows of A, in float-s.
+/// @param B The second matrix, K x N (N x K if transB is set).
+/// @param ldb The distance between the adjacent rows of B, in elements.
+/// @param beta The scale of the initial C. If it is zero, C is not read.
+/// @param C The resulting matrix, M x N.
+/// @param ldc The distance between the adjacent rows of C, in float-s.
+/// @details B is converted to float-s while it is packed, so the
+/// multiplication itself runs at the full float speed and precision.
+/// IEEE halves are converted with F16C (x86) or the NEON fp16 extension
+/// if the build enables them and with the scalar code otherwise.
+void matrix_gemm_half(int simd, HalfFloatType type, int transA, int transB,
+                      size_t M, size_t N, size_t K, float alpha,
+                      const float *A, size_t lda, const uint16_t *B,
+                      size_t ldb, float beta, float *C, size_t ldc)
+    NOTNULL(9,11,14);
+
+/// @brief The same as matrix_gemm(), followed by adding a bias to every row
+/// of C and applying an activation function:
+/// C = f(alpha * op(A) * op(B) + beta * C + 1 * bias^T).
+/// @param simd Value which indicates whether to use SIMD acceleration or not.
+/// @param transA Value which indicates whether op(A) is the transposed A.
+/// @param transB Value which indicates whether op(B) is the transposed B.
+/// @param M The number of rows in op(A) and C.
+/// @param N The number of columns in op(B) and C.
+/// @param K The number of columns in op(A) and rows in op(B).
+/// @param alpha The scale of the product.
+/// @param A The first matrix, M x K (K x M if transA is set).
+/// @param lda The distance between the adjacent rows of A, in float-s.
+/// @param B The second matrix, K x N (N x K if transB is set).
+/// @param ldb The distance between the adjacent rows of B, in float-s.
+/// @param beta The scale of the initial C. If it is zero, C is not read.
+/// @param bias The vector of length N which is added to every row of C
+/// (e.g., one value per output neuron). It may be NULL.
+/// @param activation The function to apply to every element of C.
+/// @param C The resulting matrix, M x N.
+/// @param ldc The distance between the adjacent rows of C, in float-s.
+/// @details The bias and the activation are applied by the multiplication
+/// kernel while the tile of C is still in registers, so there are no extra
+/// passes over C. tanh and sigmoid use the vectorised exp() of mathfun.h.
+void matrix_gemm_activate(int simd, int transA, int transB,
+                          size_t M, size_t N, size_t K, float alpha,
+                          const float *A, size_t lda,
+                          const float *B, size_t ldb, float beta,
+                          const float *bias, ActivationFunction activation,
+                          float *C, size_t ldc) NOTNULL(8,10,15);
+
+/// @brief Multiplies two matrices like matrix_multiply(), adds the bias
+/// to every row of the result and applies the activation function.
+/// @param simd Value which indicates whether to use SIMD acceleration or not.
+/// @param m1 The first matrix in row-major format.
+/// @param m2 The seconds matrix in row-major format.
+/// @param w1 The width of the first matrix (the number of columns).
+/// @param h1 The height of the first matrix (the number of rows).
+/// @param w2 The width of the second matrix (the number of columns).
+/// @param h2 The height of the second matrix (the number of rows).
+/// @param bias The vector of length w2, may be NULL.
+/// @param activation The function to apply to every element of res.
+/// @param res The resulting matrix, of size w2 x h1.
+/// @pre w1 must be equal to h2.
+/// @see matrix_gemm_activate().
+void matrix_multiply_activate(int simd, const float *m1, const float *m2,
+                              size_t w1, size_t h1, size_t w2, size_t h2,
+                              const float *bias,
+                              ActivationFunction activation,
+                              float *res) NOTNULL(2,3,10);
+
+/// @brief Symmetric rank-k update (SYRK), C = alpha * X * X^T + beta * C,
+/// where X = op(A) - means * 1^T and op(A) is A or its transpose. Only the
+/// upper triangle of C is calculated.
+/// @param simd Value which indicates whether to use SIMD acceleration or not.
+/// @param transA Value which indicates whether op(A) is the transposed A.
+/// Set it to calculate A^T A, e.g., the covariance matrix of the columns.
+/// @param N The number of rows in op(A), the size of C.
+/// @param K The number of columns in op(A).
+/// @param alpha The scale of the product, e.g., 1 / (K - 1) for
+/// the covariance.
+/// @param A The matrix in row-major format, N x K (K x N if transA is set).
+/// @param lda The distance between the adjacent rows of A, in float-s.
+/// @param means The values to subtract from the rows of op(A), of length N.
+/// It may be NULL, then nothing is subtracted.
+/// @param beta The scale of the initial C. If it is zero, C is not read.
+/// @param C The resulting matrix, N x N.
+/// @param ldc The distance between the adjacent rows of C, in float-s.
+/// @param mirror Value which indicates whether to copy the upper triangle
+/// of C to the lower one. Otherwise, the strictly lower triangle is not
+/// touched.
+/// @details The micro-tiles below the diagonal are skipped, so it takes
+/// about a half of the time of matrix_gemm(). The means are subtracted
+/// while the operands are packed, so A is not copied.
+/// @note matrix_multiply_transposed() calls this function if both operands
+/// are the same matrix.
+void matrix_gram(int simd, int transA, size_t N, size_t K, float alpha,
+                 const float *A, size_t lda, const float *means, float beta,
+                 float *C, size_t ldc, int mirror) NOTNULL(6,10);
+
+/// @brief Returns the size of the workspace which
+/// matrix_multiply_strassen() needs.
+/// @param M The number of rows in A and C.
+/// @param N The number of columns in B and C.
+/// @param K The number of columns in A and rows in B.
+/// @param crossover The same as in matrix_multiply_strassen().
+/// @return The number of float-s, 0 if the recursion is not used.
+size_t matrix_multiply_strassen_workspace(size_t M, size_t N, size_t K,
+                                          size_t crossover);
+
+/// @brief Multiplies two matrices with the Strassen-Winograd algorithm,
+/// C = A * B. All matrices are in row-major format and may be the views
+/// into larger ones.
+/// @param simd Value which indicates whether to use SIMD acceleration or not.
+/// @param M The number of rows in A and C.
+/// @param N The number of columns in B and C.
+/// @param K The number of columns in A and rows in B.
+/// @param A The first matrix, M x K.
+/// @param lda The distance between the adjacent rows of A, in float-s.
+/// @param B The second matrix, K x N.
+/// @param ldb The distance between the adjacent rows of B, in float-s.
+/// @param C The resulting matrix, M x N.
+/// @param ldc The distance between the adjacent rows of C, in float-s.
+/// @param crossover The recursion stops and matrix_gemm() is called when
+/// any of the dimensions is not greater than this value. 0 means
+/// the default (1024).
+/// @param workspace The buffer of matrix_multiply_strassen_workspace()
+/// float-s for the temporaries. If it is NULL, the buffer is allocated and
+/// freed internally.
+/// @details Each level of the recursion replaces 8 half-sized products
+/// with 7 and 15 additions of quarters, so two levels save 23% of the
+/// operations. The temporaries take about a third of the size of A
+/// and B.
+/// @note The error bound is weaker than the one of the classical
+/// multiplication and grows with the number of levels; expect a few more
+/// lost bits relative to max|A| * max|B| * K.
+void matrix_multiply_strassen(int simd, size_t M, size_t N, size_t K,
+                              const float *A, size_t lda,
+                              const float *B, size_t ldb,
+                              float *C, size_t ldc, size_t crossover,
+                              float *workspace) NOTNULL(5,7,9);
+
+/// @brief Multiplies a matrix by a column vector.
+/// @param simd Value which indicates whether to use SIMD acceleration or not.
+/// @param m The matrix in row-major format.
+/// @param w The width of the matrix (the number of columns).
+/// @param h The height of the matrix (the number of rows).
+/// @param stride The distance between the adjacent rows of m, in float-s.
+/// @param v The vector of length w.
+/// @param res The resulting vector of length h.
+/// @note matrix_multiply() falls back to this function if the second
+/// matrix is a single column.
+void matrix_vector_multiply(int simd, const float *m, size_t w, size_t h,
+                            size_t stride, const float *v, float *res)
+    NOTNULL(2,6,7);
+
+/// @brief The same as matrix_vector_multiply(), the matrix being stored in
+/// a 16-bit floating point format.
+/// @param simd Value which indicates whether to use SIMD acceleration or not.
+/// @param type The format of m.
+/// @param m The matrix in row-major format.
+/// @param w The width of the matrix (the number of columns).
+/// @param h The height of the matrix (the number of rows).
+/// @param stride The distance between the adjacent rows of m, in elements.
+/// @param v The vector of length w.
+/// @param res The resulting vector of length h.
+/// @details The rows are converted to float-s in registers. Since GEMV is
+/// memory bound, this is up to twice faster than matrix_vector_multiply()
+/// on large matrices.
+void matrix_vector_multiply_half(int simd, HalfFloatType type,
+                                 const uint16_t *m, size_t w, size_t h,
+                                 size_t stride, const float *v, float *res)
+    NOTNULL(3,7,8);
+
+/// @brief Multiplies the transposed matrix by a column vector, that is,
+/// multiplies a row vector by the matrix.
+/// @param simd Value which indicates whether to use SIMD acceleration or not.
+/// @param m The matrix in row-major format.
+/// @param w The width of the matrix (the number of columns).
+/// @param h The height of the matrix (the number of rows).
+/// @param stride The distance between the adjacent rows of m, in float-s.
+/// @param v The vector of length h.
+/// @param res The resulting vector of length w.
+void matrix_transposed_vector_multiply(int simd, const float *m,
+                                       size_t w, size_t h, size_t stride,
+                                       const float *v, float *res)
+    NOTNULL(2,6,7);
+
+/// @brief Multiplies each matrix of the first batch by the corresponding
+/// matrix of the second one.
+/// @param simd Value which indicates whether to use SIMD acceleration or not.
+/// @param layout The memory layout of m1, m2 and res.
+/// @param m1 The batch of the first matrices in row-major format.
+/// @param m2 The batch of the second matrices in row-major format.
+/// @param w1 The width of the first matrices, which is also the height of
+/// the second ones.
+/// @param h1 The height of the first matrices.
+/// @param w2 The width of the second matrices.
+/// @param count The number of matrices in each batch.
+/// @param res The resulting batch of count matrices, each of size w2 x h1.
+/// @details This function is intended for the tiny matrices (3x3, 4x4, 8x8,
+/// 16x16) where the overhead of matrix_multiply() dominates. The common
+/// square sizes have specialised unrolled kernels. The interleaved batches
+/// are vectorised across the matrices, one matrix per SIMD lane; the
+/// contiguous ones are multiplied row by row if w2 is 4, 8 or 16 and
+/// are transposed to the interleaved layout on the fly otherwise.
+void matrix_multiply_batch(int simd, MatrixBatchLayout layout,
+                           const float *m1, const float *m2,
+                           size_t w1, size_t h1, size_t w2, size_t count,
+                           float *res) NOTNULL(3,4,9);
+
+/// @brief Transposes a matrix.
+/// @param simd Value which indicates whether to use SIMD acceleration or not.
+/// @param src The matrix to transpose in row-major format.
+/// @param w The width of the matrix (the number of columns).
+/// @param h The height of the matrix (the number of rows).
+/// @param dst The resulting matrix of size h x w. It must not overlap
+/// with src.
+/// @details The matrix is walked by the blocks which fit into L1 cache,
+/// each block is transposed with 8x8 (AVX) or 4x4 (NEON) register tiles.
+/// The blocks are split between threads for large matrices.
+void matrix_transpose(int simd, const float *src, size_t w, size_t h,
+                      float *dst) NOTNULL(2,5);
+
+/// @brief Transposes a square matrix in place.
+/// @param simd Value which indicates whether to use SIMD acceleration or not.
+/// @param m The matrix to transpose in row-major format.
+/// @param n The width and the height of the matrix.
+void matrix_transpose_inplace(int simd, float *m, size_t n) NOTNULL(2);
+
+/// @brief Multiplies the quantized matrices, C = (A - aZeroPoint) *
+/// (B - bZeroPoint), with exact int32 accumulation.
+/// @param simd Value which indicates whether to use SIMD acceleration or not.
+/// @param A The first matrix in row-major format, M x K.
+/// @param aZeroPoint The zero point of A, in [0, 255].
+/// @param B The second matrix in row-major format, K x N.
+/// @param bZeroPoint The zero point of B, in [-128, 127].
+/// @param M The number of rows in A and C.
+/// @param N The number of columns in B and C.
+/// @param K The number of columns in A and rows in B.
+/// @param C The resulting matrix, M x N.
+/// @details The operands are packed into the blocks like in matrix_gemm(),
+/// widened to int16 with the zero points subtracted; the kernel sums the
+/// adjacent pairs along K with pmaddwd (AVX2) or vmlal (NEON).
+/// @pre K <= 32768, so that the sums cannot overflow.
+void matrix_multiply_u8s8(int simd, const uint8_t *A, int aZeroPoint,
+                          const int8_t *B, int bZeroPoint,
+                          size_t M, size_t N, size_t K, int32_t *C)
+    NOTNULL(2,4,9);
+
+/// @brief Multiplies the quantized matrices like matrix_multiply_u8s8() and
+/// converts the result to float: C = scale * sum + bias.
+/// @param simd Value which indicates whether to use SIMD acceleration or not.
+/// @param A The first matrix in row-major format, M x K.
+/// @param aZeroPoint The zero point of A, in [0, 255].
+/// @param B The second matrix in row-major format, K x N.
+/// @param bZeroPoint The zero point of B, in [-128, 127].
+/// @param M The number of rows in A and C.
+/// @param N The number of columns in B and C.
+/// @param K The number of columns in A and rows in B.
+/// @param scaleType Whether there is a single scale or one per row or column.
+/// @param scales The scales, usually the product of the scales of A and B.
+/// @param bias The values to add to every row, of length N. May be NULL.
+/// @param C The resulting matrix, M x N.
+/// @note With AVX2 or NEON, the epilogue of the complete tiles is applied to
+/// the accumulator registers of the multiplication kernel, so their int32
+/// sums are never written to memory. The partial tiles at the edges of C
+/// are stored to a small buffer and finished by the scalar code.
+void matrix_multiply_u8s8_dequantize(int simd, const uint8_t *A,
+                                     int aZeroPoint, const int8_t *B,
+                                     int bZeroPoint, size_t M, size_t N,
+                                     size_t K, QuantizationScaleType scaleType,
+                                     const float *scales, const float *bias,
+                                     float *C) NOTNULL(2,4,10,12);
+
+/// @brief Multiplies the quantized matrices like matrix_multiply_u8s8() and
+/// requantizes the result: C = saturate(round(scale * sum) + cZeroPoint).
+/// @param simd Value which indicates whether to use SIMD acceleration or not.
+/// @param A The first matrix in row-major format, M x K.
+/// @param aZeroPoint The zero point of A, in [0, 255].
+/// @param B The second matrix in row-major format, K x N.
+/// @param bZeroPoint The zero point of B, in [-128, 127].
+/// @param M The number of rows in A and C.
+/// @param N The number of columns in B and C.
+/// @param K The number of columns in A and rows in B.
+/// @param scaleType Whether there is a single scale or one per row or column.
+/// @param scales The scales, usually scale(A) * scale(B) / scale(C).
+/// @param cZeroPoint The zero point of C.
+/// @param C The resulting matrix, M x N.
+/// @note With AVX2, the epilogue of the complete tiles is applied to the
+/// accumulator registers, like in matrix_multiply_u8s8_dequantize(). ARMv7
+/// NEON cannot round to nearest while converting, so there all the tiles are
+/// requantized from a small int32 buffer by the scalar code.
+void matrix_multiply_u8s8_requantize(int simd, const uint8_t *A,
+                                     int aZeroPoint, const int8_t *B,
+                                     int bZeroPoint, size_t M, size_t N,
+                                     size_t K, QuantizationScaleType scaleType,
+                                     const float *scales, int cZeroPoint,
+                                     uint8_t *C) NOTNULL(2,4,10,12);
+
+/// @brief Converts a dense matrix to the compressed sparse row format.
+/// @param m The matrix in row-major format.
+/// @param w The width of the matrix (the number of columns).
+/// @param h The height of the matrix (the number of rows).
+/// @param stride The distance between the adjacent rows of m, in float-s.
+/// @return The sparse matrix which should be disposed with
+/// matrix_sparse_finalize().
+SparseMatrix matrix_sparse_from_dense(const float *m, size_t w, size_t h,
+                                      size_t stride) NOTNULL(1);
+
+/// @brief Frees the memory allocated by matrix_sparse_from_dense().
+/// @param matrix The sparse matrix to dispose.
+void matrix_sparse_finalize(SparseMatrix matrix);
+
+/// @brief Multiplies a sparse matrix by a dense column vector.
+/// @param simd Value which indicates whether to use SIMD acceleration or not.
+/// @param m The sparse matrix.
+/// @param v The vector of length m->width.
+/// @param res The resulting vector of length m->height.
+/// @details The non-zeros of each row are gathered eight at a time on AVX2
+/// (four at a time on NEON). With several threads, the rows are split
+/// so that every thread gets the same number of non-zeros.
+void matrix_sparse_vector_multiply(int simd, const SparseMatrix *m,
+                                   const float *v, float *res)
+    NOTNULL(2,3,4);
+
+/// @brief Multiplies a sparse matrix by a dense one.
+/// @param simd Value which indicates whether to use SIMD acceleration or not.
+/// @param m1 The first (sparse) matrix.
+/// @param m2 The second matrix in row-major format, of size
+/// w2 x m1->width.
+/// @param w2 The width of the second matrix (the number of columns).
+/// @param res The resulting matrix, of size w2 x m1->height.
+/// @details Each row of the result is accumulated in registers over the
+/// dense columns, so it is written once. The rows are split between the
+/// threads like in matrix_sparse_vector_multiply().
+void matrix_sparse_multiply(int simd, const SparseMatrix *m1,
+                            const float *m2, size_t w2, float *res)
+    NOTNULL(2,3,5);
+
+/// @brief Sets the number of threads which matrix_multiply(),
+/// matrix_multiply_transposed(), matrix_gemm(), matrix_gemm_half(),
+/// matrix_gram(), matrix_vector_multiply(), matrix_vector_multiply_half(),
+/// matrix_transposed_vector_multiply(), matrix_transpose(),
+/// matrix_transpose_inplace(), the sparse and the quantized multiplications,
+/// the batched linalg functions and pairwise_distances_topk() split the work
+/// between.
+/// @param threads The number of threads. 0 means as many as OpenMP offers
+/// (this is the default).
+/// @note Small matrices are always multiplied in the calling thread.
+/// The setting has no effect if the library is built without OpenMP.
+void matrix_set_threads(int threads);
+
+/// @brief Returns the number of threads set with matrix_set_threads().
+/// @return The number of threads, 0 means as many as OpenMP offers.
+int matrix_get_threads(void);
+
 SIMD_API_END
 
 #endif  // INC_SIMD_MATRIX_H_
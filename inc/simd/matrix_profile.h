@@ -0,0 +1,75 @@
+/*! @file matrix_profile.h
+ *  @brief Matrix profile (sliding window self-similarity join) of a series.
+ *  @author Markovtsev Vadim <v.markovtsev@samsung.com>
+ *  @version 1.0
+ *
+ *  @section Notes
+ *  This code partially conforms to <a href="http://google-styleguide.googlecode.com/svn/trunk/cppguide.xml">Google C++ Style Guide</a>.
+ *
+ *  @section Copyright
+ *  Copyright © 2013 Samsung R&D Institute Russia
+ *
+ *  @section License
+ *  Licensed to the Apache Software Foundation (ASF) under one
+ *  or more contributor license agreements.  See the NOTICE file
+ *  distributed with this work for additional information
+ *  regarding copyright ownership.  The ASF licenses this file
+ *  to you under the Apache License, Version 2.0 (the
+ *  "License"); you may not use this file except in compliance
+ *  with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an
+ *  "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ *  KIND, either express or implied.  See the License for the
+ *  specific language governing permissions and limitations
+ *  under the License.
+ */
+
+#ifndef INC_SIMD_MATRIX_PROFILE_H_
+#define INC_SIMD_MATRIX_PROFILE_H_
+
+#include <stddef.h>
+#include <simd/common.h>
+#include <simd/attributes.h>
+
+SIMD_API_BEGIN
+
+/// @brief Returns the half width of the exclusion zone around the diagonal
+/// which matrix_profile() uses to skip trivial matches.
+/// @param window The subsequence length.
+/// @return ceil(window / 4).
+int matrix_profile_exclusion_zone(size_t window);
+
+/// @brief Calculates the matrix profile of a series, that is, the
+/// z-normalized Euclidean distance from every subsequence of length window
+/// to its nearest neighbour, excluding trivial matches.
+/// @param simd Value indicating whether to use SIMD acceleration or not.
+/// @param series The series to analyse.
+/// @param length The length of series (in float-s, not in bytes).
+/// @param window The length of the subsequences (in float-s, not in bytes).
+/// @param threads The number of threads to split the diagonals between.
+/// 0 means the number of available processors.
+/// @param profile The resulting matrix profile of length
+/// (length - window + 1).
+/// @param index The resulting matrix profile index of length
+/// (length - window + 1), that is, the position of the nearest neighbour of
+/// each subsequence. It may be NULL. If some subsequence has no neighbour
+/// outside the exclusion zone, the corresponding profile value is INFINITY
+/// and the index is -1.
+/// @details The sliding dot products of the first subsequence are calculated
+/// with cross_correlate(), the rest of the distance matrix is updated along
+/// the diagonals in O(1) per element. The overall complexity is O(n^2).
+/// @note Subsequences with zero variance are treated as uncorrelated with
+/// anything, so their distances are sqrt(2 * window).
+/// @pre window >= 2.
+/// @pre length >= window.
+void matrix_profile(int simd, const float *series, size_t length,
+                    size_t window, int threads, float *profile, int *index)
+    NOTNULL(2, 6);
+
+SIMD_API_END
+
+#endif  // INC_SIMD_MATRIX_PROFILE_H_
@@ -29,7 +29,9 @@
 #define INC_SIMD_NEON_MATHFUN_H_
 
 #pragma GCC diagnostic push
+#ifdef __cplusplus
 #pragma GCC diagnostic ignored "-Wold-style-cast"
+#endif
 
 #include <arm_neon.h>
 
@@ -31,6 +31,7 @@
 #ifndef INC_SIMD_NORMALIZE_H_
 #define INC_SIMD_NORMALIZE_H_
 
+#include <stddef.h>
 #include <stdint.h>
 #include <simd/common.h>
 
@@ -89,6 +90,231 @@ void normalize2D_minmax(int simd, uint8_t min, uint8_t max,
 void minmax1D(int simd, const float *src, int length, float *min,
               float *max) NOTNULL(2);
 
+/// @brief The same as normalize2D(), but splits the plane into row bands
+/// which are processed in parallel.
+/// @param simd Value indicating whether to use available SIMD acceleration.
+/// @param threads The number of threads to split the rows between.
+/// 0 means the number of available processors.
+/// @param src The source byte array, stored in row-major format.
+/// @param src_stride The stride (the actual width) of the plane.
+/// @param width The width of the plane.
+/// @param height The height of the plane.
+/// @param dst The resulting floating point array.
+/// @param dst_stride The stride of dst.
+/// @details See minmax2D_parallel() and normalize2D_minmax_parallel().
+void normalize2D_parallel(int simd, int threads, const uint8_t *src,
+                          int src_stride, int width, int height,
+                          float *dst, int dst_stride) NOTNULL(3, 7);
+
+/// @brief The same as minmax2D(), but splits the plane into row bands
+/// which are reduced in parallel.
+/// @param simd Value indicating whether to use available SIMD acceleration.
+/// @param threads The number of threads to split the rows between.
+/// 0 means the number of available processors.
+/// @param src The source byte array, stored in row-major format.
+/// @param src_stride The stride (the actual width) of the plane.
+/// @param width The width of the plane.
+/// @param height The height of the plane.
+/// @param min The pointer to the resulting minimum. If NULL, minimum is not
+/// calculated.
+/// @param max The pointer to the resulting maximum. If NULL, maximum is not
+/// calculated.
+/// @note Planes smaller than 256K pixels, as well as builds without
+/// OpenMP, are processed in a single thread.
+void minmax2D_parallel(int simd, int threads, const uint8_t *src,
+                       int src_stride, int width, int height,
+                       uint8_t *min, uint8_t *max) NOTNULL(3);
+
+/// @brief The same as normalize2D_minmax(), but splits the plane into row
+/// bands which are processed in parallel.
+/// @param simd Value indicating whether to use available SIMD acceleration.
+/// @param threads The number of threads to split the rows between.
+/// 0 means the number of available processors.
+/// @param min The precalculated minimum value.
+/// @param max The precalculated maximum value.
+/// @param src The source byte array, stored in row-major format.
+/// @param src_stride The stride (the actual width) of the plane.
+/// @param width The width of the plane.
+/// @param height The height of the plane.
+/// @param dst The resulting floating point array.
+/// @param dst_stride The stride of dst.
+/// @details If dst is larger than the last level cache, it is written with
+/// the non-temporal (streaming) stores on x86, so that the output does not
+/// evict the source from the cache. See normalize2D_set_stream_threshold().
+void normalize2D_minmax_parallel(int simd, int threads,
+                                 uint8_t min, uint8_t max,
+                                 const uint8_t *src, int src_stride,
+                                 int width, int height,
+                                 float *dst, int dst_stride) NOTNULL(5, 9);
+
+/// @brief Sets the size of dst above which normalize2D_parallel() and
+/// normalize2D_minmax_parallel() use the streaming stores.
+/// @param bytes The size in bytes. 0 means the size of the last level cache
+/// (this is the default).
+void normalize2D_set_stream_threshold(size_t bytes);
+
+/// @brief Performs the plane normalization [min, max] -> [-1, 1] of a 16-bit
+/// plane (e.g., a depth map). Minimum and maximum is determined from the
+/// array.
+/// @param simd Value indicating whether to use available SIMD acceleration.
+/// @param src The source array, stored in row-major format.
+/// @param src_stride The stride (the actual width) of the plane in elements.
+/// @param width The width of the plane.
+/// @param height The height of the plane.
+/// @param dst The resulting floating point array.
+/// @param dst_stride The stride of dst.
+void normalize2D_u16(int simd, const uint16_t *src, int src_stride,
+                     int width, int height, float *dst, int dst_stride)
+    NOTNULL(2, 6);
+
+/// @brief Finds the minimum and the maximum value in the specified 16-bit
+/// plane.
+/// @param simd Value indicating whether to use available SIMD acceleration.
+/// @param src The source array, stored in row-major format.
+/// @param src_stride The stride (the actual width) of the plane in elements.
+/// @param width The width of the plane.
+/// @param height The height of the plane.
+/// @param min The pointer to the resulting minimum. If NULL, minimum is not
+/// calculated.
+/// @param max The pointer to the resulting maximum. If NULL, maximum is not
+/// calculated.
+void minmax2D_u16(int simd, const uint16_t *src, int src_stride,
+                  int width, int height, uint16_t *min, uint16_t *max)
+    NOTNULL(2);
+
+/// @brief Performs the plane normalization [min, max] -> [-1, 1] of a 16-bit
+/// plane.
+/// @param simd Value indicating whether to use available SIMD acceleration.
+/// @param min The precalculated minimum value.
+/// @param max The precalculated maximum value.
+/// @param src The source array, stored in row-major format.
+/// @param src_stride The stride (the actual width) of the plane in elements.
+/// @param width The width of the plane.
+/// @param height The height of the plane.
+/// @param dst The resulting floating point array.
+/// @param dst_stride The stride of dst.
+void normalize2D_minmax_u16(int simd, uint16_t min, uint16_t max,
+                            const uint16_t *src, int src_stride,
+                            int width, int height, float *dst, int dst_stride)
+    NOTNULL(4, 8);
+
+/// @brief Performs the plane normalization [min, max] -> [-1, 1] of a
+/// floating point plane. Minimum and maximum is determined from the array.
+/// @param simd Value indicating whether to use available SIMD acceleration.
+/// @param src The source array, stored in row-major format.
+/// @param src_stride The stride (the actual width) of the plane in float-s.
+/// @param width The width of the plane.
+/// @param height The height of the plane.
+/// @param dst The resulting floating point array. It may be the same as src
+/// if dst_stride is equal to src_stride.
+/// @param dst_stride The stride of dst.
+void normalize2D_f32(int simd, const float *src, int src_stride,
+                     int width, int height, float *dst, int dst_stride)
+    NOTNULL(2, 6);
+
+/// @brief Finds the minimum and the maximum value in the specified floating
+/// point plane.
+/// @param simd Value indicating whether to use available SIMD acceleration.
+/// @param src The source array, stored in row-major format.
+/// @param src_stride The stride (the actual width) of the plane in float-s.
+/// @param width The width of the plane.
+/// @param height The height of the plane.
+/// @param min The pointer to the resulting minimum. If NULL, minimum is not
+/// calculated.
+/// @param max The pointer to the resulting maximum. If NULL, maximum is not
+/// calculated.
+/// @note The result is undefined if the plane contains NaN-s.
+void minmax2D_f32(int simd, const float *src, int src_stride,
+                  int width, int height, float *min, float *max)
+    NOTNULL(2);
+
+/// @brief Performs the plane normalization [min, max] -> [-1, 1] of a
+/// floating point plane.
+/// @param simd Value indicating whether to use available SIMD acceleration.
+/// @param min The precalculated minimum value.
+/// @param max The precalculated maximum value.
+/// @param src The source array, stored in row-major format.
+/// @param src_stride The stride (the actual width) of the plane in float-s.
+/// @param width The width of the plane.
+/// @param height The height of the plane.
+/// @param dst The resulting floating point array. It may be the same as src
+/// if dst_stride is equal to src_stride.
+/// @param dst_stride The stride of dst.
+void normalize2D_minmax_f32(int simd, float min, float max,
+                            const float *src, int src_stride,
+                            int width, int height, float *dst, int dst_stride)
+    NOTNULL(4, 8);
+
+/// @brief The layout of the multichannel normalization result.
+typedef enum {
+  /// The channels stay interleaved, exactly as in the source.
+  kNormalizeInterleaved,
+  /// Each channel is written to a separate plane. The plane of channel c
+  /// starts at dst + c * height * dst_stride.
+  kNormalizePlanar
+} NormalizeLayout;
+
+/// @brief Finds the minimum and the maximum value of every channel in the
+/// specified interleaved image (e.g., RGB or RGBA).
+/// @param simd Value indicating whether to use available SIMD acceleration.
+/// @param src The source byte array, stored in row-major format.
+/// @param src_stride The stride of the image in bytes, that is, at least
+/// width * channels.
+/// @param width The width of the image in pixels.
+/// @param height The height of the image.
+/// @param channels The number of interleaved channels, from 1 to 4.
+/// @param min The array of length channels for the resulting minimums.
+/// If NULL, minimums are not calculated.
+/// @param max The array of length channels for the resulting maximums.
+/// If NULL, maximums are not calculated.
+void minmax2D_interleaved(int simd, const uint8_t *src, int src_stride,
+                          int width, int height, int channels,
+                          uint8_t *min, uint8_t *max) NOTNULL(2);
+
+/// @brief Performs the normalization [min, max] -> [-1, 1] of every channel
+/// of the specified interleaved image.
+/// @param simd Value indicating whether to use available SIMD acceleration.
+/// @param min The array of length channels with the precalculated minimums.
+/// @param max The array of length channels with the precalculated maximums.
+/// @param src The source byte array, stored in row-major format.
+/// @param src_stride The stride of the image in bytes, that is, at least
+/// width * channels.
+/// @param width The width of the image in pixels.
+/// @param height The height of the image.
+/// @param channels The number of interleaved channels, from 1 to 4.
+/// @param layout The layout of dst.
+/// @param dst The resulting floating point array.
+/// @param dst_stride The stride of dst in float-s. It must be at least
+/// width * channels for kNormalizeInterleaved and at least width for
+/// kNormalizePlanar.
+/// @note Channels with min equal to max are set to 0.
+void normalize2D_interleaved_minmax(int simd, const uint8_t *min,
+                                    const uint8_t *max, const uint8_t *src,
+                                    int src_stride, int width, int height,
+                                    int channels, NormalizeLayout layout,
+                                    float *dst, int dst_stride)
+    NOTNULL(2, 3, 4, 10);
+
+/// @brief Performs the normalization [min, max] -> [-1, 1] of the specified
+/// interleaved image. Minimums and maximums are determined from the image.
+/// @param simd Value indicating whether to use available SIMD acceleration.
+/// @param src The source byte array, stored in row-major format.
+/// @param src_stride The stride of the image in bytes, that is, at least
+/// width * channels.
+/// @param width The width of the image in pixels.
+/// @param height The height of the image.
+/// @param channels The number of interleaved channels, from 1 to 4.
+/// @param joint If nonzero, all the channels share the same minimum and
+/// maximum, otherwise each channel is normalized independently.
+/// @param layout The layout of dst.
+/// @param dst The resulting floating point array.
+/// @param dst_stride The stride of dst in float-s (see
+/// normalize2D_interleaved_minmax()).
+void normalize2D_interleaved(int simd, const uint8_t *src, int src_stride,
+                             int width, int height, int channels, int joint,
+                             NormalizeLayout layout, float *dst,
+                             int dst_stride) NOTNULL(2, 9);
+
 SIMD_API_END
 
 #endif  // INC_SIMD_NORMALIZE_H_
@@ -0,0 +1,104 @@
+/*! @file pairwise_distances.h
+ *  @brief Distance matrices between two sets of points.
+ *  @author Markovtsev Vadim <v.markovtsev@samsung.com>
+ *  @version 1.0
+ *
+ *  @section Notes
+ *  This code partially conforms to <a href="http://google-styleguide.googlecode.com/svn/trunk/cppguide.xml">Google C++ Style Guide</a>.
+ *
+ *  @section Copyright
+ *  Copyright © 2013 Samsung R&D Institute Russia
+ *
+ *  @section License
+ *  Licensed to the Apache Software Foundation (ASF) under one
+ *  or more contributor license agreements.  See the NOTICE file
+ *  distributed with this work for additional information
+ *  regarding copyright ownership.  The ASF licenses this file
+ *  to you under the Apache License, Version 2.0 (the
+ *  "License"); you may not use this file except in compliance
+ *  with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an
+ *  "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ *  KIND, either express or implied.  See the License for the
+ *  specific language governing permissions and limitations
+ *  under the License.
+ */
+
+
+#ifndef INC_SIMD_PAIRWISE_DISTANCES_H_
+#define INC_SIMD_PAIRWISE_DISTANCES_H_
+
+#include <stddef.h>
+#include <simd/common.h>
+#include <simd/attributes.h>
+
+SIMD_API_BEGIN
+
+/// @brief The metrics which pairwise_distances() supports.
+typedef enum {
+  /// @brief ||a - b||^2.
+  kDistanceSquaredEuclidean,
+  /// @brief ||a - b||.
+  kDistanceEuclidean,
+  /// @brief 1 - a . b / (||a|| ||b||), the similarity of zero vectors with
+  /// anything is 0.
+  kDistanceCosine
+} DistanceMetric;
+
+/// @brief Calculates the distances between all the pairs of points of two
+/// sets.
+/// @param simd Value which indicates whether to use SIMD acceleration or not.
+/// @param metric The distance metric.
+/// @param a The first set of points, one point (dim float-s) per row.
+/// @param na The number of points in the first set.
+/// @param b The second set of points, one point (dim float-s) per row.
+/// It may be the same as a.
+/// @param nb The number of points in the second set.
+/// @param dim The number of coordinates of each point.
+/// @param res The resulting matrix with na rows and nb columns:
+/// res[i * nb + j] is the distance between a[i] and b[j].
+/// @details The distances are expanded into ||a||^2 + ||b||^2 - 2 a . b
+/// (a . b / (||a|| ||b||) for the cosine metric), the dot products are
+/// calculated with matrix_gemm(). The rows of res are processed in blocks
+/// which fit into the cache, so that the norms are added, the negative
+/// round off is clamped and the square root is taken while the block is
+/// still hot.
+/// @note If b is a, the diagonal of res is exactly 0.
+void pairwise_distances(int simd, DistanceMetric metric,
+                        const float *a, size_t na, const float *b, size_t nb,
+                        size_t dim, float *res) NOTNULL(3, 5, 8);
+
+/// @brief Finds the k nearest points of the second set for each point of
+/// the first one, without calculating the whole distance matrix.
+/// @param simd Value which indicates whether to use SIMD acceleration or not.
+/// @param metric The distance metric.
+/// @param a The first set of points, one point (dim float-s) per row.
+/// @param na The number of points in the first set.
+/// @param b The second set of points, one point (dim float-s) per row.
+/// It may be the same as a.
+/// @param nb The number of points in the second set.
+/// @param dim The number of coordinates of each point.
+/// @param k The number of the nearest points to find.
+/// @param distances The resulting distances, k per each point of a: row i
+/// contains the distances from a[i] to its k nearest points in ascending
+/// order. Ties are resolved in favour of the lower index.
+/// @param indices The indices of the nearest points in b, k per each point
+/// of a.
+/// @details The distance matrix is calculated by the tiles like in
+/// pairwise_distances(), each tile is merged into the per row max-heaps
+/// of size k (distances and indices are used as the heaps) and discarded.
+/// The rows are split between the OpenMP threads.
+/// @pre k <= nb.
+void pairwise_distances_topk(int simd, DistanceMetric metric,
+                             const float *a, size_t na,
+                             const float *b, size_t nb, size_t dim,
+                             size_t k, float *distances, int *indices)
+    NOTNULL(3, 5, 9, 10);
+
+SIMD_API_END
+
+#endif  // INC_SIMD_PAIRWISE_DISTANCES_H_
@@ -0,0 +1,150 @@
+/*! @file vector.h
+ *  @brief BLAS level 1 operations on vectors.
+ *  @author Markovtsev Vadim <v.markovtsev@samsung.com>
+ *  @version 1.0
+ *
+ *  @section Notes
+ *  This code partially conforms to <a href="http://google-styleguide.googlecode.com/svn/trunk/cppguide.xml">Google C++ Style Guide</a>.
+ *
+ *  @section Copyright
+ *  Copyright © 2013 Samsung R&D Institute Russia
+ *
+ *  @section License
+ *  Licensed to the Apache Software Foundation (ASF) under one
+ *  or more contributor license agreements.  See the NOTICE file
+ *  distributed with this work for additional information
+ *  regarding copyright ownership.  The ASF licenses this file
+ *  to you under the Apache License, Version 2.0 (the
+ *  "License"); you may not use this file except in compliance
+ *  with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an
+ *  "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ *  KIND, either express or implied.  See the License for the
+ *  specific language governing permissions and limitations
+ *  under the License.
+ */
+
+#ifndef INC_SIMD_VECTOR_H_
+#define INC_SIMD_VECTOR_H_
+
+#include <stddef.h>
+#include <simd/common.h>
+#include <simd/attributes.h>
+
+SIMD_API_BEGIN
+
+/// @brief y = alpha * x + y.
+/// @param simd Value which indicates whether to use SIMD acceleration or not.
+/// @param n The number of elements to process.
+/// @param alpha The scale of x.
+/// @param x The first vector.
+/// @param incx The distance between the adjacent elements of x.
+/// @param y The second vector, which is updated in place.
+/// @param incy The distance between the adjacent elements of y.
+/// @note All the functions in this file are SIMD accelerated if the strides
+/// are equal to 1. Negative strides are not supported.
+void vector_axpy(int simd, size_t n, float alpha,
+                 const float *x, size_t incx, float *y, size_t incy)
+    NOTNULL(4,6);
+
+/// @brief y = alpha * x + beta * y.
+/// @param simd Value which indicates whether to use SIMD acceleration or not.
+/// @param n The number of elements to process.
+/// @param alpha The scale of x.
+/// @param x The first vector.
+/// @param incx The distance between the adjacent elements of x.
+/// @param beta The scale of y. If it is zero, y is not read.
+/// @param y The second vector, which is updated in place.
+/// @param incy The distance between the adjacent elements of y.
+void vector_axpby(int simd, size_t n, float alpha,
+                  const float *x, size_t incx, float beta,
+                  float *y, size_t incy) NOTNULL(4,7);
+
+/// @brief Calculates the dot product of two vectors.
+/// @param simd Value which indicates whether to use SIMD acceleration or not.
+/// @param n The number of elements to process.
+/// @param x The first vector.
+/// @param incx The distance between the adjacent elements of x.
+/// @param y The second vector.
+/// @param incy The distance between the adjacent elements of y.
+/// @return sum(x[i] * y[i]).
+float vector_dot(int simd, size_t n, const float *x, size_t incx,
+                 const float *y, size_t incy) NOTNULL(3,5);
+
+/// @brief Calculates the Euclidean norm of a vector.
+/// @param simd Value which indicates whether to use SIMD acceleration or not.
+/// @param n The number of elements to process.
+/// @param x The vector.
+/// @param incx The distance between the adjacent elements of x.
+/// @return sqrt(sum(x[i]^2)).
+/// @details The squares are accumulated in double precision (on NEON,
+/// the elements are scaled by the maximal magnitude instead), so the result
+/// neither overflows nor underflows unless the norm itself does.
+float vector_nrm2(int simd, size_t n, const float *x, size_t incx)
+    NOTNULL(3);
+
+/// @brief Calculates the sum of the magnitudes of the elements of a vector.
+/// @param simd Value which indicates whether to use SIMD acceleration or not.
+/// @param n The number of elements to process.
+/// @param x The vector.
+/// @param incx The distance between the adjacent elements of x.
+/// @return sum(|x[i]|).
+float vector_asum(int simd, size_t n, const float *x, size_t incx)
+    NOTNULL(3);
+
+/// @brief Finds the element with the maximal magnitude.
+/// @param simd Value which indicates whether to use SIMD acceleration or not.
+/// @param n The number of elements to process.
+/// @param x The vector.
+/// @param incx The distance between the adjacent elements of x.
+/// @return The (zero-based) index of the first element with the maximal
+/// magnitude, or -1 if n is 0. NaN-s are skipped.
+int vector_iamax(int simd, size_t n, const float *x, size_t incx)
+    NOTNULL(3);
+
+/// @brief Finds the element with the minimal magnitude.
+/// @param simd Value which indicates whether to use SIMD acceleration or not.
+/// @param n The number of elements to process.
+/// @param x The vector.
+/// @param incx The distance between the adjacent elements of x.
+/// @return The (zero-based) index of the first element with the minimal
+/// magnitude, or -1 if n is 0. NaN-s are skipped.
+int vector_iamin(int simd, size_t n, const float *x, size_t incx)
+    NOTNULL(3);
+
+/// @brief x = alpha * x.
+/// @param simd Value which indicates whether to use SIMD acceleration or not.
+/// @param n The number of elements to process.
+/// @param alpha The scale.
+/// @param x The vector, which is updated in place.
+/// @param incx The distance between the adjacent elements of x.
+void vector_scal(int simd, size_t n, float alpha, float *x, size_t incx)
+    NOTNULL(4);
+
+/// @brief y = x.
+/// @param simd Value which indicates whether to use SIMD acceleration or not.
+/// @param n The number of elements to process.
+/// @param x The source vector.
+/// @param incx The distance between the adjacent elements of x.
+/// @param y The destination vector.
+/// @param incy The distance between the adjacent elements of y.
+void vector_copy(int simd, size_t n, const float *x, size_t incx,
+                 float *y, size_t incy) NOTNULL(3,5);
+
+/// @brief Exchanges the contents of two vectors.
+/// @param simd Value which indicates whether to use SIMD acceleration or not.
+/// @param n The number of elements to process.
+/// @param x The first vector.
+/// @param incx The distance between the adjacent elements of x.
+/// @param y The second vector.
+/// @param incy The distance between the adjacent elements of y.
+void vector_swap(int simd, size_t n, float *x, size_t incx,
+                 float *y, size_t incy) NOTNULL(3,5);
+
+SIMD_API_END
+
+#endif  // INC_SIMD_VECTOR_H_
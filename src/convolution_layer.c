@@ -0,0 +1,170 @@
+/*! @file convolution_layer.c
+ *  @brief Multi-channel 2D convolution layer lowered to matrix multiplication.
+ *  @author Markovtsev Vadim <v.markovtsev@samsung.com>
+ *  @version 1.0
+ *
+ *  @section Notes
+ *  This code partially conforms to <a href="http://google-styleguide.googlecode.com/svn/trunk/cppguide.xml">Google C++ Style Guide</a>.
+ *
+ *  @section Copyright
+ *  Copyright © 2013 Samsung R&D Institute Russia
+ *
+ *  @section License
+ *  Licensed to the Apache Software Foundation (ASF) under one
+ *  or more contributor license agreements.  See the NOTICE file
+ *  distributed with this work for additional information
+ *  regarding copyright ownership.  The ASF licenses this file
+ *  to you under the Apache License, Version 2.0 (the
+ *  "License"); you may not use this file except in compliance
+ *  with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an
+ *  "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ *  KIND, either express or implied.  See the License for the
+ *  specific language governing permissions and limitations
+ *  under the License.
+ */
+
+#define LIBSIMD_IMPLEMENTATION
+#include "inc/simd/convolution_layer.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "inc/simd/arithmetic-inl.h"
+#include "inc/simd/matrix.h"
+
+/// The maximal size of the im2col band, in float-s (256 KB).
+#define IM2COL_BAND_SIZE (64 * 1024)
+
+int convolution_layer_output_size(int size, int kernelSize, int stride,
+                                  int padding) {
+  return (size + 2 * padding - kernelSize) / stride + 1;
+}
+
+/// @brief Fills the im2col matrix for the output rows [y0, y0 + rows).
+/// @details The matrix has kernelSize * kernelSize * channels rows ordered
+/// as the weights are, and rows * outWidth columns.
+static void im2col(const float *input, int channels, int width, int height,
+                   int kernelSize, int stride, int padding,
+                   int outWidth, int y0, int rows, float *col) {
+  int columns = rows * outWidth;
+  for (int ky = 0; ky < kernelSize; ky++) {
+    for (int kx = 0; kx < kernelSize; kx++) {
+      // The range of output x which hits the input
+      int xbeg = padding - kx > 0? (padding - kx + stride - 1) / stride : 0;
+      int xend = width + padding - kx > 0?
+          (width + padding - kx + stride - 1) / stride : 0;
+      if (xend > outWidth) {
+        xend = outWidth;
+      }
+      if (xbeg > xend) {
+        xbeg = xend;
+      }
+      for (int c = 0; c < channels; c++) {
+        float *dst = col + (size_t)((ky * kernelSize + kx) * channels + c) *
+            columns;
+        const float *plane = input + (size_t)c * width * height;
+        for (int r = 0; r < rows; r++) {
+          float *out = dst + r * outWidth;
+          int iy = (y0 + r) * stride + ky - padding;
+          if (iy < 0 || iy >= height) {
+            memsetf(out, 0.f, outWidth);
+            continue;
+          }
+          const float *in = plane + (size_t)iy * width + kx - padding;
+          memsetf(out, 0.f, xbeg);
+          if (stride == 1) {
+            memcpy(out + xbeg, in + xbeg, (xend - xbeg) * sizeof(float));
+          } else {
+            for (int x = xbeg; x < xend; x++) {
+              out[x] = in[x * stride];
+            }
+          }
+          memsetf(out + xend, 0.f, outWidth - xend);
+        }
+      }
+    }
+  }
+}
+
+void convolution_layer(int simd, const float *input, int channels,
+                       int width, int height, const float *weights,
+                       const float *bias, int outChannels, int kernelSize,
+                       int stride, int padding, float *output) {
+  assert(input);
+  assert(weights);
+  assert(output);
+  assert(channels > 0 && outChannels > 0);
+  assert(kernelSize > 0 && stride > 0 && padding >= 0);
+  int outWidth = convolution_layer_output_size(width, kernelSize, stride,
+                                               padding);
+  int outHeight = convolution_layer_output_size(height, kernelSize, stride,
+                                                padding);
+  assert(outWidth > 0 && outHeight > 0);
+  int depth = kernelSize * kernelSize * channels;
+
+  // The weights are transposed to outChannels x depth once per call,
+  // which is negligible compared to the multiplication itself
+  float *transposed = mallocf((size_t)depth * outChannels);
+  assert(transposed);
+  for (int d = 0; d < depth; d++) {
+    for (int o = 0; o < outChannels; o++) {
+      transposed[(size_t)o * depth + d] = weights[(size_t)d * outChannels + o];
+    }
+  }
+
+  int bandRows = IM2COL_BAND_SIZE / (depth * outWidth);
+  if (bandRows < 1) {
+    bandRows = 1;
+  }
+  if (bandRows > outHeight) {
+    bandRows = outHeight;
+  }
+  float *col = mallocf((size_t)depth * bandRows * outWidth);
+  float *band = mallocf((size_t)outChannels * bandRows * outWidth);
+  assert(col && band);
+  int planeSize = outWidth * outHeight;
+  for (int y0 = 0; y0 < outHeight; y0 += bandRows) {
+    int rows = outHeight - y0 < bandRows? outHeight - y0 : bandRows;
+    int columns = rows * outWidth;
+    im2col(input, channels, width, height, kernelSize, stride, padding,
+           outWidth, y0, rows, col);
+    matrix_multiply(simd, transposed, col, depth, outChannels, columns, depth,
+                    band);
+    for (int o = 0; o < outChannels; o++) {
+      float *dst = output + (size_t)o * planeSize + y0 * outWidth;
+      const float *src = band + (size_t)o * columns;
+      if (bias == NULL) {
+        memcpy(dst, src, columns * sizeof(float));
+        continue;
+      }
+      if (simd) {
+        int i = 0;
+#ifdef __AVX__
+        __m256 b = _mm256_set1_ps(bias[o]);
+        for (; i < columns - 7; i += 8) {
+          _mm256_storeu_ps(dst + i, _mm256_add_ps(_mm256_loadu_ps(src + i), b));
+        }
+#elif defined(__ARM_NEON__)
+        float32x4_t b = vdupq_n_f32(bias[o]);
+        for (; i < columns - 3; i += 4) {
+          vst1q_f32(dst + i, vaddq_f32(vld1q_f32(src + i), b));
+        }
+#endif
+        for (; i < columns; i++) {
+          dst[i] = src[i] + bias[o];
+        }
+      } else {
+        for (int i = 0; i < columns; i++) {
+          dst[i] = src[i] + bias[o];
+        }
+      }
+    }
+  }
+  free(band);
+  free(col);
+  free(transposed);
+}
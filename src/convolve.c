@@ -28,13 +28,14 @@
  *  under the License.
  */
 
-#ifndef NO_FFTF
 #define LIBSIMD_IMPLEMENTATION
 #include "inc/simd/convolve.h"
 #include <assert.h>
 #include <stdlib.h>
 #include <string.h>
+#ifndef NO_FFTF
 #include <fftf/api.h>
+#endif
 #include "inc/simd/arithmetic-inl.h"
 
 void convolve_simd(int simd,
@@ -100,6 +101,55 @@ void convolve_simd(int simd,
  }
 }
 
+void convolve_simd_double(int simd,
+                          const double *__restrict x, size_t xLength,
+                          const double *__restrict h, size_t hLength,
+                          double *__restrict result) {
+  assert(x);
+  assert(h);
+  assert(result);
+  assert(xLength > 0);
+  assert(hLength > 0);
+  for (int n = 0; n < (int)(xLength + hLength - 1); n++) {
+    double sum = 0;
+    int beg = n < (int)xLength? 0 : n - xLength + 1;
+    int end = n + 1;
+    if (end > (int)hLength) {
+      end = hLength;
+    }
+    if (simd) {
+#ifdef __AVX__
+      int simdEnd =  beg + ((end - beg) & ~3);
+      __m256d accum = _mm256_setzero_pd();
+      for (int m = beg; m < simdEnd; m += 4) {
+        __m256d xvec = _mm256_loadu_pd(x + n - m - 3);
+        __m256d hvec = _mm256_loadu_pd(h + m);
+        xvec = _mm256_permute2f128_pd(xvec, xvec, 1);
+        xvec = _mm256_permute_pd(xvec, 5);
+        accum = _mm256_add_pd(accum, _mm256_mul_pd(xvec, hvec));
+      }
+      __m128d accum2 = _mm_add_pd(_mm256_castpd256_pd128(accum),
+                                  _mm256_extractf128_pd(accum, 1));
+      accum2 = _mm_add_sd(accum2, _mm_unpackhi_pd(accum2, accum2));
+      sum = _mm_cvtsd_f64(accum2);
+      for (int m = simdEnd; m < end; m++) {
+        sum += h[m] * x[n - m];
+      }
+    } else {
+#else
+    } {
+#endif
+      // 32-bit NEON has no double precision vectors
+      for (int m = beg; m < end; m++) {
+        sum += h[m] * x[n - m];
+      }
+    }
+    result[n] = sum;
+  }
+}
+
+#ifndef NO_FFTF
+
 ConvolutionOverlapSaveHandle convolve_overlap_save_initialize(
     size_t xLength, size_t hLength) {
   assert(hLength < xLength / 2);
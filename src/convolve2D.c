@@ -0,0 +1,538 @@
+/*! @file convolve2D.c
+ *  @brief Two dimensional convolution of planes.
+ *  @author Markovtsev Vadim <v.markovtsev@samsung.com>
+ *  @version 1.0
+ *
+ *  @section Notes
+ *  This code partially conforms to <a href="http://google-styleguide.googlecode.com/svn/trunk/cppguide.xml">Google C++ Style Guide</a>.
+ *
+ *  @section Copyright
+ *  Copyright © 2013 Samsung R&D Institute Russia
+ *
+ *  @section License
+ *  Licensed to the Apache Software Foundation (ASF) under one
+ *  or more contributor license agreements.  See the NOTICE file
+ *  distributed with this work for additional information
+ *  regarding copyright ownership.  The ASF licenses this file
+ *  to you under the Apache License, Version 2.0 (the
+ *  "License"); you may not use this file except in compliance
+ *  with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an
+ *  "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ *  KIND, either express or implied.  See the License for the
+ *  specific language governing permissions and limitations
+ *  under the License.
+ */
+
+#define LIBSIMD_IMPLEMENTATION
+#include "inc/simd/convolve2D.h"
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef NO_FFTF
+#include <fftf/api.h>
+#endif
+#include "inc/simd/arithmetic-inl.h"
+
+/// The number of kernel elements starting from which a non-separable kernel
+/// is applied in the frequency domain.
+#define FFT_KERNEL_SIZE_THRESHOLD 225
+/// The width of the column strips in the vertical pass, in float-s.
+#define COLUMN_STRIP 512
+
+/// @brief Maps the index beyond [0, length) to the one inside, according
+/// to the extension type.
+/// @return The mapped index or -1 if the value is zero.
+static int extend_index(int i, int length, ExtensionType ext) {
+  if (i >= 0 && i < length) {
+    return i;
+  }
+  switch (ext) {
+    case EXTENSION_TYPE_PERIODIC:
+      i %= length;
+      return i < 0? i + length : i;
+    case EXTENSION_TYPE_MIRROR:
+      i %= 2 * length;
+      if (i < 0) {
+        i += 2 * length;
+      }
+      return i < length? i : 2 * length - 1 - i;
+    case EXTENSION_TYPE_CONSTANT:
+      return i < 0? 0 : length - 1;
+    case EXTENSION_TYPE_ZERO:
+      return -1;
+  }
+  return -1;
+}
+
+/// @brief Copies the row to dst, extending it by before float-s to the left
+/// and by after float-s to the right.
+static void extend_row(const float *row, int length, int before, int after,
+                       ExtensionType ext, float *dst) {
+  for (int i = -before; i < 0; i++) {
+    int index = extend_index(i, length, ext);
+    dst[i + before] = index >= 0? row[index] : 0;
+  }
+  memcpy(dst + before, row, length * sizeof(float));
+  for (int i = length; i < length + after; i++) {
+    int index = extend_index(i, length, ext);
+    dst[i + before] = index >= 0? row[index] : 0;
+  }
+}
+
+/// @brief dst[x] = sum(kernel[j] * src[x + j]).
+static void convolve2D_row(int simd, const float *src, int length,
+                           const float *kernel, int kernelLength,
+                           float *dst) {
+  int x = 0;
+  if (simd) {
+#ifdef __AVX__
+    for (; x < length - 7; x += 8) {
+      __m256 accum = _mm256_setzero_ps();
+      for (int j = 0; j < kernelLength; j++) {
+        accum = _mm256_add_ps(accum, _mm256_mul_ps(
+            _mm256_set1_ps(kernel[j]), _mm256_loadu_ps(src + x + j)));
+      }
+      _mm256_storeu_ps(dst + x, accum);
+    }
+  } else {
+#elif defined(__ARM_NEON__)
+    for (; x < length - 3; x += 4) {
+      float32x4_t accum = vdupq_n_f32(0.f);
+      for (int j = 0; j < kernelLength; j++) {
+        accum = vmlaq_n_f32(accum, vld1q_f32(src + x + j), kernel[j]);
+      }
+      vst1q_f32(dst + x, accum);
+    }
+  } else {
+#else
+  } {
+#endif
+  }
+  for (; x < length; x++) {
+    float sum = 0;
+    for (int j = 0; j < kernelLength; j++) {
+      sum += kernel[j] * src[x + j];
+    }
+    dst[x] = sum;
+  }
+}
+
+/// @brief dst[x] = sum(kernel[i] * rows[i][x]).
+static void convolve2D_column(int simd, const float *const *rows, int length,
+                              const float *kernel, int kernelLength,
+                              float *dst) {
+  int x = 0;
+  if (simd) {
+#ifdef __AVX__
+    for (; x < length - 7; x += 8) {
+      __m256 accum = _mm256_setzero_ps();
+      for (int i = 0; i < kernelLength; i++) {
+        accum = _mm256_add_ps(accum, _mm256_mul_ps(
+            _mm256_set1_ps(kernel[i]), _mm256_loadu_ps(rows[i] + x)));
+      }
+      _mm256_storeu_ps(dst + x, accum);
+    }
+  } else {
+#elif defined(__ARM_NEON__)
+    for (; x < length - 3; x += 4) {
+      float32x4_t accum = vdupq_n_f32(0.f);
+      for (int i = 0; i < kernelLength; i++) {
+        accum = vmlaq_n_f32(accum, vld1q_f32(rows[i] + x), kernel[i]);
+      }
+      vst1q_f32(dst + x, accum);
+    }
+  } else {
+#else
+  } {
+#endif
+  }
+  for (; x < length; x++) {
+    float sum = 0;
+    for (int i = 0; i < kernelLength; i++) {
+      sum += kernel[i] * rows[i][x];
+    }
+    dst[x] = sum;
+  }
+}
+
+/// @brief Applies the already flipped separable kernel.
+static void convolve2D_separable_flipped(
+    int simd, const float *src, int srcStride, int width, int height,
+    const float *rowKernel, int rowKernelLength,
+    const float *columnKernel, int columnKernelLength,
+    ExtensionType ext, float *dst, int dstStride) {
+  int left = rowKernelLength - 1 - rowKernelLength / 2;
+  int top = columnKernelLength - 1 - columnKernelLength / 2;
+
+  // Horizontal pass
+  float *tmp = mallocf((size_t)width * height);
+  float *extended = mallocf(width + rowKernelLength - 1);
+  assert(tmp && extended);
+  for (int y = 0; y < height; y++) {
+    extend_row(src + (size_t)y * srcStride, width, left,
+               rowKernelLength - 1 - left, ext, extended);
+    convolve2D_row(simd, extended, width, rowKernel, rowKernelLength,
+                   tmp + (size_t)y * width);
+  }
+  free(extended);
+
+  // Vertical pass over the column strips, so that the rows under
+  // the kernel stay in the cache while it slides down
+  int rowsCount = height + columnKernelLength - 1;
+  const float **rows = malloc(sizeof(float *) * rowsCount);
+  float *zeros = mallocf(width);
+  memsetf(zeros, 0.f, width);
+  for (int r = 0; r < rowsCount; r++) {
+    int index = extend_index(r - top, height, ext);
+    rows[r] = index >= 0? tmp + (size_t)index * width : zeros;
+  }
+  const float *strip[columnKernelLength];
+  for (int x = 0; x < width; x += COLUMN_STRIP) {
+    int stripWidth = width - x < COLUMN_STRIP? width - x : COLUMN_STRIP;
+    for (int y = 0; y < height; y++) {
+      for (int i = 0; i < columnKernelLength; i++) {
+        strip[i] = rows[y + i] + x;
+      }
+      convolve2D_column(simd, strip, stripWidth, columnKernel,
+                        columnKernelLength, dst + (size_t)y * dstStride + x);
+    }
+  }
+  free(zeros);
+  free(rows);
+  free(tmp);
+}
+
+/// @brief Copies the plane to dst, extending it according to the kernel
+/// size.
+static float *extend_plane(const float *src, int srcStride,
+                           int width, int height,
+                           int kernelWidth, int kernelHeight,
+                           ExtensionType ext) {
+  int left = kernelWidth - 1 - kernelWidth / 2;
+  int top = kernelHeight - 1 - kernelHeight / 2;
+  int extWidth = width + kernelWidth - 1;
+  int extHeight = height + kernelHeight - 1;
+  float *plane = mallocf((size_t)extWidth * extHeight);
+  assert(plane);
+  for (int r = 0; r < extHeight; r++) {
+    int index = extend_index(r - top, height, ext);
+    if (index >= 0) {
+      extend_row(src + (size_t)index * srcStride, width, left,
+                 kernelWidth - 1 - left, ext, plane + (size_t)r * extWidth);
+    } else {
+      memsetf(plane + (size_t)r * extWidth, 0.f, extWidth);
+    }
+  }
+  return plane;
+}
+
+/// @brief Applies the already flipped kernel directly.
+static void convolve2D_flipped(int simd, const float *src, int srcStride,
+                               int width, int height, const float *kernel,
+                               int kernelWidth, int kernelHeight,
+                               ExtensionType ext, float *dst, int dstStride) {
+  float *plane = extend_plane(src, srcStride, width, height,
+                              kernelWidth, kernelHeight, ext);
+  int stride = width + kernelWidth - 1;
+  for (int y = 0; y < height; y++) {
+    const float *base = plane + (size_t)y * stride;
+    float *out = dst + (size_t)y * dstStride;
+    int x = 0;
+    if (simd) {
+#ifdef __AVX__
+      // 16 outputs are kept in registers while the kernel is walked
+      for (; x < width - 15; x += 16) {
+        __m256 accum1 = _mm256_setzero_ps();
+        __m256 accum2 = _mm256_setzero_ps();
+        for (int i = 0; i < kernelHeight; i++) {
+          const float *row = base + i * stride + x;
+          const float *krow = kernel + i * kernelWidth;
+          for (int j = 0; j < kernelWidth; j++) {
+            __m256 k = _mm256_set1_ps(krow[j]);
+            accum1 = _mm256_add_ps(accum1, _mm256_mul_ps(
+                k, _mm256_loadu_ps(row + j)));
+            accum2 = _mm256_add_ps(accum2, _mm256_mul_ps(
+                k, _mm256_loadu_ps(row + j + 8)));
+          }
+        }
+        _mm256_storeu_ps(out + x, accum1);
+        _mm256_storeu_ps(out + x + 8, accum2);
+      }
+    } else {
+#elif defined(__ARM_NEON__)
+      for (; x < width - 7; x += 8) {
+        float32x4_t accum1 = vdupq_n_f32(0.f);
+        float32x4_t accum2 = vdupq_n_f32(0.f);
+        for (int i = 0; i < kernelHeight; i++) {
+          const float *row = base + i * stride + x;
+          const float *krow = kernel + i * kernelWidth;
+          for (int j = 0; j < kernelWidth; j++) {
+            accum1 = vmlaq_n_f32(accum1, vld1q_f32(row + j), krow[j]);
+            accum2 = vmlaq_n_f32(accum2, vld1q_f32(row + j + 4), krow[j]);
+          }
+        }
+        vst1q_f32(out + x, accum1);
+        vst1q_f32(out + x + 4, accum2);
+      }
+    } else {
+#else
+    } {
+#endif
+    }
+    for (; x < width; x++) {
+      float sum = 0;
+      for (int i = 0; i < kernelHeight; i++) {
+        for (int j = 0; j < kernelWidth; j++) {
+          sum += kernel[i * kernelWidth + j] * base[i * stride + x + j];
+        }
+      }
+      out[x] = sum;
+    }
+  }
+  free(plane);
+}
+
+static float *flip_kernel(const float *kernel, int length) {
+  float *flipped = mallocf(length);
+  assert(flipped);
+  rmemcpyf(flipped, kernel, length);
+  return flipped;
+}
+
+void convolve2D_simd(int simd, const float *src, int srcStride,
+                     int width, int height,
+                     const float *kernel, int kernelWidth, int kernelHeight,
+                     ExtensionType ext, float *dst, int dstStride) {
+  assert(src);
+  assert(kernel);
+  assert(dst);
+  assert(width > 0 && height > 0);
+  assert(kernelWidth > 0 && kernelHeight > 0);
+  assert(srcStride >= width && dstStride >= width);
+  float *flipped = flip_kernel(kernel, kernelWidth * kernelHeight);
+  convolve2D_flipped(simd, src, srcStride, width, height, flipped,
+                     kernelWidth, kernelHeight, ext, dst, dstStride);
+  free(flipped);
+}
+
+void convolve2D_separable(int simd, const float *src, int srcStride,
+                          int width, int height,
+                          const float *rowKernel, int rowKernelLength,
+                          const float *columnKernel, int columnKernelLength,
+                          ExtensionType ext, float *dst, int dstStride) {
+  assert(src);
+  assert(rowKernel);
+  assert(columnKernel);
+  assert(dst);
+  assert(width > 0 && height > 0);
+  assert(rowKernelLength > 0 && columnKernelLength > 0);
+  assert(srcStride >= width && dstStride >= width);
+  float *row = flip_kernel(rowKernel, rowKernelLength);
+  float *column = flip_kernel(columnKernel, columnKernelLength);
+  convolve2D_separable_flipped(simd, src, srcStride, width, height,
+                               row, rowKernelLength,
+                               column, columnKernelLength,
+                               ext, dst, dstStride);
+  free(column);
+  free(row);
+}
+
+/// @brief Checks whether the kernel is the outer product of two vectors
+/// and finds them if it is.
+static int factorize_kernel(const float *kernel, int width, int height,
+                            float *row, float *column) {
+  int pivot = 0;
+  for (int i = 1; i < width * height; i++) {
+    if (fabsf(kernel[i]) > fabsf(kernel[pivot])) {
+      pivot = i;
+    }
+  }
+  float max = fabsf(kernel[pivot]);
+  if (max == 0) {
+    return 0;
+  }
+  int pr = pivot / width, pc = pivot % width;
+  for (int i = 0; i < height; i++) {
+    column[i] = kernel[i * width + pc];
+  }
+  for (int j = 0; j < width; j++) {
+    row[j] = kernel[pr * width + j] / kernel[pivot];
+  }
+  for (int i = 0; i < height; i++) {
+    for (int j = 0; j < width; j++) {
+      if (fabsf(kernel[i * width + j] - column[i] * row[j]) > max * 1e-5f) {
+        return 0;
+      }
+    }
+  }
+  return 1;
+}
+
+Convolution2DHandle convolve2D_initialize(int width, int height,
+                                          const float *kernel,
+                                          int kernelWidth, int kernelHeight,
+                                          ExtensionType ext) {
+  assert(kernel);
+  assert(width > 0 && height > 0);
+  assert(kernelWidth > 0 && kernelHeight > 0);
+
+  Convolution2DHandle handle;
+  memset(&handle, 0, sizeof(handle));
+  handle.width = width;
+  handle.height = height;
+  handle.kernel_width = kernelWidth;
+  handle.kernel_height = kernelHeight;
+  handle.extension = ext;
+
+  float *row = mallocf(kernelWidth);
+  float *column = mallocf(kernelHeight);
+  if (factorize_kernel(kernel, kernelWidth, kernelHeight, row, column)) {
+    handle.algorithm = kConvolution2DAlgorithmSeparable;
+    handle.row_kernel = flip_kernel(row, kernelWidth);
+    handle.column_kernel = flip_kernel(column, kernelHeight);
+    free(column);
+    free(row);
+    return handle;
+  }
+  free(column);
+  free(row);
+
+#ifndef NO_FFTF
+  if (kernelWidth * kernelHeight >= FFT_KERNEL_SIZE_THRESHOLD) {
+    handle.algorithm = kConvolution2DAlgorithmFFT;
+    handle.dims = malloc(2 * sizeof(int));
+    handle.dims[0] = next_highest_power_of_2(height + kernelHeight - 1);
+    handle.dims[1] = next_highest_power_of_2(width + kernelWidth - 1);
+    int size = handle.dims[0] * handle.dims[1];
+    handle.fft_boiler_plate = mallocf(2 * size);
+    handle.K = mallocf(2 * size);
+    assert(handle.fft_boiler_plate && handle.K);
+    handle.fft_plan = fftf_init(FFTF_TYPE_COMPLEX, FFTF_DIRECTION_FORWARD,
+                                FFTF_DIMENSION_2D, handle.dims,
+                                FFTF_NO_OPTIONS, handle.fft_boiler_plate,
+                                handle.fft_boiler_plate);
+    assert(handle.fft_plan);
+    handle.fft_inverse_plan = fftf_init(
+        FFTF_TYPE_COMPLEX, FFTF_DIRECTION_BACKWARD,
+        FFTF_DIMENSION_2D, handle.dims,
+        FFTF_NO_OPTIONS, handle.fft_boiler_plate,
+        handle.fft_boiler_plate);
+    assert(handle.fft_inverse_plan);
+
+    // K = FFT(kernel) / size, computed once
+    memsetf(handle.fft_boiler_plate, 0.f, 2 * size);
+    for (int i = 0; i < kernelHeight; i++) {
+      for (int j = 0; j < kernelWidth; j++) {
+        handle.fft_boiler_plate[2 * (i * handle.dims[1] + j)] =
+            kernel[i * kernelWidth + j];
+      }
+    }
+    fftf_calc(handle.fft_plan);
+    real_multiply_scalar(handle.fft_boiler_plate, 2 * size, 1.0f / size,
+                         handle.K);
+    return handle;
+  }
+#endif
+
+  handle.algorithm = kConvolution2DAlgorithmDirect;
+  handle.kernel = flip_kernel(kernel, kernelWidth * kernelHeight);
+  return handle;
+}
+
+void convolve2D_finalize(Convolution2DHandle handle) {
+  switch (handle.algorithm) {
+    case kConvolution2DAlgorithmDirect:
+      free(handle.kernel);
+      break;
+    case kConvolution2DAlgorithmSeparable:
+      free(handle.row_kernel);
+      free(handle.column_kernel);
+      break;
+    case kConvolution2DAlgorithmFFT:
+#ifndef NO_FFTF
+      fftf_destroy(handle.fft_plan);
+      fftf_destroy(handle.fft_inverse_plan);
+      free(handle.fft_boiler_plate);
+      free(handle.K);
+      free(handle.dims);
+#endif
+      break;
+  }
+}
+
+#ifndef NO_FFTF
+static void convolve2D_fft(Convolution2DHandle handle,
+                           const float *src, int srcStride,
+                           float *dst, int dstStride) {
+  int kw = handle.kernel_width, kh = handle.kernel_height;
+  int extWidth = handle.width + kw - 1;
+  int extHeight = handle.height + kh - 1;
+  float *plane = extend_plane(src, srcStride, handle.width, handle.height,
+                              kw, kh, handle.extension);
+  int cols = handle.dims[1];
+  int size = handle.dims[0] * cols;
+  float *buffer = handle.fft_boiler_plate;
+  memsetf(buffer, 0.f, 2 * size);
+  for (int i = 0; i < extHeight; i++) {
+    for (int j = 0; j < extWidth; j++) {
+      buffer[2 * (i * cols + j)] = plane[(size_t)i * extWidth + j];
+    }
+  }
+  free(plane);
+
+  fftf_calc(handle.fft_plan);
+  int istart = 0;
+#ifdef SIMD
+  istart = 2 * size - (2 * size) % FLOAT_STEP;
+  for (int i = 0; i < istart; i += FLOAT_STEP) {
+    complex_multiply(buffer + i, handle.K + i, buffer + i);
+  }
+#endif
+  for (int i = istart; i < 2 * size; i += 2) {
+    complex_multiply_na(buffer + i, handle.K + i, buffer + i);
+  }
+  fftf_calc(handle.fft_inverse_plan);
+
+  // The linear convolution of the extended plane is shifted by the kernel
+  // size minus one, which leaves no room for the circular aliasing
+  for (int y = 0; y < handle.height; y++) {
+    const float *row = buffer + 2 * ((y + kh - 1) * cols + kw - 1);
+    for (int x = 0; x < handle.width; x++) {
+      dst[(size_t)y * dstStride + x] = row[2 * x];
+    }
+  }
+}
+#endif
+
+void convolve2D(Convolution2DHandle handle, const float *src, int srcStride,
+                float *dst, int dstStride) {
+  assert(src);
+  assert(dst);
+  assert(srcStride >= handle.width && dstStride >= handle.width);
+  switch (handle.algorithm) {
+    case kConvolution2DAlgorithmDirect:
+      convolve2D_flipped(1, src, srcStride, handle.width, handle.height,
+                         handle.kernel, handle.kernel_width,
+                         handle.kernel_height, handle.extension,
+                         dst, dstStride);
+      break;
+    case kConvolution2DAlgorithmSeparable:
+      convolve2D_separable_flipped(1, src, srcStride,
+                                   handle.width, handle.height,
+                                   handle.row_kernel, handle.kernel_width,
+                                   handle.column_kernel, handle.kernel_height,
+                                   handle.extension, dst, dstStride);
+      break;
+    case kConvolution2DAlgorithmFFT:
+#ifndef NO_FFTF
+      convolve2D_fft(handle, src, srcStride, dst, dstStride);
+#endif
+      break;
+  }
+}
@@ -28,49 +28,17 @@
  *  under the License.
  */
 
-#ifndef NO_FFTF
 #define LIBSIMD_IMPLEMENTATION
 #include "inc/simd/correlate.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef NO_FFTF
+#include <fftf/api.h>
+#endif
 #include "inc/simd/convolve.h"
 #include "inc/simd/arithmetic-inl.h"
 
-CrossCorrelationFFTHandle cross_correlate_fft_initialize(size_t xLength,
-                                                         size_t hLength) {
-  CrossCorrelationFFTHandle handle = convolve_fft_initialize(xLength, hLength);
-  handle.reverse = 1;
-  return handle;
-}
-
-void cross_correlate_fft(CrossCorrelationFFTHandle handle,
-                         const float *x, const float *h,
-                         float *result) {
-  convolve_fft(handle, x, h, result);
-}
-
-void cross_correlate_fft_finalize(CrossCorrelationFFTHandle handle) {
-  convolve_fft_finalize(handle);
-}
-
-CrossCorrelationOverlapSaveHandle cross_correlate_overlap_save_initialize(
-    size_t xLength, size_t hLength) {
-  CrossCorrelationOverlapSaveHandle handle =
-      convolve_overlap_save_initialize(xLength, hLength);
-  handle.reverse = 1;
-  return handle;
-}
-
-void cross_correlate_overlap_save(CrossCorrelationOverlapSaveHandle handle,
-                            const float *__restrict x,
-                            const float *__restrict h,
-                            float *result) {
-  convolve_overlap_save(handle, x, h, result);
-}
-
-void cross_correlate_overlap_save_finalize(
-    CrossCorrelationOverlapSaveHandle handle) {
-  convolve_overlap_save_finalize(handle);
-}
-
 void cross_correlate_simd(int simd,
                           const float *__restrict x, size_t xLength,
                           const float *__restrict h, size_t hLength,
@@ -125,6 +93,85 @@ void cross_correlate_simd(int simd,
   }
 }
 
+void cross_correlate_simd_double(int simd,
+                                 const double *__restrict x, size_t xLength,
+                                 const double *__restrict h, size_t hLength,
+                                 double *__restrict result) {
+  for (int n = hLength - 1; n > -(int)xLength; n--) {
+    double sum = 0;
+    int beg = n <= 0? -n : 0;
+    int end = -n + hLength;
+    if (end > (int)xLength) {
+      end = (int)xLength;
+    }
+    if (simd) {
+#ifdef __AVX__
+      int simdEnd = beg + ((end - beg) & ~3);
+      __m256d accum = _mm256_setzero_pd();
+      for (int m = beg; m < simdEnd; m += 4) {
+        __m256d xvec = _mm256_loadu_pd(x + m);
+        __m256d hvec = _mm256_loadu_pd(h + n + m);
+        accum = _mm256_add_pd(accum, _mm256_mul_pd(xvec, hvec));
+      }
+      __m128d accum2 = _mm_add_pd(_mm256_castpd256_pd128(accum),
+                                  _mm256_extractf128_pd(accum, 1));
+      accum2 = _mm_add_sd(accum2, _mm_unpackhi_pd(accum2, accum2));
+      sum = _mm_cvtsd_f64(accum2);
+      for (int m = simdEnd; m < end; m++) {
+        sum += x[m] * h[n + m];
+      }
+    } else {
+#else
+    } {
+#endif
+      // 32-bit NEON has no double precision vectors
+      for (int m = beg; m < end; m++) {
+        sum += x[m] * h[n + m];
+      }
+    }
+    result[-n + hLength - 1] = sum;
+  }
+}
+
+#ifndef NO_FFTF
+
+CrossCorrelationFFTHandle cross_correlate_fft_initialize(size_t xLength,
+                                                         size_t hLength) {
+  CrossCorrelationFFTHandle handle = convolve_fft_initialize(xLength, hLength);
+  handle.reverse = 1;
+  return handle;
+}
+
+void cross_correlate_fft(CrossCorrelationFFTHandle handle,
+                         const float *x, const float *h,
+                         float *result) {
+  convolve_fft(handle, x, h, result);
+}
+
+void cross_correlate_fft_finalize(CrossCorrelationFFTHandle handle) {
+  convolve_fft_finalize(handle);
+}
+
+CrossCorrelationOverlapSaveHandle cross_correlate_overlap_save_initialize(
+    size_t xLength, size_t hLength) {
+  CrossCorrelationOverlapSaveHandle handle =
+      convolve_overlap_save_initialize(xLength, hLength);
+  handle.reverse = 1;
+  return handle;
+}
+
+void cross_correlate_overlap_save(CrossCorrelationOverlapSaveHandle handle,
+                            const float *__restrict x,
+                            const float *__restrict h,
+                            float *result) {
+  convolve_overlap_save(handle, x, h, result);
+}
+
+void cross_correlate_overlap_save_finalize(
+    CrossCorrelationOverlapSaveHandle handle) {
+  convolve_overlap_save_finalize(handle);
+}
+
 CrossCorrelationHandle cross_correlate_initialize(size_t xLength,
                                                 size_t hLength) {
   CrossCorrelationHandle handle = convolve_initialize(xLength, hLength);
@@ -158,4 +205,165 @@ void cross_correlate(CrossCorrelationHandle handle,
 void cross_correlate_finalize(CrossCorrelationHandle handle) {
   convolve_finalize(handle);
 }
+
+CrossCorrelationBatchHandle cross_correlate_batch_initialize(
+    size_t xLength, const float *h, size_t hLength, size_t batchSize) {
+  assert(h);
+  assert(xLength > 0);
+  assert(hLength > 0);
+  assert(batchSize > 0);
+
+  CrossCorrelationBatchHandle handle;
+  handle.x_length = xLength;
+  handle.h_length = hLength;
+  handle.batch_size = batchSize;
+  handle.M = malloc(sizeof(int));
+  *handle.M = next_highest_power_of_2(xLength + hLength - 1);
+  int M = *handle.M;
+
+  // The template is reversed, transformed and normalized only once
+  handle.H = mallocf(M + 2);
+  assert(handle.H);
+  rmemcpyf(handle.H, h, hLength);
+  memsetf(handle.H + hLength, 0.f, M + 2 - hLength);
+  void *plan = fftf_init(FFTF_TYPE_REAL, FFTF_DIRECTION_FORWARD,
+                         FFTF_DIMENSION_1D, handle.M, FFTF_NO_OPTIONS,
+                         handle.H, handle.H);
+  assert(plan);
+  fftf_calc(plan);
+  fftf_destroy(plan);
+  real_multiply_scalar(handle.H, M + 2, 1.0f / M, handle.H);
+
+  handle.inputs = malloc(batchSize * sizeof(float *));
+  for (size_t i = 0; i < batchSize; i++) {
+    handle.inputs[i] = mallocf(M + 2);
+    assert(handle.inputs[i]);
+    memsetf(handle.inputs[i], 0.f, M + 2);
+  }
+  handle.fft_plan = fftf_init_batch(
+      FFTF_TYPE_REAL, FFTF_DIRECTION_FORWARD,
+      FFTF_DIMENSION_1D, handle.M,
+      FFTF_NO_OPTIONS, batchSize, (const float *const *)handle.inputs,
+      handle.inputs);
+  assert(handle.fft_plan);
+  handle.fft_inverse_plan = fftf_init_batch(
+      FFTF_TYPE_REAL, FFTF_DIRECTION_BACKWARD,
+      FFTF_DIMENSION_1D, handle.M,
+      FFTF_NO_OPTIONS, batchSize, (const float *const *)handle.inputs,
+      handle.inputs);
+  assert(handle.fft_inverse_plan);
+  return handle;
+}
+
+void cross_correlate_batch_finalize(CrossCorrelationBatchHandle handle) {
+  fftf_destroy(handle.fft_plan);
+  fftf_destroy(handle.fft_inverse_plan);
+  for (int i = 0; i < handle.batch_size; i++) {
+    free(handle.inputs[i]);
+  }
+  free(handle.inputs);
+  free(handle.H);
+  free(handle.M);
+}
+
+/// @brief Finds the first maximal element of the array.
+static void cross_correlate_max(const float *array, int length,
+                                float *value, int *index) {
+  int start = 0;
+  float max = array[0];
+#ifdef __AVX__
+  start = length & ~7;
+  if (start > 0) {
+    __m256 maxvec = _mm256_loadu_ps(array);
+    for (int i = 8; i < start; i += 8) {
+      maxvec = _mm256_max_ps(maxvec, _mm256_loadu_ps(array + i));
+    }
+    maxvec = _mm256_max_ps(maxvec, _mm256_permute2f128_ps(maxvec, maxvec, 1));
+    maxvec = _mm256_max_ps(maxvec, _mm256_permute_ps(maxvec, 0x4E));
+    maxvec = _mm256_max_ps(maxvec, _mm256_permute_ps(maxvec, 0xB1));
+    max = _mm256_get_ps(maxvec, 0);
+  }
+#elif defined(__ARM_NEON__)
+  start = length & ~3;
+  if (start > 0) {
+    float32x4_t maxvec = vld1q_f32(array);
+    for (int i = 4; i < start; i += 4) {
+      maxvec = vmaxq_f32(maxvec, vld1q_f32(array + i));
+    }
+    float32x2_t max2 = vpmax_f32(vget_low_f32(maxvec), vget_high_f32(maxvec));
+    max2 = vpmax_f32(max2, max2);
+    max = vget_lane_f32(max2, 0);
+  }
 #endif
+  for (int i = start; i < length; i++) {
+    if (array[i] > max) {
+      max = array[i];
+    }
+  }
+  int pos = 0;
+  while (pos < length - 1 && array[pos] != max) {
+    pos++;
+  }
+  *value = max;
+  *index = pos;
+}
+
+void cross_correlate_batch(CrossCorrelationBatchHandle handle,
+                           const float *const *x, size_t count,
+                           float *const *results,
+                           float *maxValues, int *maxLags) {
+  assert(x);
+  int M = *handle.M;
+  int xLength = handle.x_length;
+  int length = xLength + handle.h_length - 1;
+  for (size_t offset = 0; offset < count; offset += handle.batch_size) {
+    int size = handle.batch_size;
+    if (offset + size > count) {
+      size = count - offset;
+    }
+    for (int b = 0; b < size; b++) {
+      assert(x[offset + b]);
+      memcpy(handle.inputs[b], x[offset + b], xLength * sizeof(float));
+      // The inverse transform of the previous batch spoiled the padding
+      memsetf(handle.inputs[b] + xLength, 0.f, M + 2 - xLength);
+    }
+
+    // Note: the unused tail of the last batch is transformed too;
+    // this is cheaper than creating the separate plans.
+    fftf_calc(handle.fft_plan);
+    for (int b = 0; b < size; b++) {
+      float *X = handle.inputs[b];
+      int istart = 0;
+#ifdef SIMD
+      istart = M;
+      for (int i = 0; i < M; i += FLOAT_STEP) {
+        complex_multiply(X + i, handle.H + i, X + i);
+      }
+#endif
+      for (int i = istart; i < M + 2; i += 2) {
+        complex_multiply_na(X + i, handle.H + i, X + i);
+      }
+    }
+    fftf_calc(handle.fft_inverse_plan);
+
+    for (int b = 0; b < size; b++) {
+      const float *res = handle.inputs[b];
+      if (results != NULL) {
+        memcpy(results[offset + b], res, length * sizeof(float));
+      }
+      if (maxValues != NULL || maxLags != NULL) {
+        float value;
+        int index;
+        cross_correlate_max(res, length, &value, &index);
+        if (maxValues != NULL) {
+          maxValues[offset + b] = value;
+        }
+        if (maxLags != NULL) {
+          maxLags[offset + b] = index - (handle.h_length - 1);
+        }
+      }
+    }
+  }
+}
+
+#endif  // #ifndef NO_FFTF
@@ -0,0 +1,383 @@
+/*! @file correlate2D.c
+ *  @brief Two dimensional cross-correlation (template matching) of planes.
+ *  @author Markovtsev Vadim <v.markovtsev@samsung.com>
+ *  @version 1.0
+ *
+ *  @section Notes
+ *  This code partially conforms to <a href="http://google-styleguide.googlecode.com/svn/trunk/cppguide.xml">Google C++ Style Guide</a>.
+ *
+ *  @section Copyright
+ *  Copyright © 2013 Samsung R&D Institute Russia
+ *
+ *  @section License
+ *  Licensed to the Apache Software Foundation (ASF) under one
+ *  or more contributor license agreements.  See the NOTICE file
+ *  distributed with this work for additional information
+ *  regarding copyright ownership.  The ASF licenses this file
+ *  to you under the Apache License, Version 2.0 (the
+ *  "License"); you may not use this file except in compliance
+ *  with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an
+ *  "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ *  KIND, either express or implied.  See the License for the
+ *  specific language governing permissions and limitations
+ *  under the License.
+ */
+
+#define LIBSIMD_IMPLEMENTATION
+#include "inc/simd/correlate2D.h"
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef NO_FFTF
+#include <fftf/api.h>
+#endif
+#include "inc/simd/arithmetic-inl.h"
+
+/// The number of template elements starting from which the dot products
+/// are calculated in the frequency domain.
+#define FFT_TEMPLATE_SIZE_THRESHOLD 100
+
+void cross_correlate2D_simd(int simd, const float *src, int srcStride,
+                            int width, int height, const float *templ,
+                            int templateWidth, int templateHeight,
+                            float *dst, int dstStride) {
+  assert(src);
+  assert(templ);
+  assert(dst);
+  assert(templateWidth > 0 && templateWidth <= width);
+  assert(templateHeight > 0 && templateHeight <= height);
+  int outWidth = width - templateWidth + 1;
+  int outHeight = height - templateHeight + 1;
+  for (int y = 0; y < outHeight; y++) {
+    const float *base = src + (size_t)y * srcStride;
+    float *out = dst + (size_t)y * dstStride;
+    int x = 0;
+    if (simd) {
+#ifdef __AVX__
+      for (; x < outWidth - 15; x += 16) {
+        __m256 accum1 = _mm256_setzero_ps();
+        __m256 accum2 = _mm256_setzero_ps();
+        for (int i = 0; i < templateHeight; i++) {
+          const float *row = base + (size_t)i * srcStride + x;
+          const float *trow = templ + i * templateWidth;
+          for (int j = 0; j < templateWidth; j++) {
+            __m256 t = _mm256_set1_ps(trow[j]);
+            accum1 = _mm256_add_ps(accum1, _mm256_mul_ps(
+                t, _mm256_loadu_ps(row + j)));
+            accum2 = _mm256_add_ps(accum2, _mm256_mul_ps(
+                t, _mm256_loadu_ps(row + j + 8)));
+          }
+        }
+        _mm256_storeu_ps(out + x, accum1);
+        _mm256_storeu_ps(out + x + 8, accum2);
+      }
+    } else {
+#elif defined(__ARM_NEON__)
+      for (; x < outWidth - 7; x += 8) {
+        float32x4_t accum1 = vdupq_n_f32(0.f);
+        float32x4_t accum2 = vdupq_n_f32(0.f);
+        for (int i = 0; i < templateHeight; i++) {
+          const float *row = base + (size_t)i * srcStride + x;
+          const float *trow = templ + i * templateWidth;
+          for (int j = 0; j < templateWidth; j++) {
+            accum1 = vmlaq_n_f32(accum1, vld1q_f32(row + j), trow[j]);
+            accum2 = vmlaq_n_f32(accum2, vld1q_f32(row + j + 4), trow[j]);
+          }
+        }
+        vst1q_f32(out + x, accum1);
+        vst1q_f32(out + x + 4, accum2);
+      }
+    } else {
+#else
+    } {
+#endif
+    }
+    for (; x < outWidth; x++) {
+      float sum = 0;
+      for (int i = 0; i < templateHeight; i++) {
+        for (int j = 0; j < templateWidth; j++) {
+          sum += templ[i * templateWidth + j] *
+              base[(size_t)i * srcStride + x + j];
+        }
+      }
+      out[x] = sum;
+    }
+  }
+}
+
+CrossCorrelation2DHandle cross_correlate2D_initialize(
+    int width, int height, const float *templ,
+    int templateWidth, int templateHeight, int normalized) {
+  assert(templ);
+  assert(templateWidth > 0 && templateWidth <= width);
+  assert(templateHeight > 0 && templateHeight <= height);
+
+  CrossCorrelation2DHandle handle;
+  memset(&handle, 0, sizeof(handle));
+  handle.width = width;
+  handle.height = height;
+  handle.template_width = templateWidth;
+  handle.template_height = templateHeight;
+  handle.normalized = normalized;
+
+  int size = templateWidth * templateHeight;
+  handle.templ = mallocf(size);
+  assert(handle.templ);
+  memcpy(handle.templ, templ, size * sizeof(float));
+  if (normalized) {
+    // sum((T - mean(T)) * (I - mean(I))) = sum((T - mean(T)) * I)
+    double mean = 0;
+    for (int i = 0; i < size; i++) {
+      mean += templ[i];
+    }
+    mean /= size;
+    double norm = 0;
+    for (int i = 0; i < size; i++) {
+      handle.templ[i] = templ[i] - mean;
+      norm += (templ[i] - mean) * (templ[i] - mean);
+    }
+    handle.template_norm = sqrt(norm);
+  }
+
+#ifndef NO_FFTF
+  if (size >= FFT_TEMPLATE_SIZE_THRESHOLD) {
+    handle.algorithm = kConvolution2DAlgorithmFFT;
+    // The circular correlation does not wrap inside the valid region,
+    // so there is no need to pad the plane
+    handle.dims = malloc(2 * sizeof(int));
+    handle.dims[0] = next_highest_power_of_2(height);
+    handle.dims[1] = next_highest_power_of_2(width);
+    int fftSize = handle.dims[0] * handle.dims[1];
+    handle.fft_boiler_plate = mallocf(2 * fftSize);
+    handle.T = mallocf(2 * fftSize);
+    assert(handle.fft_boiler_plate && handle.T);
+    handle.fft_plan = fftf_init(FFTF_TYPE_COMPLEX, FFTF_DIRECTION_FORWARD,
+                                FFTF_DIMENSION_2D, handle.dims,
+                                FFTF_NO_OPTIONS, handle.fft_boiler_plate,
+                                handle.fft_boiler_plate);
+    assert(handle.fft_plan);
+    handle.fft_inverse_plan = fftf_init(
+        FFTF_TYPE_COMPLEX, FFTF_DIRECTION_BACKWARD,
+        FFTF_DIMENSION_2D, handle.dims,
+        FFTF_NO_OPTIONS, handle.fft_boiler_plate,
+        handle.fft_boiler_plate);
+    assert(handle.fft_inverse_plan);
+
+    // T = FFT(templ) / size, computed once
+    memsetf(handle.fft_boiler_plate, 0.f, 2 * fftSize);
+    for (int i = 0; i < templateHeight; i++) {
+      for (int j = 0; j < templateWidth; j++) {
+        handle.fft_boiler_plate[2 * (i * handle.dims[1] + j)] =
+            handle.templ[i * templateWidth + j];
+      }
+    }
+    fftf_calc(handle.fft_plan);
+    real_multiply_scalar(handle.fft_boiler_plate, 2 * fftSize,
+                         1.0f / fftSize, handle.T);
+    return handle;
+  }
+#endif
+
+  handle.algorithm = kConvolution2DAlgorithmDirect;
+  return handle;
+}
+
+void cross_correlate2D_finalize(CrossCorrelation2DHandle handle) {
+#ifndef NO_FFTF
+  if (handle.algorithm == kConvolution2DAlgorithmFFT) {
+    fftf_destroy(handle.fft_plan);
+    fftf_destroy(handle.fft_inverse_plan);
+    free(handle.fft_boiler_plate);
+    free(handle.T);
+    free(handle.dims);
+  }
+#endif
+  free(handle.templ);
+}
+
+#ifndef NO_FFTF
+static void cross_correlate2D_fft(CrossCorrelation2DHandle handle,
+                                  const float *src, int srcStride,
+                                  float *dst, int dstStride) {
+  int cols = handle.dims[1];
+  int size = handle.dims[0] * cols;
+  float *buffer = handle.fft_boiler_plate;
+  memsetf(buffer, 0.f, 2 * size);
+  for (int y = 0; y < handle.height; y++) {
+    for (int x = 0; x < handle.width; x++) {
+      buffer[2 * (y * cols + x)] = src[(size_t)y * srcStride + x];
+    }
+  }
+
+  fftf_calc(handle.fft_plan);
+  int istart = 0;
+#ifdef SIMD
+  istart = 2 * size - (2 * size) % FLOAT_STEP;
+  for (int i = 0; i < istart; i += FLOAT_STEP) {
+    complex_multiply_conjugate(buffer + i, handle.T + i, buffer + i);
+  }
+#endif
+  for (int i = istart; i < 2 * size; i += 2) {
+    complex_multiply_conjugate_na(buffer + i, handle.T + i, buffer + i);
+  }
+  fftf_calc(handle.fft_inverse_plan);
+
+  int outWidth = handle.width - handle.template_width + 1;
+  int outHeight = handle.height - handle.template_height + 1;
+  for (int y = 0; y < outHeight; y++) {
+    const float *row = buffer + 2 * y * cols;
+    for (int x = 0; x < outWidth; x++) {
+      dst[(size_t)y * dstStride + x] = row[2 * x];
+    }
+  }
+}
+#endif
+
+/// @brief Calculates the summed-area tables of the plane and of its square,
+/// each of size (width + 1) x (height + 1) with zero first row and column.
+static void summed_area_tables(int simd, const float *src, int srcStride,
+                               int width, int height,
+                               double *sat, double *sat2) {
+  int stride = width + 1;
+  memset(sat, 0, stride * sizeof(double));
+  memset(sat2, 0, stride * sizeof(double));
+  for (int y = 0; y < height; y++) {
+    const float *row = src + (size_t)y * srcStride;
+    double *prev = sat + (size_t)y * stride, *prev2 = sat2 + (size_t)y * stride;
+    double *cur = prev + stride, *cur2 = prev2 + stride;
+    double sum = 0, sum2 = 0;
+    cur[0] = 0;
+    cur2[0] = 0;
+    for (int x = 0; x < width; x++) {
+      sum += row[x];
+      sum2 += (double)row[x] * row[x];
+      cur[x + 1] = sum;
+      cur2[x + 1] = sum2;
+    }
+    int x = 1;
+    if (simd) {
+#ifdef __AVX__
+      for (; x < stride - 3; x += 4) {
+        _mm256_storeu_pd(cur + x, _mm256_add_pd(
+            _mm256_loadu_pd(cur + x), _mm256_loadu_pd(prev + x)));
+        _mm256_storeu_pd(cur2 + x, _mm256_add_pd(
+            _mm256_loadu_pd(cur2 + x), _mm256_loadu_pd(prev2 + x)));
+      }
+    } else {
+#else
+    } {
+#endif
+    }
+    for (; x < stride; x++) {
+      cur[x] += prev[x];
+      cur2[x] += prev2[x];
+    }
+  }
+}
+
+/// @brief Divides the dot products in the row by the norms of the centred
+/// windows and of the template.
+static void normalize_row(int simd, const double *sat, const double *sat2,
+                          int satStride, int width, int tw, int th,
+                          double templateNorm, float *dst) {
+  const double *top = sat, *bottom = sat + (size_t)th * satStride;
+  const double *top2 = sat2, *bottom2 = sat2 + (size_t)th * satStride;
+  double n = tw * th;
+  int x = 0;
+  if (simd) {
+#ifdef __AVX__
+    const __m256d nvec = _mm256_set1_pd(n);
+    const __m256d tnvec = _mm256_set1_pd(templateNorm);
+    const __m256d eps = _mm256_set1_pd(1e-7);
+    for (; x < width - 3; x += 4) {
+      __m256d s = _mm256_sub_pd(
+          _mm256_add_pd(_mm256_loadu_pd(bottom + x + tw),
+                        _mm256_loadu_pd(top + x)),
+          _mm256_add_pd(_mm256_loadu_pd(top + x + tw),
+                        _mm256_loadu_pd(bottom + x)));
+      __m256d s2 = _mm256_sub_pd(
+          _mm256_add_pd(_mm256_loadu_pd(bottom2 + x + tw),
+                        _mm256_loadu_pd(top2 + x)),
+          _mm256_add_pd(_mm256_loadu_pd(top2 + x + tw),
+                        _mm256_loadu_pd(bottom2 + x)));
+      __m256d var = _mm256_sub_pd(s2, _mm256_div_pd(_mm256_mul_pd(s, s),
+                                                    nvec));
+      // Zero variance windows (up to the rounding errors) are zeroed
+      __m256d valid = _mm256_cmp_pd(_mm256_mul_pd(s2, eps), var, _CMP_LT_OS);
+      __m256d norm = _mm256_mul_pd(_mm256_sqrt_pd(var), tnvec);
+      __m256d inv = _mm256_and_pd(
+          _mm256_div_pd(_mm256_set1_pd(1), norm), valid);
+      __m128 dots = _mm_loadu_ps(dst + x);
+      _mm_storeu_ps(dst + x, _mm_mul_ps(dots, _mm256_cvtpd_ps(inv)));
+    }
+  } else {
+#else
+  } {
+#endif
+  }
+  for (; x < width; x++) {
+    double s = bottom[x + tw] - top[x + tw] - bottom[x] + top[x];
+    double s2 = bottom2[x + tw] - top2[x + tw] - bottom2[x] + top2[x];
+    double var = s2 - s * s / n;
+    if (var > s2 * 1e-7) {
+      dst[x] = dst[x] / (sqrt(var) * templateNorm);
+    } else {
+      dst[x] = 0;
+    }
+  }
+}
+
+void cross_correlate2D(CrossCorrelation2DHandle handle,
+                       const float *src, int srcStride,
+                       float *dst, int dstStride) {
+  assert(src);
+  assert(dst);
+  assert(srcStride >= handle.width);
+  int outWidth = handle.width - handle.template_width + 1;
+  int outHeight = handle.height - handle.template_height + 1;
+  assert(dstStride >= outWidth);
+  switch (handle.algorithm) {
+    case kConvolution2DAlgorithmFFT:
+#ifndef NO_FFTF
+      cross_correlate2D_fft(handle, src, srcStride, dst, dstStride);
+#endif
+      break;
+    case kConvolution2DAlgorithmDirect:
+    case kConvolution2DAlgorithmSeparable:
+      cross_correlate2D_simd(1, src, srcStride, handle.width, handle.height,
+                             handle.templ, handle.template_width,
+                             handle.template_height, dst, dstStride);
+      break;
+  }
+  if (!handle.normalized) {
+    return;
+  }
+  if (handle.template_norm == 0) {
+    for (int y = 0; y < outHeight; y++) {
+      memsetf(dst + (size_t)y * dstStride, 0.f, outWidth);
+    }
+    return;
+  }
+
+  int satStride = handle.width + 1;
+  size_t satSize = (size_t)satStride * (handle.height + 1);
+  double *sat = malloc(satSize * sizeof(double));
+  double *sat2 = malloc(satSize * sizeof(double));
+  assert(sat && sat2);
+  summed_area_tables(1, src, srcStride, handle.width, handle.height,
+                     sat, sat2);
+  for (int y = 0; y < outHeight; y++) {
+    normalize_row(1, sat + (size_t)y * satStride, sat2 + (size_t)y * satStride,
+                  satStride, outWidth, handle.template_width,
+                  handle.template_height, handle.template_norm,
+                  dst + (size_t)y * dstStride);
+  }
+  free(sat2);
+  free(sat);
+}
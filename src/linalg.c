@@ -0,0 +1,392 @@
+/*! @file linalg.c
+ *  @brief Dense linear algebra implementation.
+ *  @author Markovtsev Vadim <v.markovtsev@samsung.com>
+ *  @version 1.0
+ *
+ *  @section Notes
+ *  This code partially conforms to <a href="http://google-styleguide.googlecode.com/svn/trunk/cppguide.xml">Google C++ Style Guide</a>.
+ *
+ *  @section Copyright
+ *  Copyright © 2013 Samsung R&D Institute Russia
+ *
+ *  @section License
+ *  Licensed to the Apache Software Foundation (ASF) under one
+ *  or more contributor license agreements.  See the NOTICE file
+ *  distributed with this work for additional information
+ *  regarding copyright ownership.  The ASF licenses this file
+ *  to you under the Apache License, Version 2.0 (the
+ *  "License"); you may not use this file except in compliance
+ *  with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an
+ *  "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ *  KIND, either express or implied.  See the License for the
+ *  specific language governing permissions and limitations
+ *  under the License.
+ */
+
+
+#define LIBSIMD_IMPLEMENTATION
+#include "inc/simd/linalg.h"
+#include <assert.h>
+#include <math.h>
+#include "inc/simd/matrix.h"
+#include "inc/simd/memory.h"
+#include "inc/simd/vector.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/// The size of the diagonal blocks which are processed directly; the rest
+/// is done by matrix_gemm().
+#define LINALG_BLOCK 64
+/// The minimal n^3 * count of a batch which is split between the threads.
+#define LINALG_BATCH_PARALLEL_THRESHOLD (1 << 18)
+
+/// @brief Returns the pointer to op(T)[i][k].
+INLINE const float *linalg_op(const float *t, size_t ldt, int trans,
+                              size_t i, size_t k) {
+  return trans? t + k * ldt + i : t + i * ldt + k;
+}
+
+INLINE size_t linalg_block(size_t size, size_t offset) {
+  return size - offset < LINALG_BLOCK? size - offset : LINALG_BLOCK;
+}
+
+/// @brief Solves op(T) X = B, where T is m x m and small enough to be
+/// solved row by row.
+/// @param forward Value which indicates whether op(T) is lower triangular.
+static void trsm_left_unblocked(int simd, int forward, int trans, int unit,
+                                size_t m, size_t n, const float *t,
+                                size_t ldt, float *b, size_t ldb) {
+  for (size_t s = 0; s < m; s++) {
+    size_t i = forward? s : m - 1 - s;
+    float *row = b + i * ldb;
+    size_t first = forward? 0 : i + 1, last = forward? i : m;
+    for (size_t k = first; k < last; k++) {
+      vector_axpy(simd, n, -*linalg_op(t, ldt, trans, i, k),
+                  b + k * ldb, 1, row, 1);
+    }
+    if (!unit) {
+      vector_scal(simd, n, 1 / *linalg_op(t, ldt, trans, i, i), row, 1);
+    }
+  }
+}
+
+/// @brief Solves X op(T) = B, where T is n x n and small enough to be
+/// solved column by column.
+/// @param forward Value which indicates whether op(T) is upper triangular.
+static void trsm_right_unblocked(int simd, int forward, int trans, int unit,
+                                 size_t m, size_t n, const float *t,
+                                 size_t ldt, float *b, size_t ldb) {
+  // The columns of op(T) are contiguous if T is transposed
+  size_t inc = trans? 1 : ldt;
+  for (size_t r = 0; r < m; r++) {
+    float *row = b + r * ldb;
+    for (size_t s = 0; s < n; s++) {
+      size_t j = forward? s : n - 1 - s;
+      size_t first = forward? 0 : j + 1, count = forward? j : n - j - 1;
+      float x = row[j] - vector_dot(
+          simd, count, row + first, 1,
+          linalg_op(t, ldt, trans, first, j), inc);
+      row[j] = unit? x : x / *linalg_op(t, ldt, trans, j, j);
+    }
+  }
+}
+
+static void trsm_left(int simd, int lower, int trans, int unit,
+                      size_t m, size_t n, const float *t, size_t ldt,
+                      float *b, size_t ldb) {
+  int forward = lower != trans;
+  for (size_t s = 0; s < m; s += LINALG_BLOCK) {
+    size_t nb = linalg_block(m, s);
+    size_t ib = forward? s : m - s - nb;
+    trsm_left_unblocked(simd, forward, trans, unit, nb, n,
+                        linalg_op(t, ldt, trans, ib, ib), ldt,
+                        b + ib * ldb, ldb);
+    // Eliminate the solved rows from the ones which are not solved yet
+    size_t first = forward? ib + nb : 0, rest = forward? m - ib - nb : ib;
+    if (rest > 0) {
+      matrix_gemm(simd, trans, 0, rest, n, nb, -1,
+                  linalg_op(t, ldt, trans, first, ib), ldt,
+                  b + ib * ldb, ldb, 1, b + first * ldb, ldb);
+    }
+  }
+}
+
+static void trsm_right(int simd, int lower, int trans, int unit,
+                       size_t m, size_t n, const float *t, size_t ldt,
+                       float *b, size_t ldb) {
+  int forward = lower == trans;
+  for (size_t s = 0; s < n; s += LINALG_BLOCK) {
+    size_t nb = linalg_block(n, s);
+    size_t jb = forward? s : n - s - nb;
+    trsm_right_unblocked(simd, forward, trans, unit, m, nb,
+                         linalg_op(t, ldt, trans, jb, jb), ldt,
+                         b + jb, ldb);
+    // Eliminate the solved columns from the ones which are not solved yet
+    size_t first = forward? jb + nb : 0, rest = forward? n - jb - nb : jb;
+    if (rest > 0) {
+      matrix_gemm(simd, 0, trans, m, rest, nb, -1, b + jb, ldb,
+                  linalg_op(t, ldt, trans, jb, first), ldt,
+                  1, b + first, ldb);
+    }
+  }
+}
+
+void linalg_trsm(int simd, int right, int lower, int transT,
+                 int unitDiagonal, size_t m, size_t n, float alpha,
+                 const float *t, size_t ldt, float *b, size_t ldb) {
+  assert(t);
+  assert(b);
+  assert(ldt >= (right? n : m));
+  assert(ldb >= n);
+  if (m == 0 || n == 0) {
+    return;
+  }
+  if (alpha != 1) {
+    for (size_t i = 0; i < m; i++) {
+      if (alpha == 0) {
+        memsetf(b + i * ldb, 0.f, n);
+      } else {
+        vector_scal(simd, n, alpha, b + i * ldb, 1);
+      }
+    }
+    if (alpha == 0) {
+      return;
+    }
+  }
+  if (right) {
+    trsm_right(simd, lower, transT, unitDiagonal, m, n, t, ldt, b, ldb);
+  } else {
+    trsm_left(simd, lower, transT, unitDiagonal, m, n, t, ldt, b, ldb);
+  }
+}
+
+void linalg_trsv(int simd, int lower, int transT, int unitDiagonal,
+                 size_t n, const float *t, size_t ldt, float *x) {
+  assert(t);
+  assert(x);
+  assert(ldt >= n);
+  int forward = lower != transT;
+  for (size_t s = 0; s < n; s++) {
+    size_t i = forward? s : n - 1 - s;
+    const float *row = t + i * ldt;
+    if (!transT) {
+      // The row of T is contiguous, so the solved part is a dot product
+      x[i] -= forward? vector_dot(simd, i, row, 1, x, 1) :
+                       vector_dot(simd, n - i - 1, row + i + 1, 1,
+                                  x + i + 1, 1);
+      if (!unitDiagonal) {
+        x[i] /= row[i];
+      }
+    } else {
+      // The column of op(T) is contiguous, so x[i] is eliminated from
+      // the rest once it is known
+      if (!unitDiagonal) {
+        x[i] /= row[i];
+      }
+      if (forward) {
+        vector_axpy(simd, n - i - 1, -x[i], row + i + 1, 1, x + i + 1, 1);
+      } else {
+        vector_axpy(simd, i, -x[i], row, 1, x, 1);
+      }
+    }
+  }
+}
+
+static int cholesky_unblocked(int simd, float *a, size_t n, size_t lda) {
+  for (size_t j = 0; j < n; j++) {
+    float *rowj = a + j * lda;
+    float d = rowj[j] - vector_dot(simd, j, rowj, 1, rowj, 1);
+    if (!(d > 0)) {
+      return j + 1;
+    }
+    d = sqrtf(d);
+    rowj[j] = d;
+    for (size_t i = j + 1; i < n; i++) {
+      float *rowi = a + i * lda;
+      rowi[j] = (rowi[j] - vector_dot(simd, j, rowi, 1, rowj, 1)) / d;
+    }
+  }
+  return 0;
+}
+
+int linalg_cholesky(int simd, float *a, size_t n, size_t lda) {
+  assert(a);
+  assert(lda >= n);
+  for (size_t kb = 0; kb < n; kb += LINALG_BLOCK) {
+    size_t nb = linalg_block(n, kb);
+    float *a11 = a + kb * lda + kb;
+    int info = cholesky_unblocked(simd, a11, nb, lda);
+    if (info) {
+      return kb + info;
+    }
+    size_t rest = n - kb - nb;
+    if (rest == 0) {
+      break;
+    }
+    // L21 = A21 L11^-T, A22 -= L21 L21^T
+    float *a21 = a11 + nb * lda;
+    trsm_right(simd, 1, 1, 0, rest, nb, a11, lda, a21, lda);
+    matrix_gemm(simd, 0, 1, rest, rest, nb, -1, a21, lda, a21, lda,
+                1, a21 + nb, lda);
+  }
+  for (size_t i = 0; i + 1 < n; i++) {
+    memsetf(a + i * lda + i + 1, 0.f, n - i - 1);
+  }
+  return 0;
+}
+
+void linalg_cholesky_solve(int simd, const float *l, size_t n, size_t ldl,
+                           float *b, size_t nrhs, size_t ldb) {
+  assert(l);
+  assert(b);
+  assert(ldl >= n);
+  assert(ldb >= nrhs);
+  if (n == 0 || nrhs == 0) {
+    return;
+  }
+  trsm_left(simd, 1, 0, 0, n, nrhs, l, ldl, b, ldb);
+  trsm_left(simd, 1, 1, 0, n, nrhs, l, ldl, b, ldb);
+}
+
+int linalg_lu(int simd, float *a, size_t n, size_t lda, int *pivots) {
+  assert(a);
+  assert(pivots);
+  assert(lda >= n);
+  int info = 0;
+  for (size_t kb = 0; kb < n; kb += LINALG_BLOCK) {
+    size_t nb = linalg_block(n, kb);
+    // Factorize the panel of nb columns, swapping the whole rows
+    for (size_t j = kb; j < kb + nb; j++) {
+      float *rowj = a + j * lda;
+      size_t p = j + vector_iamax(simd, n - j, rowj + j, lda);
+      pivots[j] = p;
+      if (p != j) {
+        vector_swap(simd, n, rowj, 1, a + p * lda, 1);
+      }
+      float pivot = rowj[j];
+      if (pivot == 0) {
+        if (!info) {
+          info = j + 1;
+        }
+        continue;
+      }
+      vector_scal(simd, n - j - 1, 1 / pivot, rowj + lda + j, lda);
+      for (size_t i = j + 1; i < n; i++) {
+        float *rowi = a + i * lda;
+        vector_axpy(simd, kb + nb - j - 1, -rowi[j], rowj + j + 1, 1,
+                    rowi + j + 1, 1);
+      }
+    }
+    size_t rest = n - kb - nb;
+    if (rest == 0) {
+      break;
+    }
+    // U12 = L11^-1 A12, A22 -= L21 U12
+    float *a11 = a + kb * lda + kb;
+    trsm_left(simd, 1, 0, 1, nb, rest, a11, lda, a11 + nb, lda);
+    matrix_gemm(simd, 0, 0, rest, rest, nb, -1, a11 + nb * lda, lda,
+                a11 + nb, lda, 1, a11 + nb * lda + nb, lda);
+  }
+  return info;
+}
+
+void linalg_lu_solve(int simd, const float *lu, size_t n, size_t ldlu,
+                     const int *pivots, float *b, size_t nrhs, size_t ldb) {
+  assert(lu);
+  assert(pivots);
+  assert(b);
+  assert(ldlu >= n);
+  assert(ldb >= nrhs);
+  if (n == 0 || nrhs == 0) {
+    return;
+  }
+  for (size_t i = 0; i < n; i++) {
+    if ((size_t)pivots[i] != i) {
+      vector_swap(simd, nrhs, b + i * ldb, 1, b + pivots[i] * ldb, 1);
+    }
+  }
+  trsm_left(simd, 1, 0, 1, n, nrhs, lu, ldlu, b, ldb);
+  trsm_left(simd, 0, 0, 0, n, nrhs, lu, ldlu, b, ldb);
+}
+
+/// @brief Returns the number of threads to split a batch of count n x n
+/// systems.
+static int linalg_batch_threads(size_t n UNUSED, size_t count UNUSED) {
+  int threads = 1;
+#ifdef _OPENMP
+  if ((double)n * n * n * count >= LINALG_BATCH_PARALLEL_THRESHOLD) {
+    threads = matrix_get_threads();
+    if (threads == 0) {
+      threads = omp_get_max_threads();
+    }
+    if ((size_t)threads > count) {
+      threads = count;
+    }
+  }
+#endif
+  return threads;
+}
+
+void linalg_cholesky_batch(int simd, float *a, size_t n, size_t count,
+                           int *info) {
+  assert(a);
+  assert(info);
+  int threads UNUSED = linalg_batch_threads(n, count);
+#ifdef _OPENMP
+  #pragma omp parallel for num_threads(threads) schedule(static)
+#endif
+  for (int i = 0; i < (int)count; i++) {
+    info[i] = linalg_cholesky(simd, a + (size_t)i * n * n, n, n);
+  }
+}
+
+void linalg_cholesky_solve_batch(int simd, const float *l, size_t n,
+                                 size_t count, float *b, size_t nrhs) {
+  assert(l);
+  assert(b);
+  int threads UNUSED = linalg_batch_threads(n, count);
+#ifdef _OPENMP
+  #pragma omp parallel for num_threads(threads) schedule(static)
+#endif
+  for (int i = 0; i < (int)count; i++) {
+    linalg_cholesky_solve(simd, l + (size_t)i * n * n, n, n,
+                          b + (size_t)i * n * nrhs, nrhs, nrhs);
+  }
+}
+
+void linalg_lu_batch(int simd, float *a, size_t n, size_t count,
+                     int *pivots, int *info) {
+  assert(a);
+  assert(pivots);
+  assert(info);
+  int threads UNUSED = linalg_batch_threads(n, count);
+#ifdef _OPENMP
+  #pragma omp parallel for num_threads(threads) schedule(static)
+#endif
+  for (int i = 0; i < (int)count; i++) {
+    info[i] = linalg_lu(simd, a + (size_t)i * n * n, n, n,
+                        pivots + (size_t)i * n);
+  }
+}
+
+void linalg_lu_solve_batch(int simd, const float *lu, size_t n, size_t count,
+                           const int *pivots, float *b, size_t nrhs) {
+  assert(lu);
+  assert(pivots);
+  assert(b);
+  int threads UNUSED = linalg_batch_threads(n, count);
+#ifdef _OPENMP
+  #pragma omp parallel for num_threads(threads) schedule(static)
+#endif
+  for (int i = 0; i < (int)count; i++) {
+    linalg_lu_solve(simd, lu + (size_t)i * n * n, n, n,
+                    pivots + (size_t)i * n, b + (size_t)i * n * nrhs,
+                    nrhs, nrhs);
+  }
+}
@@ -31,8 +31,224 @@
 #define LIBSIMD_IMPLEMENTATION
 #include "inc/simd/matrix.h"
 #include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
 #include "inc/simd/memory.h"
+#include "inc/simd/vector.h"
 #include <simd/instruction_set.h>
+// The emulated AVX has no rounding without SSE4.1, which exp256_ps() needs
+#if !defined(__SSE3__) || defined(__SSE4_1__)
+#include "inc/simd/mathfun.h"
+#define MATRIX_VECTOR_EXP
+#endif
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/// The number of threads used by the matrix multiplication, 0 means all.
+static int matrix_threads = 0;
+
+/// @brief The storage types of the second operand of gemm_blocked().
+typedef enum {
+  kGemmElementFloat,
+  kGemmElementFloat16,
+  kGemmElementBFloat16
+} GemmElementType;
+
+/// @brief The optional features of gemm_blocked().
+typedef struct {
+  /// The values subtracted from the rows of A while it is packed, or NULL.
+  const float *a_shift;
+  /// The values subtracted from the columns of B while it is packed,
+  /// or NULL. B must consist of float-s.
+  const float *b_shift;
+  /// Value which indicates whether only the upper triangle of C (j >= i)
+  /// is calculated.
+  int upper;
+  /// The values added to the columns of C after the multiplication,
+  /// or NULL.
+  const float *bias;
+  /// The function applied to C after the bias.
+  ActivationFunction activation;
+} GemmExtras;
+
+/// @brief Converts IEEE 754 binary16 to float.
+INLINE float matrix_float16_to_float(uint16_t half) {
+  uint32_t sign = (uint32_t)(half & 0x8000) << 16;
+  uint32_t exponent = (half >> 10) & 0x1F;
+  uint32_t mantissa = half & 0x3FF;
+  uint32_t bits;
+  if (exponent == 0x1F) {
+    // Infinity or NaN
+    bits = sign | 0x7F800000 | (mantissa << 13);
+  } else if (exponent != 0) {
+    bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+  } else {
+    // Zero or subnormal, mantissa * 2^-24 is exact in float
+    float value = mantissa * (1.f / 16777216.f);
+    return sign? -value : value;
+  }
+  float value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+/// @brief Converts bfloat16 to float.
+INLINE float matrix_bfloat16_to_float(uint16_t half) {
+  uint32_t bits = (uint32_t)half << 16;
+  float value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+INLINE float matrix_half_to_float(uint16_t half, int bf16) {
+  return bf16? matrix_bfloat16_to_float(half) :
+               matrix_float16_to_float(half);
+}
+
+INLINE float matrix_activate(float x, ActivationFunction activation) {
+  switch (activation) {
+    case kActivationRelu:
+      return x > 0? x : 0;
+    case kActivationTanh:
+      return tanhf(x);
+    case kActivationSigmoid:
+      return 1 / (1 + expf(-x));
+    default:
+      return x;
+  }
+}
+
+#ifdef __AVX__
+/// @brief Loads 8 half precision numbers and converts them to float-s.
+INLINE __m256 matrix_load_half_avx(const uint16_t *src, int bf16) {
+  if (bf16) {
+    // bfloat16 is the upper half of float
+    __m128i half = _mm_loadu_si128((const __m128i *)src);
+    __m128i zero = _mm_setzero_si128();
+    __m256 res = _mm256_castps128_ps256(
+        _mm_castsi128_ps(_mm_unpacklo_epi16(zero, half)));
+    return _mm256_insertf128_ps(
+        res, _mm_castsi128_ps(_mm_unpackhi_epi16(zero, half)), 1);
+  }
+#ifdef __F16C__
+  return _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *)src));
+#else
+  float values[8] __attribute__((aligned(32)));
+  for (int i = 0; i < 8; i++) {
+    values[i] = matrix_float16_to_float(src[i]);
+  }
+  return _mm256_load_ps(values);
+#endif
+}
+
+/// @brief Applies the activation function to 8 float-s.
+/// @details tanh(x) = sign(x) * (1 - exp(-2|x|)) / (1 + exp(-2|x|)),
+/// which loses the relative precision near zero, so the Taylor series is
+/// used there instead. exp256_ps() clamps its argument, so NaN-s are
+/// restored explicitly.
+INLINE __m256 matrix_activate_avx(__m256 x, ActivationFunction activation) {
+  if (activation == kActivationIdentity) {
+    return x;
+  }
+  if (activation == kActivationRelu) {
+    return _mm256_max_ps(x, _mm256_setzero_ps());
+  }
+#ifdef MATRIX_VECTOR_EXP
+  const __m256 one = _mm256_set1_ps(1.f);
+  __m256 res;
+  if (activation == kActivationTanh) {
+    const __m256 sign = _mm256_set1_ps(-0.f);
+    __m256 ax = _mm256_andnot_ps(sign, x);
+    __m256 e = exp256_ps(_mm256_mul_ps(ax, _mm256_set1_ps(-2.f)));
+    __m256 big = _mm256_div_ps(_mm256_sub_ps(one, e), _mm256_add_ps(one, e));
+    big = _mm256_or_ps(big, _mm256_and_ps(sign, x));
+    __m256 x2 = _mm256_mul_ps(x, x);
+    __m256 small = _mm256_add_ps(
+        _mm256_mul_ps(x2, _mm256_set1_ps(-17.f / 315)),
+        _mm256_set1_ps(2.f / 15));
+    small = _mm256_add_ps(_mm256_mul_ps(small, x2),
+                          _mm256_set1_ps(-1.f / 3));
+    small = _mm256_add_ps(_mm256_mul_ps(small, x2), one);
+    small = _mm256_mul_ps(small, x);
+    res = _mm256_blendv_ps(
+        big, small, _mm256_cmp_ps(ax, _mm256_set1_ps(0.0625f), _CMP_LT_OS));
+  } else {
+    __m256 e = exp256_ps(_mm256_sub_ps(_mm256_setzero_ps(), x));
+    res = _mm256_div_ps(one, _mm256_add_ps(one, e));
+  }
+  return _mm256_blendv_ps(res, x, _mm256_cmp_ps(x, x, _CMP_UNORD_Q));
+#else
+  float values[8] __attribute__((aligned(32)));
+  _mm256_store_ps(values, x);
+  for (int i = 0; i < 8; i++) {
+    values[i] = matrix_activate(values[i], activation);
+  }
+  return _mm256_load_ps(values);
+#endif
+}
+#endif
+
+#ifdef __ARM_NEON__
+/// @brief Loads 4 half precision numbers and converts them to float-s.
+INLINE float32x4_t matrix_load_half_neon(const uint16_t *src, int bf16) {
+  uint16x4_t half = vld1_u16(src);
+  if (bf16) {
+    return vreinterpretq_f32_u32(vshll_n_u16(half, 16));
+  }
+#if defined(__ARM_FP) && (__ARM_FP & 2)
+  return vcvt_f32_f16(vreinterpret_f16_u16(half));
+#else
+  float values[4] __attribute__((aligned(16)));
+  for (int i = 0; i < 4; i++) {
+    values[i] = matrix_float16_to_float(src[i]);
+  }
+  return vld1q_f32(values);
+#endif
+}
+
+/// @brief Calculates 1 / x with two Newton-Raphson refinements.
+INLINE float32x4_t matrix_reciprocal_neon(float32x4_t x) {
+  float32x4_t r = vrecpeq_f32(x);
+  r = vmulq_f32(r, vrecpsq_f32(x, r));
+  return vmulq_f32(r, vrecpsq_f32(x, r));
+}
+
+/// @brief Applies the activation function to 4 float-s.
+/// @see matrix_activate_avx().
+INLINE float32x4_t matrix_activate_neon(float32x4_t x,
+                                        ActivationFunction activation) {
+  if (activation == kActivationIdentity) {
+    return x;
+  }
+  if (activation == kActivationRelu) {
+    return vmaxq_f32(x, vdupq_n_f32(0.f));
+  }
+  const float32x4_t one = vdupq_n_f32(1.f);
+  float32x4_t res;
+  if (activation == kActivationTanh) {
+    const uint32x4_t sign = vdupq_n_u32(0x80000000);
+    float32x4_t ax = vabsq_f32(x);
+    float32x4_t e = exp_ps(vmulq_n_f32(ax, -2.f));
+    float32x4_t big = vmulq_f32(vsubq_f32(one, e),
+                                matrix_reciprocal_neon(vaddq_f32(one, e)));
+    big = vreinterpretq_f32_u32(vorrq_u32(
+        vreinterpretq_u32_f32(big),
+        vandq_u32(sign, vreinterpretq_u32_f32(x))));
+    float32x4_t x2 = vmulq_f32(x, x);
+    float32x4_t small = vmlaq_n_f32(vdupq_n_f32(2.f / 15), x2, -17.f / 315);
+    small = vmlaq_f32(vdupq_n_f32(-1.f / 3), small, x2);
+    small = vmlaq_f32(one, small, x2);
+    small = vmulq_f32(small, x);
+    res = vbslq_f32(vcltq_f32(ax, vdupq_n_f32(0.0625f)), small, big);
+  } else {
+    float32x4_t e = exp_ps(vnegq_f32(x));
+    res = matrix_reciprocal_neon(vaddq_f32(one, e));
+  }
+  return vbslq_f32(vceqq_f32(x, x), res, x);
+}
+#endif
 
 static void matrix_add_novec(const float *m1, const float *m2,
                       size_t w, size_t h, float *res) {
@@ -79,6 +295,68 @@ static void matrix_multiply_transposed_novec(const float *m1, const float *m2,
   }
 }
 
+static void matrix_multiply_double_novec(const double *m1, const double *m2,
+                                         size_t w1, size_t h1, size_t w2,
+                                         double *res) {
+  for (size_t j = 0; j < h1; j++) {
+    for (size_t i = 0; i < w2; i++) {
+      double sum = 0;
+      for (size_t k = 0; k < w1; k++) {
+        sum += m1[j * w1 + k] * m2[k * w2 + i];
+      }
+      res[j * w2 + i] = sum;
+    }
+  }
+}
+
+static void matrix_multiply_transposed_double_novec(
+    const double *m1, const double *m2, size_t w1, size_t h1, size_t h2,
+    double *res) {
+  for (size_t j = 0; j < h1; j++) {
+    for (size_t i = 0; i < h2; i++) {
+      double sum = 0;
+      for (size_t k = 0; k < w1; k++) {
+        sum += m1[j * w1 + k] * m2[i * w1 + k];
+      }
+      res[j * h2 + i] = sum;
+    }
+  }
+}
+
+static void matrix_gemm_novec(int m, int n, int k, float alpha,
+                              const float *a, int rsa, int csa,
+                              const float *b, int rsb, int csb,
+                              float beta, float *c, int ldc) {
+  for (int i = 0; i < m; i++) {
+    for (int j = 0; j < n; j++) {
+      float sum = 0;
+      for (int p = 0; p < k; p++) {
+        sum += a[i * rsa + p * csa] * b[p * rsb + j * csb];
+      }
+      float *dst = c + (size_t)i * ldc + j;
+      *dst = beta == 0? alpha * sum : alpha * sum + beta * *dst;
+    }
+  }
+}
+
+static void matrix_gemm_half_novec(int m, int n, int k, float alpha,
+                                   const float *a, int rsa, int csa,
+                                   const uint16_t *b, int bf16,
+                                   int rsb, int csb,
+                                   float beta, float *c, int ldc) {
+  for (int i = 0; i < m; i++) {
+    for (int j = 0; j < n; j++) {
+      float sum = 0;
+      for (int p = 0; p < k; p++) {
+        sum += a[i * rsa + p * csa] *
+               matrix_half_to_float(b[p * rsb + j * csb], bf16);
+      }
+      float *dst = c + (size_t)i * ldc + j;
+      *dst = beta == 0? alpha * sum : alpha * sum + beta * *dst;
+    }
+  }
+}
+
 #ifdef __ARM_NEON__
 static void matrix_add_neon(const float *m1, const float *m2,
                             size_t w, size_t h, float *res) {
@@ -109,61 +387,6 @@ static void matrix_sub_neon(const float *m1, const float *m2,
     res[i] = m1[i] - m2[i];
   }
 }
-
-static void matrix_multiply_neon(const float *m1, const float *m2,
-                                 size_t w1, size_t h1, size_t w2,
-                                 size_t h2 UNUSED, float *res) {
-  float col2[w1] __attribute__((aligned(64)));
-  for (int i = 0; i < (int)w2; i++) {
-    for (int k = 0; k < (int)w1; k++) {
-      col2[k] = m2[k * w2 + i];
-    }
-    for (int j = 0; j < (int)h1; j++) {
-      float32x4_t sum = vdupq_n_f32(0.f);
-      for (int k = 0; k < (int)w1 - 7; k += 8) {
-        float32x4_t v1 = vld1q_f32(m1 + j * w1 + k);
-        float32x4_t v2 = vld1q_f32(col2 + k);
-        sum = vmlaq_f32(sum, v1, v2);
-        v1 = vld1q_f32(m1 + j * w1 + k + 4);
-        v2 = vld1q_f32(col2 + k + 4);
-        sum = vmlaq_f32(sum, v1, v2);
-      }
-      float32x2_t sum2 = vpadd_f32(vget_high_f32(sum),
-                                   vget_low_f32(sum));
-      float rsum = vget_lane_f32(sum2, 0) + vget_lane_f32(sum2, 1);
-      for (int k = (w1 & ~0x7); k < (int)w1; k++) {
-        rsum += m1[j * w1 + k] * col2[k];
-      }
-      res[j * w2 + i] = rsum;
-    }
-  }
-}
-
-static void matrix_multiply_transposed_neon(const float *m1, const float *m2,
-                                            size_t w1, size_t h1,
-                                            size_t w2 UNUSED,  size_t h2,
-                                            float *res) {
-  for (int j = 0; j < (int)h1; j++) {
-    for (int i = 0; i < (int)h2; i++) {
-      float32x4_t sum = vdupq_n_f32(0.f);
-      for (int k = 0; k < (int)w1 - 7; k += 8) {
-        float32x4_t v1 = vld1q_f32(m1 + j * w1 + k);
-        float32x4_t v2 = vld1q_f32(m2 + i * w1 + k);
-        sum = vmlaq_f32(sum, v1, v2);
-        v1 = vld1q_f32(m1 + j * w1 + k + 4);
-        v2 = vld1q_f32(m2 + i * w1 + k + 4);
-        sum = vmlaq_f32(sum, v1, v2);
-      }
-      float32x2_t sum2 = vpadd_f32(vget_high_f32(sum),
-                                   vget_low_f32(sum));
-      float rsum = vget_lane_f32(sum2, 0) + vget_lane_f32(sum2, 1);
-      for (int k = (w1 & ~0x7); k < (int)w1; k++) {
-        rsum += m1[j * w1 + k] * m2[i * w1 + k];
-      }
-      res[j * h2 + i] = rsum;
-    }
-  }
-}
 #endif
 
 #ifdef __AVX__
@@ -196,128 +419,2776 @@ static void matrix_sub_avx(const float *m1, const float *m2,
     res[i] = m1[i] - m2[i];
   }
 }
+#endif
 
-static void matrix_multiply_avx(const float *m1, const float *m2,
-                                size_t w1, size_t h1, size_t w2,
-                                size_t h2 UNUSED, float *res) {
-  assert(align_complement_f32(m1) == 0);
-  float col2[w1] __attribute__((aligned(64)));
-  for (int i = 0; i < (int)w2; i++) {
-    for (int k = 0; k < (int)w1; k++) {
-      col2[k] = m2[k * w2 + i];
+#if defined(__AVX__) || defined(__ARM_NEON__)
+
+// The blocked matrix multiplication in the spirit of GotoBLAS: the panels of
+// both operands are packed into contiguous aligned buffers so that the
+// micro-kernel reads them sequentially, KC x NR panel of B stays in L1,
+// MC x KC block of A stays in L2 and KC x NC block of B stays in L3.
+#ifdef __AVX__
+#define GEMM_MR 6
+#define GEMM_NR 16
+#define GEMM_MC 72
+#define GEMM_KC 512
+#define GEMM_NC 4096
+#else
+// 32-bit NEON has only 16 quad registers, so 4 x 8 is the largest tile
+// which leaves room for the operands
+#define GEMM_MR 4
+#define GEMM_NR 8
+#define GEMM_MC 128
+#define GEMM_KC 256
+#define GEMM_NC 1024
+#endif
+
+/// @brief Packs mc x kc block of A into the row micro-panels of GEMM_MR
+/// rows, zero padding the last one.
+/// @param rs The distance between the adjacent rows of A.
+/// @param cs The distance between the adjacent columns of A.
+/// @param shift The values to subtract from the rows of A, or NULL.
+static void gemm_pack_a(const float *a, int rs, int cs, int mc, int kc,
+                        const float *shift, float *dst) {
+  for (int i = 0; i < mc; i += GEMM_MR) {
+    int rows = mc - i < GEMM_MR? mc - i : GEMM_MR;
+    for (int p = 0; p < kc; p++) {
+      int r = 0;
+      if (shift) {
+        for (; r < rows; r++) {
+          *dst++ = a[(i + r) * rs + p * cs] - shift[i + r];
+        }
+      }
+      for (; r < rows; r++) {
+        *dst++ = a[(i + r) * rs + p * cs];
+      }
+      for (; r < GEMM_MR; r++) {
+        *dst++ = 0;
+      }
     }
-    for (int j = 0; j < (int)h1; j++) {
-      __m256 sum = _mm256_setzero_ps();
-      for (int k = 0; k < (int)w1 - 7; k += 8) {
-        __m256 v1 = _mm256_loadu_ps(m1 + j * w1 + k);
-        __m256 v2 = _mm256_load_ps(col2 + k);
-        __m256 dp = _mm256_mul_ps(v1, v2);
-        sum = _mm256_add_ps(sum, dp);
+  }
+}
+
+/// @brief Packs kc x nc block of B into the column micro-panels of GEMM_NR
+/// columns, zero padding the last one.
+/// @param rs The distance between the adjacent rows of B.
+/// @param cs The distance between the adjacent columns of B.
+/// @param shift The values to subtract from the columns of B, or NULL.
+static void gemm_pack_b(const float *b, int rs, int cs, int kc, int nc,
+                        const float *shift, float *dst) {
+  for (int j = 0; j < nc; j += GEMM_NR) {
+    int cols = nc - j < GEMM_NR? nc - j : GEMM_NR;
+    for (int p = 0; p < kc; p++) {
+      const float *src = b + p * rs + j * cs;
+      int c = 0;
+      if (shift) {
+        for (; c < cols; c++) {
+          dst[c] = src[c * cs] - shift[j + c];
+        }
+      } else if (cs == 1) {
+        memcpy(dst, src, cols * sizeof(float));
+        c = cols;
+      } else {
+        for (; c < cols; c++) {
+          dst[c] = src[c * cs];
+        }
       }
-      sum = _mm256_hadd_ps(sum, sum);
-      sum = _mm256_hadd_ps(sum, sum);
-      float rsum = _mm256_get_ps(sum, 0) + _mm256_get_ps(sum, 4);
-      for (int k = (w1 & ~0x7); k < (int)w1; k++) {
-        rsum += m1[j * w1 + k] * col2[k];
+      for (; c < GEMM_NR; c++) {
+        dst[c] = 0;
       }
-      res[j * w2 + i] = rsum;
+      dst += GEMM_NR;
     }
   }
 }
 
-static void matrix_multiply_transposed_avx(const float *m1, const float *m2,
-                                           size_t w1, size_t h1,
-                                           size_t w2 UNUSED,  size_t h2,
-                                           float *res) {
-  assert(align_complement_f32(m1) == 0);
-  assert(align_complement_f32(m2) == 0);
-  for (int j = 0; j < (int)h1; j++) {
-    for (int i = 0; i < (int)h2; i++) {
-      __m256 sum = _mm256_setzero_ps();
-      for (int k = 0; k < (int)w1 - 7; k += 8) {
-        __m256 v1 = _mm256_loadu_ps(m1 + j * w1 + k);
-        __m256 v2 = _mm256_loadu_ps(m2 + i * w1 + k);
-        __m256 dp = _mm256_mul_ps(v1, v2);
-        sum = _mm256_add_ps(sum, dp);
+/// @brief Same as gemm_pack_b(), converting the half precision B
+/// in registers.
+static void gemm_pack_b_half(const uint16_t *b, int bf16, int rs, int cs,
+                             int kc, int nc, float *dst) {
+  for (int j = 0; j < nc; j += GEMM_NR) {
+    int cols = nc - j < GEMM_NR? nc - j : GEMM_NR;
+    for (int p = 0; p < kc; p++) {
+      const uint16_t *src = b + p * rs + j * cs;
+      int c = 0;
+      if (cs == 1) {
+#ifdef __AVX__
+        for (; c + 8 <= cols; c += 8) {
+          _mm256_storeu_ps(dst + c, matrix_load_half_avx(src + c, bf16));
+        }
+#else
+        for (; c + 4 <= cols; c += 4) {
+          vst1q_f32(dst + c, matrix_load_half_neon(src + c, bf16));
+        }
+#endif
+      }
+      for (; c < cols; c++) {
+        dst[c] = matrix_half_to_float(src[c * cs], bf16);
       }
-      sum = _mm256_hadd_ps(sum, sum);
-      sum = _mm256_hadd_ps(sum, sum);
-      float rsum = _mm256_get_ps(sum, 0) + _mm256_get_ps(sum, 4);
-      for (int k = (w1 & ~0x7); k < (int)w1; k++) {
-        rsum += m1[j * w1 + k] * m2[i * w1 + k];
+      for (; c < GEMM_NR; c++) {
+        dst[c] = 0;
       }
-      res[j * h2 + i] = rsum;
+      dst += GEMM_NR;
     }
   }
 }
+
+#ifdef __AVX__
+#ifdef __FMA__
+#define GEMM_FMADD(a, b, c) _mm256_fmadd_ps(a, b, c)
+#else
+#define GEMM_FMADD(a, b, c) _mm256_add_ps(_mm256_mul_ps(a, b), c)
 #endif
 
-void matrix_add(int simd, const float *m1, const float *m2,
-                size_t w, size_t h, float *res) {
-  assert(m1);
-  assert(m2);
-  assert(res);
-  assert(w > 0);
-  assert(h > 0);
+/// @brief Calculates GEMM_MR x GEMM_NR tile of
+/// f(alpha * A * B + beta * C + bias) from the packed micro-panels, keeping
+/// the whole tile in registers.
+/// @param bias GEMM_NR values to add to the rows of the tile, or NULL.
+/// @param activation The function f.
+/// @note C is not read if beta is zero.
+static void gemm_kernel(int kc, const float *a, const float *b,
+                        float *c, int ldc, float alpha, float beta,
+                        const float *bias, ActivationFunction activation) {
+  __m256 c00 = _mm256_setzero_ps(), c01 = _mm256_setzero_ps();
+  __m256 c10 = _mm256_setzero_ps(), c11 = _mm256_setzero_ps();
+  __m256 c20 = _mm256_setzero_ps(), c21 = _mm256_setzero_ps();
+  __m256 c30 = _mm256_setzero_ps(), c31 = _mm256_setzero_ps();
+  __m256 c40 = _mm256_setzero_ps(), c41 = _mm256_setzero_ps();
+  __m256 c50 = _mm256_setzero_ps(), c51 = _mm256_setzero_ps();
+  for (int p = 0; p < kc; p++) {
+    __m256 b0 = _mm256_load_ps(b);
+    __m256 b1 = _mm256_load_ps(b + 8);
+    __m256 av = _mm256_broadcast_ss(a);
+    c00 = GEMM_FMADD(av, b0, c00);
+    c01 = GEMM_FMADD(av, b1, c01);
+    av = _mm256_broadcast_ss(a + 1);
+    c10 = GEMM_FMADD(av, b0, c10);
+    c11 = GEMM_FMADD(av, b1, c11);
+    av = _mm256_broadcast_ss(a + 2);
+    c20 = GEMM_FMADD(av, b0, c20);
+    c21 = GEMM_FMADD(av, b1, c21);
+    av = _mm256_broadcast_ss(a + 3);
+    c30 = GEMM_FMADD(av, b0, c30);
+    c31 = GEMM_FMADD(av, b1, c31);
+    av = _mm256_broadcast_ss(a + 4);
+    c40 = GEMM_FMADD(av, b0, c40);
+    c41 = GEMM_FMADD(av, b1, c41);
+    av = _mm256_broadcast_ss(a + 5);
+    c50 = GEMM_FMADD(av, b0, c50);
+    c51 = GEMM_FMADD(av, b1, c51);
+    a += GEMM_MR;
+    b += GEMM_NR;
+  }
+  const __m256 alphavec = _mm256_set1_ps(alpha);
+  const __m256 betavec = _mm256_set1_ps(beta);
+  const __m256 bias0 = bias? _mm256_loadu_ps(bias) : _mm256_setzero_ps();
+  const __m256 bias1 = bias? _mm256_loadu_ps(bias + 8) : _mm256_setzero_ps();
+#define GEMM_STORE(row, v0, v1) do { \
+    float *dst = c + (row) * ldc; \
+    if (alpha != 1) { \
+      v0 = _mm256_mul_ps(v0, alphavec); \
+      v1 = _mm256_mul_ps(v1, alphavec); \
+    } \
+    if (beta == 1) { \
+      v0 = _mm256_add_ps(v0, _mm256_loadu_ps(dst)); \
+      v1 = _mm256_add_ps(v1, _mm256_loadu_ps(dst + 8)); \
+    } else if (beta != 0) { \
+      v0 = GEMM_FMADD(betavec, _mm256_loadu_ps(dst), v0); \
+      v1 = GEMM_FMADD(betavec, _mm256_loadu_ps(dst + 8), v1); \
+    } \
+    if (bias) { \
+      v0 = _mm256_add_ps(v0, bias0); \
+      v1 = _mm256_add_ps(v1, bias1); \
+    } \
+    if (activation != kActivationIdentity) { \
+      v0 = matrix_activate_avx(v0, activation); \
+      v1 = matrix_activate_avx(v1, activation); \
+    } \
+    _mm256_storeu_ps(dst, v0); \
+    _mm256_storeu_ps(dst + 8, v1); \
+  } while (0)
+  GEMM_STORE(0, c00, c01);
+  GEMM_STORE(1, c10, c11);
+  GEMM_STORE(2, c20, c21);
+  GEMM_STORE(3, c30, c31);
+  GEMM_STORE(4, c40, c41);
+  GEMM_STORE(5, c50, c51);
+#undef GEMM_STORE
+}
+#else
+/// @brief Calculates GEMM_MR x GEMM_NR tile of
+/// f(alpha * A * B + beta * C + bias) from the packed micro-panels, keeping
+/// the whole tile in registers.
+/// @param bias GEMM_NR values to add to the rows of the tile, or NULL.
+/// @param activation The function f.
+/// @note C is not read if beta is zero.
+static void gemm_kernel(int kc, const float *a, const float *b,
+                        float *c, int ldc, float alpha, float beta,
+                        const float *bias, ActivationFunction activation) {
+  float32x4_t c00 = vdupq_n_f32(0.f), c01 = vdupq_n_f32(0.f);
+  float32x4_t c10 = vdupq_n_f32(0.f), c11 = vdupq_n_f32(0.f);
+  float32x4_t c20 = vdupq_n_f32(0.f), c21 = vdupq_n_f32(0.f);
+  float32x4_t c30 = vdupq_n_f32(0.f), c31 = vdupq_n_f32(0.f);
+  for (int p = 0; p < kc; p++) {
+    float32x4_t b0 = vld1q_f32(b);
+    float32x4_t b1 = vld1q_f32(b + 4);
+    float32x4_t av = vld1q_f32(a);
+    float32x2_t alo = vget_low_f32(av), ahi = vget_high_f32(av);
+    c00 = vmlaq_lane_f32(c00, b0, alo, 0);
+    c01 = vmlaq_lane_f32(c01, b1, alo, 0);
+    c10 = vmlaq_lane_f32(c10, b0, alo, 1);
+    c11 = vmlaq_lane_f32(c11, b1, alo, 1);
+    c20 = vmlaq_lane_f32(c20, b0, ahi, 0);
+    c21 = vmlaq_lane_f32(c21, b1, ahi, 0);
+    c30 = vmlaq_lane_f32(c30, b0, ahi, 1);
+    c31 = vmlaq_lane_f32(c31, b1, ahi, 1);
+    a += GEMM_MR;
+    b += GEMM_NR;
+  }
+  const float32x4_t bias0 = bias? vld1q_f32(bias) : vdupq_n_f32(0.f);
+  const float32x4_t bias1 = bias? vld1q_f32(bias + 4) : vdupq_n_f32(0.f);
+#define GEMM_STORE(row, v0, v1) do { \
+    float *dst = c + (row) * ldc; \
+    if (alpha != 1) { \
+      v0 = vmulq_n_f32(v0, alpha); \
+      v1 = vmulq_n_f32(v1, alpha); \
+    } \
+    if (beta == 1) { \
+      v0 = vaddq_f32(v0, vld1q_f32(dst)); \
+      v1 = vaddq_f32(v1, vld1q_f32(dst + 4)); \
+    } else if (beta != 0) { \
+      v0 = vmlaq_n_f32(v0, vld1q_f32(dst), beta); \
+      v1 = vmlaq_n_f32(v1, vld1q_f32(dst + 4), beta); \
+    } \
+    if (bias) { \
+      v0 = vaddq_f32(v0, bias0); \
+      v1 = vaddq_f32(v1, bias1); \
+    } \
+    if (activation != kActivationIdentity) { \
+      v0 = matrix_activate_neon(v0, activation); \
+      v1 = matrix_activate_neon(v1, activation); \
+    } \
+    vst1q_f32(dst, v0); \
+    vst1q_f32(dst + 4, v1); \
+  } while (0)
+  GEMM_STORE(0, c00, c01);
+  GEMM_STORE(1, c10, c11);
+  GEMM_STORE(2, c20, c21);
+  GEMM_STORE(3, c30, c31);
+#undef GEMM_STORE
+}
+#endif
+
+/// @brief Calculates the partial tile at the bottom or right edge of C
+/// through a temporary buffer.
+/// @param bias cols values to add to the rows of the tile, or NULL.
+/// @param diagonal The elements with j - i < diagonal are not stored.
+static void gemm_kernel_edge(int kc, const float *a, const float *b,
+                             float *c, int ldc, float alpha, float beta,
+                             const float *bias, ActivationFunction activation,
+                             int rows, int cols, int diagonal) {
+  float tile[GEMM_MR * GEMM_NR] __attribute__((aligned(32)));
+  gemm_kernel(kc, a, b, tile, GEMM_NR, alpha, 0, NULL, kActivationIdentity);
+  for (int i = 0; i < rows; i++) {
+    float *row = tile + i * GEMM_NR;
+    int jbeg = i + diagonal > 0? i + diagonal : 0;
+    for (int j = jbeg; j < cols; j++) {
+      if (beta != 0) {
+        row[j] += beta * c[i * ldc + j];
+      }
+      if (bias) {
+        row[j] += bias[j];
+      }
+    }
+    if (activation != kActivationIdentity) {
+      // The tile is padded, so the whole row is processed
+#ifdef __AVX__
+      for (int j = 0; j < GEMM_NR; j += 8) {
+        _mm256_store_ps(row + j, matrix_activate_avx(_mm256_load_ps(row + j),
+                                                     activation));
+      }
+#else
+      for (int j = 0; j < GEMM_NR; j += 4) {
+        vst1q_f32(row + j, matrix_activate_neon(vld1q_f32(row + j),
+                                                activation));
+      }
+#endif
+    }
+    for (int j = jbeg; j < cols; j++) {
+      c[i * ldc + j] = row[j];
+    }
+  }
+}
+
+/// Below this number of multiply-adds GEMM runs in the calling thread.
+#define GEMM_PARALLEL_THRESHOLD (128 * 128 * 128)
+
+/// @brief Calculates the macro-tile of C from the packed blocks.
+/// @param upper Value which indicates whether only the upper triangle of C
+/// is calculated.
+/// @param diagonal The column of C minus the row of C of the top left
+/// corner of the macro-tile.
+/// @param bias The values to add to the columns of the macro-tile, or NULL.
+/// @param activation The function to apply to the macro-tile.
+static void gemm_macro_kernel(int mcur, int kcur, int jbeg, int jend,
+                              const float *packedA, const float *packedB,
+                              float *c, int ldc, float alpha, float beta,
+                              int upper, int diagonal, const float *bias,
+                              ActivationFunction activation) {
+  for (int jr = jbeg; jr < jend; jr += GEMM_NR) {
+    int cols = jend - jr < GEMM_NR? jend - jr : GEMM_NR;
+    const float *pb = packedB + jr * kcur;
+    for (int ir = 0; ir < mcur; ir += GEMM_MR) {
+      int rows = mcur - ir < GEMM_MR? mcur - ir : GEMM_MR;
+      const float *pa = packedA + ir * kcur;
+      float *dst = c + (size_t)ir * ldc + jr;
+      // j - i of the top left corner of the micro-tile
+      int corner = diagonal + jr - ir;
+      if (upper && corner + cols - 1 < 0) {
+        // Entirely below the diagonal
+        continue;
+      }
+      int crossed = upper && corner - (rows - 1) < 0;
+      const float *pbias = bias? bias + jr : NULL;
+      if (rows == GEMM_MR && cols == GEMM_NR && !crossed) {
+        gemm_kernel(kcur, pa, pb, dst, ldc, alpha, beta, pbias, activation);
+      } else {
+        gemm_kernel_edge(kcur, pa, pb, dst, ldc, alpha, beta, pbias,
+                         activation, rows, cols,
+                         crossed? -corner : -GEMM_MR);
+      }
+    }
+  }
+}
+
+/// @brief C = alpha * A * B + beta * C, where A is m x k and B is k x n;
+/// both are accessed through the row and column strides, so any of them
+/// may be transposed. B is stored as float-s or as half precision numbers
+/// (uint16_t), according to btype.
+/// @param extras The optional features, may be NULL.
+/// @details The threads share the packed block of B and split the macro-tiles
+/// of C, each packing its own blocks of A. The bias and the activation are
+/// applied by the micro-kernel together with the last block of K.
+static void gemm_blocked(int m, int n, int k,
+                         const float *a, int rsa, int csa,
+                         const void *b, GemmElementType btype,
+                         int rsb, int csb,
+                         float alpha, float beta, float *c, int ldc,
+                         const GemmExtras *extras) {
+  const GemmExtras none = { NULL, NULL, 0, NULL, kActivationIdentity };
+  if (!extras) {
+    extras = &none;
+  }
+  assert(!extras->b_shift || btype == kGemmElementFloat);
+  int threads = 1;
+#ifdef _OPENMP
+  if ((double)m * n * k >= GEMM_PARALLEL_THRESHOLD) {
+    threads = matrix_threads > 0? matrix_threads : omp_get_max_threads();
+  }
+#endif
+  int nc = n < GEMM_NC? n : GEMM_NC;
+  int kc = k < GEMM_KC? k : GEMM_KC;
+  int mc = m < GEMM_MC? m : GEMM_MC;
+  int mblocks = (m + GEMM_MC - 1) / GEMM_MC;
+  float *packedB = mallocf((size_t)(nc + GEMM_NR) * kc);
+  assert(packedB);
+#ifdef _OPENMP
+  #pragma omp parallel num_threads(threads) if (threads > 1)
+#endif
+  {
+    float *packedA = mallocf((size_t)(mc + GEMM_MR) * kc);
+    assert(packedA);
+    for (int jc = 0; jc < n; jc += GEMM_NC) {
+      int ncur = n - jc < GEMM_NC? n - jc : GEMM_NC;
+      int panels = (ncur + GEMM_NR - 1) / GEMM_NR;
+      // Split the columns too if there are not enough row blocks
+      int splits = (threads + mblocks - 1) / mblocks;
+      if (splits > panels) {
+        splits = panels;
+      }
+      for (int pc = 0; pc < k; pc += GEMM_KC) {
+        int kcur = k - pc < GEMM_KC? k - pc : GEMM_KC;
+#ifdef _OPENMP
+        #pragma omp for schedule(static)
+#endif
+        for (int p = 0; p < panels; p++) {
+          int jr = p * GEMM_NR;
+          int cols = ncur - jr < GEMM_NR? ncur - jr : GEMM_NR;
+          size_t offset = (size_t)pc * rsb + (size_t)(jc + jr) * csb;
+          if (btype == kGemmElementFloat) {
+            gemm_pack_b((const float *)b + offset, rsb, csb, kcur, cols,
+                        extras->b_shift? extras->b_shift + jc + jr : NULL,
+                        packedB + jr * kcur);
+          } else {
+            gemm_pack_b_half((const uint16_t *)b + offset,
+                             btype == kGemmElementBFloat16, rsb, csb, kcur,
+                             cols, packedB + jr * kcur);
+          }
+        }
+        // The partial products of the later blocks are added to C
+        float pbeta = pc > 0? 1 : beta;
+        int last = pc + kcur == k;
+        const float *bias = last && extras->bias? extras->bias + jc : NULL;
+        ActivationFunction activation =
+            last? extras->activation : kActivationIdentity;
+#ifdef _OPENMP
+        #pragma omp for schedule(dynamic, 1)
+#endif
+        for (int t = 0; t < mblocks * splits; t++) {
+          int ic = (t / splits) * GEMM_MC;
+          int split = t % splits;
+          int mcur = m - ic < GEMM_MC? m - ic : GEMM_MC;
+          int jbeg = (split * panels / splits) * GEMM_NR;
+          int jend = ((split + 1) * panels / splits) * GEMM_NR;
+          if (jend > ncur) {
+            jend = ncur;
+          }
+          if (extras->upper && jc + jend - 1 < ic) {
+            // Entirely below the diagonal
+            continue;
+          }
+          gemm_pack_a(a + ic * rsa + pc * csa, rsa, csa, mcur, kcur,
+                      extras->a_shift? extras->a_shift + ic : NULL, packedA);
+          gemm_macro_kernel(mcur, kcur, jbeg, jend, packedA, packedB,
+                            c + (size_t)ic * ldc + jc, ldc, alpha, pbeta,
+                            extras->upper, jc - ic, bias, activation);
+        }
+      }
+    }
+    free(packedA);
+  }
+  free(packedB);
+}
+
+#endif
+
+#ifdef __AVX__
+// The double precision multiplication blocks the operands the same way as
+// gemm_blocked(), but reads them in place instead of packing: KC x NR panel
+// of B stays in L1 and MC x KC block of A stays in L2.
+#define GEMM_DOUBLE_MR 4
+#define GEMM_DOUBLE_NR 8
+#define GEMM_DOUBLE_MC 128
+#define GEMM_DOUBLE_KC 256
+
+#ifdef __FMA__
+#define GEMM_DOUBLE_FMADD(a, b, c) _mm256_fmadd_pd(a, b, c)
+#else
+#define GEMM_DOUBLE_FMADD(a, b, c) _mm256_add_pd(_mm256_mul_pd(a, b), c)
+#endif
+
+/// @brief Adds GEMM_DOUBLE_MR x GEMM_DOUBLE_NR tile of A * B to C, or
+/// overwrites C if first is set, keeping the whole tile in registers.
+static void gemm_double_kernel(int kc, const double *a, int lda,
+                               const double *b, int ldb,
+                               double *c, int ldc, int first) {
+  __m256d c00 = _mm256_setzero_pd(), c01 = _mm256_setzero_pd();
+  __m256d c10 = _mm256_setzero_pd(), c11 = _mm256_setzero_pd();
+  __m256d c20 = _mm256_setzero_pd(), c21 = _mm256_setzero_pd();
+  __m256d c30 = _mm256_setzero_pd(), c31 = _mm256_setzero_pd();
+  for (int p = 0; p < kc; p++) {
+    __m256d b0 = _mm256_loadu_pd(b + p * ldb);
+    __m256d b1 = _mm256_loadu_pd(b + p * ldb + 4);
+    __m256d av = _mm256_set1_pd(a[p]);
+    c00 = GEMM_DOUBLE_FMADD(av, b0, c00);
+    c01 = GEMM_DOUBLE_FMADD(av, b1, c01);
+    av = _mm256_set1_pd(a[lda + p]);
+    c10 = GEMM_DOUBLE_FMADD(av, b0, c10);
+    c11 = GEMM_DOUBLE_FMADD(av, b1, c11);
+    av = _mm256_set1_pd(a[2 * lda + p]);
+    c20 = GEMM_DOUBLE_FMADD(av, b0, c20);
+    c21 = GEMM_DOUBLE_FMADD(av, b1, c21);
+    av = _mm256_set1_pd(a[3 * lda + p]);
+    c30 = GEMM_DOUBLE_FMADD(av, b0, c30);
+    c31 = GEMM_DOUBLE_FMADD(av, b1, c31);
+  }
+#define GEMM_DOUBLE_STORE(row, v0, v1) do { \
+    double *dst = c + (row) * ldc; \
+    if (!first) { \
+      v0 = _mm256_add_pd(v0, _mm256_loadu_pd(dst)); \
+      v1 = _mm256_add_pd(v1, _mm256_loadu_pd(dst + 4)); \
+    } \
+    _mm256_storeu_pd(dst, v0); \
+    _mm256_storeu_pd(dst + 4, v1); \
+  } while (0)
+  GEMM_DOUBLE_STORE(0, c00, c01);
+  GEMM_DOUBLE_STORE(1, c10, c11);
+  GEMM_DOUBLE_STORE(2, c20, c21);
+  GEMM_DOUBLE_STORE(3, c30, c31);
+#undef GEMM_DOUBLE_STORE
+}
+
+/// @brief The same as gemm_double_kernel() for the partial tiles at
+/// the bottom and right edges of C.
+static void gemm_double_kernel_edge(int kc, const double *a, int lda,
+                                    const double *b, int ldb,
+                                    double *c, int ldc, int first,
+                                    int rows, int cols) {
+  for (int i = 0; i < rows; i++) {
+    for (int j = 0; j < cols; j++) {
+      double sum = first? 0 : c[i * ldc + j];
+      for (int p = 0; p < kc; p++) {
+        sum += a[i * lda + p] * b[p * ldb + j];
+      }
+      c[i * ldc + j] = sum;
+    }
+  }
+}
+
+/// @brief C = A * B, where A is m x k and B is k x n, all row-major and
+/// contiguous.
+/// @details The threads split the row blocks of C.
+static void gemm_double_avx(int m, int n, int k, const double *a,
+                            const double *b, double *c) {
+  int threads UNUSED = 1;
+#ifdef _OPENMP
+  if ((double)m * n * k >= GEMM_PARALLEL_THRESHOLD) {
+    threads = matrix_threads > 0? matrix_threads : omp_get_max_threads();
+  }
+#endif
+  int mblocks = (m + GEMM_DOUBLE_MC - 1) / GEMM_DOUBLE_MC;
+#ifdef _OPENMP
+  #pragma omp parallel num_threads(threads) if (threads > 1)
+#endif
+  for (int pc = 0; pc < k; pc += GEMM_DOUBLE_KC) {
+    int kcur = k - pc < GEMM_DOUBLE_KC? k - pc : GEMM_DOUBLE_KC;
+#ifdef _OPENMP
+    #pragma omp for schedule(dynamic, 1)
+#endif
+    for (int t = 0; t < mblocks; t++) {
+      int ic = t * GEMM_DOUBLE_MC;
+      int mcur = m - ic < GEMM_DOUBLE_MC? m - ic : GEMM_DOUBLE_MC;
+      for (int jr = 0; jr < n; jr += GEMM_DOUBLE_NR) {
+        int cols = n - jr < GEMM_DOUBLE_NR? n - jr : GEMM_DOUBLE_NR;
+        for (int ir = 0; ir < mcur; ir += GEMM_DOUBLE_MR) {
+          int rows = mcur - ir < GEMM_DOUBLE_MR? mcur - ir : GEMM_DOUBLE_MR;
+          const double *pa = a + (size_t)(ic + ir) * k + pc;
+          const double *pb = b + (size_t)pc * n + jr;
+          double *pc_ = c + (size_t)(ic + ir) * n + jr;
+          if (rows == GEMM_DOUBLE_MR && cols == GEMM_DOUBLE_NR) {
+            gemm_double_kernel(kcur, pa, k, pb, n, pc_, n, pc == 0);
+          } else {
+            gemm_double_kernel_edge(kcur, pa, k, pb, n, pc_, n, pc == 0,
+                                    rows, cols);
+          }
+        }
+      }
+    }
+  }
+}
+#endif
+
+/// The minimal number of matrix elements to split GEMV between threads.
+#define GEMV_PARALLEL_THRESHOLD (1 << 18)
+/// The minimal number of rows a GEMV thread gets.
+#define GEMV_THREAD_ROWS 32
+
+/// @brief res = m * v for h rows of width w.
+static void gemv_novec(const float *m, int w, int h, int stride,
+                       const float *v, float *res) {
+  for (int i = 0; i < h; i++) {
+    const float *row = m + (size_t)i * stride;
+    float sum = 0;
+    for (int j = 0; j < w; j++) {
+      sum += row[j] * v[j];
+    }
+    res[i] = sum;
+  }
+}
+
+/// @brief res += transposed(m) * v for h rows of width w.
+static void gemv_transposed_novec(const float *m, int w, int h, int stride,
+                                  const float *v, float *res) {
+  for (int i = 0; i < h; i++) {
+    const float *row = m + (size_t)i * stride;
+    for (int j = 0; j < w; j++) {
+      res[j] += row[j] * v[i];
+    }
+  }
+}
+
+#ifdef __AVX__
+static float gemv_dot_avx(const float *row, int w, const float *v) {
+  __m256 s0 = _mm256_setzero_ps(), s1 = _mm256_setzero_ps();
+  int j = 0;
+  for (; j + 16 <= w; j += 16) {
+    s0 = GEMM_FMADD(_mm256_loadu_ps(row + j), _mm256_loadu_ps(v + j), s0);
+    s1 = GEMM_FMADD(_mm256_loadu_ps(row + j + 8), _mm256_loadu_ps(v + j + 8),
+                    s1);
+  }
+  s0 = _mm256_add_ps(s0, s1);
+  __m128 s = _mm_add_ps(_mm256_castps256_ps128(s0),
+                        _mm256_extractf128_ps(s0, 1));
+  s = _mm_hadd_ps(s, s);
+  s = _mm_hadd_ps(s, s);
+  float sum = _mm_cvtss_f32(s);
+  for (; j < w; j++) {
+    sum += row[j] * v[j];
+  }
+  return sum;
+}
+
+/// @brief Eight rows at once, so that every load of v is reused eight times
+/// and the eight independent accumulators hide the FMA latency.
+static void gemv_avx(const float *m, int w, int h, int stride,
+                     const float *v, float *res) {
+  int i = 0;
+  for (; i + 8 <= h; i += 8) {
+    const float *r = m + (size_t)i * stride;
+    __m256 s0 = _mm256_setzero_ps(), s1 = _mm256_setzero_ps();
+    __m256 s2 = _mm256_setzero_ps(), s3 = _mm256_setzero_ps();
+    __m256 s4 = _mm256_setzero_ps(), s5 = _mm256_setzero_ps();
+    __m256 s6 = _mm256_setzero_ps(), s7 = _mm256_setzero_ps();
+    int j = 0;
+    for (; j + 8 <= w; j += 8) {
+      __m256 x = _mm256_loadu_ps(v + j);
+      s0 = GEMM_FMADD(_mm256_loadu_ps(r + j), x, s0);
+      s1 = GEMM_FMADD(_mm256_loadu_ps(r + stride + j), x, s1);
+      s2 = GEMM_FMADD(_mm256_loadu_ps(r + 2 * stride + j), x, s2);
+      s3 = GEMM_FMADD(_mm256_loadu_ps(r + 3 * stride + j), x, s3);
+      s4 = GEMM_FMADD(_mm256_loadu_ps(r + 4 * stride + j), x, s4);
+      s5 = GEMM_FMADD(_mm256_loadu_ps(r + 5 * stride + j), x, s5);
+      s6 = GEMM_FMADD(_mm256_loadu_ps(r + 6 * stride + j), x, s6);
+      s7 = GEMM_FMADD(_mm256_loadu_ps(r + 7 * stride + j), x, s7);
+    }
+    // Reduce each accumulator to its own lane of the result
+    __m256 lo = _mm256_hadd_ps(_mm256_hadd_ps(s0, s1), _mm256_hadd_ps(s2, s3));
+    __m256 hi = _mm256_hadd_ps(_mm256_hadd_ps(s4, s5), _mm256_hadd_ps(s6, s7));
+    __m256 sums = _mm256_add_ps(_mm256_permute2f128_ps(lo, hi, 0x20),
+                                _mm256_permute2f128_ps(lo, hi, 0x31));
+    _mm256_storeu_ps(res + i, sums);
+    for (; j < w; j++) {
+      for (int l = 0; l < 8; l++) {
+        res[i + l] += r[l * stride + j] * v[j];
+      }
+    }
+  }
+  for (; i < h; i++) {
+    res[i] = gemv_dot_avx(m + (size_t)i * stride, w, v);
+  }
+}
+
+/// @brief Four rows at once, so that res is loaded and stored four times less.
+static void gemv_transposed_avx(const float *m, int w, int h, int stride,
+                                const float *v, float *res) {
+  int i = 0;
+  for (; i + 4 <= h; i += 4) {
+    const float *r0 = m + (size_t)i * stride, *r1 = r0 + stride;
+    const float *r2 = r1 + stride, *r3 = r2 + stride;
+    __m256 v0 = _mm256_set1_ps(v[i]), v1 = _mm256_set1_ps(v[i + 1]);
+    __m256 v2 = _mm256_set1_ps(v[i + 2]), v3 = _mm256_set1_ps(v[i + 3]);
+    int j = 0;
+    for (; j + 8 <= w; j += 8) {
+      __m256 acc = _mm256_loadu_ps(res + j);
+      acc = GEMM_FMADD(_mm256_loadu_ps(r0 + j), v0, acc);
+      acc = GEMM_FMADD(_mm256_loadu_ps(r1 + j), v1, acc);
+      acc = GEMM_FMADD(_mm256_loadu_ps(r2 + j), v2, acc);
+      acc = GEMM_FMADD(_mm256_loadu_ps(r3 + j), v3, acc);
+      _mm256_storeu_ps(res + j, acc);
+    }
+    for (; j < w; j++) {
+      res[j] += r0[j] * v[i] + r1[j] * v[i + 1] +
+                r2[j] * v[i + 2] + r3[j] * v[i + 3];
+    }
+  }
+  for (; i < h; i++) {
+    const float *row = m + (size_t)i * stride;
+    __m256 vi = _mm256_set1_ps(v[i]);
+    int j = 0;
+    for (; j + 8 <= w; j += 8) {
+      _mm256_storeu_ps(res + j, GEMM_FMADD(_mm256_loadu_ps(row + j), vi,
+                                           _mm256_loadu_ps(res + j)));
+    }
+    for (; j < w; j++) {
+      res[j] += row[j] * v[i];
+    }
+  }
+}
+#endif
+
+#ifdef __ARM_NEON__
+static float gemv_dot_neon(const float *row, int w, const float *v) {
+  float32x4_t s = vdupq_n_f32(0.f);
+  int j = 0;
+  for (; j + 4 <= w; j += 4) {
+    s = vmlaq_f32(s, vld1q_f32(row + j), vld1q_f32(v + j));
+  }
+  float32x2_t p = vadd_f32(vget_low_f32(s), vget_high_f32(s));
+  float sum = vget_lane_f32(vpadd_f32(p, p), 0);
+  for (; j < w; j++) {
+    sum += row[j] * v[j];
+  }
+  return sum;
+}
+
+/// @brief Four rows at once, so that every load of v is reused four times.
+static void gemv_neon(const float *m, int w, int h, int stride,
+                      const float *v, float *res) {
+  int i = 0;
+  for (; i + 4 <= h; i += 4) {
+    const float *r0 = m + (size_t)i * stride, *r1 = r0 + stride;
+    const float *r2 = r1 + stride, *r3 = r2 + stride;
+    float32x4_t s0 = vdupq_n_f32(0.f), s1 = vdupq_n_f32(0.f);
+    float32x4_t s2 = vdupq_n_f32(0.f), s3 = vdupq_n_f32(0.f);
+    int j = 0;
+    for (; j + 4 <= w; j += 4) {
+      float32x4_t x = vld1q_f32(v + j);
+      s0 = vmlaq_f32(s0, vld1q_f32(r0 + j), x);
+      s1 = vmlaq_f32(s1, vld1q_f32(r1 + j), x);
+      s2 = vmlaq_f32(s2, vld1q_f32(r2 + j), x);
+      s3 = vmlaq_f32(s3, vld1q_f32(r3 + j), x);
+    }
+    float32x2_t p01 = vpadd_f32(
+        vadd_f32(vget_low_f32(s0), vget_high_f32(s0)),
+        vadd_f32(vget_low_f32(s1), vget_high_f32(s1)));
+    float32x2_t p23 = vpadd_f32(
+        vadd_f32(vget_low_f32(s2), vget_high_f32(s2)),
+        vadd_f32(vget_low_f32(s3), vget_high_f32(s3)));
+    vst1q_f32(res + i, vcombine_f32(p01, p23));
+    for (; j < w; j++) {
+      res[i] += r0[j] * v[j];
+      res[i + 1] += r1[j] * v[j];
+      res[i + 2] += r2[j] * v[j];
+      res[i + 3] += r3[j] * v[j];
+    }
+  }
+  for (; i < h; i++) {
+    res[i] = gemv_dot_neon(m + (size_t)i * stride, w, v);
+  }
+}
+
+static void gemv_transposed_neon(const float *m, int w, int h, int stride,
+                                 const float *v, float *res) {
+  int i = 0;
+  for (; i + 4 <= h; i += 4) {
+    const float *r0 = m + (size_t)i * stride, *r1 = r0 + stride;
+    const float *r2 = r1 + stride, *r3 = r2 + stride;
+    int j = 0;
+    for (; j + 4 <= w; j += 4) {
+      float32x4_t acc = vld1q_f32(res + j);
+      acc = vmlaq_n_f32(acc, vld1q_f32(r0 + j), v[i]);
+      acc = vmlaq_n_f32(acc, vld1q_f32(r1 + j), v[i + 1]);
+      acc = vmlaq_n_f32(acc, vld1q_f32(r2 + j), v[i + 2]);
+      acc = vmlaq_n_f32(acc, vld1q_f32(r3 + j), v[i + 3]);
+      vst1q_f32(res + j, acc);
+    }
+    for (; j < w; j++) {
+      res[j] += r0[j] * v[i] + r1[j] * v[i + 1] +
+                r2[j] * v[i + 2] + r3[j] * v[i + 3];
+    }
+  }
+  gemv_transposed_novec(m + (size_t)i * stride, w, h - i, stride, v + i, res);
+}
+#endif
+
+static void gemv(int simd, const float *m, int w, int h, int stride,
+                 const float *v, float *res) {
   if (simd) {
 #ifdef __ARM_NEON__
-    matrix_add_neon(m1, m2, w, h, res);
+    gemv_neon(m, w, h, stride, v, res);
   } else {
 #elif defined(__AVX__)
-    matrix_add_avx(m1, m2, w, h, res);
+    gemv_avx(m, w, h, stride, v, res);
   } else {
 #else
   } {
 #endif
-    matrix_add_novec(m1, m2, w, h, res);
+    gemv_novec(m, w, h, stride, v, res);
   }
 }
 
-void matrix_sub(int simd, const float *m1, const float *m2,
-                size_t w, size_t h, float *res) {
-  assert(m1);
-  assert(m2);
-  assert(res);
-  assert(w > 0);
-  assert(h > 0);
+static void gemv_transposed(int simd, const float *m, int w, int h,
+                            int stride, const float *v, float *res) {
   if (simd) {
 #ifdef __ARM_NEON__
-    matrix_sub_neon(m1, m2, w, h, res);
+    gemv_transposed_neon(m, w, h, stride, v, res);
   } else {
 #elif defined(__AVX__)
-    matrix_sub_avx(m1, m2, w, h, res);
+    gemv_transposed_avx(m, w, h, stride, v, res);
   } else {
 #else
   } {
 #endif
-    matrix_sub_novec(m1, m2, w, h, res);
+    gemv_transposed_novec(m, w, h, stride, v, res);
   }
 }
 
-void matrix_multiply(int simd, const float *m1, const float *m2,
-                     size_t w1, size_t h1, size_t w2, size_t h2,
-                     float *res) {
-  assert(w1 == h2);
-  assert(m1);
-  assert(m2);
+/// @brief Returns the number of threads to split the rows of a w x h GEMV.
+static int gemv_threads(size_t w UNUSED, size_t h UNUSED) {
+  int threads = 1;
+#ifdef _OPENMP
+  if ((double)w * h >= GEMV_PARALLEL_THRESHOLD) {
+    threads = matrix_threads > 0? matrix_threads : omp_get_max_threads();
+    if (threads > (int)(h / GEMV_THREAD_ROWS)) {
+      threads = h / GEMV_THREAD_ROWS;
+    }
+    if (threads < 1) {
+      threads = 1;
+    }
+  }
+#endif
+  return threads;
+}
+
+static void gemv_half_novec(const uint16_t *m, int bf16, int w, int h,
+                            int stride, const float *v, float *res) {
+  for (int i = 0; i < h; i++) {
+    const uint16_t *row = m + (size_t)i * stride;
+    float sum = 0;
+    for (int j = 0; j < w; j++) {
+      sum += matrix_half_to_float(row[j], bf16) * v[j];
+    }
+    res[i] = sum;
+  }
+}
+
+#ifdef __AVX__
+/// @brief The same as gemv_avx(), the rows are converted to float-s in
+/// registers, so the matrix is streamed at half of the bandwidth.
+INLINE void gemv_half_avx_kernel(const uint16_t *m, int bf16, int w, int h,
+                                 int stride, const float *v, float *res) {
+  int i = 0;
+  for (; i + 8 <= h; i += 8) {
+    const uint16_t *r = m + (size_t)i * stride;
+    __m256 s0 = _mm256_setzero_ps(), s1 = _mm256_setzero_ps();
+    __m256 s2 = _mm256_setzero_ps(), s3 = _mm256_setzero_ps();
+    __m256 s4 = _mm256_setzero_ps(), s5 = _mm256_setzero_ps();
+    __m256 s6 = _mm256_setzero_ps(), s7 = _mm256_setzero_ps();
+    int j = 0;
+    for (; j + 8 <= w; j += 8) {
+      __m256 x = _mm256_loadu_ps(v + j);
+      s0 = GEMM_FMADD(matrix_load_half_avx(r + j, bf16), x, s0);
+      s1 = GEMM_FMADD(matrix_load_half_avx(r + stride + j, bf16), x, s1);
+      s2 = GEMM_FMADD(matrix_load_half_avx(r + 2 * stride + j, bf16), x, s2);
+      s3 = GEMM_FMADD(matrix_load_half_avx(r + 3 * stride + j, bf16), x, s3);
+      s4 = GEMM_FMADD(matrix_load_half_avx(r + 4 * stride + j, bf16), x, s4);
+      s5 = GEMM_FMADD(matrix_load_half_avx(r + 5 * stride + j, bf16), x, s5);
+      s6 = GEMM_FMADD(matrix_load_half_avx(r + 6 * stride + j, bf16), x, s6);
+      s7 = GEMM_FMADD(matrix_load_half_avx(r + 7 * stride + j, bf16), x, s7);
+    }
+    __m256 lo = _mm256_hadd_ps(_mm256_hadd_ps(s0, s1), _mm256_hadd_ps(s2, s3));
+    __m256 hi = _mm256_hadd_ps(_mm256_hadd_ps(s4, s5), _mm256_hadd_ps(s6, s7));
+    __m256 sums = _mm256_add_ps(_mm256_permute2f128_ps(lo, hi, 0x20),
+                                _mm256_permute2f128_ps(lo, hi, 0x31));
+    _mm256_storeu_ps(res + i, sums);
+    for (; j < w; j++) {
+      for (int l = 0; l < 8; l++) {
+        res[i + l] += matrix_half_to_float(r[l * stride + j], bf16) * v[j];
+      }
+    }
+  }
+  for (; i < h; i++) {
+    const uint16_t *row = m + (size_t)i * stride;
+    __m256 acc = _mm256_setzero_ps();
+    int j = 0;
+    for (; j + 8 <= w; j += 8) {
+      acc = GEMM_FMADD(matrix_load_half_avx(row + j, bf16),
+                       _mm256_loadu_ps(v + j), acc);
+    }
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(acc),
+                          _mm256_extractf128_ps(acc, 1));
+    s = _mm_hadd_ps(s, s);
+    s = _mm_hadd_ps(s, s);
+    float sum = _mm_cvtss_f32(s);
+    for (; j < w; j++) {
+      sum += matrix_half_to_float(row[j], bf16) * v[j];
+    }
+    res[i] = sum;
+  }
+}
+
+static void gemv_half_avx(const uint16_t *m, int bf16, int w, int h,
+                          int stride, const float *v, float *res) {
+  if (bf16) {
+    gemv_half_avx_kernel(m, 1, w, h, stride, v, res);
+  } else {
+    gemv_half_avx_kernel(m, 0, w, h, stride, v, res);
+  }
+}
+#endif
+
+#ifdef __ARM_NEON__
+/// @brief The same as gemv_neon(), the rows are converted to float-s in
+/// registers, so the matrix is streamed at half of the bandwidth.
+INLINE void gemv_half_neon_kernel(const uint16_t *m, int bf16, int w, int h,
+                                  int stride, const float *v, float *res) {
+  int i = 0;
+  for (; i + 4 <= h; i += 4) {
+    const uint16_t *r0 = m + (size_t)i * stride, *r1 = r0 + stride;
+    const uint16_t *r2 = r1 + stride, *r3 = r2 + stride;
+    float32x4_t s0 = vdupq_n_f32(0.f), s1 = vdupq_n_f32(0.f);
+    float32x4_t s2 = vdupq_n_f32(0.f), s3 = vdupq_n_f32(0.f);
+    int j = 0;
+    for (; j + 4 <= w; j += 4) {
+      float32x4_t x = vld1q_f32(v + j);
+      s0 = vmlaq_f32(s0, matrix_load_half_neon(r0 + j, bf16), x);
+      s1 = vmlaq_f32(s1, matrix_load_half_neon(r1 + j, bf16), x);
+      s2 = vmlaq_f32(s2, matrix_load_half_neon(r2 + j, bf16), x);
+      s3 = vmlaq_f32(s3, matrix_load_half_neon(r3 + j, bf16), x);
+    }
+    float32x2_t p01 = vpadd_f32(
+        vadd_f32(vget_low_f32(s0), vget_high_f32(s0)),
+        vadd_f32(vget_low_f32(s1), vget_high_f32(s1)));
+    float32x2_t p23 = vpadd_f32(
+        vadd_f32(vget_low_f32(s2), vget_high_f32(s2)),
+        vadd_f32(vget_low_f32(s3), vget_high_f32(s3)));
+    vst1q_f32(res + i, vcombine_f32(p01, p23));
+    for (; j < w; j++) {
+      res[i] += matrix_half_to_float(r0[j], bf16) * v[j];
+      res[i + 1] += matrix_half_to_float(r1[j], bf16) * v[j];
+      res[i + 2] += matrix_half_to_float(r2[j], bf16) * v[j];
+      res[i + 3] += matrix_half_to_float(r3[j], bf16) * v[j];
+    }
+  }
+  gemv_half_novec(m + (size_t)i * stride, bf16, w, h - i, stride, v,
+                  res + i);
+}
+
+static void gemv_half_neon(const uint16_t *m, int bf16, int w, int h,
+                           int stride, const float *v, float *res) {
+  if (bf16) {
+    gemv_half_neon_kernel(m, 1, w, h, stride, v, res);
+  } else {
+    gemv_half_neon_kernel(m, 0, w, h, stride, v, res);
+  }
+}
+#endif
+
+static void gemv_half(int simd, const uint16_t *m, int bf16, int w, int h,
+                      int stride, const float *v, float *res) {
+  if (simd) {
+#ifdef __ARM_NEON__
+    gemv_half_neon(m, bf16, w, h, stride, v, res);
+  } else {
+#elif defined(__AVX__)
+    gemv_half_avx(m, bf16, w, h, stride, v, res);
+  } else {
+#else
+  } {
+#endif
+    gemv_half_novec(m, bf16, w, h, stride, v, res);
+  }
+}
+
+/// The maximal number of elements in the three matrices of a batched
+/// multiplication which are transposed to the interleaved layout on the fly.
+#define MATRIX_BATCH_MAX_ELEMENTS 768
+/// The maximal w1 * h1 * w2 which matrix_multiply() treats as a batch of
+/// one matrix, without packing the operands.
+#define MATRIX_SMALL_PRODUCT (16 * 16 * 16)
+
+/// @brief Returns the size of the square matrices, or 0 if they are not.
+static int matrix_batch_square_size(int w1, int h1, int w2) {
+  return w1 == h1 && h1 == w2? w1 : 0;
+}
+
+/// @brief C = A * B for a single matrix. It is always inlined, so that the
+/// constant dimensions fully unroll the loops.
+INLINE void matrix_small_novec(const float *a, const float *b,
+                               int w1, int h1, int w2, float *c) {
+  for (int i = 0; i < h1; i++) {
+    for (int j = 0; j < w2; j++) {
+      float sum = 0;
+      for (int k = 0; k < w1; k++) {
+        sum += a[i * w1 + k] * b[k * w2 + j];
+      }
+      c[i * w2 + j] = sum;
+    }
+  }
+}
+
+INLINE void matrix_batch_contiguous_novec_kernel(
+    const float *m1, const float *m2, int w1, int h1, int w2,
+    size_t count, float *res) {
+  for (size_t n = 0; n < count; n++) {
+    matrix_small_novec(m1 + n * w1 * h1, m2 + n * w1 * w2, w1, h1, w2,
+                       res + n * h1 * w2);
+  }
+}
+
+static void matrix_batch_contiguous_novec(const float *m1, const float *m2,
+                                          int w1, int h1, int w2,
+                                          size_t count, float *res) {
+  switch (matrix_batch_square_size(w1, h1, w2)) {
+    case 2:
+      matrix_batch_contiguous_novec_kernel(m1, m2, 2, 2, 2, count, res);
+      return;
+    case 3:
+      matrix_batch_contiguous_novec_kernel(m1, m2, 3, 3, 3, count, res);
+      return;
+    case 4:
+      matrix_batch_contiguous_novec_kernel(m1, m2, 4, 4, 4, count, res);
+      return;
+    default:
+      matrix_batch_contiguous_novec_kernel(m1, m2, w1, h1, w2, count, res);
+      return;
+  }
+}
+
+/// @brief Lanes [from, to) of the interleaved batch.
+static void matrix_batch_interleaved_novec(const float *m1, const float *m2,
+                                           int w1, int h1, int w2,
+                                           size_t count, size_t from,
+                                           size_t to, float *res) {
+  for (size_t n = from; n < to; n++) {
+    for (int i = 0; i < h1; i++) {
+      for (int j = 0; j < w2; j++) {
+        float sum = 0;
+        for (int k = 0; k < w1; k++) {
+          sum += m1[(i * w1 + k) * count + n] * m2[(k * w2 + j) * count + n];
+        }
+        res[(i * w2 + j) * count + n] = sum;
+      }
+    }
+  }
+}
+
+#ifdef __AVX__
+/// @brief One matrix per lane, eight matrices at a time.
+INLINE void matrix_batch_interleaved_avx_kernel(
+    const float *m1, const float *m2, int w1, int h1, int w2,
+    size_t count, float *res) {
+  size_t n = 0;
+  for (; n + 8 <= count; n += 8) {
+    for (int i = 0; i < h1; i++) {
+      const float *a = m1 + i * w1 * count + n;
+      float *c = res + i * w2 * count + n;
+      int j = 0;
+      // Four columns at once to reuse the loads of the row of A
+      for (; j + 4 <= w2; j += 4) {
+        const float *b = m2 + j * count + n;
+        __m256 ak = _mm256_loadu_ps(a);
+        __m256 sum0 = _mm256_mul_ps(ak, _mm256_loadu_ps(b));
+        __m256 sum1 = _mm256_mul_ps(ak, _mm256_loadu_ps(b + count));
+        __m256 sum2 = _mm256_mul_ps(ak, _mm256_loadu_ps(b + 2 * count));
+        __m256 sum3 = _mm256_mul_ps(ak, _mm256_loadu_ps(b + 3 * count));
+        for (int k = 1; k < w1; k++) {
+          ak = _mm256_loadu_ps(a + k * count);
+          b += w2 * count;
+          sum0 = GEMM_FMADD(ak, _mm256_loadu_ps(b), sum0);
+          sum1 = GEMM_FMADD(ak, _mm256_loadu_ps(b + count), sum1);
+          sum2 = GEMM_FMADD(ak, _mm256_loadu_ps(b + 2 * count), sum2);
+          sum3 = GEMM_FMADD(ak, _mm256_loadu_ps(b + 3 * count), sum3);
+        }
+        _mm256_storeu_ps(c + j * count, sum0);
+        _mm256_storeu_ps(c + (j + 1) * count, sum1);
+        _mm256_storeu_ps(c + (j + 2) * count, sum2);
+        _mm256_storeu_ps(c + (j + 3) * count, sum3);
+      }
+      for (; j < w2; j++) {
+        __m256 sum = _mm256_mul_ps(_mm256_loadu_ps(a),
+                                   _mm256_loadu_ps(m2 + j * count + n));
+        for (int k = 1; k < w1; k++) {
+          sum = GEMM_FMADD(_mm256_loadu_ps(a + k * count),
+                           _mm256_loadu_ps(m2 + (k * w2 + j) * count + n),
+                           sum);
+        }
+        _mm256_storeu_ps(c + j * count, sum);
+      }
+    }
+  }
+  matrix_batch_interleaved_novec(m1, m2, w1, h1, w2, count, n, count, res);
+}
+
+static void matrix_batch_interleaved_avx(const float *m1, const float *m2,
+                                         int w1, int h1, int w2,
+                                         size_t count, float *res) {
+  switch (matrix_batch_square_size(w1, h1, w2)) {
+    case 2:
+      matrix_batch_interleaved_avx_kernel(m1, m2, 2, 2, 2, count, res);
+      return;
+    case 3:
+      matrix_batch_interleaved_avx_kernel(m1, m2, 3, 3, 3, count, res);
+      return;
+    case 4:
+      matrix_batch_interleaved_avx_kernel(m1, m2, 4, 4, 4, count, res);
+      return;
+    default:
+      matrix_batch_interleaved_avx_kernel(m1, m2, w1, h1, w2, count, res);
+      return;
+  }
+}
+
+/// @brief C = A * B for a single matrix whose rows are 4 wide.
+INLINE void matrix_small_w4_avx(const float *a, const float *b,
+                                int w1, int h1, float *c) {
+  for (int i = 0; i < h1; i++) {
+    __m128 sum = _mm_mul_ps(_mm_set1_ps(a[i * w1]), _mm_loadu_ps(b));
+    for (int k = 1; k < w1; k++) {
+      sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(a[i * w1 + k]),
+                                       _mm_loadu_ps(b + k * 4)));
+    }
+    _mm_storeu_ps(c + i * 4, sum);
+  }
+}
+
+/// @brief C = A * B for a single matrix whose rows are 8 wide.
+INLINE void matrix_small_w8_avx(const float *a, const float *b,
+                                int w1, int h1, float *c) {
+  for (int i = 0; i < h1; i++) {
+    __m256 sum = _mm256_mul_ps(_mm256_set1_ps(a[i * w1]),
+                               _mm256_loadu_ps(b));
+    for (int k = 1; k < w1; k++) {
+      sum = GEMM_FMADD(_mm256_set1_ps(a[i * w1 + k]),
+                       _mm256_loadu_ps(b + k * 8), sum);
+    }
+    _mm256_storeu_ps(c + i * 8, sum);
+  }
+}
+
+/// @brief C = A * B for a single matrix whose rows are 16 wide.
+INLINE void matrix_small_w16_avx(const float *a, const float *b,
+                                 int w1, int h1, float *c) {
+  for (int i = 0; i < h1; i++) {
+    __m256 ai = _mm256_set1_ps(a[i * w1]);
+    __m256 sum0 = _mm256_mul_ps(ai, _mm256_loadu_ps(b));
+    __m256 sum1 = _mm256_mul_ps(ai, _mm256_loadu_ps(b + 8));
+    for (int k = 1; k < w1; k++) {
+      ai = _mm256_set1_ps(a[i * w1 + k]);
+      sum0 = GEMM_FMADD(ai, _mm256_loadu_ps(b + k * 16), sum0);
+      sum1 = GEMM_FMADD(ai, _mm256_loadu_ps(b + k * 16 + 8), sum1);
+    }
+    _mm256_storeu_ps(c + i * 16, sum0);
+    _mm256_storeu_ps(c + i * 16 + 8, sum1);
+  }
+}
+
+/// @brief The matrices which are too narrow for the row kernels are
+/// transposed to the interleaved layout eight at a time.
+static void matrix_batch_contiguous_avx(const float *m1, const float *m2,
+                                        int w1, int h1, int w2,
+                                        size_t count, float *res) {
+  int sa = w1 * h1, sb = w1 * w2, sc = h1 * w2;
+  size_t n = 0;
+  int square = matrix_batch_square_size(w1, h1, w2);
+  if (w2 == 4 || w2 == 8 || w2 == 16) {
+    for (; n < count; n++) {
+      const float *a = m1 + n * sa, *b = m2 + n * sb;
+      float *c = res + n * sc;
+      if (square == 4) {
+        matrix_small_w4_avx(a, b, 4, 4, c);
+      } else if (square == 8) {
+        matrix_small_w8_avx(a, b, 8, 8, c);
+      } else if (square == 16) {
+        matrix_small_w16_avx(a, b, 16, 16, c);
+      } else if (w2 == 4) {
+        matrix_small_w4_avx(a, b, w1, h1, c);
+      } else if (w2 == 8) {
+        matrix_small_w8_avx(a, b, w1, h1, c);
+      } else {
+        matrix_small_w16_avx(a, b, w1, h1, c);
+      }
+    }
+  } else if (sa + sb + sc <= MATRIX_BATCH_MAX_ELEMENTS) {
+    float buffer[MATRIX_BATCH_MAX_ELEMENTS * 8] __attribute__((aligned(32)));
+    float *a = buffer, *b = a + sa * 8, *c = b + sb * 8;
+    for (; n + 8 <= count; n += 8) {
+      for (int l = 0; l < 8; l++) {
+        for (int e = 0; e < sa; e++) {
+          a[e * 8 + l] = m1[(n + l) * sa + e];
+        }
+        for (int e = 0; e < sb; e++) {
+          b[e * 8 + l] = m2[(n + l) * sb + e];
+        }
+      }
+      matrix_batch_interleaved_avx(a, b, w1, h1, w2, 8, c);
+      for (int l = 0; l < 8; l++) {
+        for (int e = 0; e < sc; e++) {
+          res[(n + l) * sc + e] = c[e * 8 + l];
+        }
+      }
+    }
+  }
+  matrix_batch_contiguous_novec(m1 + n * sa, m2 + n * sb, w1, h1, w2,
+                                count - n, res + n * sc);
+}
+#endif
+
+#ifdef __ARM_NEON__
+/// @brief One matrix per lane, four matrices at a time.
+INLINE void matrix_batch_interleaved_neon_kernel(
+    const float *m1, const float *m2, int w1, int h1, int w2,
+    size_t count, float *res) {
+  size_t n = 0;
+  for (; n + 4 <= count; n += 4) {
+    for (int i = 0; i < h1; i++) {
+      for (int j = 0; j < w2; j++) {
+        float32x4_t sum = vmulq_f32(vld1q_f32(m1 + i * w1 * count + n),
+                                    vld1q_f32(m2 + j * count + n));
+        for (int k = 1; k < w1; k++) {
+          sum = vmlaq_f32(sum, vld1q_f32(m1 + (i * w1 + k) * count + n),
+                          vld1q_f32(m2 + (k * w2 + j) * count + n));
+        }
+        vst1q_f32(res + (i * w2 + j) * count + n, sum);
+      }
+    }
+  }
+  matrix_batch_interleaved_novec(m1, m2, w1, h1, w2, count, n, count, res);
+}
+
+static void matrix_batch_interleaved_neon(const float *m1, const float *m2,
+                                          int w1, int h1, int w2,
+                                          size_t count, float *res) {
+  switch (matrix_batch_square_size(w1, h1, w2)) {
+    case 2:
+      matrix_batch_interleaved_neon_kernel(m1, m2, 2, 2, 2, count, res);
+      return;
+    case 3:
+      matrix_batch_interleaved_neon_kernel(m1, m2, 3, 3, 3, count, res);
+      return;
+    case 4:
+      matrix_batch_interleaved_neon_kernel(m1, m2, 4, 4, 4, count, res);
+      return;
+    default:
+      matrix_batch_interleaved_neon_kernel(m1, m2, w1, h1, w2, count, res);
+      return;
+  }
+}
+
+/// @brief C = A * B for a single matrix whose rows are a multiple of 4 wide.
+INLINE void matrix_small_neon(const float *a, const float *b,
+                              int w1, int h1, int w2, float *c) {
+  for (int i = 0; i < h1; i++) {
+    for (int j = 0; j < w2; j += 4) {
+      float32x4_t sum = vmulq_n_f32(vld1q_f32(b + j), a[i * w1]);
+      for (int k = 1; k < w1; k++) {
+        sum = vmlaq_n_f32(sum, vld1q_f32(b + k * w2 + j), a[i * w1 + k]);
+      }
+      vst1q_f32(c + i * w2 + j, sum);
+    }
+  }
+}
+
+static void matrix_batch_contiguous_neon(const float *m1, const float *m2,
+                                         int w1, int h1, int w2,
+                                         size_t count, float *res) {
+  if (w2 % 4 != 0 || w2 > 16) {
+    matrix_batch_contiguous_novec(m1, m2, w1, h1, w2, count, res);
+    return;
+  }
+  int sa = w1 * h1, sb = w1 * w2, sc = h1 * w2;
+  int square = matrix_batch_square_size(w1, h1, w2);
+  for (size_t n = 0; n < count; n++) {
+    const float *a = m1 + n * sa, *b = m2 + n * sb;
+    float *c = res + n * sc;
+    if (square == 4) {
+      matrix_small_neon(a, b, 4, 4, 4, c);
+    } else if (square == 8) {
+      matrix_small_neon(a, b, 8, 8, 8, c);
+    } else {
+      matrix_small_neon(a, b, w1, h1, w2, c);
+    }
+  }
+}
+#endif
+
+/// The side of the square blocks which matrix_transpose() walks, so that
+/// both the source and the destination block stay in L1.
+#define TRANSPOSE_BLOCK 32
+/// The minimal number of matrix elements to split the transposition between
+/// threads.
+#define TRANSPOSE_PARALLEL_THRESHOLD (1 << 18)
+
+/// @brief Transposes the w x h block of src into the h x w block of dst.
+static void matrix_transpose_block_novec(const float *src, int ss,
+                                         int w, int h, float *dst, int ds) {
+  for (int i = 0; i < h; i++) {
+    for (int j = 0; j < w; j++) {
+      dst[j * ds + i] = src[i * ss + j];
+    }
+  }
+}
+
+#ifdef __AVX__
+/// @brief Transposes an 8x8 tile in registers. All the loads happen before
+/// the stores, so src may be equal to dst.
+INLINE void matrix_transpose8x8_avx(const float *src, int ss,
+                                    float *dst, int ds) {
+  __m256 r0 = _mm256_loadu_ps(src);
+  __m256 r1 = _mm256_loadu_ps(src + ss);
+  __m256 r2 = _mm256_loadu_ps(src + 2 * ss);
+  __m256 r3 = _mm256_loadu_ps(src + 3 * ss);
+  __m256 r4 = _mm256_loadu_ps(src + 4 * ss);
+  __m256 r5 = _mm256_loadu_ps(src + 5 * ss);
+  __m256 r6 = _mm256_loadu_ps(src + 6 * ss);
+  __m256 r7 = _mm256_loadu_ps(src + 7 * ss);
+  // Interleave the pairs of rows
+  __m256 t0 = _mm256_unpacklo_ps(r0, r1);
+  __m256 t1 = _mm256_unpackhi_ps(r0, r1);
+  __m256 t2 = _mm256_unpacklo_ps(r2, r3);
+  __m256 t3 = _mm256_unpackhi_ps(r2, r3);
+  __m256 t4 = _mm256_unpacklo_ps(r4, r5);
+  __m256 t5 = _mm256_unpackhi_ps(r4, r5);
+  __m256 t6 = _mm256_unpacklo_ps(r6, r7);
+  __m256 t7 = _mm256_unpackhi_ps(r6, r7);
+  // Gather the 4x4 transposes in each 128-bit lane
+  r0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+  r1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+  r2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+  r3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+  r4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0));
+  r5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+  r6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0));
+  r7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+  // Swap the off-diagonal 4x4 quarters
+  _mm256_storeu_ps(dst, _mm256_permute2f128_ps(r0, r4, 0x20));
+  _mm256_storeu_ps(dst + ds, _mm256_permute2f128_ps(r1, r5, 0x20));
+  _mm256_storeu_ps(dst + 2 * ds, _mm256_permute2f128_ps(r2, r6, 0x20));
+  _mm256_storeu_ps(dst + 3 * ds, _mm256_permute2f128_ps(r3, r7, 0x20));
+  _mm256_storeu_ps(dst + 4 * ds, _mm256_permute2f128_ps(r0, r4, 0x31));
+  _mm256_storeu_ps(dst + 5 * ds, _mm256_permute2f128_ps(r1, r5, 0x31));
+  _mm256_storeu_ps(dst + 6 * ds, _mm256_permute2f128_ps(r2, r6, 0x31));
+  _mm256_storeu_ps(dst + 7 * ds, _mm256_permute2f128_ps(r3, r7, 0x31));
+}
+
+static void matrix_transpose_block_avx(const float *src, int ss,
+                                       int w, int h, float *dst, int ds) {
+  int i = 0;
+  for (; i + 8 <= h; i += 8) {
+    int j = 0;
+    for (; j + 8 <= w; j += 8) {
+      matrix_transpose8x8_avx(src + i * ss + j, ss, dst + j * ds + i, ds);
+    }
+    matrix_transpose_block_novec(src + i * ss + j, ss, w - j, 8,
+                                 dst + j * ds + i, ds);
+  }
+  matrix_transpose_block_novec(src + i * ss, ss, w, h - i, dst + i, ds);
+}
+#endif
+
+#ifdef __ARM_NEON__
+/// @brief Transposes a 4x4 tile in registers.
+INLINE void matrix_transpose4x4_neon(const float *src, int ss,
+                                     float *dst, int ds) {
+  float32x4x2_t t01 = vtrnq_f32(vld1q_f32(src), vld1q_f32(src + ss));
+  float32x4x2_t t23 = vtrnq_f32(vld1q_f32(src + 2 * ss),
+                                vld1q_f32(src + 3 * ss));
+  vst1q_f32(dst, vcombine_f32(vget_low_f32(t01.val[0]),
+                              vget_low_f32(t23.val[0])));
+  vst1q_f32(dst + ds, vcombine_f32(vget_low_f32(t01.val[1]),
+                                   vget_low_f32(t23.val[1])));
+  vst1q_f32(dst + 2 * ds, vcombine_f32(vget_high_f32(t01.val[0]),
+                                       vget_high_f32(t23.val[0])));
+  vst1q_f32(dst + 3 * ds, vcombine_f32(vget_high_f32(t01.val[1]),
+                                       vget_high_f32(t23.val[1])));
+}
+
+static void matrix_transpose_block_neon(const float *src, int ss,
+                                        int w, int h, float *dst, int ds) {
+  int i = 0;
+  for (; i + 4 <= h; i += 4) {
+    int j = 0;
+    for (; j + 4 <= w; j += 4) {
+      matrix_transpose4x4_neon(src + i * ss + j, ss, dst + j * ds + i, ds);
+    }
+    matrix_transpose_block_novec(src + i * ss + j, ss, w - j, 4,
+                                 dst + j * ds + i, ds);
+  }
+  matrix_transpose_block_novec(src + i * ss, ss, w, h - i, dst + i, ds);
+}
+#endif
+
+static void matrix_transpose_block(int simd, const float *src, int ss,
+                                   int w, int h, float *dst, int ds) {
+  if (simd) {
+#ifdef __ARM_NEON__
+    matrix_transpose_block_neon(src, ss, w, h, dst, ds);
+  } else {
+#elif defined(__AVX__)
+    matrix_transpose_block_avx(src, ss, w, h, dst, ds);
+  } else {
+#else
+  } {
+#endif
+    matrix_transpose_block_novec(src, ss, w, h, dst, ds);
+  }
+}
+
+/// @brief Returns the number of threads to transpose a matrix of the
+/// specified size with.
+static int matrix_transpose_threads(size_t size UNUSED) {
+#ifdef _OPENMP
+  if (size >= TRANSPOSE_PARALLEL_THRESHOLD) {
+    return matrix_threads > 0? matrix_threads : omp_get_max_threads();
+  }
+#endif
+  return 1;
+}
+
+/// The maximal K for which the int32 sums of the int8 GEMM cannot overflow.
+#define MATRIX_INT8_MAX_K 32768
+
+typedef enum {
+  kMatrixQuantizedOutputInt32,
+  kMatrixQuantizedOutputFloat,
+  kMatrixQuantizedOutputUint8
+} MatrixQuantizedOutput;
+
+/// @brief Where and how the int8 GEMM writes its results.
+typedef struct {
+  MatrixQuantizedOutput type;
+  void *c;
+  int ldc;
+  QuantizationScaleType scale_type;
+  const float *scales;
+  const float *bias;
+  int zero_point;
+} GemmInt8Output;
+
+/// @brief Applies the epilogue to a rows x cols tile of exact int32 sums
+/// which starts at (i0, j0) in C.
+static void gemm_int8_store(const GemmInt8Output *out, const int32_t *tile,
+                            int ldt, int i0, int j0, int rows, int cols) {
+  for (int i = 0; i < rows; i++) {
+    const int32_t *src = tile + i * ldt;
+    size_t offset = (size_t)(i0 + i) * out->ldc + j0;
+    switch (out->type) {
+      case kMatrixQuantizedOutputInt32:
+        memcpy((int32_t *)out->c + offset, src, cols * sizeof(int32_t));
+        break;
+      case kMatrixQuantizedOutputFloat: {
+        float *dst = (float *)out->c + offset;
+        for (int j = 0; j < cols; j++) {
+          float scale = out->scales[
+              out->scale_type == kQuantizationScalePerRow? i0 + i :
+              out->scale_type == kQuantizationScalePerColumn? j0 + j : 0];
+          dst[j] = src[j] * scale + (out->bias? out->bias[j0 + j] : 0);
+        }
+        break;
+      }
+      case kMatrixQuantizedOutputUint8: {
+        uint8_t *dst = (uint8_t *)out->c + offset;
+        for (int j = 0; j < cols; j++) {
+          float scale = out->scales[
+              out->scale_type == kQuantizationScalePerRow? i0 + i :
+              out->scale_type == kQuantizationScalePerColumn? j0 + j : 0];
+          int v = (int)lrintf(src[j] * scale) + out->zero_point;
+          dst[j] = v < 0? 0 : v > 255? 255 : v;
+        }
+        break;
+      }
+    }
+  }
+}
+
+static void gemm_int8_novec(int m, int n, int k,
+                            const uint8_t *a, int za, const int8_t *b, int zb,
+                            const GemmInt8Output *out) {
+  int32_t *row = malloc(n * sizeof(int32_t));
+  assert(row);
+  for (int i = 0; i < m; i++) {
+    for (int j = 0; j < n; j++) {
+      row[j] = 0;
+    }
+    for (int p = 0; p < k; p++) {
+      int av = a[(size_t)i * k + p] - za;
+      const int8_t *brow = b + (size_t)p * n;
+      for (int j = 0; j < n; j++) {
+        row[j] += av * (brow[j] - zb);
+      }
+    }
+    gemm_int8_store(out, row, n, i, 0, 1, n);
+  }
+  free(row);
+}
+
+#if defined(__AVX2__) || defined(__ARM_NEON__)
+
+/// The int8 operands are widened to int16 with the zero points subtracted
+/// while packing, and the adjacent pairs along K are multiplied and summed
+/// into int32 with a single instruction (pmaddwd), so the results are exact.
+#ifdef __AVX2__
+#define GEMM_INT8_MR 6
+#define GEMM_INT8_NR 16
+#else
+#define GEMM_INT8_MR 4
+#define GEMM_INT8_NR 8
+#endif
+#define GEMM_INT8_MC 96
+/// The size of the packed panel of B in bytes. K is not blocked, so that
+/// the epilogue is applied to the complete sums straight from the registers
+/// (except for the partial edge tiles, which go through a small buffer).
+#define GEMM_INT8_PANEL_BYTES (2 << 20)
+
+/// @brief Packs mc rows of A as MR-row slivers of int16 pairs along K.
+static void gemm_int8_pack_a(const uint8_t *a, int lda, int za, int mc,
+                             int k, int16_t *dst) {
+  int kp = (k + 1) / 2;
+  for (int ir = 0; ir < mc; ir += GEMM_INT8_MR) {
+    int rows = mc - ir < GEMM_INT8_MR? mc - ir : GEMM_INT8_MR;
+    for (int p = 0; p < kp; p++) {
+      for (int r = 0; r < GEMM_INT8_MR; r++) {
+        const uint8_t *src = a + (size_t)(ir + r) * lda + 2 * p;
+        dst[2 * r] = r < rows? src[0] - za : 0;
+        dst[2 * r + 1] = r < rows && 2 * p + 1 < k? src[1] - za : 0;
+      }
+      dst += 2 * GEMM_INT8_MR;
+    }
+  }
+}
+
+/// @brief Packs nc columns of B as NR-column slivers of int16 pairs along K.
+static void gemm_int8_pack_b(const int8_t *b, int ldb, int zb, int k,
+                             int nc, int16_t *dst) {
+  int kp = (k + 1) / 2;
+  for (int jr = 0; jr < nc; jr += GEMM_INT8_NR) {
+    int cols = nc - jr < GEMM_INT8_NR? nc - jr : GEMM_INT8_NR;
+    for (int p = 0; p < kp; p++) {
+      const int8_t *src = b + (size_t)2 * p * ldb + jr;
+      for (int c = 0; c < GEMM_INT8_NR; c++) {
+        dst[2 * c] = c < cols? src[c] - zb : 0;
+        dst[2 * c + 1] = c < cols && 2 * p + 1 < k? src[ldb + c] - zb : 0;
+      }
+      dst += 2 * GEMM_INT8_NR;
+    }
+  }
+}
+
+#ifdef __AVX2__
+/// @brief Applies the epilogue to 16 int32 sums of row i in the registers and
+/// writes them to C at (i, j).
+INLINE void gemm_int8_epilogue_avx2(const GemmInt8Output *out, int i, int j,
+                                    __m256i s0, __m256i s1) {
+  size_t offset = (size_t)i * out->ldc + j;
+  if (out->type == kMatrixQuantizedOutputInt32) {
+    _mm256_storeu_si256((__m256i *)((int32_t *)out->c + offset), s0);
+    _mm256_storeu_si256((__m256i *)((int32_t *)out->c + offset + 8), s1);
+    return;
+  }
+  __m256 scale0, scale1;
+  if (out->scale_type == kQuantizationScalePerColumn) {
+    scale0 = _mm256_loadu_ps(out->scales + j);
+    scale1 = _mm256_loadu_ps(out->scales + j + 8);
+  } else {
+    scale0 = scale1 = _mm256_set1_ps(out->scales[
+        out->scale_type == kQuantizationScalePerRow? i : 0]);
+  }
+  __m256 f0 = _mm256_mul_ps(_mm256_cvtepi32_ps(s0), scale0);
+  __m256 f1 = _mm256_mul_ps(_mm256_cvtepi32_ps(s1), scale1);
+  if (out->type == kMatrixQuantizedOutputFloat) {
+    if (out->bias) {
+      f0 = _mm256_add_ps(f0, _mm256_loadu_ps(out->bias + j));
+      f1 = _mm256_add_ps(f1, _mm256_loadu_ps(out->bias + j + 8));
+    }
+    _mm256_storeu_ps((float *)out->c + offset, f0);
+    _mm256_storeu_ps((float *)out->c + offset + 8, f1);
+    return;
+  }
+  // cvtps rounds to nearest even like lrintf(), packs saturate to [0, 255]
+  __m256i zero_point = _mm256_set1_epi32(out->zero_point);
+  __m256i q0 = _mm256_add_epi32(_mm256_cvtps_epi32(f0), zero_point);
+  __m256i q1 = _mm256_add_epi32(_mm256_cvtps_epi32(f1), zero_point);
+  __m256i q = _mm256_permute4x64_epi64(_mm256_packs_epi32(q0, q1), 0xD8);
+  __m128i q8 = _mm_packus_epi16(_mm256_castsi256_si128(q),
+                                _mm256_extracti128_si256(q, 1));
+  _mm_storeu_si128((__m128i *)((uint8_t *)out->c + offset), q8);
+}
+
+#define GEMM_INT8_MADD(r) do { \
+  __m256i ar = _mm256_castps_si256(_mm256_broadcast_ss( \
+      (const float *)(a + 2 * r))); \
+  c##r##0 = _mm256_add_epi32(c##r##0, _mm256_madd_epi16(ar, b0)); \
+  c##r##1 = _mm256_add_epi32(c##r##1, _mm256_madd_epi16(ar, b1)); \
+} while (0)
+
+#define GEMM_INT8_STORE(r) do { \
+  if (out) { \
+    gemm_int8_epilogue_avx2(out, i0 + r, j0, c##r##0, c##r##1); \
+  } else { \
+    _mm256_storeu_si256((__m256i *)(tile + r * GEMM_INT8_NR), c##r##0); \
+    _mm256_storeu_si256((__m256i *)(tile + r * GEMM_INT8_NR + 8), c##r##1); \
+  } \
+} while (0)
+
+/// @brief Calculates the 6x16 tile of int32 sums over kp pairs along K.
+/// @details If out is not NULL, the tile is complete and the epilogue is
+/// applied to the accumulators, writing C at (i0, j0) directly. Otherwise,
+/// the sums are stored to tile.
+static void gemm_int8_kernel(int kp, const int16_t *a, const int16_t *b,
+                             const GemmInt8Output *out, int i0, int j0,
+                             int32_t *tile) {
+  __m256i c00 = _mm256_setzero_si256(), c01 = _mm256_setzero_si256();
+  __m256i c10 = _mm256_setzero_si256(), c11 = _mm256_setzero_si256();
+  __m256i c20 = _mm256_setzero_si256(), c21 = _mm256_setzero_si256();
+  __m256i c30 = _mm256_setzero_si256(), c31 = _mm256_setzero_si256();
+  __m256i c40 = _mm256_setzero_si256(), c41 = _mm256_setzero_si256();
+  __m256i c50 = _mm256_setzero_si256(), c51 = _mm256_setzero_si256();
+  for (int p = 0; p < kp; p++) {
+    // Every row contributes a pair of int16 which is broadcast as a whole
+    __m256i b0 = _mm256_loadu_si256((const __m256i *)b);
+    __m256i b1 = _mm256_loadu_si256((const __m256i *)(b + 16));
+    GEMM_INT8_MADD(0);
+    GEMM_INT8_MADD(1);
+    GEMM_INT8_MADD(2);
+    GEMM_INT8_MADD(3);
+    GEMM_INT8_MADD(4);
+    GEMM_INT8_MADD(5);
+    a += 2 * GEMM_INT8_MR;
+    b += 2 * GEMM_INT8_NR;
+  }
+  GEMM_INT8_STORE(0);
+  GEMM_INT8_STORE(1);
+  GEMM_INT8_STORE(2);
+  GEMM_INT8_STORE(3);
+  GEMM_INT8_STORE(4);
+  GEMM_INT8_STORE(5);
+}
+#else
+#define GEMM_INT8_MLAL(r) do { \
+  c##r##0 = vmlal_n_s16(c##r##0, vget_low_s16(bk.val[0]), a[2 * r]); \
+  c##r##1 = vmlal_n_s16(c##r##1, vget_high_s16(bk.val[0]), a[2 * r]); \
+  c##r##0 = vmlal_n_s16(c##r##0, vget_low_s16(bk.val[1]), a[2 * r + 1]); \
+  c##r##1 = vmlal_n_s16(c##r##1, vget_high_s16(bk.val[1]), a[2 * r + 1]); \
+} while (0)
+
+/// @brief Applies the epilogue to 8 int32 sums of row i in the registers and
+/// writes them to C at (i, j).
+/// @details ARMv7 cannot convert float to int with rounding to nearest,
+/// so the caller requantizes through the tile instead.
+INLINE void gemm_int8_epilogue_neon(const GemmInt8Output *out, int i, int j,
+                                    int32x4_t s0, int32x4_t s1) {
+  size_t offset = (size_t)i * out->ldc + j;
+  if (out->type == kMatrixQuantizedOutputInt32) {
+    vst1q_s32((int32_t *)out->c + offset, s0);
+    vst1q_s32((int32_t *)out->c + offset + 4, s1);
+    return;
+  }
+  float32x4_t scale0, scale1;
+  if (out->scale_type == kQuantizationScalePerColumn) {
+    scale0 = vld1q_f32(out->scales + j);
+    scale1 = vld1q_f32(out->scales + j + 4);
+  } else {
+    scale0 = scale1 = vdupq_n_f32(out->scales[
+        out->scale_type == kQuantizationScalePerRow? i : 0]);
+  }
+  float32x4_t f0 = vmulq_f32(vcvtq_f32_s32(s0), scale0);
+  float32x4_t f1 = vmulq_f32(vcvtq_f32_s32(s1), scale1);
+  if (out->bias) {
+    f0 = vaddq_f32(f0, vld1q_f32(out->bias + j));
+    f1 = vaddq_f32(f1, vld1q_f32(out->bias + j + 4));
+  }
+  vst1q_f32((float *)out->c + offset, f0);
+  vst1q_f32((float *)out->c + offset + 4, f1);
+}
+
+#define GEMM_INT8_STORE(r) do { \
+  if (out) { \
+    gemm_int8_epilogue_neon(out, i0 + r, j0, c##r##0, c##r##1); \
+  } else { \
+    vst1q_s32(tile + r * GEMM_INT8_NR, c##r##0); \
+    vst1q_s32(tile + r * GEMM_INT8_NR + 4, c##r##1); \
+  } \
+} while (0)
+
+/// @brief Calculates the 4x8 tile of int32 sums over kp pairs along K.
+/// @details If out is not NULL, the tile is complete and the epilogue is
+/// applied to the accumulators, writing C at (i0, j0) directly. Otherwise,
+/// the sums are stored to tile.
+static void gemm_int8_kernel(int kp, const int16_t *a, const int16_t *b,
+                             const GemmInt8Output *out, int i0, int j0,
+                             int32_t *tile) {
+  int32x4_t c00 = vdupq_n_s32(0), c01 = vdupq_n_s32(0);
+  int32x4_t c10 = vdupq_n_s32(0), c11 = vdupq_n_s32(0);
+  int32x4_t c20 = vdupq_n_s32(0), c21 = vdupq_n_s32(0);
+  int32x4_t c30 = vdupq_n_s32(0), c31 = vdupq_n_s32(0);
+  for (int p = 0; p < kp; p++) {
+    // De-interleave the pairs into the even and the odd row of B
+    int16x8x2_t bk = vld2q_s16(b);
+    GEMM_INT8_MLAL(0);
+    GEMM_INT8_MLAL(1);
+    GEMM_INT8_MLAL(2);
+    GEMM_INT8_MLAL(3);
+    a += 2 * GEMM_INT8_MR;
+    b += 2 * GEMM_INT8_NR;
+  }
+  GEMM_INT8_STORE(0);
+  GEMM_INT8_STORE(1);
+  GEMM_INT8_STORE(2);
+  GEMM_INT8_STORE(3);
+}
+#endif
+
+static void gemm_int8_blocked(int m, int n, int k,
+                              const uint8_t *a, int za,
+                              const int8_t *b, int zb,
+                              const GemmInt8Output *out) {
+  int kp = (k + 1) / 2;
+  // The panel of B is sized to stay in the outer level cache
+  int nc = GEMM_INT8_PANEL_BYTES / (4 * kp);
+  nc = nc / GEMM_INT8_NR * GEMM_INT8_NR;
+  if (nc < GEMM_INT8_NR) {
+    nc = GEMM_INT8_NR;
+  }
+  if (nc > n) {
+    nc = (n + GEMM_INT8_NR - 1) / GEMM_INT8_NR * GEMM_INT8_NR;
+  }
+  int mblocks = (m + GEMM_INT8_MC - 1) / GEMM_INT8_MC;
+  // Whether the epilogue of the complete tiles runs on the accumulators
+#ifdef __AVX2__
+  int direct = 1;
+#else
+  int direct = out->type != kMatrixQuantizedOutputUint8;
+#endif
+  int threads UNUSED = 1;
+#ifdef _OPENMP
+  if ((double)m * n * k >= GEMM_PARALLEL_THRESHOLD) {
+    threads = matrix_threads > 0? matrix_threads : omp_get_max_threads();
+  }
+#endif
+  int16_t *packedB = malloc_aligned((size_t)nc * kp * 2 * sizeof(int16_t));
+  assert(packedB);
+#ifdef _OPENMP
+  #pragma omp parallel num_threads(threads) if (threads > 1)
+#endif
+  {
+    int mc = m < GEMM_INT8_MC? m : GEMM_INT8_MC;
+    mc = (mc + GEMM_INT8_MR - 1) / GEMM_INT8_MR * GEMM_INT8_MR;
+    int16_t *packedA = malloc_aligned((size_t)mc * kp * 2 * sizeof(int16_t));
+    assert(packedA);
+    int32_t tile[GEMM_INT8_MR * GEMM_INT8_NR] __attribute__((aligned(32)));
+    for (int jc = 0; jc < n; jc += nc) {
+      int ncur = n - jc < nc? n - jc : nc;
+      int panels = (ncur + GEMM_INT8_NR - 1) / GEMM_INT8_NR;
+#ifdef _OPENMP
+      #pragma omp for schedule(static)
+#endif
+      for (int p = 0; p < panels; p++) {
+        int jr = p * GEMM_INT8_NR;
+        int cols = ncur - jr < GEMM_INT8_NR? ncur - jr : GEMM_INT8_NR;
+        gemm_int8_pack_b(b + jc + jr, n, zb, k, cols,
+                         packedB + (size_t)jr * kp * 2);
+      }
+#ifdef _OPENMP
+      #pragma omp for schedule(dynamic, 1)
+#endif
+      for (int t = 0; t < mblocks; t++) {
+        int ic = t * GEMM_INT8_MC;
+        int mcur = m - ic < GEMM_INT8_MC? m - ic : GEMM_INT8_MC;
+        gemm_int8_pack_a(a + (size_t)ic * k, k, za, mcur, k, packedA);
+        for (int jr = 0; jr < ncur; jr += GEMM_INT8_NR) {
+          int cols = ncur - jr < GEMM_INT8_NR? ncur - jr : GEMM_INT8_NR;
+          for (int ir = 0; ir < mcur; ir += GEMM_INT8_MR) {
+            int rows = mcur - ir < GEMM_INT8_MR? mcur - ir : GEMM_INT8_MR;
+            if (rows == GEMM_INT8_MR && cols == GEMM_INT8_NR && direct) {
+              gemm_int8_kernel(kp, packedA + (size_t)ir * kp * 2,
+                               packedB + (size_t)jr * kp * 2, out,
+                               ic + ir, jc + jr, NULL);
+              continue;
+            }
+            gemm_int8_kernel(kp, packedA + (size_t)ir * kp * 2,
+                             packedB + (size_t)jr * kp * 2, NULL, 0, 0,
+                             tile);
+            gemm_int8_store(out, tile, GEMM_INT8_NR, ic + ir, jc + jr,
+                            rows, cols);
+          }
+        }
+      }
+    }
+    free(packedA);
+  }
+  free(packedB);
+}
+
+#endif  // defined(__AVX2__) || defined(__ARM_NEON__)
+
+static void gemm_int8(int simd, int m, int n, int k,
+                      const uint8_t *a, int za, const int8_t *b, int zb,
+                      const GemmInt8Output *out) {
+  assert(za >= 0 && za <= 255);
+  assert(zb >= -128 && zb <= 127);
+  assert(k <= MATRIX_INT8_MAX_K);
+  if (simd) {
+#if defined(__AVX2__) || defined(__ARM_NEON__)
+    gemm_int8_blocked(m, n, k, a, za, b, zb, out);
+  } else {
+#else
+  } {
+#endif
+    gemm_int8_novec(m, n, k, a, za, b, zb, out);
+  }
+}
+
+/// The minimal number of multiply-adds in a sparse multiplication which
+/// is split between the threads.
+#define SPARSE_PARALLEL_THRESHOLD (1 << 18)
+
+static void sparse_gemv_novec(const SparseMatrix *m, size_t beg, size_t end,
+                              const float *v, float *res) {
+  for (size_t i = beg; i < end; i++) {
+    float sum = 0;
+    for (size_t p = m->row_offsets[i]; p < m->row_offsets[i + 1]; p++) {
+      sum += m->values[p] * v[m->columns[p]];
+    }
+    res[i] = sum;
+  }
+}
+
+static void sparse_gemm_novec(const SparseMatrix *m, size_t beg, size_t end,
+                              const float *b, size_t n, float *res) {
+  for (size_t i = beg; i < end; i++) {
+    float *row = res + i * n;
+    memsetf(row, 0.f, n);
+    for (size_t p = m->row_offsets[i]; p < m->row_offsets[i + 1]; p++) {
+      float value = m->values[p];
+      const float *src = b + (size_t)m->columns[p] * n;
+      for (size_t j = 0; j < n; j++) {
+        row[j] += value * src[j];
+      }
+    }
+  }
+}
+
+#ifdef __AVX__
+#ifdef __AVX2__
+/// @brief Gathers eight elements of v at a time.
+static void sparse_gemv_avx(const SparseMatrix *m, size_t beg, size_t end,
+                            const float *v, float *res) {
+  for (size_t i = beg; i < end; i++) {
+    size_t p = m->row_offsets[i], last = m->row_offsets[i + 1];
+    __m256 acc = _mm256_setzero_ps();
+    for (; p + 8 <= last; p += 8) {
+      __m256i columns = _mm256_loadu_si256((const __m256i *)(m->columns + p));
+      acc = GEMM_FMADD(_mm256_loadu_ps(m->values + p),
+                       _mm256_i32gather_ps(v, columns, 4), acc);
+    }
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(acc),
+                          _mm256_extractf128_ps(acc, 1));
+    s = _mm_hadd_ps(s, s);
+    s = _mm_hadd_ps(s, s);
+    float sum = _mm_cvtss_f32(s);
+    for (; p < last; p++) {
+      sum += m->values[p] * v[m->columns[p]];
+    }
+    res[i] = sum;
+  }
+}
+#endif
+
+/// @brief Accumulates 32 columns of a row of the result in registers
+/// while the non-zeros of the sparse row are walked.
+static void sparse_gemm_avx(const SparseMatrix *m, size_t beg, size_t end,
+                            const float *b, size_t n, float *res) {
+  for (size_t i = beg; i < end; i++) {
+    size_t first = m->row_offsets[i], last = m->row_offsets[i + 1];
+    float *row = res + i * n;
+    size_t j = 0;
+    for (; j + 32 <= n; j += 32) {
+      __m256 r0 = _mm256_setzero_ps(), r1 = _mm256_setzero_ps();
+      __m256 r2 = _mm256_setzero_ps(), r3 = _mm256_setzero_ps();
+      for (size_t p = first; p < last; p++) {
+        __m256 value = _mm256_set1_ps(m->values[p]);
+        const float *src = b + (size_t)m->columns[p] * n + j;
+        r0 = GEMM_FMADD(value, _mm256_loadu_ps(src), r0);
+        r1 = GEMM_FMADD(value, _mm256_loadu_ps(src + 8), r1);
+        r2 = GEMM_FMADD(value, _mm256_loadu_ps(src + 16), r2);
+        r3 = GEMM_FMADD(value, _mm256_loadu_ps(src + 24), r3);
+      }
+      _mm256_storeu_ps(row + j, r0);
+      _mm256_storeu_ps(row + j + 8, r1);
+      _mm256_storeu_ps(row + j + 16, r2);
+      _mm256_storeu_ps(row + j + 24, r3);
+    }
+    for (; j + 8 <= n; j += 8) {
+      __m256 r0 = _mm256_setzero_ps();
+      for (size_t p = first; p < last; p++) {
+        r0 = GEMM_FMADD(_mm256_set1_ps(m->values[p]),
+                        _mm256_loadu_ps(b + (size_t)m->columns[p] * n + j),
+                        r0);
+      }
+      _mm256_storeu_ps(row + j, r0);
+    }
+    for (; j < n; j++) {
+      float sum = 0;
+      for (size_t p = first; p < last; p++) {
+        sum += m->values[p] * b[(size_t)m->columns[p] * n + j];
+      }
+      row[j] = sum;
+    }
+  }
+}
+#endif
+
+#ifdef __ARM_NEON__
+static void sparse_gemv_neon(const SparseMatrix *m, size_t beg, size_t end,
+                             const float *v, float *res) {
+  for (size_t i = beg; i < end; i++) {
+    size_t p = m->row_offsets[i], last = m->row_offsets[i + 1];
+    float32x4_t acc = vdupq_n_f32(0.f);
+    for (; p + 4 <= last; p += 4) {
+      const int *columns = m->columns + p;
+      float32x4_t x = vld1q_dup_f32(v + columns[0]);
+      x = vld1q_lane_f32(v + columns[1], x, 1);
+      x = vld1q_lane_f32(v + columns[2], x, 2);
+      x = vld1q_lane_f32(v + columns[3], x, 3);
+      acc = vmlaq_f32(acc, vld1q_f32(m->values + p), x);
+    }
+    float32x2_t s = vadd_f32(vget_low_f32(acc), vget_high_f32(acc));
+    float sum = vget_lane_f32(vpadd_f32(s, s), 0);
+    for (; p < last; p++) {
+      sum += m->values[p] * v[m->columns[p]];
+    }
+    res[i] = sum;
+  }
+}
+
+/// @brief Accumulates 16 columns of a row of the result in registers
+/// while the non-zeros of the sparse row are walked.
+static void sparse_gemm_neon(const SparseMatrix *m, size_t beg, size_t end,
+                             const float *b, size_t n, float *res) {
+  for (size_t i = beg; i < end; i++) {
+    size_t first = m->row_offsets[i], last = m->row_offsets[i + 1];
+    float *row = res + i * n;
+    size_t j = 0;
+    for (; j + 16 <= n; j += 16) {
+      float32x4_t r0 = vdupq_n_f32(0.f), r1 = vdupq_n_f32(0.f);
+      float32x4_t r2 = vdupq_n_f32(0.f), r3 = vdupq_n_f32(0.f);
+      for (size_t p = first; p < last; p++) {
+        float value = m->values[p];
+        const float *src = b + (size_t)m->columns[p] * n + j;
+        r0 = vmlaq_n_f32(r0, vld1q_f32(src), value);
+        r1 = vmlaq_n_f32(r1, vld1q_f32(src + 4), value);
+        r2 = vmlaq_n_f32(r2, vld1q_f32(src + 8), value);
+        r3 = vmlaq_n_f32(r3, vld1q_f32(src + 12), value);
+      }
+      vst1q_f32(row + j, r0);
+      vst1q_f32(row + j + 4, r1);
+      vst1q_f32(row + j + 8, r2);
+      vst1q_f32(row + j + 12, r3);
+    }
+    for (; j + 4 <= n; j += 4) {
+      float32x4_t r0 = vdupq_n_f32(0.f);
+      for (size_t p = first; p < last; p++) {
+        r0 = vmlaq_n_f32(r0, vld1q_f32(b + (size_t)m->columns[p] * n + j),
+                         m->values[p]);
+      }
+      vst1q_f32(row + j, r0);
+    }
+    for (; j < n; j++) {
+      float sum = 0;
+      for (size_t p = first; p < last; p++) {
+        sum += m->values[p] * b[(size_t)m->columns[p] * n + j];
+      }
+      row[j] = sum;
+    }
+  }
+}
+#endif
+
+static void sparse_gemv(int simd, const SparseMatrix *m, size_t beg,
+                        size_t end, const float *v, float *res) {
+  if (simd) {
+#ifdef __ARM_NEON__
+    sparse_gemv_neon(m, beg, end, v, res);
+  } else {
+#elif defined(__AVX2__)
+    sparse_gemv_avx(m, beg, end, v, res);
+  } else {
+#else
+  } {
+#endif
+    sparse_gemv_novec(m, beg, end, v, res);
+  }
+}
+
+static void sparse_gemm(int simd, const SparseMatrix *m, size_t beg,
+                        size_t end, const float *b, size_t n, float *res) {
+  if (simd) {
+#ifdef __ARM_NEON__
+    sparse_gemm_neon(m, beg, end, b, n, res);
+  } else {
+#elif defined(__AVX__)
+    sparse_gemm_avx(m, beg, end, b, n, res);
+  } else {
+#else
+  } {
+#endif
+    sparse_gemm_novec(m, beg, end, b, n, res);
+  }
+}
+
+/// @brief Returns the number of threads to split the rows of a sparse
+/// multiplication with the specified number of multiply-adds.
+static int sparse_threads(size_t work UNUSED, size_t rows UNUSED) {
+  int threads = 1;
+#ifdef _OPENMP
+  if (work >= SPARSE_PARALLEL_THRESHOLD) {
+    threads = matrix_threads > 0? matrix_threads : omp_get_max_threads();
+    if ((size_t)threads > rows) {
+      threads = rows;
+    }
+  }
+#endif
+  return threads;
+}
+
+/// @brief Returns the first row of the part-th of parts row ranges which
+/// contain the same number of non-zeros, so that the threads are balanced
+/// regardless of how the non-zeros are distributed.
+static size_t sparse_split(const SparseMatrix *m, int part, int parts) {
+  if (part == parts) {
+    return m->height;
+  }
+  size_t target = m->row_offsets[m->height] * part / parts;
+  size_t lo = 0, hi = m->height;
+  while (lo < hi) {
+    size_t mid = (lo + hi) / 2;
+    if (m->row_offsets[mid] < target) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+INLINE float matrix_operation(MatrixOperation op, float x, float y) {
+  switch (op) {
+    case kMatrixOperationAdd:
+      return x + y;
+    case kMatrixOperationSub:
+      return x - y;
+    case kMatrixOperationMul:
+      return x * y;
+    default:
+      return x / y;
+  }
+}
+
+static void matrix_broadcast_novec(MatrixOperation op,
+                                   MatrixDirection direction,
+                                   const float *m, size_t w, size_t h,
+                                   size_t stride, const float *v,
+                                   float *res, size_t resStride) {
+  for (size_t i = 0; i < h; i++) {
+    const float *src = m + i * stride;
+    float *dst = res + i * resStride;
+    for (size_t j = 0; j < w; j++) {
+      dst[j] = matrix_operation(
+          op, src[j], direction == kMatrixPerColumn? v[j] : v[i]);
+    }
+  }
+}
+
+/// @brief The identity element of the reduction.
+INLINE float matrix_reduction_initial(MatrixReduction op) {
+  switch (op) {
+    case kMatrixReductionMin:
+      return INFINITY;
+    case kMatrixReductionMax:
+      return -INFINITY;
+    default:
+      return 0;
+  }
+}
+
+INLINE float matrix_reduction_step(MatrixReduction op, float acc, float x) {
+  switch (op) {
+    case kMatrixReductionMin:
+      return x < acc? x : acc;
+    case kMatrixReductionMax:
+      return x > acc? x : acc;
+    default:
+      return acc + x;
+  }
+}
+
+/// @brief Reduces a row of w elements, except the norm.
+static float matrix_reduce_row_novec(MatrixReduction op, const float *row,
+                                     size_t w) {
+  float acc = matrix_reduction_initial(op);
+  for (size_t j = 0; j < w; j++) {
+    acc = matrix_reduction_step(op, acc, row[j]);
+  }
+  return acc;
+}
+
+/// @brief Accumulates a row into the per column results, except the norm.
+static void matrix_reduce_column_step_novec(MatrixReduction op,
+                                            const float *row, size_t w,
+                                            float *acc) {
+  for (size_t j = 0; j < w; j++) {
+    acc[j] = matrix_reduction_step(op, acc[j], row[j]);
+  }
+}
+
+/// @brief Accumulates the squares of a row into the per column sums.
+static void matrix_reduce_squares_novec(const float *row, size_t w,
+                                        double *acc) {
+  for (size_t j = 0; j < w; j++) {
+    acc[j] += (double)row[j] * row[j];
+  }
+}
+
+static int matrix_argmax_row_novec(const float *row, size_t w) {
+  int index = -1;
+  float best = -INFINITY;
+  for (size_t j = 0; j < w; j++) {
+    if (row[j] > best || (index < 0 && row[j] == best)) {
+      best = row[j];
+      index = j;
+    }
+  }
+  return index;
+}
+
+/// @brief Updates the per column maximums and their row indices with row i.
+static void matrix_argmax_column_step_novec(const float *row, size_t w,
+                                            int i, float *best,
+                                            float *index) {
+  for (size_t j = 0; j < w; j++) {
+    if (row[j] > best[j] || (index[j] < 0 && row[j] == best[j])) {
+      best[j] = row[j];
+      index[j] = i;
+    }
+  }
+}
+
+#ifdef __AVX__
+INLINE __m256 matrix_operation_avx(MatrixOperation op, __m256 x, __m256 y) {
+  switch (op) {
+    case kMatrixOperationAdd:
+      return _mm256_add_ps(x, y);
+    case kMatrixOperationSub:
+      return _mm256_sub_ps(x, y);
+    case kMatrixOperationMul:
+      return _mm256_mul_ps(x, y);
+    default:
+      return _mm256_div_ps(x, y);
+  }
+}
+
+static void matrix_broadcast_avx(MatrixOperation op,
+                                 MatrixDirection direction,
+                                 const float *m, size_t w, size_t h,
+                                 size_t stride, const float *v,
+                                 float *res, size_t resStride) {
+  for (size_t i = 0; i < h; i++) {
+    const float *src = m + i * stride;
+    float *dst = res + i * resStride;
+    size_t j = 0;
+    if (direction == kMatrixPerColumn) {
+      for (; j + 8 <= w; j += 8) {
+        _mm256_storeu_ps(dst + j, matrix_operation_avx(
+            op, _mm256_loadu_ps(src + j), _mm256_loadu_ps(v + j)));
+      }
+      for (; j < w; j++) {
+        dst[j] = matrix_operation(op, src[j], v[j]);
+      }
+    } else {
+      __m256 value = _mm256_set1_ps(v[i]);
+      for (; j + 8 <= w; j += 8) {
+        _mm256_storeu_ps(dst + j, matrix_operation_avx(
+            op, _mm256_loadu_ps(src + j), value));
+      }
+      for (; j < w; j++) {
+        dst[j] = matrix_operation(op, src[j], v[i]);
+      }
+    }
+  }
+}
+
+/// @note _mm256_min_ps() and _mm256_max_ps() return the second operand if
+/// either one is NaN, so NaN-s are skipped.
+INLINE __m256 matrix_reduction_step_avx(MatrixReduction op, __m256 acc,
+                                        __m256 x) {
+  switch (op) {
+    case kMatrixReductionMin:
+      return _mm256_min_ps(x, acc);
+    case kMatrixReductionMax:
+      return _mm256_max_ps(x, acc);
+    default:
+      return _mm256_add_ps(acc, x);
+  }
+}
+
+static float matrix_reduce_row_avx(MatrixReduction op, const float *row,
+                                   size_t w) {
+  __m256 acc0 = _mm256_set1_ps(matrix_reduction_initial(op));
+  __m256 acc1 = acc0;
+  size_t j = 0;
+  for (; j + 16 <= w; j += 16) {
+    acc0 = matrix_reduction_step_avx(op, acc0, _mm256_loadu_ps(row + j));
+    acc1 = matrix_reduction_step_avx(op, acc1, _mm256_loadu_ps(row + j + 8));
+  }
+  if (j + 8 <= w) {
+    acc0 = matrix_reduction_step_avx(op, acc0, _mm256_loadu_ps(row + j));
+    j += 8;
+  }
+  acc0 = matrix_reduction_step_avx(op, acc0, acc1);
+  float lanes[8] __attribute__((aligned(32)));
+  _mm256_store_ps(lanes, acc0);
+  float acc = lanes[0];
+  for (int k = 1; k < 8; k++) {
+    acc = matrix_reduction_step(op, acc, lanes[k]);
+  }
+  for (; j < w; j++) {
+    acc = matrix_reduction_step(op, acc, row[j]);
+  }
+  return acc;
+}
+
+static void matrix_reduce_column_step_avx(MatrixReduction op,
+                                          const float *row, size_t w,
+                                          float *acc) {
+  size_t j = 0;
+  for (; j + 8 <= w; j += 8) {
+    _mm256_storeu_ps(acc + j, matrix_reduction_step_avx(
+        op, _mm256_loadu_ps(acc + j), _mm256_loadu_ps(row + j)));
+  }
+  for (; j < w; j++) {
+    acc[j] = matrix_reduction_step(op, acc[j], row[j]);
+  }
+}
+
+static void matrix_reduce_squares_avx(const float *row, size_t w,
+                                      double *acc) {
+  size_t j = 0;
+  for (; j + 4 <= w; j += 4) {
+    __m256d x = _mm256_cvtps_pd(_mm_loadu_ps(row + j));
+    _mm256_storeu_pd(acc + j, _mm256_add_pd(_mm256_loadu_pd(acc + j),
+                                            _mm256_mul_pd(x, x)));
+  }
+  for (; j < w; j++) {
+    acc[j] += (double)row[j] * row[j];
+  }
+}
+
+/// @brief Replaces best and index where x is greater, or where index is
+/// still -1 and x is not NaN (this catches -INFINITY).
+INLINE void matrix_argmax_step_avx(__m256 x, __m256 i, __m256 *best,
+                                   __m256 *index) {
+  // The emulated AVX supports only the predicates up to _CMP_ORD_Q
+  __m256 unset = _mm256_cmp_ps(*index, _mm256_setzero_ps(), _CMP_LT_OS);
+  __m256 mask = _mm256_or_ps(
+      _mm256_cmp_ps(*best, x, _CMP_LT_OS),
+      _mm256_and_ps(unset, _mm256_cmp_ps(x, *best, _CMP_EQ_OQ)));
+  // Not blendv, which the emulated AVX lacks without SSE4.1
+  *best = _mm256_or_ps(_mm256_and_ps(mask, x), _mm256_andnot_ps(mask, *best));
+  *index = _mm256_or_ps(_mm256_and_ps(mask, i),
+                        _mm256_andnot_ps(mask, *index));
+}
+
+static int matrix_argmax_row_avx(const float *row, size_t w) {
+  __m256 best = _mm256_set1_ps(-INFINITY);
+  __m256 index = _mm256_set1_ps(-1.f);
+  __m256 lane = _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7);
+  size_t j = 0;
+  for (; j + 8 <= w; j += 8) {
+    matrix_argmax_step_avx(_mm256_loadu_ps(row + j),
+                           _mm256_add_ps(lane, _mm256_set1_ps(j)),
+                           &best, &index);
+  }
+  float lanes[8] __attribute__((aligned(32)));
+  float indices[8] __attribute__((aligned(32)));
+  _mm256_store_ps(lanes, best);
+  _mm256_store_ps(indices, index);
+  int res = -1;
+  float value = -INFINITY;
+  for (int k = 0; k < 8; k++) {
+    if (indices[k] < 0) {
+      continue;
+    }
+    // The lanes hold the first occurrences, so the ties go to the lowest
+    if (res < 0 || lanes[k] > value ||
+        (lanes[k] == value && indices[k] < res)) {
+      value = lanes[k];
+      res = indices[k];
+    }
+  }
+  for (; j < w; j++) {
+    if (row[j] > value || (res < 0 && row[j] == value)) {
+      value = row[j];
+      res = j;
+    }
+  }
+  return res;
+}
+
+static void matrix_argmax_column_step_avx(const float *row, size_t w,
+                                          int i, float *best,
+                                          float *index) {
+  __m256 iv = _mm256_set1_ps(i);
+  size_t j = 0;
+  for (; j + 8 <= w; j += 8) {
+    __m256 b = _mm256_loadu_ps(best + j);
+    __m256 idx = _mm256_loadu_ps(index + j);
+    matrix_argmax_step_avx(_mm256_loadu_ps(row + j), iv, &b, &idx);
+    _mm256_storeu_ps(best + j, b);
+    _mm256_storeu_ps(index + j, idx);
+  }
+  matrix_argmax_column_step_novec(row + j, w - j, i, best + j, index + j);
+}
+#endif
+
+#ifdef __ARM_NEON__
+INLINE float32x4_t matrix_operation_neon(MatrixOperation op, float32x4_t x,
+                                         float32x4_t y) {
+  switch (op) {
+    case kMatrixOperationAdd:
+      return vaddq_f32(x, y);
+    case kMatrixOperationSub:
+      return vsubq_f32(x, y);
+    case kMatrixOperationMul:
+      return vmulq_f32(x, y);
+    default:
+      return vmulq_f32(x, matrix_reciprocal_neon(y));
+  }
+}
+
+static void matrix_broadcast_neon(MatrixOperation op,
+                                  MatrixDirection direction,
+                                  const float *m, size_t w, size_t h,
+                                  size_t stride, const float *v,
+                                  float *res, size_t resStride) {
+  for (size_t i = 0; i < h; i++) {
+    const float *src = m + i * stride;
+    float *dst = res + i * resStride;
+    size_t j = 0;
+    if (direction == kMatrixPerColumn) {
+      for (; j + 4 <= w; j += 4) {
+        vst1q_f32(dst + j, matrix_operation_neon(
+            op, vld1q_f32(src + j), vld1q_f32(v + j)));
+      }
+      for (; j < w; j++) {
+        dst[j] = matrix_operation(op, src[j], v[j]);
+      }
+    } else {
+      float32x4_t value = vdupq_n_f32(v[i]);
+      for (; j + 4 <= w; j += 4) {
+        vst1q_f32(dst + j, matrix_operation_neon(
+            op, vld1q_f32(src + j), value));
+      }
+      for (; j < w; j++) {
+        dst[j] = matrix_operation(op, src[j], v[i]);
+      }
+    }
+  }
+}
+
+/// @note vminq_f32() and vmaxq_f32() propagate NaN-s, so the comparisons
+/// are used instead to skip them.
+INLINE float32x4_t matrix_reduction_step_neon(MatrixReduction op,
+                                              float32x4_t acc,
+                                              float32x4_t x) {
+  switch (op) {
+    case kMatrixReductionMin:
+      return vbslq_f32(vcltq_f32(x, acc), x, acc);
+    case kMatrixReductionMax:
+      return vbslq_f32(vcgtq_f32(x, acc), x, acc);
+    default:
+      return vaddq_f32(acc, x);
+  }
+}
+
+static float matrix_reduce_row_neon(MatrixReduction op, const float *row,
+                                    size_t w) {
+  float32x4_t acc0 = vdupq_n_f32(matrix_reduction_initial(op));
+  float32x4_t acc1 = acc0;
+  size_t j = 0;
+  for (; j + 8 <= w; j += 8) {
+    acc0 = matrix_reduction_step_neon(op, acc0, vld1q_f32(row + j));
+    acc1 = matrix_reduction_step_neon(op, acc1, vld1q_f32(row + j + 4));
+  }
+  acc0 = matrix_reduction_step_neon(op, acc0, acc1);
+  float lanes[4] __attribute__((aligned(16)));
+  vst1q_f32(lanes, acc0);
+  float acc = lanes[0];
+  for (int k = 1; k < 4; k++) {
+    acc = matrix_reduction_step(op, acc, lanes[k]);
+  }
+  for (; j < w; j++) {
+    acc = matrix_reduction_step(op, acc, row[j]);
+  }
+  return acc;
+}
+
+static void matrix_reduce_column_step_neon(MatrixReduction op,
+                                           const float *row, size_t w,
+                                           float *acc) {
+  size_t j = 0;
+  for (; j + 4 <= w; j += 4) {
+    vst1q_f32(acc + j, matrix_reduction_step_neon(
+        op, vld1q_f32(acc + j), vld1q_f32(row + j)));
+  }
+  for (; j < w; j++) {
+    acc[j] = matrix_reduction_step(op, acc[j], row[j]);
+  }
+}
+
+/// @brief Same as matrix_argmax_step_avx().
+INLINE void matrix_argmax_step_neon(float32x4_t x, float32x4_t i,
+                                    float32x4_t *best, float32x4_t *index) {
+  uint32x4_t unset = vcltq_f32(*index, vdupq_n_f32(0.f));
+  uint32x4_t mask = vorrq_u32(vcgtq_f32(x, *best),
+                              vandq_u32(unset, vceqq_f32(x, *best)));
+  *best = vbslq_f32(mask, x, *best);
+  *index = vbslq_f32(mask, i, *index);
+}
+
+static int matrix_argmax_row_neon(const float *row, size_t w) {
+  float32x4_t best = vdupq_n_f32(-INFINITY);
+  float32x4_t index = vdupq_n_f32(-1.f);
+  const float lane_init[4] = { 0, 1, 2, 3 };
+  float32x4_t lane = vld1q_f32(lane_init);
+  size_t j = 0;
+  for (; j + 4 <= w; j += 4) {
+    matrix_argmax_step_neon(vld1q_f32(row + j),
+                            vaddq_f32(lane, vdupq_n_f32(j)), &best, &index);
+  }
+  float lanes[4] __attribute__((aligned(16)));
+  float indices[4] __attribute__((aligned(16)));
+  vst1q_f32(lanes, best);
+  vst1q_f32(indices, index);
+  int res = -1;
+  float value = -INFINITY;
+  for (int k = 0; k < 4; k++) {
+    if (indices[k] < 0) {
+      continue;
+    }
+    if (res < 0 || lanes[k] > value ||
+        (lanes[k] == value && indices[k] < res)) {
+      value = lanes[k];
+      res = indices[k];
+    }
+  }
+  for (; j < w; j++) {
+    if (row[j] > value || (res < 0 && row[j] == value)) {
+      value = row[j];
+      res = j;
+    }
+  }
+  return res;
+}
+
+static void matrix_argmax_column_step_neon(const float *row, size_t w,
+                                           int i, float *best,
+                                           float *index) {
+  float32x4_t iv = vdupq_n_f32(i);
+  size_t j = 0;
+  for (; j + 4 <= w; j += 4) {
+    float32x4_t b = vld1q_f32(best + j);
+    float32x4_t idx = vld1q_f32(index + j);
+    matrix_argmax_step_neon(vld1q_f32(row + j), iv, &b, &idx);
+    vst1q_f32(best + j, b);
+    vst1q_f32(index + j, idx);
+  }
+  matrix_argmax_column_step_novec(row + j, w - j, i, best + j, index + j);
+}
+#endif
+
+static float matrix_reduce_row(int simd, MatrixReduction op,
+                               const float *row, size_t w) {
+  if (simd) {
+#ifdef __ARM_NEON__
+    return matrix_reduce_row_neon(op, row, w);
+  } else {
+#elif defined(__AVX__)
+    return matrix_reduce_row_avx(op, row, w);
+  } else {
+#else
+  } {
+#endif
+    return matrix_reduce_row_novec(op, row, w);
+  }
+}
+
+static void matrix_reduce_column_step(int simd, MatrixReduction op,
+                                      const float *row, size_t w,
+                                      float *acc) {
+  if (simd) {
+#ifdef __ARM_NEON__
+    matrix_reduce_column_step_neon(op, row, w, acc);
+  } else {
+#elif defined(__AVX__)
+    matrix_reduce_column_step_avx(op, row, w, acc);
+  } else {
+#else
+  } {
+#endif
+    matrix_reduce_column_step_novec(op, row, w, acc);
+  }
+}
+
+/// @note 32-bit NEON has no double precision vectors.
+static void matrix_reduce_squares(int simd, const float *row, size_t w,
+                                  double *acc) {
+  if (simd) {
+#ifdef __AVX__
+    matrix_reduce_squares_avx(row, w, acc);
+  } else {
+#else
+  } {
+#endif
+    matrix_reduce_squares_novec(row, w, acc);
+  }
+}
+
+static int matrix_argmax_row(int simd, const float *row, size_t w) {
+  if (simd) {
+#ifdef __ARM_NEON__
+    return matrix_argmax_row_neon(row, w);
+  } else {
+#elif defined(__AVX__)
+    return matrix_argmax_row_avx(row, w);
+  } else {
+#else
+  } {
+#endif
+    return matrix_argmax_row_novec(row, w);
+  }
+}
+
+static void matrix_argmax_column_step(int simd, const float *row, size_t w,
+                                      int i, float *best, float *index) {
+  if (simd) {
+#ifdef __ARM_NEON__
+    matrix_argmax_column_step_neon(row, w, i, best, index);
+  } else {
+#elif defined(__AVX__)
+    matrix_argmax_column_step_avx(row, w, i, best, index);
+  } else {
+#else
+  } {
+#endif
+    matrix_argmax_column_step_novec(row, w, i, best, index);
+  }
+}
+
+void matrix_add(int simd, const float *m1, const float *m2,
+                size_t w, size_t h, float *res) {
+  assert(m1);
+  assert(m2);
+  assert(res);
+  assert(w > 0);
+  assert(h > 0);
+  if (simd) {
+#ifdef __ARM_NEON__
+    matrix_add_neon(m1, m2, w, h, res);
+  } else {
+#elif defined(__AVX__)
+    matrix_add_avx(m1, m2, w, h, res);
+  } else {
+#else
+  } {
+#endif
+    matrix_add_novec(m1, m2, w, h, res);
+  }
+}
+
+void matrix_sub(int simd, const float *m1, const float *m2,
+                size_t w, size_t h, float *res) {
+  assert(m1);
+  assert(m2);
+  assert(res);
+  assert(w > 0);
+  assert(h > 0);
+  if (simd) {
+#ifdef __ARM_NEON__
+    matrix_sub_neon(m1, m2, w, h, res);
+  } else {
+#elif defined(__AVX__)
+    matrix_sub_avx(m1, m2, w, h, res);
+  } else {
+#else
+  } {
+#endif
+    matrix_sub_novec(m1, m2, w, h, res);
+  }
+}
+
+void matrix_broadcast(int simd, MatrixOperation op,
+                      MatrixDirection direction, const float *m,
+                      size_t w, size_t h, size_t stride, const float *v,
+                      float *res, size_t resStride) {
+  assert(m);
+  assert(v);
+  assert(res);
+  assert(op >= kMatrixOperationAdd && op <= kMatrixOperationDiv);
+  assert(stride >= w);
+  assert(resStride >= w);
+  if (simd) {
+#ifdef __ARM_NEON__
+    matrix_broadcast_neon(op, direction, m, w, h, stride, v, res, resStride);
+  } else {
+#elif defined(__AVX__)
+    matrix_broadcast_avx(op, direction, m, w, h, stride, v, res, resStride);
+  } else {
+#else
+  } {
+#endif
+    matrix_broadcast_novec(op, direction, m, w, h, stride, v, res,
+                           resStride);
+  }
+}
+
+void matrix_reduce(int simd, MatrixReduction op, MatrixDirection direction,
+                   const float *m, size_t w, size_t h, size_t stride,
+                   float *res) {
+  assert(m);
+  assert(res);
+  assert(op >= kMatrixReductionSum && op <= kMatrixReductionNorm2);
+  assert(w > 0);
+  assert(h > 0);
+  assert(stride >= w);
+  MatrixReduction step = op == kMatrixReductionMean? kMatrixReductionSum : op;
+  if (direction == kMatrixPerRow) {
+    for (size_t i = 0; i < h; i++) {
+      const float *row = m + i * stride;
+      if (op == kMatrixReductionNorm2) {
+        res[i] = vector_nrm2(simd, w, row, 1);
+      } else {
+        res[i] = matrix_reduce_row(simd, step, row, w);
+        if (op == kMatrixReductionMean) {
+          res[i] /= w;
+        }
+      }
+    }
+    return;
+  }
+  // The rows are streamed into the per column accumulators instead of
+  // striding down the columns
+  if (op == kMatrixReductionNorm2) {
+    double *acc = calloc(w, sizeof(double));
+    assert(acc);
+    for (size_t i = 0; i < h; i++) {
+      matrix_reduce_squares(simd, m + i * stride, w, acc);
+    }
+    for (size_t j = 0; j < w; j++) {
+      res[j] = sqrt(acc[j]);
+    }
+    free(acc);
+    return;
+  }
+  memsetf(res, matrix_reduction_initial(step), w);
+  for (size_t i = 0; i < h; i++) {
+    matrix_reduce_column_step(simd, step, m + i * stride, w, res);
+  }
+  if (op == kMatrixReductionMean) {
+    for (size_t j = 0; j < w; j++) {
+      res[j] /= h;
+    }
+  }
+}
+
+void matrix_argmax(int simd, MatrixDirection direction, const float *m,
+                   size_t w, size_t h, size_t stride, int *res) {
+  assert(m);
+  assert(res);
+  assert(w > 0);
+  assert(h > 0);
+  assert(stride >= w);
+  // The SIMD lanes keep the indices in float-s
+  assert(w < (1 << 24));
+  assert(h < (1 << 24));
+  if (direction == kMatrixPerRow) {
+    for (size_t i = 0; i < h; i++) {
+      res[i] = matrix_argmax_row(simd, m + i * stride, w);
+    }
+    return;
+  }
+  float *best = mallocf(w * 2);
+  assert(best);
+  float *index = best + w;
+  memsetf(best, -INFINITY, w);
+  memsetf(index, -1, w);
+  for (size_t i = 0; i < h; i++) {
+    matrix_argmax_column_step(simd, m + i * stride, w, i, best, index);
+  }
+  for (size_t j = 0; j < w; j++) {
+    res[j] = index[j];
+  }
+  free(best);
+}
+
+void matrix_multiply(int simd, const float *m1, const float *m2,
+                     size_t w1, size_t h1, size_t w2, size_t h2,
+                     float *res) {
+  assert(w1 == h2);
+  assert(m1);
+  assert(m2);
   assert(res);
   assert(w1 > 0);
   assert(h1 > 0);
   assert(w2 > 0);
   if (simd) {
-#ifdef __ARM_NEON__
-    matrix_multiply_neon(m1, m2, w1, h1, w2, h2, res);
-  } else {
-#elif defined(__AVX__)
-    matrix_multiply_avx(m1, m2, w1, h1, w2, h2, res);
+#if defined(__ARM_NEON__) || defined(__AVX__)
+    if (w2 == 1) {
+      matrix_vector_multiply(simd, m1, w1, h1, w1, m2, res);
+    } else if (h1 == 1) {
+      matrix_transposed_vector_multiply(simd, m2, w2, h2, w2, m1, res);
+    } else if (w1 * h1 * w2 <= MATRIX_SMALL_PRODUCT) {
+      matrix_multiply_batch(simd, kMatrixBatchLayoutContiguous, m1, m2,
+                            w1, h1, w2, 1, res);
+    } else {
+      gemm_blocked(h1, w2, w1, m1, w1, 1, m2, kGemmElementFloat, w2, 1,
+                   1, 0, res, w2, NULL);
+    }
   } else {
 #else
   } {
-#endif    
+#endif
     matrix_multiply_novec(m1, m2, w1, h1, w2, h2, res);
   }
 }
 
+void matrix_multiply_double(int simd, const double *m1, const double *m2,
+                            size_t w1, size_t h1, size_t w2, size_t h2,
+                            double *res) {
+  assert(w1 == h2);
+  assert(m1);
+  assert(m2);
+  assert(res);
+  assert(w1 > 0);
+  assert(h1 > 0);
+  assert(w2 > 0);
+  if (simd) {
+#ifdef __AVX__
+    gemm_double_avx(h1, w2, w1, m1, m2, res);
+  } else {
+#else
+  } {
+#endif
+    matrix_multiply_double_novec(m1, m2, w1, h1, w2, res);
+  }
+}
+
+void matrix_multiply_transposed_double(int simd, const double *m1,
+                                       const double *m2, size_t w1,
+                                       size_t h1, size_t w2, size_t h2,
+                                       double *res) {
+  assert(w1 == w2);
+  assert(m1);
+  assert(m2);
+  assert(res);
+  assert(w1 > 0);
+  assert(h1 > 0);
+  assert(h2 > 0);
+  if (simd) {
+#ifdef __AVX__
+    // Transposing back costs O(n^2) and lets the vectorised kernel stream
+    // the rows of the second operand
+    double *m2t = malloc(w2 * h2 * sizeof(double));
+    assert(m2t);
+    for (size_t i0 = 0; i0 < h2; i0 += 16) {
+      size_t iend = i0 + 16 < h2? i0 + 16 : h2;
+      for (size_t k0 = 0; k0 < w2; k0 += 16) {
+        size_t kend = k0 + 16 < w2? k0 + 16 : w2;
+        for (size_t i = i0; i < iend; i++) {
+          for (size_t k = k0; k < kend; k++) {
+            m2t[k * h2 + i] = m2[i * w2 + k];
+          }
+        }
+      }
+    }
+    gemm_double_avx(h1, h2, w1, m1, m2t, res);
+    free(m2t);
+  } else {
+#else
+  } {
+#endif
+    matrix_multiply_transposed_double_novec(m1, m2, w1, h1, h2, res);
+  }
+}
+
 void matrix_multiply_transposed(int simd, const float *m1, const float *m2,
                                 size_t w1, size_t h1, size_t w2, size_t h2,
                                 float *res) {
@@ -329,16 +3200,690 @@ void matrix_multiply_transposed(int simd, const float *m1, const float *m2,
   assert(h1 > 0);
   assert(h2 > 0);
   if (simd) {
+#if defined(__ARM_NEON__) || defined(__AVX__)
+    if (h2 == 1) {
+      matrix_vector_multiply(simd, m1, w1, h1, w1, m2, res);
+    } else if (h1 == 1) {
+      matrix_vector_multiply(simd, m2, w2, h2, w2, m1, res);
+    } else if (m1 == m2 && h1 == h2) {
+      // The result is symmetric, so only a half of it is calculated
+      matrix_gram(simd, 0, h1, w1, 1, m1, w1, NULL, 0, res, h2, 1);
+    } else {
+      gemm_blocked(h1, h2, w1, m1, w1, 1, m2, kGemmElementFloat, 1, w2,
+                   1, 0, res, h2, NULL);
+    }
+  } else {
+#else
+  } {
+#endif
+    matrix_multiply_transposed_novec(m1, m2, w1, h1, w2, h2, res);
+  }
+}
+
+/// @brief C = beta * C, the degenerate case of GEMM.
+static void matrix_gemm_scale(size_t m, size_t n, float beta, float *c,
+                              size_t ldc) {
+  for (size_t i = 0; i < m; i++) {
+    float *row = c + i * ldc;
+    if (beta == 0) {
+      memsetf(row, 0.f, n);
+    } else if (beta != 1) {
+      for (size_t j = 0; j < n; j++) {
+        row[j] *= beta;
+      }
+    }
+  }
+}
+
+/// @brief C = f(C + bias), the epilogue of matrix_gemm_activate() as
+/// a separate pass.
+static void matrix_activate_rows(int simd, size_t m, size_t n,
+                                 const float *bias,
+                                 ActivationFunction activation,
+                                 float *c, size_t ldc) {
+  if (!bias && activation == kActivationIdentity) {
+    return;
+  }
+  for (size_t i = 0; i < m; i++) {
+    float *row = c + i * ldc;
+    size_t j = 0;
+    if (simd) {
+#ifdef __ARM_NEON__
+      for (; j + 4 <= n; j += 4) {
+        float32x4_t v = vld1q_f32(row + j);
+        if (bias) {
+          v = vaddq_f32(v, vld1q_f32(bias + j));
+        }
+        vst1q_f32(row + j, matrix_activate_neon(v, activation));
+      }
+#elif defined(__AVX__)
+      for (; j + 8 <= n; j += 8) {
+        __m256 v = _mm256_loadu_ps(row + j);
+        if (bias) {
+          v = _mm256_add_ps(v, _mm256_loadu_ps(bias + j));
+        }
+        _mm256_storeu_ps(row + j, matrix_activate_avx(v, activation));
+      }
+#endif
+    }
+    for (; j < n; j++) {
+      row[j] = matrix_activate(row[j] + (bias? bias[j] : 0), activation);
+    }
+  }
+}
+
+void matrix_gemm(int simd, int transA, int transB,
+                 size_t M, size_t N, size_t K, float alpha,
+                 const float *A, size_t lda, const float *B, size_t ldb,
+                 float beta, float *C, size_t ldc) {
+  matrix_gemm_activate(simd, transA, transB, M, N, K, alpha, A, lda, B, ldb,
+                       beta, NULL, kActivationIdentity, C, ldc);
+}
+
+void matrix_gemm_activate(int simd, int transA, int transB,
+                          size_t M, size_t N, size_t K, float alpha,
+                          const float *A, size_t lda,
+                          const float *B, size_t ldb, float beta,
+                          const float *bias, ActivationFunction activation,
+                          float *C, size_t ldc) {
+  assert(A);
+  assert(B);
+  assert(C);
+  assert(ldc >= N);
+  assert(lda >= (transA? M : K));
+  assert(ldb >= (transB? K : N));
+  assert(activation >= kActivationIdentity &&
+         activation <= kActivationSigmoid);
+  if (M == 0 || N == 0) {
+    return;
+  }
+  if (K == 0 || alpha == 0) {
+    matrix_gemm_scale(M, N, beta, C, ldc);
+    matrix_activate_rows(simd, M, N, bias, activation, C, ldc);
+    return;
+  }
+  // op(A)[i][p] = A[i * rsa + p * csa], op(B)[p][j] = B[p * rsb + j * csb]
+  int rsa = transA? 1 : lda, csa = transA? lda : 1;
+  int rsb = transB? 1 : ldb, csb = transB? ldb : 1;
+  if (simd) {
+#if defined(__ARM_NEON__) || defined(__AVX__)
+    GemmExtras extras = { NULL, NULL, 0, bias, activation };
+    gemm_blocked(M, N, K, A, rsa, csa, B, kGemmElementFloat, rsb, csb,
+                 alpha, beta, C, ldc, &extras);
+  } else {
+#else
+  } {
+#endif
+    matrix_gemm_novec(M, N, K, alpha, A, rsa, csa, B, rsb, csb, beta, C, ldc);
+    matrix_activate_rows(simd, M, N, bias, activation, C, ldc);
+  }
+}
+
+void matrix_multiply_activate(int simd, const float *m1, const float *m2,
+                              size_t w1, size_t h1, size_t w2, size_t h2,
+                              const float *bias,
+                              ActivationFunction activation,
+                              float *res) {
+  assert(w1 == h2);
+  assert(w1 > 0);
+  assert(h1 > 0);
+  assert(w2 > 0);
+  if (w2 == 1 || h1 == 1 || w1 * h1 * w2 <= MATRIX_SMALL_PRODUCT) {
+    // The specialised kernels of matrix_multiply() win here and the result
+    // is still in the cache for the second pass
+    matrix_multiply(simd, m1, m2, w1, h1, w2, h2, res);
+    matrix_activate_rows(simd, h1, w2, bias, activation, res, w2);
+    return;
+  }
+  matrix_gemm_activate(simd, 0, 0, h1, w2, w1, 1, m1, w1, m2, w2, 0,
+                       bias, activation, res, w2);
+}
+
+void matrix_gemm_half(int simd, HalfFloatType type, int transA, int transB,
+                      size_t M, size_t N, size_t K, float alpha,
+                      const float *A, size_t lda, const uint16_t *B,
+                      size_t ldb, float beta, float *C, size_t ldc) {
+  assert(A);
+  assert(B);
+  assert(C);
+  assert(type == kHalfFloatIEEE || type == kHalfFloatBFloat16);
+  assert(ldc >= N);
+  assert(lda >= (transA? M : K));
+  assert(ldb >= (transB? K : N));
+  if (M == 0 || N == 0) {
+    return;
+  }
+  if (K == 0 || alpha == 0) {
+    matrix_gemm_scale(M, N, beta, C, ldc);
+    return;
+  }
+  int rsa = transA? 1 : lda, csa = transA? lda : 1;
+  int rsb = transB? 1 : ldb, csb = transB? ldb : 1;
+  if (simd) {
+#if defined(__ARM_NEON__) || defined(__AVX__)
+    gemm_blocked(M, N, K, A, rsa, csa, B,
+                 type == kHalfFloatBFloat16? kGemmElementBFloat16 :
+                                             kGemmElementFloat16,
+                 rsb, csb, alpha, beta, C, ldc, NULL);
+  } else {
+#else
+  } {
+#endif
+    matrix_gemm_half_novec(M, N, K, alpha, A, rsa, csa, B,
+                           type == kHalfFloatBFloat16, rsb, csb,
+                           beta, C, ldc);
+  }
+}
+
+static void matrix_gram_novec(int n, int k, float alpha, const float *a,
+                              int rsa, int csa, const float *means,
+                              float beta, float *c, int ldc) {
+  for (int i = 0; i < n; i++) {
+    float mi = means? means[i] : 0;
+    for (int j = i; j < n; j++) {
+      float mj = means? means[j] : 0;
+      float sum = 0;
+      for (int p = 0; p < k; p++) {
+        sum += (a[i * rsa + p * csa] - mi) * (a[j * rsa + p * csa] - mj);
+      }
+      float *dst = c + (size_t)i * ldc + j;
+      *dst = beta == 0? alpha * sum : alpha * sum + beta * *dst;
+    }
+  }
+}
+
+/// @brief Copies the upper triangle of a square matrix to the lower one.
+static void matrix_gram_mirror(int simd, float *c, int n, int ldc) {
+  for (int ib = 0; ib < n; ib += TRANSPOSE_BLOCK) {
+    int ih = n - ib < TRANSPOSE_BLOCK? n - ib : TRANSPOSE_BLOCK;
+    for (int i = ib + 1; i < ib + ih; i++) {
+      for (int j = ib; j < i; j++) {
+        c[(size_t)i * ldc + j] = c[(size_t)j * ldc + i];
+      }
+    }
+    for (int jb = ib + ih; jb < n; jb += TRANSPOSE_BLOCK) {
+      int jw = n - jb < TRANSPOSE_BLOCK? n - jb : TRANSPOSE_BLOCK;
+      matrix_transpose_block(simd, c + (size_t)ib * ldc + jb, ldc, jw, ih,
+                             c + (size_t)jb * ldc + ib, ldc);
+    }
+  }
+}
+
+void matrix_gram(int simd, int transA, size_t N, size_t K, float alpha,
+                 const float *A, size_t lda, const float *means, float beta,
+                 float *C, size_t ldc, int mirror) {
+  assert(A);
+  assert(C);
+  assert(ldc >= N);
+  assert(lda >= (transA? N : K));
+  if (N == 0) {
+    return;
+  }
+  if (K == 0 || alpha == 0) {
+    // Only the upper triangle, the lower one is either mirrored or kept
+    for (size_t i = 0; i < N; i++) {
+      matrix_gemm_scale(1, N - i, beta, C + i * ldc + i, ldc);
+    }
+  } else {
+    int rsa = transA? 1 : lda, csa = transA? lda : 1;
+    if (simd) {
+#if defined(__ARM_NEON__) || defined(__AVX__)
+      // op(A) op(A)^T, both operands are packed from A
+      GemmExtras extras = { means, means, 1, NULL, kActivationIdentity };
+      gemm_blocked(N, N, K, A, rsa, csa, A, kGemmElementFloat, csa, rsa,
+                   alpha, beta, C, ldc, &extras);
+    } else {
+#else
+    } {
+#endif
+      matrix_gram_novec(N, K, alpha, A, rsa, csa, means, beta, C, ldc);
+    }
+  }
+  if (mirror) {
+    matrix_gram_mirror(simd, C, N, ldc);
+  }
+}
+
+/// The default size below which matrix_multiply_strassen() falls back to
+/// the blocked multiplication.
+#define MATRIX_STRASSEN_CROSSOVER 1024
+
+/// @brief res = x + y or res = x - y for rows x cols submatrices.
+static void strassen_add(int simd, size_t rows, size_t cols,
+                         const float *x, size_t ldx, const float *y,
+                         size_t ldy, float *res, size_t ldres,
+                         int subtract) {
+  for (size_t i = 0; i < rows; i++) {
+    if (subtract) {
+      matrix_sub(simd, x + i * ldx, y + i * ldy, cols, 1, res + i * ldres);
+    } else {
+      matrix_add(simd, x + i * ldx, y + i * ldy, cols, 1, res + i * ldres);
+    }
+  }
+}
+
+static int strassen_is_leaf(size_t m, size_t n, size_t k, size_t crossover) {
+  return m <= crossover || n <= crossover || k <= crossover;
+}
+
+/// @brief The number of float-s in the temporaries of all the levels of
+/// the recursion.
+static size_t strassen_workspace(size_t m, size_t n, size_t k,
+                                 size_t crossover) {
+  if (strassen_is_leaf(m, n, k, crossover)) {
+    return 0;
+  }
+  size_t m2 = m / 2, n2 = n / 2, k2 = k / 2;
+  return m2 * (k2 > n2? k2 : n2) + k2 * n2 +
+      strassen_workspace(m2, n2, k2, crossover);
+}
+
+/// @brief C = A * B with the Strassen-Winograd recursion.
+/// @details The schedule of the 7 products and 15 additions comes from
+/// Boscher et al., "Memory efficient scheduling of Strassen-Winograd's
+/// matrix multiplication algorithm": it needs only two temporaries, X for
+/// a quadrant of A or C and Y for a quadrant of B, the rest is computed in
+/// the quadrants of C. The odd row, column and inner dimension are peeled
+/// off and added with matrix_gemm().
+static void strassen(int simd, size_t m, size_t n, size_t k,
+                     const float *a, size_t lda, const float *b, size_t ldb,
+                     float *c, size_t ldc, size_t crossover, float *work) {
+  if (strassen_is_leaf(m, n, k, crossover)) {
+    matrix_gemm(simd, 0, 0, m, n, k, 1, a, lda, b, ldb, 0, c, ldc);
+    return;
+  }
+  size_t m2 = m / 2, n2 = n / 2, k2 = k / 2;
+  const float *a11 = a, *a12 = a + k2;
+  const float *a21 = a + m2 * lda, *a22 = a21 + k2;
+  const float *b11 = b, *b12 = b + n2;
+  const float *b21 = b + k2 * ldb, *b22 = b21 + n2;
+  float *c11 = c, *c12 = c + n2;
+  float *c21 = c + m2 * ldc, *c22 = c21 + n2;
+  size_t ldx = k2 > n2? k2 : n2;
+  float *x = work;
+  float *y = x + m2 * ldx;
+  float *next = y + k2 * n2;
+  // S3 = A11 - A21, T3 = B22 - B12, C21 = P7 = S3 * T3
+  strassen_add(simd, m2, k2, a11, lda, a21, lda, x, ldx, 1);
+  strassen_add(simd, k2, n2, b22, ldb, b12, ldb, y, n2, 1);
+  strassen(simd, m2, n2, k2, x, ldx, y, n2, c21, ldc, crossover, next);
+  // S1 = A21 + A22, T1 = B12 - B11, C22 = P5 = S1 * T1
+  strassen_add(simd, m2, k2, a21, lda, a22, lda, x, ldx, 0);
+  strassen_add(simd, k2, n2, b12, ldb, b11, ldb, y, n2, 1);
+  strassen(simd, m2, n2, k2, x, ldx, y, n2, c22, ldc, crossover, next);
+  // S2 = S1 - A11, T2 = B22 - T1, C12 = P6 = S2 * T2
+  strassen_add(simd, m2, k2, x, ldx, a11, lda, x, ldx, 1);
+  strassen_add(simd, k2, n2, b22, ldb, y, n2, y, n2, 1);
+  strassen(simd, m2, n2, k2, x, ldx, y, n2, c12, ldc, crossover, next);
+  // S4 = A12 - S2, C11 = P3 = S4 * B22
+  strassen_add(simd, m2, k2, a12, lda, x, ldx, x, ldx, 1);
+  strassen(simd, m2, n2, k2, x, ldx, b22, ldb, c11, ldc, crossover, next);
+  // X = P1 = A11 * B11
+  strassen(simd, m2, n2, k2, a11, lda, b11, ldb, x, ldx, crossover, next);
+  // U2 = P1 + P6, U3 = U2 + P7, U4 = U2 + P5, U7 = U3 + P5, U5 = U4 + P3
+  strassen_add(simd, m2, n2, x, ldx, c12, ldc, c12, ldc, 0);
+  strassen_add(simd, m2, n2, c12, ldc, c21, ldc, c21, ldc, 0);
+  strassen_add(simd, m2, n2, c12, ldc, c22, ldc, c12, ldc, 0);
+  strassen_add(simd, m2, n2, c21, ldc, c22, ldc, c22, ldc, 0);
+  strassen_add(simd, m2, n2, c12, ldc, c11, ldc, c12, ldc, 0);
+  // T4 = T2 - B21, C11 = P4 = A22 * T4, U6 = U3 - P4
+  strassen_add(simd, k2, n2, y, n2, b21, ldb, y, n2, 1);
+  strassen(simd, m2, n2, k2, a22, lda, y, n2, c11, ldc, crossover, next);
+  strassen_add(simd, m2, n2, c21, ldc, c11, ldc, c21, ldc, 1);
+  // C11 = P2 = A12 * B21, U1 = P1 + P2
+  strassen(simd, m2, n2, k2, a12, lda, b21, ldb, c11, ldc, crossover, next);
+  strassen_add(simd, m2, n2, x, ldx, c11, ldc, c11, ldc, 0);
+  // Peel off the odd dimensions
+  if (k % 2) {
+    matrix_gemm(simd, 0, 0, 2 * m2, 2 * n2, 1, 1, a + 2 * k2, lda,
+                b + 2 * k2 * ldb, ldb, 1, c, ldc);
+  }
+  if (n % 2) {
+    matrix_gemm(simd, 0, 0, 2 * m2, 1, k, 1, a, lda, b + 2 * n2, ldb,
+                0, c + 2 * n2, ldc);
+  }
+  if (m % 2) {
+    matrix_gemm(simd, 0, 0, 1, n, k, 1, a + 2 * m2 * lda, lda, b, ldb,
+                0, c + 2 * m2 * ldc, ldc);
+  }
+}
+
+size_t matrix_multiply_strassen_workspace(size_t M, size_t N, size_t K,
+                                          size_t crossover) {
+  return strassen_workspace(M, N, K, crossover > 0?
+                            crossover : MATRIX_STRASSEN_CROSSOVER);
+}
+
+void matrix_multiply_strassen(int simd, size_t M, size_t N, size_t K,
+                              const float *A, size_t lda,
+                              const float *B, size_t ldb,
+                              float *C, size_t ldc, size_t crossover,
+                              float *workspace) {
+  assert(A);
+  assert(B);
+  assert(C);
+  assert(lda >= K);
+  assert(ldb >= N);
+  assert(ldc >= N);
+  if (crossover == 0) {
+    crossover = MATRIX_STRASSEN_CROSSOVER;
+  }
+  // The recursion is pointless below 2 x 2 blocks
+  if (crossover < 2) {
+    crossover = 2;
+  }
+  size_t size = strassen_workspace(M, N, K, crossover);
+  float *work = workspace;
+  if (!work && size > 0) {
+    work = mallocf(size);
+    assert(work);
+  }
+  strassen(simd, M, N, K, A, lda, B, ldb, C, ldc, crossover, work);
+  if (work != workspace) {
+    free(work);
+  }
+}
+
+void matrix_vector_multiply_half(int simd, HalfFloatType type,
+                                 const uint16_t *m, size_t w, size_t h,
+                                 size_t stride, const float *v, float *res) {
+  assert(m);
+  assert(v);
+  assert(res);
+  assert(type == kHalfFloatIEEE || type == kHalfFloatBFloat16);
+  assert(stride >= w);
+  int bf16 = type == kHalfFloatBFloat16;
+  int threads = gemv_threads(w, h);
+  if (threads == 1) {
+    gemv_half(simd, m, bf16, w, h, stride, v, res);
+    return;
+  }
+#ifdef _OPENMP
+  #pragma omp parallel for num_threads(threads) schedule(static)
+#endif
+  for (int t = 0; t < threads; t++) {
+    int beg = (int)((size_t)t * h / threads);
+    int end = (int)((size_t)(t + 1) * h / threads);
+    gemv_half(simd, m + (size_t)beg * stride, bf16, w, end - beg, stride, v,
+              res + beg);
+  }
+}
+
+void matrix_vector_multiply(int simd, const float *m, size_t w, size_t h,
+                            size_t stride, const float *v, float *res) {
+  assert(m);
+  assert(v);
+  assert(res);
+  assert(stride >= w);
+  int threads = gemv_threads(w, h);
+  if (threads == 1) {
+    gemv(simd, m, w, h, stride, v, res);
+    return;
+  }
+#ifdef _OPENMP
+  #pragma omp parallel for num_threads(threads) schedule(static)
+#endif
+  for (int t = 0; t < threads; t++) {
+    int beg = (int)((size_t)t * h / threads);
+    int end = (int)((size_t)(t + 1) * h / threads);
+    gemv(simd, m + (size_t)beg * stride, w, end - beg, stride, v, res + beg);
+  }
+}
+
+void matrix_transposed_vector_multiply(int simd, const float *m,
+                                       size_t w, size_t h, size_t stride,
+                                       const float *v, float *res) {
+  assert(m);
+  assert(v);
+  assert(res);
+  assert(stride >= w);
+  memsetf(res, 0.f, w);
+  int threads = gemv_threads(w, h);
+  if (threads == 1) {
+    gemv_transposed(simd, m, w, h, stride, v, res);
+    return;
+  }
+  // Every thread but the first one sums its rows into a private vector
+  float *partial = mallocf(w * (threads - 1));
+  assert(partial);
+  memsetf(partial, 0.f, w * (threads - 1));
+#ifdef _OPENMP
+  #pragma omp parallel for num_threads(threads) schedule(static)
+#endif
+  for (int t = 0; t < threads; t++) {
+    int beg = (int)((size_t)t * h / threads);
+    int end = (int)((size_t)(t + 1) * h / threads);
+    gemv_transposed(simd, m + (size_t)beg * stride, w, end - beg, stride,
+                    v + beg, t == 0? res : partial + (t - 1) * w);
+  }
+  for (int t = 1; t < threads; t++) {
+    matrix_add(simd, res, partial + (t - 1) * w, w, 1, res);
+  }
+  free(partial);
+}
+
+void matrix_multiply_batch(int simd, MatrixBatchLayout layout,
+                           const float *m1, const float *m2,
+                           size_t w1, size_t h1, size_t w2, size_t count,
+                           float *res) {
+  assert(m1);
+  assert(m2);
+  assert(res);
+  assert(w1 > 0);
+  assert(h1 > 0);
+  assert(w2 > 0);
+  if (layout == kMatrixBatchLayoutInterleaved) {
+    if (simd) {
+#ifdef __ARM_NEON__
+      matrix_batch_interleaved_neon(m1, m2, w1, h1, w2, count, res);
+    } else {
+#elif defined(__AVX__)
+      matrix_batch_interleaved_avx(m1, m2, w1, h1, w2, count, res);
+    } else {
+#else
+    } {
+#endif
+      matrix_batch_interleaved_novec(m1, m2, w1, h1, w2, count, 0, count,
+                                     res);
+    }
+    return;
+  }
+  if (simd) {
 #ifdef __ARM_NEON__
-    matrix_multiply_transposed_neon(m1, m2, w1, h1, w2, h2, res);
+    matrix_batch_contiguous_neon(m1, m2, w1, h1, w2, count, res);
   } else {
 #elif defined(__AVX__)
-    matrix_multiply_transposed_avx(m1, m2, w1, h1, w2, h2, res);
+    matrix_batch_contiguous_avx(m1, m2, w1, h1, w2, count, res);
   } else {
 #else
   } {
 #endif
-    matrix_multiply_transposed_novec(m1, m2, w1, h1, w2, h2, res);
+    matrix_batch_contiguous_novec(m1, m2, w1, h1, w2, count, res);
+  }
+}
+
+void matrix_transpose(int simd, const float *src, size_t w, size_t h,
+                      float *dst) {
+  assert(src);
+  assert(dst);
+  assert(src != dst);
+  int bw = (w + TRANSPOSE_BLOCK - 1) / TRANSPOSE_BLOCK;
+  int bh = (h + TRANSPOSE_BLOCK - 1) / TRANSPOSE_BLOCK;
+  int threads UNUSED = matrix_transpose_threads(w * h);
+#ifdef _OPENMP
+  #pragma omp parallel for num_threads(threads) schedule(static) \
+      if (threads > 1)
+#endif
+  for (int t = 0; t < bw * bh; t++) {
+    int i0 = (t / bw) * TRANSPOSE_BLOCK, j0 = (t % bw) * TRANSPOSE_BLOCK;
+    int bsh = (int)h - i0 < TRANSPOSE_BLOCK? (int)h - i0 : TRANSPOSE_BLOCK;
+    int bsw = (int)w - j0 < TRANSPOSE_BLOCK? (int)w - j0 : TRANSPOSE_BLOCK;
+    matrix_transpose_block(simd, src + (size_t)i0 * w + j0, w, bsw, bsh,
+                           dst + (size_t)j0 * h + i0, h);
+  }
+}
+
+void matrix_transpose_inplace(int simd, float *m, size_t n) {
+  assert(m);
+  int blocks = (n + TRANSPOSE_BLOCK - 1) / TRANSPOSE_BLOCK;
+  int threads UNUSED = matrix_transpose_threads(n * n);
+  // Every iteration swaps the blocks (ib, jb) and (jb, ib) with jb >= ib,
+  // so the iterations never touch the same memory
+#ifdef _OPENMP
+  #pragma omp parallel for num_threads(threads) schedule(dynamic, 1) \
+      if (threads > 1)
+#endif
+  for (int ib = 0; ib < blocks; ib++) {
+    float buffer[TRANSPOSE_BLOCK * TRANSPOSE_BLOCK]
+        __attribute__((aligned(32)));
+    int i0 = ib * TRANSPOSE_BLOCK;
+    int bsh = (int)n - i0 < TRANSPOSE_BLOCK? (int)n - i0 : TRANSPOSE_BLOCK;
+    for (int jb = ib; jb < blocks; jb++) {
+      int j0 = jb * TRANSPOSE_BLOCK;
+      int bsw = (int)n - j0 < TRANSPOSE_BLOCK? (int)n - j0 : TRANSPOSE_BLOCK;
+      float *upper = m + (size_t)i0 * n + j0;
+      float *lower = m + (size_t)j0 * n + i0;
+      matrix_transpose_block(simd, upper, n, bsw, bsh, buffer, bsh);
+      if (jb != ib) {
+        matrix_transpose_block(simd, lower, n, bsh, bsw, upper, n);
+      }
+      for (int r = 0; r < bsw; r++) {
+        memcpy(lower + (size_t)r * n, buffer + r * bsh, bsh * sizeof(float));
+      }
+    }
+  }
+}
+
+void matrix_multiply_u8s8(int simd, const uint8_t *A, int aZeroPoint,
+                          const int8_t *B, int bZeroPoint,
+                          size_t M, size_t N, size_t K, int32_t *C) {
+  assert(A);
+  assert(B);
+  assert(C);
+  GemmInt8Output out = { kMatrixQuantizedOutputInt32, C, N,
+                         kQuantizationScalePerTensor, NULL, NULL, 0 };
+  gemm_int8(simd, M, N, K, A, aZeroPoint, B, bZeroPoint, &out);
+}
+
+void matrix_multiply_u8s8_dequantize(int simd, const uint8_t *A,
+                                     int aZeroPoint, const int8_t *B,
+                                     int bZeroPoint, size_t M, size_t N,
+                                     size_t K, QuantizationScaleType scaleType,
+                                     const float *scales, const float *bias,
+                                     float *C) {
+  assert(A);
+  assert(B);
+  assert(scales);
+  assert(C);
+  GemmInt8Output out = { kMatrixQuantizedOutputFloat, C, N,
+                         scaleType, scales, bias, 0 };
+  gemm_int8(simd, M, N, K, A, aZeroPoint, B, bZeroPoint, &out);
+}
+
+void matrix_multiply_u8s8_requantize(int simd, const uint8_t *A,
+                                     int aZeroPoint, const int8_t *B,
+                                     int bZeroPoint, size_t M, size_t N,
+                                     size_t K, QuantizationScaleType scaleType,
+                                     const float *scales, int cZeroPoint,
+                                     uint8_t *C) {
+  assert(A);
+  assert(B);
+  assert(scales);
+  assert(C);
+  GemmInt8Output out = { kMatrixQuantizedOutputUint8, C, N,
+                         scaleType, scales, NULL, cZeroPoint };
+  gemm_int8(simd, M, N, K, A, aZeroPoint, B, bZeroPoint, &out);
+}
+
+SparseMatrix matrix_sparse_from_dense(const float *m, size_t w, size_t h,
+                                      size_t stride) {
+  assert(m);
+  assert(stride >= w);
+  SparseMatrix res = { w, h, NULL, NULL, NULL };
+  res.row_offsets = malloc((h + 1) * sizeof(res.row_offsets[0]));
+  assert(res.row_offsets);
+  res.row_offsets[0] = 0;
+  for (size_t i = 0; i < h; i++) {
+    size_t count = 0;
+    for (size_t j = 0; j < w; j++) {
+      count += m[i * stride + j] != 0;
+    }
+    res.row_offsets[i + 1] = res.row_offsets[i] + count;
+  }
+  size_t nnz = res.row_offsets[h];
+  // Keep the pointers valid even if there are no non-zeros
+  res.values = mallocf(nnz > 0? nnz : 1);
+  res.columns = malloc((nnz > 0? nnz : 1) * sizeof(res.columns[0]));
+  assert(res.values);
+  assert(res.columns);
+  size_t p = 0;
+  for (size_t i = 0; i < h; i++) {
+    for (size_t j = 0; j < w; j++) {
+      float value = m[i * stride + j];
+      if (value != 0) {
+        res.values[p] = value;
+        res.columns[p] = j;
+        p++;
+      }
+    }
+  }
+  return res;
+}
+
+void matrix_sparse_finalize(SparseMatrix matrix) {
+  free(matrix.values);
+  free(matrix.columns);
+  free(matrix.row_offsets);
+}
+
+void matrix_sparse_vector_multiply(int simd, const SparseMatrix *m,
+                                   const float *v, float *res) {
+  assert(m);
+  assert(v);
+  assert(res);
+  assert(m->row_offsets[0] == 0);
+  int threads = sparse_threads(m->row_offsets[m->height], m->height);
+  if (threads == 1) {
+    sparse_gemv(simd, m, 0, m->height, v, res);
+    return;
+  }
+#ifdef _OPENMP
+  #pragma omp parallel for num_threads(threads) schedule(static)
+#endif
+  for (int t = 0; t < threads; t++) {
+    sparse_gemv(simd, m, sparse_split(m, t, threads),
+                sparse_split(m, t + 1, threads), v, res);
+  }
+}
+
+void matrix_sparse_multiply(int simd, const SparseMatrix *m1,
+                            const float *m2, size_t w2, float *res) {
+  assert(m1);
+  assert(m2);
+  assert(res);
+  assert(m1->row_offsets[0] == 0);
+  if (w2 == 0) {
+    return;
+  }
+  int threads = sparse_threads(m1->row_offsets[m1->height] * w2, m1->height);
+  if (threads == 1) {
+    sparse_gemm(simd, m1, 0, m1->height, m2, w2, res);
+    return;
+  }
+#ifdef _OPENMP
+  #pragma omp parallel for num_threads(threads) schedule(static)
+#endif
+  for (int t = 0; t < threads; t++) {
+    sparse_gemm(simd, m1, sparse_split(m1, t, threads),
+                sparse_split(m1, t + 1, threads), m2, w2, res);
   }
 }
 
+void matrix_set_threads(int threads) {
+  assert(threads >= 0);
+  matrix_threads = threads;
+}
+
+int matrix_get_threads(void) {
+  return matrix_threads;
+}
@@ -0,0 +1,344 @@
+/*! @file matrix_profile.c
+ *  @brief Matrix profile (sliding window self-similarity join) of a series.
+ *  @author Markovtsev Vadim <v.markovtsev@samsung.com>
+ *  @version 1.0
+ *
+ *  @section Notes
+ *  This code partially conforms to <a href="http://google-styleguide.googlecode.com/svn/trunk/cppguide.xml">Google C++ Style Guide</a>.
+ *
+ *  @section Copyright
+ *  Copyright © 2013 Samsung R&D Institute Russia
+ *
+ *  @section License
+ *  Licensed to the Apache Software Foundation (ASF) under one
+ *  or more contributor license agreements.  See the NOTICE file
+ *  distributed with this work for additional information
+ *  regarding copyright ownership.  The ASF licenses this file
+ *  to you under the Apache License, Version 2.0 (the
+ *  "License"); you may not use this file except in compliance
+ *  with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an
+ *  "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ *  KIND, either express or implied.  See the License for the
+ *  specific language governing permissions and limitations
+ *  under the License.
+ */
+
+#define LIBSIMD_IMPLEMENTATION
+#include "inc/simd/matrix_profile.h"
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include <simd/instruction_set.h>
+#include "inc/simd/correlate.h"
+#include "inc/simd/memory.h"
+
+/// @brief Everything the diagonal walkers need to know about the series.
+/// @details The covariance of subsequences i and j (j > i) is updated along
+/// the diagonal as cov(i, j) = cov(i - 1, j - 1) + df[i] * dg[j] +
+/// df[j] * dg[i], which avoids the cancellation of the raw dot product
+/// formula (QT - m * mu_i * mu_j).
+typedef struct {
+  const float *df;
+  const float *dg;
+  const float *invnorm;
+  /// cov(0, k) for every diagonal k
+  const float *cov;
+  int length;
+} MatrixProfileContext;
+
+INLINE void matrix_profile_update(float corr, int i, int j,
+                                  float *best, int *index) {
+  if (corr > best[i]) {
+    best[i] = corr;
+    index[i] = j;
+  }
+  if (corr > best[j]) {
+    best[j] = corr;
+    index[j] = i;
+  }
+}
+
+/// @brief Walks diagonal k starting from row start, given the covariance
+/// of the previous element (or of the first one if start is 0).
+static void matrix_profile_diagonal_novec(const MatrixProfileContext *ctx,
+                                          int k, int start, float cov,
+                                          float *best, int *index) {
+  const float *df = ctx->df, *dg = ctx->dg, *invnorm = ctx->invnorm;
+  for (int i = start; i + k < ctx->length; i++) {
+    int j = i + k;
+    if (i > 0) {
+      cov += df[i] * dg[j] + df[j] * dg[i];
+    }
+    matrix_profile_update(cov * invnorm[i] * invnorm[j], i, j, best, index);
+  }
+}
+
+#ifdef __AVX__
+static void matrix_profile_strip_avx(const MatrixProfileContext *ctx, int k0,
+                                     float *best, int *index) {
+  const float *df = ctx->df, *dg = ctx->dg, *invnorm = ctx->invnorm;
+  __m256 cov = _mm256_loadu_ps(ctx->cov + k0);
+  // All 8 diagonals are defined while i + k0 + 7 < length
+  int full = ctx->length - k0 - 7;
+  for (int i = 0; i < full; i++) {
+    int j = i + k0;
+    if (i > 0) {
+      __m256 dfi = _mm256_set1_ps(df[i]);
+      __m256 dgi = _mm256_set1_ps(dg[i]);
+      __m256 dfj = _mm256_loadu_ps(df + j);
+      __m256 dgj = _mm256_loadu_ps(dg + j);
+      cov = _mm256_add_ps(cov, _mm256_add_ps(_mm256_mul_ps(dfi, dgj),
+                                             _mm256_mul_ps(dgi, dfj)));
+    }
+    __m256 corr = _mm256_mul_ps(
+        _mm256_mul_ps(cov, _mm256_set1_ps(invnorm[i])),
+        _mm256_loadu_ps(invnorm + j));
+    // Columns j..j+7 are contiguous and are updated as a whole
+    __m256 col = _mm256_loadu_ps(best + j);
+    __m256 mask = _mm256_cmp_ps(col, corr, _CMP_LT_OS);
+    if (_mm256_movemask_ps(mask)) {
+      // No blendv, it is not emulated in the SSE3 build
+      _mm256_storeu_ps(best + j, _mm256_or_ps(
+          _mm256_and_ps(mask, corr), _mm256_andnot_ps(mask, col)));
+      __m256 idx = _mm256_loadu_ps((const float *)(index + j));
+      __m256 row = _mm256_castsi256_ps(_mm256_set1_epi32(i));
+      _mm256_storeu_ps((float *)(index + j), _mm256_or_ps(
+          _mm256_and_ps(mask, row), _mm256_andnot_ps(mask, idx)));
+    }
+    // Row i is improved rarely, so do the horizontal work only then
+    mask = _mm256_cmp_ps(_mm256_set1_ps(best[i]), corr, _CMP_LT_OS);
+    if (_mm256_movemask_ps(mask)) {
+      float lanes[8] __attribute__((aligned(32)));
+      _mm256_store_ps(lanes, corr);
+      for (int l = 0; l < 8; l++) {
+        if (lanes[l] > best[i]) {
+          best[i] = lanes[l];
+          index[i] = j + l;
+        }
+      }
+    }
+  }
+  float covs[8] __attribute__((aligned(32)));
+  _mm256_store_ps(covs, cov);
+  int start = full > 0? full : 0;
+  for (int l = 0; l < 8; l++) {
+    matrix_profile_diagonal_novec(ctx, k0 + l, start, covs[l], best, index);
+  }
+}
+#endif
+
+#ifdef __ARM_NEON__
+static void matrix_profile_strip_neon(const MatrixProfileContext *ctx, int k0,
+                                      float *best, int *index) {
+  const float *df = ctx->df, *dg = ctx->dg, *invnorm = ctx->invnorm;
+  float32x4_t cov = vld1q_f32(ctx->cov + k0);
+  // All 4 diagonals are defined while i + k0 + 3 < length
+  int full = ctx->length - k0 - 3;
+  for (int i = 0; i < full; i++) {
+    int j = i + k0;
+    if (i > 0) {
+      cov = vmlaq_n_f32(cov, vld1q_f32(dg + j), df[i]);
+      cov = vmlaq_n_f32(cov, vld1q_f32(df + j), dg[i]);
+    }
+    float32x4_t corr = vmulq_f32(vmulq_n_f32(cov, invnorm[i]),
+                                 vld1q_f32(invnorm + j));
+    float32x4_t col = vld1q_f32(best + j);
+    uint32x4_t mask = vcgtq_f32(corr, col);
+    uint32x2_t any = vorr_u32(vget_low_u32(mask), vget_high_u32(mask));
+    if (vget_lane_u32(any, 0) | vget_lane_u32(any, 1)) {
+      vst1q_f32(best + j, vbslq_f32(mask, corr, col));
+      int32x4_t idx = vld1q_s32(index + j);
+      vst1q_s32(index + j, vbslq_s32(mask, vdupq_n_s32(i), idx));
+    }
+    mask = vcgtq_f32(corr, vdupq_n_f32(best[i]));
+    any = vorr_u32(vget_low_u32(mask), vget_high_u32(mask));
+    if (vget_lane_u32(any, 0) | vget_lane_u32(any, 1)) {
+      float lanes[4] __attribute__((aligned(16)));
+      vst1q_f32(lanes, corr);
+      for (int l = 0; l < 4; l++) {
+        if (lanes[l] > best[i]) {
+          best[i] = lanes[l];
+          index[i] = j + l;
+        }
+      }
+    }
+  }
+  float covs[4] __attribute__((aligned(16)));
+  vst1q_f32(covs, cov);
+  int start = full > 0? full : 0;
+  for (int l = 0; l < 4; l++) {
+    matrix_profile_diagonal_novec(ctx, k0 + l, start, covs[l], best, index);
+  }
+}
+#endif
+
+/// @brief Calculates the sliding dot products of the first subsequence
+/// with every subsequence.
+static void matrix_profile_first_row(int simd UNUSED, const float *series,
+                                     size_t length, size_t window,
+                                     float *qt) {
+  float *corr = mallocf(length + window - 1);
+  assert(corr);
+#ifndef NO_FFTF
+  CrossCorrelationHandle handle = cross_correlate_initialize(length, window);
+  cross_correlate(handle, series, series, corr);
+  cross_correlate_finalize(handle);
+#else
+  cross_correlate_simd(simd, series, length, series, window, corr);
+#endif
+  // corr[j + window - 1] = sum(series[j + t] * series[t])
+  for (size_t j = 0; j < length - window + 1; j++) {
+    qt[j] = corr[j + window - 1];
+  }
+  free(corr);
+}
+
+int matrix_profile_exclusion_zone(size_t window) {
+  return (int)((window + 3) / 4);
+}
+
+void matrix_profile(int simd, const float *series, size_t length,
+                    size_t window, int threads, float *profile, int *index) {
+  assert(series);
+  assert(profile);
+  assert(window >= 2);
+  assert(length >= window);
+  const int m = window;
+  const int l = length - window + 1;
+  const int excl = matrix_profile_exclusion_zone(window);
+
+  // Means and inverse norms of the centred subsequences are calculated
+  // in double precision since they anchor all the subsequent updates
+  double *mean = malloc(sizeof(double) * l);
+  float *invnorm = mallocf(l);
+  assert(mean);
+  assert(invnorm);
+  double sum = 0;
+  for (int t = 0; t < m - 1; t++) {
+    sum += series[t];
+  }
+  for (int i = 0; i < l; i++) {
+    sum += series[i + m - 1];
+    double mu = sum / m;
+    double norm = 0;
+    for (int t = 0; t < m; t++) {
+      double d = series[i + t] - mu;
+      norm += d * d;
+    }
+    mean[i] = mu;
+    invnorm[i] = norm > 0? 1 / sqrt(norm) : 0;
+    sum -= series[i];
+  }
+
+  float *df = mallocf(l);
+  float *dg = mallocf(l);
+  assert(df);
+  assert(dg);
+  df[0] = 0;
+  dg[0] = 0;
+  for (int i = 1; i < l; i++) {
+    df[i] = (series[i + m - 1] - series[i - 1]) / 2;
+    dg[i] = (series[i + m - 1] - mean[i]) + (series[i - 1] - mean[i - 1]);
+  }
+
+  float *cov = mallocf(l);
+  assert(cov);
+  matrix_profile_first_row(simd, series, length, window, cov);
+  for (int k = 0; k < l; k++) {
+    cov[k] = cov[k] - m * mean[0] * mean[k];
+  }
+
+  MatrixProfileContext ctx = { df, dg, invnorm, cov, l };
+
+#ifdef _OPENMP
+  if (threads <= 0) {
+    threads = omp_get_max_threads();
+  }
+#else
+  threads = 1;
+#endif
+  float *best = mallocf((size_t)l * threads);
+  int *best_index = malloc(sizeof(int) * l * threads);
+  assert(best);
+  assert(best_index);
+  for (int i = 0; i < l * threads; i++) {
+    best[i] = -INFINITY;
+    best_index[i] = -1;
+  }
+
+  int strip = 1;
+  if (simd) {
+#ifdef __ARM_NEON__
+    strip = 4;
+#elif defined(__AVX__)
+    strip = 8;
+#endif
+  }
+  int diagonals = l > excl? l - excl : 0;
+  int strips = (diagonals + strip - 1) / strip;
+#ifdef _OPENMP
+  // Diagonals get shorter with k, hence the dynamic schedule
+  #pragma omp parallel for num_threads(threads) schedule(dynamic, 1)
+#endif
+  for (int s = 0; s < strips; s++) {
+#ifdef _OPENMP
+    int thread = omp_get_thread_num();
+#else
+    int thread = 0;
+#endif
+    float *tbest = best + (size_t)thread * l;
+    int *tindex = best_index + (size_t)thread * l;
+    int k0 = excl + s * strip;
+    if (k0 + strip > l) {
+      for (int k = k0; k < l; k++) {
+        matrix_profile_diagonal_novec(&ctx, k, 0, cov[k], tbest, tindex);
+      }
+      continue;
+    }
+    if (simd) {
+#ifdef __ARM_NEON__
+      matrix_profile_strip_neon(&ctx, k0, tbest, tindex);
+    } else {
+#elif defined(__AVX__)
+      matrix_profile_strip_avx(&ctx, k0, tbest, tindex);
+    } else {
+#else
+    } {
+#endif
+      matrix_profile_diagonal_novec(&ctx, k0, 0, cov[k0], tbest, tindex);
+    }
+  }
+
+  // Merge the per-thread profiles
+  for (int t = 1; t < threads; t++) {
+    for (int i = 0; i < l; i++) {
+      if (best[t * l + i] > best[i]) {
+        best[i] = best[t * l + i];
+        best_index[i] = best_index[t * l + i];
+      }
+    }
+  }
+  for (int i = 0; i < l; i++) {
+    float corr = best[i] < 1? best[i] : 1;
+    profile[i] = sqrtf(2 * m * (1 - corr));
+    if (index) {
+      index[i] = best_index[i];
+    }
+  }
+
+  free(best_index);
+  free(best);
+  free(cov);
+  free(dg);
+  free(df);
+  free(invnorm);
+  free(mean);
+}
@@ -86,6 +86,9 @@ void memsetf(float *ptr, float value, size_t length) {
 #ifdef __AVX__
   const __m256 fillvec = _mm256_set1_ps(value);
   size_t startIndex = align_complement_f32(ptr);
+  if (startIndex > length) {
+    startIndex = length;
+  }
 
   for (size_t i = 0; i < startIndex; i++) {
     ptr[i] = value;
@@ -32,9 +32,42 @@
 #include "inc/simd/normalize.h"
 #include <assert.h>
 #include <float.h>
+#include <stdlib.h>
+#include <unistd.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include <simd/attributes.h>
 #include <simd/instruction_set.h>
 #include <simd/memory.h>
 
+/// The minimal number of pixels to split the plane between threads.
+#define NORMALIZE_PARALLEL_THRESHOLD (256 * 1024)
+
+/// The size of the last level cache in bytes if it cannot be queried.
+#define NORMALIZE_DEFAULT_LLC_SIZE (8 * 1024 * 1024)
+
+/// The size of dst above which the streaming stores are used, 0 means LLC.
+static size_t normalize_stream_threshold = 0;
+
+/// @brief Updates the per channel minimums and maximums with the interleaved
+/// elements, the first of which belongs to channel 0.
+static void minmax_interleaved_fold(const uint8_t* min_src,
+                                    const uint8_t* max_src, int length,
+                                    int channels, uint8_t* min, uint8_t* max) {
+  for (int i = 0, c = 0; i < length; i++) {
+    if (min_src[i] < min[c]) {
+      min[c] = min_src[i];
+    }
+    if (max_src[i] > max[c]) {
+      max[c] = max_src[i];
+    }
+    if (++c == channels) {
+      c = 0;
+    }
+  }
+}
+
 #ifdef __ARM_NEON__
 
 static void normalize2D_minmax_neon(uint8_t min, uint8_t max,
@@ -42,7 +75,9 @@ static void normalize2D_minmax_neon(uint8_t min, uint8_t max,
                                     int width, int height,
                                     float* dst, int dst_stride) {
   if (max == min) {
-    memsetf(dst, 0, width * height);
+    for (int y = 0; y < height; y++) {
+      memsetf(dst + y * dst_stride, 0, width);
+    }
     return;
   }
   const uint8x16_t min_vec = vdupq_n_u8(min);
@@ -203,6 +238,280 @@ static void minmax1D_neon(const float* src, int length,
   }
 }
 
+static void normalize2D_minmax_u16_neon(uint16_t min, uint16_t max,
+                                        const uint16_t* src, int src_stride,
+                                        int width, int height,
+                                        float* dst, int dst_stride) {
+  if (max == min) {
+    for (int y = 0; y < height; y++) {
+      memsetf(dst + y * dst_stride, 0, width);
+    }
+    return;
+  }
+  const uint16x8_t min_vec = vdupq_n_u16(min);
+  float diff = (max - min) / 2.f;
+  const float32x4_t diff_vec = vdupq_n_f32(1.f / diff);
+  const float32x4_t sub_vec = vdupq_n_f32(1.f);
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width - 7; x += 8) {
+      uint16x8_t vec = vld1q_u16(src + y * src_stride + x);
+      vec = vqsubq_u16(vec, min_vec);
+      float32x4_t flo = vcvtq_f32_u32(vmovl_u16(vget_low_u16(vec)));
+      float32x4_t fhi = vcvtq_f32_u32(vmovl_u16(vget_high_u16(vec)));
+      flo = vsubq_f32(vmulq_f32(flo, diff_vec), sub_vec);
+      fhi = vsubq_f32(vmulq_f32(fhi, diff_vec), sub_vec);
+      float* dst_ptr = dst + y * dst_stride + x;
+      vst1q_f32(dst_ptr, flo);
+      vst1q_f32(dst_ptr + 4, fhi);
+    }
+    for (int x = width & ~0x7; x < width; x++) {
+      dst[y * dst_stride + x] = (src[y * src_stride + x] - min) / diff - 1.0f;
+    }
+  }
+}
+
+static void minmax2D_u16_neon(const uint16_t* src, int src_stride,
+                              int width, int height,
+                              uint16_t* min_ptr, uint16_t* max_ptr) {
+  uint16_t min = src[0], max = src[0];
+  uint16x8_t min_vec = vdupq_n_u16(min), max_vec = vdupq_n_u16(max);
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width - 7; x += 8) {
+      uint16x8_t vec = vld1q_u16(src + y * src_stride + x);
+      min_vec = vminq_u16(vec, min_vec);
+      max_vec = vmaxq_u16(vec, max_vec);
+    }
+    for (int x = width & ~0x7; x < width; x++) {
+      uint16_t val = src[y * src_stride + x];
+      if (val < min) {
+        min = val;
+      }
+      if (val > max) {
+        max = val;
+      }
+    }
+  }
+  // Gather the results
+  uint16_t min_arr[8] __attribute__((aligned(64))),
+      max_arr[8] __attribute__((aligned(64)));
+  vst1q_u16(min_arr, min_vec);
+  vst1q_u16(max_arr, max_vec);
+  for (int i = 0; i < 8; i++) {
+    if (min_arr[i] < min) {
+      min = min_arr[i];
+    }
+    if (max_arr[i] > max) {
+      max = max_arr[i];
+    }
+  }
+
+  if (min_ptr) {
+    *min_ptr = min;
+  }
+  if (max_ptr) {
+    *max_ptr = max;
+  }
+}
+
+static void normalize2D_minmax_f32_neon(float min, float max,
+                                        const float* src, int src_stride,
+                                        int width, int height,
+                                        float* dst, int dst_stride) {
+  if (max == min) {
+    for (int y = 0; y < height; y++) {
+      memsetf(dst + y * dst_stride, 0, width);
+    }
+    return;
+  }
+  const float32x4_t min_vec = vdupq_n_f32(min);
+  float diff = (max - min) / 2.f;
+  const float32x4_t diff_vec = vdupq_n_f32(1.f / diff);
+  const float32x4_t sub_vec = vdupq_n_f32(1.f);
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width - 3; x += 4) {
+      float32x4_t vec = vld1q_f32(src + y * src_stride + x);
+      vec = vmulq_f32(vsubq_f32(vec, min_vec), diff_vec);
+      vst1q_f32(dst + y * dst_stride + x, vsubq_f32(vec, sub_vec));
+    }
+    for (int x = width & ~0x3; x < width; x++) {
+      dst[y * dst_stride + x] = (src[y * src_stride + x] - min) / diff - 1.0f;
+    }
+  }
+}
+
+static void minmax2D_f32_neon(const float* src, int src_stride,
+                              int width, int height,
+                              float* min_ptr, float* max_ptr) {
+  float min = src[0], max = src[0];
+  float32x4_t min_vec = vdupq_n_f32(min), max_vec = vdupq_n_f32(max);
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width - 3; x += 4) {
+      float32x4_t vec = vld1q_f32(src + y * src_stride + x);
+      min_vec = vminq_f32(vec, min_vec);
+      max_vec = vmaxq_f32(vec, max_vec);
+    }
+    for (int x = width & ~0x3; x < width; x++) {
+      float val = src[y * src_stride + x];
+      if (val < min) {
+        min = val;
+      }
+      if (val > max) {
+        max = val;
+      }
+    }
+  }
+  // Gather the results
+  float min_arr[4] __attribute__((aligned(64))),
+      max_arr[4] __attribute__((aligned(64)));
+  vst1q_f32(min_arr, min_vec);
+  vst1q_f32(max_arr, max_vec);
+  for (int i = 0; i < 4; i++) {
+    if (min_arr[i] < min) {
+      min = min_arr[i];
+    }
+    if (max_arr[i] > max) {
+      max = max_arr[i];
+    }
+  }
+
+  if (min_ptr) {
+    *min_ptr = min;
+  }
+  if (max_ptr) {
+    *max_ptr = max;
+  }
+}
+
+/// @brief Converts 16 bytes to 4 float vectors.
+INLINE void normalize_unpack_neon(uint8x16_t vec, float32x4_t res[4]) {
+  uint16x8_t vec16lo = vmovl_u8(vget_low_u8(vec));
+  uint16x8_t vec16hi = vmovl_u8(vget_high_u8(vec));
+  res[0] = vcvtq_f32_u32(vmovl_u16(vget_low_u16(vec16lo)));
+  res[1] = vcvtq_f32_u32(vmovl_u16(vget_high_u16(vec16lo)));
+  res[2] = vcvtq_f32_u32(vmovl_u16(vget_low_u16(vec16hi)));
+  res[3] = vcvtq_f32_u32(vmovl_u16(vget_high_u16(vec16hi)));
+}
+
+static void minmax2D_interleaved_neon(const uint8_t* src, int src_stride,
+                                      int width, int height, int channels,
+                                      uint8_t* min, uint8_t* max) {
+  // Each group of 16 pixels is loaded into channels vectors, so that every
+  // lane of an accumulator always meets the same channel
+  const int row = width * channels, group = 16 * channels;
+  uint8x16_t min_vec[4], max_vec[4];
+  for (int i = 0; i < channels; i++) {
+    min_vec[i] = vdupq_n_u8(0xFF);
+    max_vec[i] = vdupq_n_u8(0);
+  }
+  for (int y = 0; y < height; y++) {
+    const uint8_t* ptr = src + y * src_stride;
+    int x;
+    for (x = 0; x <= row - group; x += group) {
+      for (int i = 0; i < channels; i++) {
+        uint8x16_t vec = vld1q_u8(ptr + x + 16 * i);
+        min_vec[i] = vminq_u8(vec, min_vec[i]);
+        max_vec[i] = vmaxq_u8(vec, max_vec[i]);
+      }
+    }
+    minmax_interleaved_fold(ptr + x, ptr + x, row - x, channels, min, max);
+  }
+  // Gather the results
+  uint8_t min_arr[64] __attribute__((aligned(64))),
+      max_arr[64] __attribute__((aligned(64)));
+  for (int i = 0; i < channels; i++) {
+    vst1q_u8(min_arr + 16 * i, min_vec[i]);
+    vst1q_u8(max_arr + 16 * i, max_vec[i]);
+  }
+  minmax_interleaved_fold(min_arr, max_arr, group, channels, min, max);
+}
+
+static void normalize2D_interleaved_neon(const float* scale,
+                                         const float* offset,
+                                         const uint8_t* src, int src_stride,
+                                         int width, int height, int channels,
+                                         NormalizeLayout layout,
+                                         float* dst, int dst_stride) {
+  const int row = width * channels, group = 16 * channels;
+  // Float vector j of a group covers channels (4 * j + lane) % channels,
+  // which repeat with the period of channels vectors
+  float32x4_t scale_vec[4], offset_vec[4];
+  for (int i = 0; i < channels; i++) {
+    float s[4], o[4];
+    for (int k = 0; k < 4; k++) {
+      int c = layout == kNormalizeInterleaved? (4 * i + k) % channels : i;
+      s[k] = scale[c];
+      o[k] = offset[c];
+    }
+    scale_vec[i] = vld1q_f32(s);
+    offset_vec[i] = vld1q_f32(o);
+  }
+  for (int y = 0; y < height; y++) {
+    const uint8_t* ptr = src + y * src_stride;
+    int x;
+    for (x = 0; x <= row - group; x += group) {
+      uint8x16_t vec[4];
+      if (layout == kNormalizeInterleaved) {
+        for (int i = 0; i < channels; i++) {
+          vec[i] = vld1q_u8(ptr + x + 16 * i);
+        }
+      } else {
+        switch (channels) {
+          case 1:
+            vec[0] = vld1q_u8(ptr + x);
+            break;
+          case 2: {
+            uint8x16x2_t v = vld2q_u8(ptr + x);
+            vec[0] = v.val[0];
+            vec[1] = v.val[1];
+            break;
+          }
+          case 3: {
+            uint8x16x3_t v = vld3q_u8(ptr + x);
+            vec[0] = v.val[0];
+            vec[1] = v.val[1];
+            vec[2] = v.val[2];
+            break;
+          }
+          default: {
+            uint8x16x4_t v = vld4q_u8(ptr + x);
+            vec[0] = v.val[0];
+            vec[1] = v.val[1];
+            vec[2] = v.val[2];
+            vec[3] = v.val[3];
+            break;
+          }
+        }
+      }
+      for (int i = 0; i < channels; i++) {
+        float32x4_t f[4];
+        normalize_unpack_neon(vec[i], f);
+        float* dst_ptr;
+        if (layout == kNormalizeInterleaved) {
+          dst_ptr = dst + y * dst_stride + x + 16 * i;
+        } else {
+          dst_ptr = dst + (i * height + y) * dst_stride + x / channels;
+        }
+        for (int k = 0; k < 4; k++) {
+          int j = layout == kNormalizeInterleaved? (4 * i + k) % channels : i;
+          vst1q_f32(dst_ptr + 4 * k,
+                    vmlaq_f32(offset_vec[j], f[k], scale_vec[j]));
+        }
+      }
+    }
+    for (int c = 0; x < row; x++) {
+      float val = ptr[x] * scale[c] + offset[c];
+      if (layout == kNormalizeInterleaved) {
+        dst[y * dst_stride + x] = val;
+      } else {
+        dst[(c * height + y) * dst_stride + x / channels] = val;
+      }
+      if (++c == channels) {
+        c = 0;
+      }
+    }
+  }
+}
+
 #endif
 
 
@@ -213,7 +522,9 @@ static void normalize2D_minmax_sse(uint8_t min, uint8_t max,
                                    int width, int height,
                                    float* dst, int dst_stride) {
   if (max == min) {
-    memsetf(dst, 0, width * height);
+    for (int y = 0; y < height; y++) {
+      memsetf(dst + y * dst_stride, 0, width);
+    }
     return;
   }
   const __m128i min_vec = _mm_set1_epi8(min);
@@ -314,6 +625,105 @@ static void minmax2D_sse(const uint8_t* src, int src_stride,
   }
 }
 
+#ifndef __AVX2__
+// The 16-bit functions are superseded by their AVX2 versions if available
+
+#ifdef __SSE4_1__
+#define normalize_min_epu16 _mm_min_epu16
+#define normalize_max_epu16 _mm_max_epu16
+#else
+// SSE2 has only the signed 16-bit minimum and maximum, so the sign bits are
+// flipped around them
+INLINE __m128i normalize_min_epu16(__m128i a, __m128i b) {
+  const __m128i sign = _mm_set1_epi16(-0x8000);
+  __m128i res = _mm_min_epi16(_mm_xor_si128(a, sign), _mm_xor_si128(b, sign));
+  return _mm_xor_si128(res, sign);
+}
+
+INLINE __m128i normalize_max_epu16(__m128i a, __m128i b) {
+  const __m128i sign = _mm_set1_epi16(-0x8000);
+  __m128i res = _mm_max_epi16(_mm_xor_si128(a, sign), _mm_xor_si128(b, sign));
+  return _mm_xor_si128(res, sign);
+}
+#endif
+
+static void normalize2D_minmax_u16_sse(uint16_t min, uint16_t max,
+                                       const uint16_t* src, int src_stride,
+                                       int width, int height,
+                                       float* dst, int dst_stride) {
+  if (max == min) {
+    for (int y = 0; y < height; y++) {
+      memsetf(dst + y * dst_stride, 0, width);
+    }
+    return;
+  }
+  const __m128i min_vec = _mm_set1_epi16(min);
+  float diff = (max - min) / 2.f;
+  const __m128 diff_vec = _mm_set1_ps(1.f / diff);
+  const __m128 sub_vec = _mm_set1_ps(1.f);
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width - 7; x += 8) {
+      __m128i vec = _mm_loadu_si128((const __m128i*)(src + y * src_stride + x));
+      vec = _mm_subs_epu16(vec, min_vec);
+      __m128 flo = _mm_cvtepi32_ps(_mm_unpacklo_epi16(vec, _mm_setzero_si128()));
+      __m128 fhi = _mm_cvtepi32_ps(_mm_unpackhi_epi16(vec, _mm_setzero_si128()));
+      flo = _mm_sub_ps(_mm_mul_ps(flo, diff_vec), sub_vec);
+      fhi = _mm_sub_ps(_mm_mul_ps(fhi, diff_vec), sub_vec);
+      float* dst_ptr = dst + y * dst_stride + x;
+      _mm_storeu_ps(dst_ptr, flo);
+      _mm_storeu_ps(dst_ptr + 4, fhi);
+    }
+    for (int x = width & ~0x7; x < width; x++) {
+      dst[y * dst_stride + x] = (src[y * src_stride + x] - min) / diff - 1.0f;
+    }
+  }
+}
+
+static void minmax2D_u16_sse(const uint16_t* src, int src_stride,
+                             int width, int height,
+                             uint16_t* min_ptr, uint16_t* max_ptr) {
+  uint16_t min = src[0], max = src[0];
+  __m128i min_vec = _mm_set1_epi16(min), max_vec = _mm_set1_epi16(max);
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width - 7; x += 8) {
+      __m128i vec = _mm_loadu_si128((const __m128i*)(src + y * src_stride + x));
+      min_vec = normalize_min_epu16(vec, min_vec);
+      max_vec = normalize_max_epu16(vec, max_vec);
+    }
+    for (int x = width & ~0x7; x < width; x++) {
+      uint16_t val = src[y * src_stride + x];
+      if (val < min) {
+        min = val;
+      }
+      if (val > max) {
+        max = val;
+      }
+    }
+  }
+  // Gather the results
+  uint16_t min_arr[8] __attribute__((aligned(64))),
+      max_arr[8] __attribute__((aligned(64)));
+  _mm_store_si128((__m128i*)min_arr, min_vec);
+  _mm_store_si128((__m128i*)max_arr, max_vec);
+  for (int i = 0; i < 8; i++) {
+    if (min_arr[i] < min) {
+      min = min_arr[i];
+    }
+    if (max_arr[i] > max) {
+      max = max_arr[i];
+    }
+  }
+
+  if (min_ptr) {
+    *min_ptr = min;
+  }
+  if (max_ptr) {
+    *max_ptr = max;
+  }
+}
+
+#endif  // !__AVX2__
+
 #ifdef __AVX__
 static void minmax1D_avx(const float* src, int length,
                          float* min_ptr, float* max_ptr) {
@@ -365,45 +775,68 @@ static void minmax1D_avx(const float* src, int length,
     *max_ptr = max;
   }
 }
-#endif  // __AVX__
-
-#endif  // __SSE2__
 
-static void normalize2D_minmax_novec(uint8_t min, uint8_t max,
-                                     const uint8_t* src, int src_stride,
-                                     int width, int height,
-                                     float* dst, int dst_stride) {
+static void normalize2D_minmax_f32_avx(float min, float max,
+                                       const float* src, int src_stride,
+                                       int width, int height,
+                                       float* dst, int dst_stride) {
   if (max == min) {
     for (int y = 0; y < height; y++) {
-      for (int x = 0; x < width; x++) {
-        dst[y * dst_stride + x] = 0;
-      }
+      memsetf(dst + y * dst_stride, 0, width);
     }
     return;
   }
+  const __m256 min_vec = _mm256_set1_ps(min);
   float diff = (max - min) / 2.f;
+  const __m256 diff_vec = _mm256_set1_ps(1.f / diff);
+  const __m256 sub_vec = _mm256_set1_ps(1.f);
   for (int y = 0; y < height; y++) {
-    for (int x = 0; x < width; x++) {
+    for (int x = 0; x < width - 7; x += 8) {
+      __m256 vec = _mm256_loadu_ps(src + y * src_stride + x);
+      vec = _mm256_mul_ps(_mm256_sub_ps(vec, min_vec), diff_vec);
+      _mm256_storeu_ps(dst + y * dst_stride + x, _mm256_sub_ps(vec, sub_vec));
+    }
+    for (int x = width & ~0x7; x < width; x++) {
       dst[y * dst_stride + x] = (src[y * src_stride + x] - min) / diff - 1.0f;
     }
   }
 }
 
-static void minmax2D_novec(const uint8_t* src, int src_stride,
-                           int width, int height,
-                           uint8_t* min_ptr, uint8_t* max_ptr) {
-  uint8_t min = src[0], max = src[0];
+static void minmax2D_f32_avx(const float* src, int src_stride,
+                             int width, int height,
+                             float* min_ptr, float* max_ptr) {
+  float min = src[0], max = src[0];
+  __m256 min_vec = _mm256_set1_ps(min), max_vec = _mm256_set1_ps(max);
   for (int y = 0; y < height; y++) {
-    for (int x = 0; x < width; x++) {
+    for (int x = 0; x < width - 7; x += 8) {
+      __m256 vec = _mm256_loadu_ps(src + y * src_stride + x);
+      min_vec = _mm256_min_ps(vec, min_vec);
+      max_vec = _mm256_max_ps(vec, max_vec);
+    }
+    for (int x = width & ~0x7; x < width; x++) {
       float val = src[y * src_stride + x];
-      if (min_ptr && val < min) {
+      if (val < min) {
         min = val;
       }
-      if (max_ptr && val > max) {
+      if (val > max) {
         max = val;
       }
     }
   }
+  // Gather the results
+  float min_arr[8] __attribute__((aligned(64))),
+      max_arr[8] __attribute__((aligned(64)));
+  _mm256_store_ps(min_arr, min_vec);
+  _mm256_store_ps(max_arr, max_vec);
+  for (int i = 0; i < 8; i++) {
+    if (min_arr[i] < min) {
+      min = min_arr[i];
+    }
+    if (max_arr[i] > max) {
+      max = max_arr[i];
+    }
+  }
+
   if (min_ptr) {
     *min_ptr = min;
   }
@@ -412,18 +845,78 @@ static void minmax2D_novec(const uint8_t* src, int src_stride,
   }
 }
 
-static void minmax1D_novec(const float* src, int length,
-                           float* min_ptr, float* max_ptr) {
-  float min = src[0], max = src[0];
-  for (int i = 0; i < length; i++) {
-    float val = src[i];
-    if (min_ptr && val < min) {
-      min = val;
+#ifdef __AVX2__
+static void normalize2D_minmax_u16_avx2(uint16_t min, uint16_t max,
+                                        const uint16_t* src, int src_stride,
+                                        int width, int height,
+                                        float* dst, int dst_stride) {
+  if (max == min) {
+    for (int y = 0; y < height; y++) {
+      memsetf(dst + y * dst_stride, 0, width);
     }
-    if (max_ptr && val > max) {
-      max = val;
+    return;
+  }
+  const __m256i min_vec = _mm256_set1_epi16(min);
+  float diff = (max - min) / 2.f;
+  const __m256 diff_vec = _mm256_set1_ps(1.f / diff);
+  const __m256 sub_vec = _mm256_set1_ps(1.f);
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width - 15; x += 16) {
+      __m256i vec = _mm256_loadu_si256(
+          (const __m256i*)(src + y * src_stride + x));
+      vec = _mm256_subs_epu16(vec, min_vec);
+      __m256 flo = _mm256_cvtepi32_ps(
+          _mm256_cvtepu16_epi32(_mm256_castsi256_si128(vec)));
+      __m256 fhi = _mm256_cvtepi32_ps(
+          _mm256_cvtepu16_epi32(_mm256_extracti128_si256(vec, 1)));
+      flo = _mm256_sub_ps(_mm256_mul_ps(flo, diff_vec), sub_vec);
+      fhi = _mm256_sub_ps(_mm256_mul_ps(fhi, diff_vec), sub_vec);
+      float* dst_ptr = dst + y * dst_stride + x;
+      _mm256_storeu_ps(dst_ptr, flo);
+      _mm256_storeu_ps(dst_ptr + 8, fhi);
+    }
+    for (int x = width & ~0xF; x < width; x++) {
+      dst[y * dst_stride + x] = (src[y * src_stride + x] - min) / diff - 1.0f;
+    }
+  }
+}
+
+static void minmax2D_u16_avx2(const uint16_t* src, int src_stride,
+                              int width, int height,
+                              uint16_t* min_ptr, uint16_t* max_ptr) {
+  uint16_t min = src[0], max = src[0];
+  __m256i min_vec = _mm256_set1_epi16(min), max_vec = _mm256_set1_epi16(max);
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width - 15; x += 16) {
+      __m256i vec = _mm256_loadu_si256(
+          (const __m256i*)(src + y * src_stride + x));
+      min_vec = _mm256_min_epu16(vec, min_vec);
+      max_vec = _mm256_max_epu16(vec, max_vec);
+    }
+    for (int x = width & ~0xF; x < width; x++) {
+      uint16_t val = src[y * src_stride + x];
+      if (val < min) {
+        min = val;
+      }
+      if (val > max) {
+        max = val;
+      }
+    }
+  }
+  // Gather the results
+  uint16_t min_arr[16] __attribute__((aligned(64))),
+      max_arr[16] __attribute__((aligned(64)));
+  _mm256_store_si256((__m256i*)min_arr, min_vec);
+  _mm256_store_si256((__m256i*)max_arr, max_vec);
+  for (int i = 0; i < 16; i++) {
+    if (min_arr[i] < min) {
+      min = min_arr[i];
+    }
+    if (max_arr[i] > max) {
+      max = max_arr[i];
     }
   }
+
   if (min_ptr) {
     *min_ptr = min;
   }
@@ -431,23 +924,390 @@ static void minmax1D_novec(const float* src, int length,
     *max_ptr = max;
   }
 }
+#endif  // __AVX2__
 
-void normalize2D(int simd, const uint8_t* src, int src_stride,
-                 int width, int height, float* dst, int dst_stride) {
-  uint8_t min, max;
-  minmax2D(simd, src, src_stride, width, height, &min, &max);
-  normalize2D_minmax(simd, min, max, src, src_stride, width, height,
-                     dst, dst_stride);
+#endif  // __AVX__
+
+/// @brief Converts 16 bytes to 4 float vectors.
+INLINE void normalize_unpack_sse(__m128i vec, __m128 res[4]) {
+  __m128i intlo = _mm_unpacklo_epi8(vec, _mm_setzero_si128());
+  __m128i inthi = _mm_unpackhi_epi8(vec, _mm_setzero_si128());
+  res[0] = _mm_cvtepi32_ps(_mm_unpacklo_epi16(intlo, _mm_setzero_si128()));
+  res[1] = _mm_cvtepi32_ps(_mm_unpackhi_epi16(intlo, _mm_setzero_si128()));
+  res[2] = _mm_cvtepi32_ps(_mm_unpacklo_epi16(inthi, _mm_setzero_si128()));
+  res[3] = _mm_cvtepi32_ps(_mm_unpackhi_epi16(inthi, _mm_setzero_si128()));
 }
 
-void minmax2D(int simd, const uint8_t* src, int src_stride,
-              int width, int height, uint8_t* min, uint8_t* max) {
-  assert(src);
-  assert(width > 0);
-  assert(height > 0);
-  assert(src_stride >= width);
-  if (!min && !max) {
-    return;
+/// @brief Splits 4 interleaved pixels (channels vectors) into channels
+/// vectors of 4 values of the same channel.
+INLINE void normalize_deinterleave_sse(const __m128* src, int channels,
+                                       __m128* res) {
+  switch (channels) {
+    case 1:
+      res[0] = src[0];
+      break;
+    case 2:
+      res[0] = _mm_shuffle_ps(src[0], src[1], _MM_SHUFFLE(2, 0, 2, 0));
+      res[1] = _mm_shuffle_ps(src[0], src[1], _MM_SHUFFLE(3, 1, 3, 1));
+      break;
+    case 3: {
+      // r0 g0 b0 r1 | g1 b1 r2 g2 | b2 r3 g3 b3
+      __m128 rg = _mm_shuffle_ps(src[1], src[2], _MM_SHUFFLE(2, 1, 3, 2));
+      __m128 gb = _mm_shuffle_ps(src[0], src[1], _MM_SHUFFLE(1, 0, 2, 1));
+      res[0] = _mm_shuffle_ps(src[0], rg, _MM_SHUFFLE(2, 0, 3, 0));
+      res[1] = _mm_shuffle_ps(gb, rg, _MM_SHUFFLE(3, 1, 2, 0));
+      res[2] = _mm_shuffle_ps(gb, src[2], _MM_SHUFFLE(3, 0, 3, 1));
+      break;
+    }
+    default:
+      res[0] = src[0];
+      res[1] = src[1];
+      res[2] = src[2];
+      res[3] = src[3];
+      _MM_TRANSPOSE4_PS(res[0], res[1], res[2], res[3]);
+      break;
+  }
+}
+
+static void minmax2D_interleaved_sse(const uint8_t* src, int src_stride,
+                                     int width, int height, int channels,
+                                     uint8_t* min, uint8_t* max) {
+  // Each group of 16 pixels is loaded into channels vectors, so that every
+  // lane of an accumulator always meets the same channel
+  const int row = width * channels, group = 16 * channels;
+  __m128i min_vec[4], max_vec[4];
+  for (int i = 0; i < channels; i++) {
+    min_vec[i] = _mm_set1_epi8(-1);
+    max_vec[i] = _mm_setzero_si128();
+  }
+  for (int y = 0; y < height; y++) {
+    const uint8_t* ptr = src + y * src_stride;
+    int x;
+    for (x = 0; x <= row - group; x += group) {
+      for (int i = 0; i < channels; i++) {
+        __m128i vec = _mm_loadu_si128((const __m128i*)(ptr + x + 16 * i));
+        min_vec[i] = _mm_min_epu8(vec, min_vec[i]);
+        max_vec[i] = _mm_max_epu8(vec, max_vec[i]);
+      }
+    }
+    minmax_interleaved_fold(ptr + x, ptr + x, row - x, channels, min, max);
+  }
+  // Gather the results
+  uint8_t min_arr[64] __attribute__((aligned(64))),
+      max_arr[64] __attribute__((aligned(64)));
+  for (int i = 0; i < channels; i++) {
+    _mm_store_si128((__m128i*)(min_arr + 16 * i), min_vec[i]);
+    _mm_store_si128((__m128i*)(max_arr + 16 * i), max_vec[i]);
+  }
+  minmax_interleaved_fold(min_arr, max_arr, group, channels, min, max);
+}
+
+static void normalize2D_interleaved_sse(const float* scale,
+                                        const float* offset,
+                                        const uint8_t* src, int src_stride,
+                                        int width, int height, int channels,
+                                        NormalizeLayout layout,
+                                        float* dst, int dst_stride) {
+  const int row = width * channels, group = 16 * channels;
+  // Float vector j of a group covers channels (4 * j + lane) % channels,
+  // which repeat with the period of channels vectors
+  __m128 scale_vec[4], offset_vec[4];
+  for (int i = 0; i < channels; i++) {
+    if (layout == kNormalizeInterleaved) {
+      scale_vec[i] = _mm_setr_ps(
+          scale[(4 * i) % channels], scale[(4 * i + 1) % channels],
+          scale[(4 * i + 2) % channels], scale[(4 * i + 3) % channels]);
+      offset_vec[i] = _mm_setr_ps(
+          offset[(4 * i) % channels], offset[(4 * i + 1) % channels],
+          offset[(4 * i + 2) % channels], offset[(4 * i + 3) % channels]);
+    } else {
+      scale_vec[i] = _mm_set1_ps(scale[i]);
+      offset_vec[i] = _mm_set1_ps(offset[i]);
+    }
+  }
+  for (int y = 0; y < height; y++) {
+    const uint8_t* ptr = src + y * src_stride;
+    int x;
+    for (x = 0; x <= row - group; x += group) {
+      __m128 f[16];
+      for (int i = 0; i < channels; i++) {
+        normalize_unpack_sse(
+            _mm_loadu_si128((const __m128i*)(ptr + x + 16 * i)), f + 4 * i);
+      }
+      if (layout == kNormalizeInterleaved) {
+        float* dst_ptr = dst + y * dst_stride + x;
+        for (int j = 0; j < 4 * channels; j++) {
+          __m128 val = _mm_mul_ps(f[j], scale_vec[j % channels]);
+          val = _mm_add_ps(val, offset_vec[j % channels]);
+          _mm_storeu_ps(dst_ptr + 4 * j, val);
+        }
+        continue;
+      }
+      for (int p = 0; p < 4; p++) {
+        __m128 planes[4];
+        normalize_deinterleave_sse(f + channels * p, channels, planes);
+        for (int i = 0; i < channels; i++) {
+          __m128 val = _mm_mul_ps(planes[i], scale_vec[i]);
+          val = _mm_add_ps(val, offset_vec[i]);
+          _mm_storeu_ps(dst + (i * height + y) * dst_stride +
+                        x / channels + 4 * p, val);
+        }
+      }
+    }
+    for (int c = 0; x < row; x++) {
+      float val = ptr[x] * scale[c] + offset[c];
+      if (layout == kNormalizeInterleaved) {
+        dst[y * dst_stride + x] = val;
+      } else {
+        dst[(c * height + y) * dst_stride + x / channels] = val;
+      }
+      if (++c == channels) {
+        c = 0;
+      }
+    }
+  }
+}
+
+/// @brief The same as normalize2D_minmax_sse(), but writes dst with
+/// the non-temporal stores, bypassing the cache.
+static void normalize2D_minmax_stream_sse(uint8_t min, uint8_t max,
+                                          const uint8_t* src, int src_stride,
+                                          int width, int height,
+                                          float* dst, int dst_stride) {
+  assert(max != min);
+  const __m128i min_vec = _mm_set1_epi8(min);
+  float diff = (max - min) / 2.f;
+  const __m128 diff_vec = _mm_set1_ps(1.f / diff);
+  const __m128 sub_vec = _mm_set1_ps(1.f);
+  for (int y = 0; y < height; y++) {
+    const uint8_t* src_ptr = src + y * src_stride;
+    float* dst_ptr = dst + y * dst_stride;
+    // _mm_stream_ps() requires the aligned address
+    int head = ((16 - ((uintptr_t)dst_ptr & 15)) & 15) / sizeof(float);
+    if (head > width) {
+      head = width;
+    }
+    int x;
+    for (x = 0; x < head; x++) {
+      dst_ptr[x] = (src_ptr[x] - min) / diff - 1.0f;
+    }
+    for (; x < width - 15; x += 16) {
+      __m128i vec = _mm_loadu_si128((const __m128i*)(src_ptr + x));
+      vec = _mm_subs_epu8(vec, min_vec);
+      __m128 f[4];
+      normalize_unpack_sse(vec, f);
+      for (int i = 0; i < 4; i++) {
+        _mm_stream_ps(dst_ptr + x + 4 * i,
+                      _mm_sub_ps(_mm_mul_ps(f[i], diff_vec), sub_vec));
+      }
+    }
+    for (; x < width; x++) {
+      dst_ptr[x] = (src_ptr[x] - min) / diff - 1.0f;
+    }
+  }
+  _mm_sfence();
+}
+
+#endif  // __SSE2__
+
+static void normalize2D_minmax_novec(uint8_t min, uint8_t max,
+                                     const uint8_t* src, int src_stride,
+                                     int width, int height,
+                                     float* dst, int dst_stride) {
+  if (max == min) {
+    for (int y = 0; y < height; y++) {
+      for (int x = 0; x < width; x++) {
+        dst[y * dst_stride + x] = 0;
+      }
+    }
+    return;
+  }
+  float diff = (max - min) / 2.f;
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      dst[y * dst_stride + x] = (src[y * src_stride + x] - min) / diff - 1.0f;
+    }
+  }
+}
+
+static void minmax2D_novec(const uint8_t* src, int src_stride,
+                           int width, int height,
+                           uint8_t* min_ptr, uint8_t* max_ptr) {
+  uint8_t min = src[0], max = src[0];
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      float val = src[y * src_stride + x];
+      if (min_ptr && val < min) {
+        min = val;
+      }
+      if (max_ptr && val > max) {
+        max = val;
+      }
+    }
+  }
+  if (min_ptr) {
+    *min_ptr = min;
+  }
+  if (max_ptr) {
+    *max_ptr = max;
+  }
+}
+
+static void minmax1D_novec(const float* src, int length,
+                           float* min_ptr, float* max_ptr) {
+  float min = src[0], max = src[0];
+  for (int i = 0; i < length; i++) {
+    float val = src[i];
+    if (min_ptr && val < min) {
+      min = val;
+    }
+    if (max_ptr && val > max) {
+      max = val;
+    }
+  }
+  if (min_ptr) {
+    *min_ptr = min;
+  }
+  if (max_ptr) {
+    *max_ptr = max;
+  }
+}
+
+static void normalize2D_minmax_u16_novec(uint16_t min, uint16_t max,
+                                         const uint16_t* src, int src_stride,
+                                         int width, int height,
+                                         float* dst, int dst_stride) {
+  if (max == min) {
+    for (int y = 0; y < height; y++) {
+      for (int x = 0; x < width; x++) {
+        dst[y * dst_stride + x] = 0;
+      }
+    }
+    return;
+  }
+  float diff = (max - min) / 2.f;
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      dst[y * dst_stride + x] = (src[y * src_stride + x] - min) / diff - 1.0f;
+    }
+  }
+}
+
+static void minmax2D_u16_novec(const uint16_t* src, int src_stride,
+                               int width, int height,
+                               uint16_t* min_ptr, uint16_t* max_ptr) {
+  uint16_t min = src[0], max = src[0];
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      uint16_t val = src[y * src_stride + x];
+      if (val < min) {
+        min = val;
+      }
+      if (val > max) {
+        max = val;
+      }
+    }
+  }
+  if (min_ptr) {
+    *min_ptr = min;
+  }
+  if (max_ptr) {
+    *max_ptr = max;
+  }
+}
+
+static void normalize2D_minmax_f32_novec(float min, float max,
+                                         const float* src, int src_stride,
+                                         int width, int height,
+                                         float* dst, int dst_stride) {
+  if (max == min) {
+    for (int y = 0; y < height; y++) {
+      for (int x = 0; x < width; x++) {
+        dst[y * dst_stride + x] = 0;
+      }
+    }
+    return;
+  }
+  float diff = (max - min) / 2.f;
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      dst[y * dst_stride + x] = (src[y * src_stride + x] - min) / diff - 1.0f;
+    }
+  }
+}
+
+static void minmax2D_f32_novec(const float* src, int src_stride,
+                               int width, int height,
+                               float* min_ptr, float* max_ptr) {
+  float min = src[0], max = src[0];
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      float val = src[y * src_stride + x];
+      if (val < min) {
+        min = val;
+      }
+      if (val > max) {
+        max = val;
+      }
+    }
+  }
+  if (min_ptr) {
+    *min_ptr = min;
+  }
+  if (max_ptr) {
+    *max_ptr = max;
+  }
+}
+
+static void minmax2D_interleaved_novec(const uint8_t* src, int src_stride,
+                                       int width, int height, int channels,
+                                       uint8_t* min, uint8_t* max) {
+  for (int y = 0; y < height; y++) {
+    minmax_interleaved_fold(src + y * src_stride, src + y * src_stride,
+                            width * channels, channels, min, max);
+  }
+}
+
+static void normalize2D_interleaved_novec(const uint8_t* min,
+                                          const uint8_t* max,
+                                          const uint8_t* src, int src_stride,
+                                          int width, int height, int channels,
+                                          NormalizeLayout layout,
+                                          float* dst, int dst_stride) {
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      for (int c = 0; c < channels; c++) {
+        float val = 0;
+        if (max[c] != min[c]) {
+          float diff = (max[c] - min[c]) / 2.f;
+          val = (src[y * src_stride + x * channels + c] - min[c]) / diff - 1.0f;
+        }
+        if (layout == kNormalizeInterleaved) {
+          dst[y * dst_stride + x * channels + c] = val;
+        } else {
+          dst[(c * height + y) * dst_stride + x] = val;
+        }
+      }
+    }
+  }
+}
+
+void normalize2D(int simd, const uint8_t* src, int src_stride,
+                 int width, int height, float* dst, int dst_stride) {
+  uint8_t min, max;
+  minmax2D(simd, src, src_stride, width, height, &min, &max);
+  normalize2D_minmax(simd, min, max, src, src_stride, width, height,
+                     dst, dst_stride);
+}
+
+void minmax2D(int simd, const uint8_t* src, int src_stride,
+              int width, int height, uint8_t* min, uint8_t* max) {
+  assert(src);
+  assert(width > 0);
+  assert(height > 0);
+  assert(src_stride >= width);
+  if (!min && !max) {
+    return;
   }
   if (simd) {
 #ifdef __ARM_NEON__
@@ -509,3 +1369,369 @@ void minmax1D(int simd, const float *src, int length, float *min, float *max) {
     minmax1D_novec(src, length, min, max);
   }
 }
+
+void normalize2D_u16(int simd, const uint16_t* src, int src_stride,
+                     int width, int height, float* dst, int dst_stride) {
+  uint16_t min, max;
+  minmax2D_u16(simd, src, src_stride, width, height, &min, &max);
+  normalize2D_minmax_u16(simd, min, max, src, src_stride, width, height,
+                         dst, dst_stride);
+}
+
+void minmax2D_u16(int simd, const uint16_t* src, int src_stride,
+                  int width, int height, uint16_t* min, uint16_t* max) {
+  assert(src);
+  assert(width > 0);
+  assert(height > 0);
+  assert(src_stride >= width);
+  if (!min && !max) {
+    return;
+  }
+  if (simd) {
+#ifdef __ARM_NEON__
+    minmax2D_u16_neon(src, src_stride, width, height, min, max);
+  } else {
+#elif defined(__AVX2__)
+    minmax2D_u16_avx2(src, src_stride, width, height, min, max);
+  } else {
+#elif defined(__SSE2__)
+    minmax2D_u16_sse(src, src_stride, width, height, min, max);
+  } else {
+#else
+  } {
+#endif
+    minmax2D_u16_novec(src, src_stride, width, height, min, max);
+  }
+}
+
+void normalize2D_minmax_u16(int simd, uint16_t min, uint16_t max,
+                            const uint16_t* src, int src_stride,
+                            int width, int height, float* dst,
+                            int dst_stride) {
+  assert(src);
+  assert(dst);
+  assert(width > 0);
+  assert(height > 0);
+  assert(src_stride >= width);
+  assert(dst_stride >= width);
+  assert(min <= max);
+  if (simd) {
+#ifdef __ARM_NEON__
+    normalize2D_minmax_u16_neon(min, max, src, src_stride, width, height,
+                                dst, dst_stride);
+  } else {
+#elif defined(__AVX2__)
+    normalize2D_minmax_u16_avx2(min, max, src, src_stride, width, height,
+                                dst, dst_stride);
+  } else {
+#elif defined(__SSE2__)
+    normalize2D_minmax_u16_sse(min, max, src, src_stride, width, height,
+                               dst, dst_stride);
+  } else {
+#else
+  } {
+#endif
+    normalize2D_minmax_u16_novec(min, max, src, src_stride, width, height,
+                                 dst, dst_stride);
+  }
+}
+
+void normalize2D_f32(int simd, const float* src, int src_stride,
+                     int width, int height, float* dst, int dst_stride) {
+  float min, max;
+  minmax2D_f32(simd, src, src_stride, width, height, &min, &max);
+  normalize2D_minmax_f32(simd, min, max, src, src_stride, width, height,
+                         dst, dst_stride);
+}
+
+void minmax2D_f32(int simd, const float* src, int src_stride,
+                  int width, int height, float* min, float* max) {
+  assert(src);
+  assert(width > 0);
+  assert(height > 0);
+  assert(src_stride >= width);
+  if (!min && !max) {
+    return;
+  }
+  if (simd) {
+#ifdef __ARM_NEON__
+    minmax2D_f32_neon(src, src_stride, width, height, min, max);
+  } else {
+#elif defined(__AVX__)
+    minmax2D_f32_avx(src, src_stride, width, height, min, max);
+  } else {
+#else
+  } {
+#endif
+    minmax2D_f32_novec(src, src_stride, width, height, min, max);
+  }
+}
+
+void normalize2D_minmax_f32(int simd, float min, float max,
+                            const float* src, int src_stride,
+                            int width, int height, float* dst,
+                            int dst_stride) {
+  assert(src);
+  assert(dst);
+  assert(width > 0);
+  assert(height > 0);
+  assert(src_stride >= width);
+  assert(dst_stride >= width);
+  assert(src != dst || src_stride == dst_stride);
+  assert(min <= max);
+  if (simd) {
+#ifdef __ARM_NEON__
+    normalize2D_minmax_f32_neon(min, max, src, src_stride, width, height,
+                                dst, dst_stride);
+  } else {
+#elif defined(__AVX__)
+    normalize2D_minmax_f32_avx(min, max, src, src_stride, width, height,
+                               dst, dst_stride);
+  } else {
+#else
+  } {
+#endif
+    normalize2D_minmax_f32_novec(min, max, src, src_stride, width, height,
+                                 dst, dst_stride);
+  }
+}
+
+void minmax2D_interleaved(int simd, const uint8_t *src, int src_stride,
+                          int width, int height, int channels,
+                          uint8_t *min, uint8_t *max) {
+  assert(src);
+  assert(width > 0);
+  assert(height > 0);
+  assert(channels >= 1 && channels <= 4);
+  assert(src_stride >= width * channels);
+  if (!min && !max) {
+    return;
+  }
+  uint8_t min_res[4] = { 0xFF, 0xFF, 0xFF, 0xFF }, max_res[4] = { 0 };
+  if (simd) {
+#ifdef __ARM_NEON__
+    minmax2D_interleaved_neon(src, src_stride, width, height, channels,
+                              min_res, max_res);
+  } else {
+#elif defined(__SSE2__)
+    minmax2D_interleaved_sse(src, src_stride, width, height, channels,
+                             min_res, max_res);
+  } else {
+#else
+  } {
+#endif
+    minmax2D_interleaved_novec(src, src_stride, width, height, channels,
+                               min_res, max_res);
+  }
+  for (int c = 0; c < channels; c++) {
+    if (min) {
+      min[c] = min_res[c];
+    }
+    if (max) {
+      max[c] = max_res[c];
+    }
+  }
+}
+
+void normalize2D_interleaved_minmax(int simd, const uint8_t *min,
+                                    const uint8_t *max, const uint8_t *src,
+                                    int src_stride, int width, int height,
+                                    int channels, NormalizeLayout layout,
+                                    float *dst, int dst_stride) {
+  assert(min);
+  assert(max);
+  assert(src);
+  assert(dst);
+  assert(width > 0);
+  assert(height > 0);
+  assert(channels >= 1 && channels <= 4);
+  assert(src_stride >= width * channels);
+  assert(dst_stride >= (layout == kNormalizeInterleaved?
+                        width * channels : width));
+  if (simd) {
+#if defined(__ARM_NEON__) || defined(__SSE2__)
+    // dst = src * scale + offset
+    float scale[4], offset[4];
+    for (int c = 0; c < channels; c++) {
+      assert(min[c] <= max[c]);
+      scale[c] = max[c] != min[c]? 2.f / (max[c] - min[c]) : 0;
+      offset[c] = -min[c] * scale[c] - 1.f;
+      if (max[c] == min[c]) {
+        offset[c] = 0;
+      }
+    }
+#endif
+#ifdef __ARM_NEON__
+    normalize2D_interleaved_neon(scale, offset, src, src_stride, width,
+                                 height, channels, layout, dst, dst_stride);
+  } else {
+#elif defined(__SSE2__)
+    normalize2D_interleaved_sse(scale, offset, src, src_stride, width,
+                                height, channels, layout, dst, dst_stride);
+  } else {
+#else
+  } {
+#endif
+    normalize2D_interleaved_novec(min, max, src, src_stride, width, height,
+                                  channels, layout, dst, dst_stride);
+  }
+}
+
+void normalize2D_interleaved(int simd, const uint8_t *src, int src_stride,
+                             int width, int height, int channels, int joint,
+                             NormalizeLayout layout, float *dst,
+                             int dst_stride) {
+  uint8_t min[4], max[4];
+  minmax2D_interleaved(simd, src, src_stride, width, height, channels,
+                       min, max);
+  if (joint) {
+    for (int c = 1; c < channels; c++) {
+      if (min[c] < min[0]) {
+        min[0] = min[c];
+      }
+      if (max[c] > max[0]) {
+        max[0] = max[c];
+      }
+    }
+    for (int c = 1; c < channels; c++) {
+      min[c] = min[0];
+      max[c] = max[0];
+    }
+  }
+  normalize2D_interleaved_minmax(simd, min, max, src, src_stride, width,
+                                 height, channels, layout, dst, dst_stride);
+}
+
+/// @brief Returns the number of row bands to split a width x height plane.
+static int normalize_threads(int threads UNUSED, int width UNUSED,
+                             int height UNUSED) {
+  int res = 1;
+#ifdef _OPENMP
+  if ((size_t)width * height >= NORMALIZE_PARALLEL_THRESHOLD) {
+    res = threads > 0? threads : omp_get_max_threads();
+    if (res > height) {
+      res = height;
+    }
+  }
+#endif
+  return res;
+}
+
+/// @brief Returns the size of the last level cache in bytes.
+static size_t normalize_llc_size(void) {
+  long size = 0;
+#ifdef _SC_LEVEL3_CACHE_SIZE
+  size = sysconf(_SC_LEVEL3_CACHE_SIZE);
+#endif
+#ifdef _SC_LEVEL2_CACHE_SIZE
+  if (size <= 0) {
+    size = sysconf(_SC_LEVEL2_CACHE_SIZE);
+  }
+#endif
+  return size > 0? (size_t)size : NORMALIZE_DEFAULT_LLC_SIZE;
+}
+
+void normalize2D_parallel(int simd, int threads, const uint8_t* src,
+                          int src_stride, int width, int height,
+                          float* dst, int dst_stride) {
+  uint8_t min, max;
+  minmax2D_parallel(simd, threads, src, src_stride, width, height,
+                    &min, &max);
+  normalize2D_minmax_parallel(simd, threads, min, max, src, src_stride,
+                              width, height, dst, dst_stride);
+}
+
+void minmax2D_parallel(int simd, int threads, const uint8_t* src,
+                       int src_stride, int width, int height,
+                       uint8_t* min, uint8_t* max) {
+  assert(src);
+  assert(width > 0);
+  assert(height > 0);
+  assert(src_stride >= width);
+  if (!min && !max) {
+    return;
+  }
+  threads = normalize_threads(threads, width, height);
+  if (threads == 1) {
+    minmax2D(simd, src, src_stride, width, height, min, max);
+    return;
+  }
+  uint8_t* band_min = malloc(threads * 2);
+  assert(band_min);
+  uint8_t* band_max = band_min + threads;
+#ifdef _OPENMP
+  #pragma omp parallel for num_threads(threads) schedule(static)
+#endif
+  for (int t = 0; t < threads; t++) {
+    int y0 = (int)((int64_t)height * t / threads);
+    int y1 = (int)((int64_t)height * (t + 1) / threads);
+    minmax2D(simd, src + (size_t)y0 * src_stride, src_stride, width,
+             y1 - y0, band_min + t, band_max + t);
+  }
+  for (int t = 1; t < threads; t++) {
+    if (band_min[t] < band_min[0]) {
+      band_min[0] = band_min[t];
+    }
+    if (band_max[t] > band_max[0]) {
+      band_max[0] = band_max[t];
+    }
+  }
+  if (min) {
+    *min = band_min[0];
+  }
+  if (max) {
+    *max = band_max[0];
+  }
+  free(band_min);
+}
+
+void normalize2D_minmax_parallel(int simd, int threads,
+                                 uint8_t min, uint8_t max,
+                                 const uint8_t* src, int src_stride,
+                                 int width, int height,
+                                 float* dst, int dst_stride) {
+  assert(src);
+  assert(dst);
+  assert(width > 0);
+  assert(height > 0);
+  assert(src_stride >= width);
+  assert(dst_stride >= width);
+  assert(min <= max);
+  threads = normalize_threads(threads, width, height);
+  // The output which does not fit into the cache would only evict the source
+  int stream = (size_t)height * dst_stride * sizeof(float) >
+      (normalize_stream_threshold > 0? normalize_stream_threshold :
+                                        normalize_llc_size());
+#ifdef __SSE2__
+  stream = stream && simd && max != min;
+#else
+  stream = 0;
+#endif
+  if (threads == 1 && !stream) {
+    normalize2D_minmax(simd, min, max, src, src_stride, width, height,
+                       dst, dst_stride);
+    return;
+  }
+#ifdef _OPENMP
+  #pragma omp parallel for num_threads(threads) schedule(static)
+#endif
+  for (int t = 0; t < threads; t++) {
+    int y0 = (int)((int64_t)height * t / threads);
+    int y1 = (int)((int64_t)height * (t + 1) / threads);
+    const uint8_t* band_src = src + (size_t)y0 * src_stride;
+    float* band_dst = dst + (size_t)y0 * dst_stride;
+#ifdef __SSE2__
+    if (stream) {
+      normalize2D_minmax_stream_sse(min, max, band_src, src_stride, width,
+                                    y1 - y0, band_dst, dst_stride);
+      continue;
+    }
+#endif
+    normalize2D_minmax(simd, min, max, band_src, src_stride, width, y1 - y0,
+                       band_dst, dst_stride);
+  }
+}
+
+void normalize2D_set_stream_threshold(size_t bytes) {
+  normalize_stream_threshold = bytes;
+}
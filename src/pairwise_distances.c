@@ -0,0 +1,395 @@
+/*! @file pairwise_distances.c
+ *  @brief Distance matrices between two sets of points implementation.
+ *  @author Markovtsev Vadim <v.markovtsev@samsung.com>
+ *  @version 1.0
+ *
+ *  @section Notes
+ *  This code partially conforms to <a href="http://google-styleguide.googlecode.com/svn/trunk/cppguide.xml">Google C++ Style Guide</a>.
+ *
+ *  @section Copyright
+ *  Copyright © 2013 Samsung R&D Institute Russia
+ *
+ *  @section License
+ *  Licensed to the Apache Software Foundation (ASF) under one
+ *  or more contributor license agreements.  See the NOTICE file
+ *  distributed with this work for additional information
+ *  regarding copyright ownership.  The ASF licenses this file
+ *  to you under the Apache License, Version 2.0 (the
+ *  "License"); you may not use this file except in compliance
+ *  with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an
+ *  "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ *  KIND, either express or implied.  See the License for the
+ *  specific language governing permissions and limitations
+ *  under the License.
+ */
+
+
+#define LIBSIMD_IMPLEMENTATION
+#include "inc/simd/pairwise_distances.h"
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include "inc/simd/matrix.h"
+#include "inc/simd/memory.h"
+#include "inc/simd/vector.h"
+#include <simd/instruction_set.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/// The size of the block of distances which stays in cache between
+/// the multiplication and the epilogue, in bytes.
+#define PAIRWISE_TILE_BYTES (1 << 18)
+/// The minimal number of rows in a block, so that packing the second set
+/// of points in matrix_gemm() is amortized.
+#define PAIRWISE_MIN_ROWS 32
+/// The maximal number of columns in a block of pairwise_distances_topk().
+#define PAIRWISE_TOPK_COLUMNS 2048
+/// The minimal number of multiply-adds which pairwise_distances_topk()
+/// splits between the threads.
+#define PAIRWISE_PARALLEL_THRESHOLD (1 << 20)
+
+/// @brief Calculates the squared norms of the points or, for the cosine
+/// metric, their reciprocal norms (0 for zero vectors).
+static void pairwise_norms(int simd, DistanceMetric metric, const float *m,
+                           size_t count, size_t dim, float *norms) {
+  for (size_t i = 0; i < count; i++) {
+    const float *row = m + i * dim;
+    float norm = vector_dot(simd, dim, row, 1, row, 1);
+    if (metric == kDistanceCosine) {
+      norm = norm > 0? 1 / sqrtf(norm) : 0;
+    }
+    norms[i] = norm;
+  }
+}
+
+static void pairwise_epilogue_novec(DistanceMetric metric, float an,
+                                    const float *bn, size_t n, float *row) {
+  for (size_t j = 0; j < n; j++) {
+    float d;
+    if (metric == kDistanceCosine) {
+      d = 1 - row[j] * (an * bn[j]);
+      d = d > 0? (d < 2? d : 2) : 0;
+    } else {
+      d = row[j] + an + bn[j];
+      d = d > 0? d : 0;
+      if (metric == kDistanceEuclidean) {
+        d = sqrtf(d);
+      }
+    }
+    row[j] = d;
+  }
+}
+
+#ifdef __AVX__
+static void pairwise_epilogue_avx(DistanceMetric metric, float an,
+                                  const float *bn, size_t n, float *row) {
+  const __m256 va = _mm256_set1_ps(an);
+  const __m256 zero = _mm256_setzero_ps();
+  size_t j = 0;
+  if (metric == kDistanceCosine) {
+    const __m256 one = _mm256_set1_ps(1), two = _mm256_set1_ps(2);
+    for (; j + 8 <= n; j += 8) {
+      __m256 scale = _mm256_mul_ps(va, _mm256_loadu_ps(bn + j));
+      __m256 d = _mm256_sub_ps(
+          one, _mm256_mul_ps(_mm256_loadu_ps(row + j), scale));
+      _mm256_storeu_ps(row + j,
+                       _mm256_min_ps(_mm256_max_ps(d, zero), two));
+    }
+  } else {
+    int root = metric == kDistanceEuclidean;
+    for (; j + 8 <= n; j += 8) {
+      __m256 d = _mm256_add_ps(_mm256_add_ps(_mm256_loadu_ps(row + j), va),
+                               _mm256_loadu_ps(bn + j));
+      d = _mm256_max_ps(d, zero);
+      if (root) {
+        d = _mm256_sqrt_ps(d);
+      }
+      _mm256_storeu_ps(row + j, d);
+    }
+  }
+  pairwise_epilogue_novec(metric, an, bn + j, n - j, row + j);
+}
+#endif
+
+#ifdef __ARM_NEON__
+static void pairwise_epilogue_neon(DistanceMetric metric, float an,
+                                   const float *bn, size_t n, float *row) {
+  const float32x4_t zero = vdupq_n_f32(0.f);
+  size_t j = 0;
+  if (metric == kDistanceCosine) {
+    const float32x4_t one = vdupq_n_f32(1.f), two = vdupq_n_f32(2.f);
+    for (; j + 4 <= n; j += 4) {
+      float32x4_t d = vmlsq_f32(one, vld1q_f32(row + j),
+                                vmulq_n_f32(vld1q_f32(bn + j), an));
+      vst1q_f32(row + j, vminq_f32(vmaxq_f32(d, zero), two));
+    }
+  } else {
+    const float32x4_t va = vdupq_n_f32(an);
+    for (; j + 4 <= n; j += 4) {
+      float32x4_t d = vaddq_f32(vaddq_f32(vld1q_f32(row + j), va),
+                                vld1q_f32(bn + j));
+      vst1q_f32(row + j, vmaxq_f32(d, zero));
+    }
+    if (metric == kDistanceEuclidean) {
+      // 32-bit NEON has no square root
+      for (size_t i = 0; i < j; i++) {
+        row[i] = sqrtf(row[i]);
+      }
+    }
+  }
+  pairwise_epilogue_novec(metric, an, bn + j, n - j, row + j);
+}
+#endif
+
+/// @brief Turns the dot products in a row of distances into the distances.
+static void pairwise_epilogue(int simd, DistanceMetric metric, float an,
+                              const float *bn, size_t n, float *row) {
+  if (simd) {
+#ifdef __ARM_NEON__
+    pairwise_epilogue_neon(metric, an, bn, n, row);
+  } else {
+#elif defined(__AVX__)
+    pairwise_epilogue_avx(metric, an, bn, n, row);
+  } else {
+#else
+  } {
+#endif
+    pairwise_epilogue_novec(metric, an, bn, n, row);
+  }
+}
+
+/// @brief Calculates the rows x cols block of distances.
+/// @param diagonal The index of the column which is the same point as the
+/// first row, or -1 if the sets are different. The distances between
+/// the same points are set to exact zeros.
+static void pairwise_block(int simd, DistanceMetric metric,
+                           const float *a, const float *an, size_t rows,
+                           const float *b, const float *bn, size_t cols,
+                           size_t dim, long diagonal, float *res,
+                           size_t ldr) {
+  matrix_gemm(simd, 0, 1, rows, cols, dim,
+              metric == kDistanceCosine? 1 : -2, a, dim, b, dim, 0, res, ldr);
+  for (size_t i = 0; i < rows; i++) {
+    float *row = res + i * ldr;
+    pairwise_epilogue(simd, metric, an[i], bn, cols, row);
+    long j = diagonal + (long)i;
+    if (diagonal >= -(long)i && j < (long)cols) {
+      row[j] = 0;
+    }
+  }
+}
+
+/// @brief Returns the number of rows in a block of the specified width.
+static size_t pairwise_block_rows(size_t cols, size_t rows) {
+  size_t block = PAIRWISE_TILE_BYTES / sizeof(float) / cols;
+  if (block < PAIRWISE_MIN_ROWS) {
+    block = PAIRWISE_MIN_ROWS;
+  }
+  return block < rows? block : rows;
+}
+
+void pairwise_distances(int simd, DistanceMetric metric,
+                        const float *a, size_t na, const float *b, size_t nb,
+                        size_t dim, float *res) {
+  assert(a);
+  assert(b);
+  assert(res);
+  if (na == 0 || nb == 0) {
+    return;
+  }
+  float *an = mallocf(na);
+  float *bn = b == a? an : mallocf(nb);
+  assert(an);
+  assert(bn);
+  pairwise_norms(simd, metric, a, na, dim, an);
+  if (bn != an) {
+    pairwise_norms(simd, metric, b, nb, dim, bn);
+  }
+  size_t rows = pairwise_block_rows(nb, na);
+  for (size_t i = 0; i < na; i += rows) {
+    size_t ir = na - i < rows? na - i : rows;
+    pairwise_block(simd, metric, a + i * dim, an + i, ir, b, bn, nb, dim,
+                   b == a? (long)i : -(long)(ir + 1), res + i * nb, nb);
+  }
+  if (bn != an) {
+    free(bn);
+  }
+  free(an);
+}
+
+/// @brief Compares (distance, index) pairs, NaN-s being the largest.
+INLINE int pairwise_greater(float d1, int i1, float d2, int i2) {
+  return d1 > d2 || (d1 == d2 && i1 > i2) || (d1 != d1 && d2 == d2);
+}
+
+static void pairwise_heap_sift_down(float *dist, int *idx, size_t size,
+                                    size_t pos) {
+  for (;;) {
+    size_t largest = pos, left = 2 * pos + 1, right = left + 1;
+    if (left < size && pairwise_greater(dist[left], idx[left],
+                                        dist[largest], idx[largest])) {
+      largest = left;
+    }
+    if (right < size && pairwise_greater(dist[right], idx[right],
+                                         dist[largest], idx[largest])) {
+      largest = right;
+    }
+    if (largest == pos) {
+      return;
+    }
+    float d = dist[pos];
+    dist[pos] = dist[largest];
+    dist[largest] = d;
+    int i = idx[pos];
+    idx[pos] = idx[largest];
+    idx[largest] = i;
+    pos = largest;
+  }
+}
+
+static void pairwise_heap_push(float *dist, int *idx, size_t size,
+                               float d, int i) {
+  size_t pos = size;
+  while (pos > 0) {
+    size_t parent = (pos - 1) / 2;
+    if (!pairwise_greater(d, i, dist[parent], idx[parent])) {
+      break;
+    }
+    dist[pos] = dist[parent];
+    idx[pos] = idx[parent];
+    pos = parent;
+  }
+  dist[pos] = d;
+  idx[pos] = i;
+}
+
+/// @brief Merges a row of distances into the max-heap of size k.
+/// @param offset The index of the first distance in the row.
+/// @param filled The number of elements in the heap.
+static void pairwise_heap_merge(int simd UNUSED, const float *row, size_t n,
+                                size_t offset, size_t k, size_t filled,
+                                float *dist, int *idx) {
+  size_t j = 0;
+  for (; j < n && filled < k; j++, filled++) {
+    pairwise_heap_push(dist, idx, filled, row[j], offset + j);
+  }
+#ifdef __AVX__
+  if (simd) {
+    // Most of the distances are larger than the heap's top, so they are
+    // filtered eight at a time. The equal ones have greater indices and
+    // lose, NaN on the top is replaced by anything (the scalar path).
+    __m256 top = _mm256_set1_ps(dist[0]);
+    for (; j + 8 <= n && dist[0] == dist[0]; j += 8) {
+      int mask = _mm256_movemask_ps(
+          _mm256_cmp_ps(_mm256_loadu_ps(row + j), top, _CMP_LT_OS));
+      while (mask) {
+        int lane = __builtin_ctz(mask);
+        mask &= mask - 1;
+        if (pairwise_greater(dist[0], idx[0], row[j + lane],
+                             offset + j + lane)) {
+          dist[0] = row[j + lane];
+          idx[0] = offset + j + lane;
+          pairwise_heap_sift_down(dist, idx, k, 0);
+          top = _mm256_set1_ps(dist[0]);
+        }
+      }
+    }
+  }
+#endif
+  for (; j < n; j++) {
+    if (pairwise_greater(dist[0], idx[0], row[j], offset + j)) {
+      dist[0] = row[j];
+      idx[0] = offset + j;
+      pairwise_heap_sift_down(dist, idx, k, 0);
+    }
+  }
+}
+
+/// @brief Sorts the max-heap in ascending order.
+static void pairwise_heap_sort(float *dist, int *idx, size_t size) {
+  for (size_t end = size; end > 1; end--) {
+    float d = dist[0];
+    dist[0] = dist[end - 1];
+    dist[end - 1] = d;
+    int i = idx[0];
+    idx[0] = idx[end - 1];
+    idx[end - 1] = i;
+    pairwise_heap_sift_down(dist, idx, end - 1, 0);
+  }
+}
+
+void pairwise_distances_topk(int simd, DistanceMetric metric,
+                             const float *a, size_t na,
+                             const float *b, size_t nb, size_t dim,
+                             size_t k, float *distances, int *indices) {
+  assert(a);
+  assert(b);
+  assert(distances);
+  assert(indices);
+  assert(k <= nb);
+  if (na == 0 || k == 0) {
+    return;
+  }
+  float *an = mallocf(na);
+  float *bn = b == a? an : mallocf(nb);
+  assert(an);
+  assert(bn);
+  pairwise_norms(simd, metric, a, na, dim, an);
+  if (bn != an) {
+    pairwise_norms(simd, metric, b, nb, dim, bn);
+  }
+  size_t cols = nb < PAIRWISE_TOPK_COLUMNS? nb : PAIRWISE_TOPK_COLUMNS;
+  size_t rows = pairwise_block_rows(cols, na);
+  int blocks = (na + rows - 1) / rows;
+  int threads UNUSED = 1;
+#ifdef _OPENMP
+  if ((double)na * nb * (dim + 1) >= PAIRWISE_PARALLEL_THRESHOLD) {
+    threads = matrix_get_threads();
+    if (threads == 0) {
+      threads = omp_get_max_threads();
+    }
+    if (threads > blocks) {
+      threads = blocks;
+    }
+  }
+  #pragma omp parallel num_threads(threads) if (threads > 1)
+#endif
+  {
+    float *block = mallocf(rows * cols);
+    assert(block);
+#ifdef _OPENMP
+    #pragma omp for schedule(dynamic, 1)
+#endif
+    for (int t = 0; t < blocks; t++) {
+      size_t i0 = t * rows;
+      size_t ir = na - i0 < rows? na - i0 : rows;
+      for (size_t j0 = 0; j0 < nb; j0 += cols) {
+        size_t jc = nb - j0 < cols? nb - j0 : cols;
+        pairwise_block(simd, metric, a + i0 * dim, an + i0, ir,
+                       b + j0 * dim, bn + j0, jc, dim,
+                       b == a? (long)i0 - (long)j0 : -(long)(ir + 1),
+                       block, jc);
+        size_t filled = j0 < k? j0 : k;
+        for (size_t i = 0; i < ir; i++) {
+          pairwise_heap_merge(simd, block + i * jc, jc, j0, k, filled,
+                              distances + (i0 + i) * k,
+                              indices + (i0 + i) * k);
+        }
+      }
+      for (size_t i = i0; i < i0 + ir; i++) {
+        pairwise_heap_sort(distances + i * k, indices + i * k, k);
+      }
+    }
+    free(block);
+  }
+  if (bn != an) {
+    free(bn);
+  }
+  free(an);
+}
@@ -0,0 +1,625 @@
+/*! @file vector.c
+ *  @brief BLAS level 1 operations on vectors.
+ *  @author Markovtsev Vadim <v.markovtsev@samsung.com>
+ *  @version 1.0
+ *
+ *  @section Notes
+ *  This code partially conforms to <a href="http://google-styleguide.googlecode.com/svn/trunk/cppguide.xml">Google C++ Style Guide</a>.
+ *
+ *  @section Copyright
+ *  Copyright © 2013 Samsung R&D Institute Russia
+ *
+ *  @section License
+ *  Licensed to the Apache Software Foundation (ASF) under one
+ *  or more contributor license agreements.  See the NOTICE file
+ *  distributed with this work for additional information
+ *  regarding copyright ownership.  The ASF licenses this file
+ *  to you under the Apache License, Version 2.0 (the
+ *  "License"); you may not use this file except in compliance
+ *  with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an
+ *  "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ *  KIND, either express or implied.  See the License for the
+ *  specific language governing permissions and limitations
+ *  under the License.
+ */
+
+#define LIBSIMD_IMPLEMENTATION
+#include "inc/simd/vector.h"
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+#include <simd/instruction_set.h>
+
+#ifdef __AVX__
+#ifdef __FMA__
+#define VECTOR_FMADD(a, b, c) _mm256_fmadd_ps(a, b, c)
+#define VECTOR_FMADD_PD(a, b, c) _mm256_fmadd_pd(a, b, c)
+#else
+#define VECTOR_FMADD(a, b, c) _mm256_add_ps(_mm256_mul_ps(a, b), c)
+#define VECTOR_FMADD_PD(a, b, c) _mm256_add_pd(_mm256_mul_pd(a, b), c)
+#endif
+
+INLINE float vector_hsum_avx(__m256 v) {
+  __m128 s = _mm_add_ps(_mm256_castps256_ps128(v),
+                        _mm256_extractf128_ps(v, 1));
+  s = _mm_hadd_ps(s, s);
+  s = _mm_hadd_ps(s, s);
+  return _mm_cvtss_f32(s);
+}
+
+INLINE __m256 vector_abs_avx(__m256 v) {
+  return _mm256_andnot_ps(_mm256_set1_ps(-0.f), v);
+}
+#endif
+
+#ifdef __ARM_NEON__
+INLINE float vector_hsum_neon(float32x4_t v) {
+  float32x2_t s = vadd_f32(vget_low_f32(v), vget_high_f32(v));
+  return vget_lane_f32(vpadd_f32(s, s), 0);
+}
+#endif
+
+static void vector_axpby_novec(size_t n, float alpha,
+                               const float *x, size_t incx, float beta,
+                               float *y, size_t incy) {
+  for (size_t i = 0; i < n; i++) {
+    float *dst = y + i * incy;
+    *dst = beta == 0? alpha * x[i * incx] : alpha * x[i * incx] + beta * *dst;
+  }
+}
+
+static float vector_dot_novec(size_t n, const float *x, size_t incx,
+                              const float *y, size_t incy) {
+  float sum = 0;
+  for (size_t i = 0; i < n; i++) {
+    sum += x[i * incx] * y[i * incy];
+  }
+  return sum;
+}
+
+static float vector_nrm2_novec(size_t n, const float *x, size_t incx) {
+  // The square of any float fits into double without overflow or underflow
+  double sum = 0;
+  for (size_t i = 0; i < n; i++) {
+    double v = x[i * incx];
+    sum += v * v;
+  }
+  return sqrt(sum);
+}
+
+static float vector_asum_novec(size_t n, const float *x, size_t incx) {
+  float sum = 0;
+  for (size_t i = 0; i < n; i++) {
+    sum += fabsf(x[i * incx]);
+  }
+  return sum;
+}
+
+static int vector_iamax_novec(size_t n, const float *x, size_t incx) {
+  int index = 0;
+  float best = -1;
+  for (size_t i = 0; i < n; i++) {
+    float v = fabsf(x[i * incx]);
+    if (v > best) {
+      best = v;
+      index = i;
+    }
+  }
+  return index;
+}
+
+static int vector_iamin_novec(size_t n, const float *x, size_t incx) {
+  int index = 0;
+  float best = INFINITY;
+  for (size_t i = 0; i < n; i++) {
+    float v = fabsf(x[i * incx]);
+    if (v < best) {
+      best = v;
+      index = i;
+    }
+  }
+  return index;
+}
+
+#if defined(__AVX__) || defined(__ARM_NEON__)
+/// @brief Returns the index of the first element with the magnitude equal
+/// to value, or 0 if there is no such element.
+static int vector_find_magnitude(size_t n, const float *x, float value) {
+  size_t i = 0;
+#ifdef __AVX__
+  const __m256 target = _mm256_set1_ps(value);
+  for (; i + 8 <= n; i += 8) {
+    __m256 eq = _mm256_cmp_ps(vector_abs_avx(_mm256_loadu_ps(x + i)), target,
+                              _CMP_EQ_OQ);
+    int mask = _mm256_movemask_ps(eq);
+    if (mask) {
+      return i + __builtin_ctz(mask);
+    }
+  }
+#endif
+  for (; i < n; i++) {
+    if (fabsf(x[i]) == value) {
+      return i;
+    }
+  }
+  return 0;
+}
+#endif
+
+#ifdef __AVX__
+static void vector_axpby_avx(size_t n, float alpha, const float *x,
+                             float beta, float *y) {
+  const __m256 va = _mm256_set1_ps(alpha);
+  const __m256 vb = _mm256_set1_ps(beta);
+  size_t i = 0;
+  if (beta == 0) {
+    for (; i + 16 <= n; i += 16) {
+      _mm256_storeu_ps(y + i, _mm256_mul_ps(va, _mm256_loadu_ps(x + i)));
+      _mm256_storeu_ps(y + i + 8,
+                       _mm256_mul_ps(va, _mm256_loadu_ps(x + i + 8)));
+    }
+  } else if (beta == 1) {
+    for (; i + 16 <= n; i += 16) {
+      _mm256_storeu_ps(y + i, VECTOR_FMADD(va, _mm256_loadu_ps(x + i),
+                                           _mm256_loadu_ps(y + i)));
+      _mm256_storeu_ps(y + i + 8,
+                       VECTOR_FMADD(va, _mm256_loadu_ps(x + i + 8),
+                                    _mm256_loadu_ps(y + i + 8)));
+    }
+  } else {
+    for (; i + 16 <= n; i += 16) {
+      __m256 y0 = _mm256_mul_ps(vb, _mm256_loadu_ps(y + i));
+      __m256 y1 = _mm256_mul_ps(vb, _mm256_loadu_ps(y + i + 8));
+      _mm256_storeu_ps(y + i, VECTOR_FMADD(va, _mm256_loadu_ps(x + i), y0));
+      _mm256_storeu_ps(y + i + 8,
+                       VECTOR_FMADD(va, _mm256_loadu_ps(x + i + 8), y1));
+    }
+  }
+  vector_axpby_novec(n - i, alpha, x + i, 1, beta, y + i, 1);
+}
+
+static float vector_dot_avx(size_t n, const float *x, const float *y) {
+  __m256 s0 = _mm256_setzero_ps(), s1 = _mm256_setzero_ps();
+  __m256 s2 = _mm256_setzero_ps(), s3 = _mm256_setzero_ps();
+  size_t i = 0;
+  for (; i + 32 <= n; i += 32) {
+    s0 = VECTOR_FMADD(_mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i), s0);
+    s1 = VECTOR_FMADD(_mm256_loadu_ps(x + i + 8), _mm256_loadu_ps(y + i + 8),
+                      s1);
+    s2 = VECTOR_FMADD(_mm256_loadu_ps(x + i + 16),
+                      _mm256_loadu_ps(y + i + 16), s2);
+    s3 = VECTOR_FMADD(_mm256_loadu_ps(x + i + 24),
+                      _mm256_loadu_ps(y + i + 24), s3);
+  }
+  for (; i + 8 <= n; i += 8) {
+    s0 = VECTOR_FMADD(_mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i), s0);
+  }
+  float sum = vector_hsum_avx(_mm256_add_ps(_mm256_add_ps(s0, s1),
+                                            _mm256_add_ps(s2, s3)));
+  return sum + vector_dot_novec(n - i, x + i, 1, y + i, 1);
+}
+
+static float vector_nrm2_avx(size_t n, const float *x) {
+  __m256d s0 = _mm256_setzero_pd(), s1 = _mm256_setzero_pd();
+  __m256d s2 = _mm256_setzero_pd(), s3 = _mm256_setzero_pd();
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m256d v0 = _mm256_cvtps_pd(_mm_loadu_ps(x + i));
+    __m256d v1 = _mm256_cvtps_pd(_mm_loadu_ps(x + i + 4));
+    __m256d v2 = _mm256_cvtps_pd(_mm_loadu_ps(x + i + 8));
+    __m256d v3 = _mm256_cvtps_pd(_mm_loadu_ps(x + i + 12));
+    s0 = VECTOR_FMADD_PD(v0, v0, s0);
+    s1 = VECTOR_FMADD_PD(v1, v1, s1);
+    s2 = VECTOR_FMADD_PD(v2, v2, s2);
+    s3 = VECTOR_FMADD_PD(v3, v3, s3);
+  }
+  __m256d s = _mm256_add_pd(_mm256_add_pd(s0, s1), _mm256_add_pd(s2, s3));
+  __m128d h = _mm_add_pd(_mm256_castpd256_pd128(s),
+                         _mm256_extractf128_pd(s, 1));
+  double sum = _mm_cvtsd_f64(_mm_hadd_pd(h, h));
+  for (; i < n; i++) {
+    double v = x[i];
+    sum += v * v;
+  }
+  return sqrt(sum);
+}
+
+static float vector_asum_avx(size_t n, const float *x) {
+  __m256 s0 = _mm256_setzero_ps(), s1 = _mm256_setzero_ps();
+  __m256 s2 = _mm256_setzero_ps(), s3 = _mm256_setzero_ps();
+  size_t i = 0;
+  for (; i + 32 <= n; i += 32) {
+    s0 = _mm256_add_ps(s0, vector_abs_avx(_mm256_loadu_ps(x + i)));
+    s1 = _mm256_add_ps(s1, vector_abs_avx(_mm256_loadu_ps(x + i + 8)));
+    s2 = _mm256_add_ps(s2, vector_abs_avx(_mm256_loadu_ps(x + i + 16)));
+    s3 = _mm256_add_ps(s3, vector_abs_avx(_mm256_loadu_ps(x + i + 24)));
+  }
+  float sum = vector_hsum_avx(_mm256_add_ps(_mm256_add_ps(s0, s1),
+                                            _mm256_add_ps(s2, s3)));
+  return sum + vector_asum_novec(n - i, x + i, 1);
+}
+
+/// @brief Returns the maximal (if max is set) or the minimal magnitude,
+/// skipping NaN-s.
+static float vector_extreme_magnitude_avx(size_t n, const float *x, int max) {
+  // _mm256_max_ps() and _mm256_min_ps() return the second operand if any
+  // of them is NaN
+  __m256 acc = _mm256_set1_ps(max? -1 : INFINITY);
+  size_t i = 0;
+  if (max) {
+    for (; i + 8 <= n; i += 8) {
+      acc = _mm256_max_ps(vector_abs_avx(_mm256_loadu_ps(x + i)), acc);
+    }
+  } else {
+    for (; i + 8 <= n; i += 8) {
+      acc = _mm256_min_ps(vector_abs_avx(_mm256_loadu_ps(x + i)), acc);
+    }
+  }
+  float lanes[8] __attribute__((aligned(32)));
+  _mm256_store_ps(lanes, acc);
+  float best = lanes[0];
+  for (int l = 1; l < 8; l++) {
+    if (max? lanes[l] > best : lanes[l] < best) {
+      best = lanes[l];
+    }
+  }
+  for (; i < n; i++) {
+    float v = fabsf(x[i]);
+    if (max? v > best : v < best) {
+      best = v;
+    }
+  }
+  return best;
+}
+
+static void vector_scal_avx(size_t n, float alpha, float *x) {
+  const __m256 va = _mm256_set1_ps(alpha);
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    _mm256_storeu_ps(x + i, _mm256_mul_ps(va, _mm256_loadu_ps(x + i)));
+    _mm256_storeu_ps(x + i + 8, _mm256_mul_ps(va, _mm256_loadu_ps(x + i + 8)));
+  }
+  for (; i < n; i++) {
+    x[i] *= alpha;
+  }
+}
+
+static void vector_swap_avx(size_t n, float *x, float *y) {
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256 vx = _mm256_loadu_ps(x + i);
+    _mm256_storeu_ps(x + i, _mm256_loadu_ps(y + i));
+    _mm256_storeu_ps(y + i, vx);
+  }
+  for (; i < n; i++) {
+    float tmp = x[i];
+    x[i] = y[i];
+    y[i] = tmp;
+  }
+}
+#endif
+
+#ifdef __ARM_NEON__
+static void vector_axpby_neon(size_t n, float alpha, const float *x,
+                              float beta, float *y) {
+  size_t i = 0;
+  if (beta == 0) {
+    for (; i + 8 <= n; i += 8) {
+      vst1q_f32(y + i, vmulq_n_f32(vld1q_f32(x + i), alpha));
+      vst1q_f32(y + i + 4, vmulq_n_f32(vld1q_f32(x + i + 4), alpha));
+    }
+  } else {
+    for (; i + 8 <= n; i += 8) {
+      float32x4_t y0 = vmulq_n_f32(vld1q_f32(y + i), beta);
+      float32x4_t y1 = vmulq_n_f32(vld1q_f32(y + i + 4), beta);
+      vst1q_f32(y + i, vmlaq_n_f32(y0, vld1q_f32(x + i), alpha));
+      vst1q_f32(y + i + 4, vmlaq_n_f32(y1, vld1q_f32(x + i + 4), alpha));
+    }
+  }
+  vector_axpby_novec(n - i, alpha, x + i, 1, beta, y + i, 1);
+}
+
+static float vector_dot_neon(size_t n, const float *x, const float *y) {
+  float32x4_t s0 = vdupq_n_f32(0.f), s1 = vdupq_n_f32(0.f);
+  float32x4_t s2 = vdupq_n_f32(0.f), s3 = vdupq_n_f32(0.f);
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    s0 = vmlaq_f32(s0, vld1q_f32(x + i), vld1q_f32(y + i));
+    s1 = vmlaq_f32(s1, vld1q_f32(x + i + 4), vld1q_f32(y + i + 4));
+    s2 = vmlaq_f32(s2, vld1q_f32(x + i + 8), vld1q_f32(y + i + 8));
+    s3 = vmlaq_f32(s3, vld1q_f32(x + i + 12), vld1q_f32(y + i + 12));
+  }
+  float sum = vector_hsum_neon(vaddq_f32(vaddq_f32(s0, s1),
+                                         vaddq_f32(s2, s3)));
+  return sum + vector_dot_novec(n - i, x + i, 1, y + i, 1);
+}
+
+static float vector_asum_neon(size_t n, const float *x) {
+  float32x4_t s0 = vdupq_n_f32(0.f), s1 = vdupq_n_f32(0.f);
+  float32x4_t s2 = vdupq_n_f32(0.f), s3 = vdupq_n_f32(0.f);
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    s0 = vaddq_f32(s0, vabsq_f32(vld1q_f32(x + i)));
+    s1 = vaddq_f32(s1, vabsq_f32(vld1q_f32(x + i + 4)));
+    s2 = vaddq_f32(s2, vabsq_f32(vld1q_f32(x + i + 8)));
+    s3 = vaddq_f32(s3, vabsq_f32(vld1q_f32(x + i + 12)));
+  }
+  float sum = vector_hsum_neon(vaddq_f32(vaddq_f32(s0, s1),
+                                         vaddq_f32(s2, s3)));
+  return sum + vector_asum_novec(n - i, x + i, 1);
+}
+
+/// @brief Returns the maximal (if max is set) or the minimal magnitude,
+/// skipping NaN-s.
+static float vector_extreme_magnitude_neon(size_t n, const float *x,
+                                           int max) {
+  float32x4_t acc = vdupq_n_f32(max? -1 : INFINITY);
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    float32x4_t v = vabsq_f32(vld1q_f32(x + i));
+    // The comparison is false for NaN-s, so they never get selected
+    uint32x4_t better = max? vcgtq_f32(v, acc) : vcltq_f32(v, acc);
+    acc = vbslq_f32(better, v, acc);
+  }
+  float lanes[4] __attribute__((aligned(16)));
+  vst1q_f32(lanes, acc);
+  float best = lanes[0];
+  for (int l = 1; l < 4; l++) {
+    if (max? lanes[l] > best : lanes[l] < best) {
+      best = lanes[l];
+    }
+  }
+  for (; i < n; i++) {
+    float v = fabsf(x[i]);
+    if (max? v > best : v < best) {
+      best = v;
+    }
+  }
+  return best;
+}
+
+/// @brief ARMv7 NEON has no double precision lanes, so the elements are
+/// scaled by a power of 2 close to the maximal magnitude if their squares
+/// may overflow or underflow.
+static float vector_nrm2_neon(size_t n, const float *x) {
+  float32x4_t m = vdupq_n_f32(0.f);
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    m = vmaxq_f32(m, vabsq_f32(vld1q_f32(x + i)));
+  }
+  float lanes[4] __attribute__((aligned(16)));
+  vst1q_f32(lanes, m);
+  float amax = fmaxf(fmaxf(lanes[0], lanes[1]), fmaxf(lanes[2], lanes[3]));
+  for (; i < n; i++) {
+    amax = fmaxf(amax, fabsf(x[i]));
+  }
+  if (amax == 0 || !isfinite(amax)) {
+    return vector_nrm2_novec(n, x, 1);
+  }
+  int exponent = ilogbf(amax);
+  if (exponent < -126) {
+    // Subnormal maximum, the scale would overflow
+    return vector_nrm2_novec(n, x, 1);
+  }
+  float scale = 1, unscale = 1;
+  if (exponent < -50 || exponent > 50) {
+    scale = ldexpf(1.f, -exponent);
+    unscale = ldexpf(1.f, exponent);
+  }
+  float32x4_t s0 = vdupq_n_f32(0.f), s1 = vdupq_n_f32(0.f);
+  for (i = 0; i + 8 <= n; i += 8) {
+    float32x4_t v0 = vmulq_n_f32(vld1q_f32(x + i), scale);
+    float32x4_t v1 = vmulq_n_f32(vld1q_f32(x + i + 4), scale);
+    s0 = vmlaq_f32(s0, v0, v0);
+    s1 = vmlaq_f32(s1, v1, v1);
+  }
+  float sum = vector_hsum_neon(vaddq_f32(s0, s1));
+  for (; i < n; i++) {
+    float v = x[i] * scale;
+    sum += v * v;
+  }
+  return sqrtf(sum) * unscale;
+}
+
+static void vector_scal_neon(size_t n, float alpha, float *x) {
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    vst1q_f32(x + i, vmulq_n_f32(vld1q_f32(x + i), alpha));
+    vst1q_f32(x + i + 4, vmulq_n_f32(vld1q_f32(x + i + 4), alpha));
+  }
+  for (; i < n; i++) {
+    x[i] *= alpha;
+  }
+}
+
+static void vector_swap_neon(size_t n, float *x, float *y) {
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    float32x4_t vx = vld1q_f32(x + i);
+    vst1q_f32(x + i, vld1q_f32(y + i));
+    vst1q_f32(y + i, vx);
+  }
+  for (; i < n; i++) {
+    float tmp = x[i];
+    x[i] = y[i];
+    y[i] = tmp;
+  }
+}
+#endif
+
+void vector_axpy(int simd, size_t n, float alpha,
+                 const float *x, size_t incx, float *y, size_t incy) {
+  vector_axpby(simd, n, alpha, x, incx, 1, y, incy);
+}
+
+void vector_axpby(int simd, size_t n, float alpha,
+                  const float *x, size_t incx, float beta,
+                  float *y, size_t incy) {
+  assert(x);
+  assert(y);
+  assert(incx > 0);
+  assert(incy > 0);
+  if (simd && incx == 1 && incy == 1) {
+#ifdef __ARM_NEON__
+    vector_axpby_neon(n, alpha, x, beta, y);
+  } else {
+#elif defined(__AVX__)
+    vector_axpby_avx(n, alpha, x, beta, y);
+  } else {
+#else
+  } {
+#endif
+    vector_axpby_novec(n, alpha, x, incx, beta, y, incy);
+  }
+}
+
+float vector_dot(int simd, size_t n, const float *x, size_t incx,
+                 const float *y, size_t incy) {
+  assert(x);
+  assert(y);
+  assert(incx > 0);
+  assert(incy > 0);
+  if (simd && incx == 1 && incy == 1) {
+#ifdef __ARM_NEON__
+    return vector_dot_neon(n, x, y);
+  } else {
+#elif defined(__AVX__)
+    return vector_dot_avx(n, x, y);
+  } else {
+#else
+  } {
+#endif
+    return vector_dot_novec(n, x, incx, y, incy);
+  }
+}
+
+float vector_nrm2(int simd, size_t n, const float *x, size_t incx) {
+  assert(x);
+  assert(incx > 0);
+  if (simd && incx == 1) {
+#ifdef __ARM_NEON__
+    return vector_nrm2_neon(n, x);
+  } else {
+#elif defined(__AVX__)
+    return vector_nrm2_avx(n, x);
+  } else {
+#else
+  } {
+#endif
+    return vector_nrm2_novec(n, x, incx);
+  }
+}
+
+float vector_asum(int simd, size_t n, const float *x, size_t incx) {
+  assert(x);
+  assert(incx > 0);
+  if (simd && incx == 1) {
+#ifdef __ARM_NEON__
+    return vector_asum_neon(n, x);
+  } else {
+#elif defined(__AVX__)
+    return vector_asum_avx(n, x);
+  } else {
+#else
+  } {
+#endif
+    return vector_asum_novec(n, x, incx);
+  }
+}
+
+/// @brief The extreme magnitude is found in the first pass and its first
+/// occurrence in the second one, which stops early.
+static int vector_iamax_iamin(int simd, size_t n, const float *x,
+                              size_t incx, int max) {
+  assert(x);
+  assert(incx > 0);
+  if (n == 0) {
+    return -1;
+  }
+  if (simd && incx == 1) {
+#ifdef __ARM_NEON__
+    return vector_find_magnitude(n, x,
+                                 vector_extreme_magnitude_neon(n, x, max));
+  } else {
+#elif defined(__AVX__)
+    return vector_find_magnitude(n, x,
+                                 vector_extreme_magnitude_avx(n, x, max));
+  } else {
+#else
+  } {
+#endif
+    return max? vector_iamax_novec(n, x, incx) :
+                vector_iamin_novec(n, x, incx);
+  }
+}
+
+int vector_iamax(int simd, size_t n, const float *x, size_t incx) {
+  return vector_iamax_iamin(simd, n, x, incx, 1);
+}
+
+int vector_iamin(int simd, size_t n, const float *x, size_t incx) {
+  return vector_iamax_iamin(simd, n, x, incx, 0);
+}
+
+void vector_scal(int simd, size_t n, float alpha, float *x, size_t incx) {
+  assert(x);
+  assert(incx > 0);
+  if (simd && incx == 1) {
+#ifdef __ARM_NEON__
+    vector_scal_neon(n, alpha, x);
+  } else {
+#elif defined(__AVX__)
+    vector_scal_avx(n, alpha, x);
+  } else {
+#else
+  } {
+#endif
+    for (size_t i = 0; i < n; i++) {
+      x[i * incx] *= alpha;
+    }
+  }
+}
+
+void vector_copy(int simd UNUSED, size_t n, const float *x, size_t incx,
+                 float *y, size_t incy) {
+  assert(x);
+  assert(y);
+  assert(incx > 0);
+  assert(incy > 0);
+  if (incx == 1 && incy == 1) {
+    memcpy(y, x, n * sizeof(float));
+    return;
+  }
+  for (size_t i = 0; i < n; i++) {
+    y[i * incy] = x[i * incx];
+  }
+}
+
+void vector_swap(int simd, size_t n, float *x, size_t incx,
+                 float *y, size_t incy) {
+  assert(x);
+  assert(y);
+  assert(incx > 0);
+  assert(incy > 0);
+  if (simd && incx == 1 && incy == 1) {
+#ifdef __ARM_NEON__
+    vector_swap_neon(n, x, y);
+  } else {
+#elif defined(__AVX__)
+    vector_swap_avx(n, x, y);
+  } else {
+#else
+  } {
+#endif
+    for (size_t i = 0; i < n; i++) {
+      float tmp = x[i * incx];
+      x[i * incx] = y[i * incy];
+      y[i * incy] = tmp;
+    }
+  }
+}
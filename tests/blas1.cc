@@ -0,0 +1,183 @@
+/*! @file blas1.cc
+ *  @brief Tests for vector.
+ *  @author Markovtsev Vadim <v.markovtsev@samsung.com>
+ *  @version 1.0
+ *
+ *  @section Notes
+ *  This code partially conforms to <a href="http://google-styleguide.googlecode.com/svn/trunk/cppguide.xml">Google C++ Style Guide</a>.
+ *
+ *  @section Copyright
+ *  Copyright © 2013 Samsung R&D Institute Russia
+ *
+ *  @section License
+ *  Licensed to the Apache Software Foundation (ASF) under one
+ *  or more contributor license agreements.  See the NOTICE file
+ *  distributed with this work for additional information
+ *  regarding copyright ownership.  The ASF licenses this file
+ *  to you under the Apache License, Version 2.0 (the
+ *  "License"); you may not use this file except in compliance
+ *  with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an
+ *  "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ *  KIND, either express or implied.  See the License for the
+ *  specific language governing permissions and limitations
+ *  under the License.
+ */
+
+
+#include <math.h>
+#include <simd/memory.h>
+#include <simd/vector.h>
+#include <gtest/gtest.h>
+
+class VectorTest : public ::testing::TestWithParam<int> {
+ protected:
+  virtual void SetUp() {
+    n_ = GetParam();
+    // Room for the stride of 3
+    x_ = mallocf(n_ * 3 + 1);
+    y_ = mallocf(n_ * 3 + 1);
+    for (int i = 0; i < n_ * 3 + 1; i++) {
+      x_[i] = (i * 7 % 23) - 11;
+      y_[i] = (i * 5 % 17) - 8;
+    }
+  }
+
+  virtual void TearDown() {
+    free(y_);
+    free(x_);
+  }
+
+  int n_;
+  float *x_;
+  float *y_;
+};
+
+TEST_P(VectorTest, Axpby) {
+  float *y = mallocf(n_ * 3 + 1);
+  for (int inc = 1; inc <= 3; inc += 2) {
+    for (float beta : { 0.f, 1.f, -0.5f }) {
+      for (int simd = 0; simd < 2; simd++) {
+        memcpy(y, y_, (n_ * 3 + 1) * sizeof(float));
+        if (beta == 1) {
+          vector_axpy(simd, n_, 2, x_, inc, y, inc);
+        } else {
+          vector_axpby(simd, n_, 2, x_, inc, beta, y, inc);
+        }
+        for (int i = 0; i < n_; i++) {
+          ASSERT_EQ(2 * x_[i * inc] + beta * y_[i * inc], y[i * inc])
+              << inc << " " << beta << " " << simd << " " << i;
+        }
+        // The gaps are not touched
+        for (int i = 0; i < n_ * inc; i++) {
+          if (i % inc != 0) {
+            ASSERT_EQ(y_[i], y[i]);
+          }
+        }
+      }
+    }
+  }
+  free(y);
+}
+
+TEST_P(VectorTest, Reductions) {
+  for (int inc = 1; inc <= 3; inc += 2) {
+    float dot = 0, asum = 0;
+    double nrm2 = 0;
+    for (int i = 0; i < n_; i++) {
+      dot += x_[i * inc] * y_[i * inc];
+      asum += fabsf(x_[i * inc]);
+      nrm2 += x_[i * inc] * x_[i * inc];
+    }
+    nrm2 = sqrt(nrm2);
+    for (int simd = 0; simd < 2; simd++) {
+      ASSERT_EQ(dot, vector_dot(simd, n_, x_, inc, y_, inc));
+      ASSERT_EQ(asum, vector_asum(simd, n_, x_, inc));
+      ASSERT_NEAR(nrm2, vector_nrm2(simd, n_, x_, inc), nrm2 * 1E-6);
+    }
+  }
+}
+
+TEST_P(VectorTest, IndexOfExtremum) {
+  for (int inc = 1; inc <= 3; inc += 2) {
+    int imax = n_ > 0? 0 : -1, imin = imax;
+    for (int i = 1; i < n_; i++) {
+      if (fabsf(x_[i * inc]) > fabsf(x_[imax * inc])) {
+        imax = i;
+      }
+      if (fabsf(x_[i * inc]) < fabsf(x_[imin * inc])) {
+        imin = i;
+      }
+    }
+    for (int simd = 0; simd < 2; simd++) {
+      ASSERT_EQ(imax, vector_iamax(simd, n_, x_, inc)) << inc << simd;
+      ASSERT_EQ(imin, vector_iamin(simd, n_, x_, inc)) << inc << simd;
+    }
+  }
+}
+
+TEST_P(VectorTest, ScalCopySwap) {
+  float *x = mallocf(n_ * 3 + 1);
+  float *y = mallocf(n_ * 3 + 1);
+  for (int inc = 1; inc <= 3; inc += 2) {
+    for (int simd = 0; simd < 2; simd++) {
+      memcpy(x, x_, (n_ * 3 + 1) * sizeof(float));
+      memcpy(y, y_, (n_ * 3 + 1) * sizeof(float));
+      vector_scal(simd, n_, -3, x, inc);
+      for (int i = 0; i < n_; i++) {
+        ASSERT_EQ(-3 * x_[i * inc], x[i * inc]);
+      }
+      vector_swap(simd, n_, x, inc, y, inc);
+      for (int i = 0; i < n_; i++) {
+        ASSERT_EQ(-3 * x_[i * inc], y[i * inc]);
+        ASSERT_EQ(y_[i * inc], x[i * inc]);
+      }
+      vector_copy(simd, n_, x_, inc, y, 1);
+      for (int i = 0; i < n_; i++) {
+        ASSERT_EQ(x_[i * inc], y[i]);
+      }
+    }
+  }
+  free(y);
+  free(x);
+}
+
+INSTANTIATE_TEST_CASE_P(
+    Lengths, VectorTest,
+    ::testing::Values(0, 1, 7, 8, 31, 33, 1000));
+
+TEST(Vector, Nrm2Scaling) {
+  const int n = 100;
+  float x[n];
+  for (float scale : { 1E-30f, 1E30f, 1E-40f }) {
+    for (int i = 0; i < n; i++) {
+      x[i] = scale * (i % 3 + 1);
+    }
+    // sqrt(34 * 1 + 33 * 4 + 33 * 9)
+    float expected = scale * sqrtf(463);
+    for (int simd = 0; simd < 2; simd++) {
+      ASSERT_NEAR(expected, vector_nrm2(simd, n, x, 1), expected * 1E-5)
+          << scale << " " << simd;
+    }
+  }
+}
+
+TEST(Vector, ExtremumSkipsNaN) {
+  float x[20];
+  for (int i = 0; i < 20; i++) {
+    x[i] = i - 10;
+  }
+  x[0] = NAN;
+  x[13] = NAN;
+  for (int simd = 0; simd < 2; simd++) {
+    ASSERT_EQ(1, vector_iamax(simd, 20, x, 1));
+    ASSERT_EQ(10, vector_iamin(simd, 20, x, 1));
+    ASSERT_EQ(-1, vector_iamax(simd, 0, x, 1));
+  }
+}
+
+#include "tests/google/src/gtest_main.cc"
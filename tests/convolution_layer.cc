@@ -0,0 +1,129 @@
+/*! @file convolution_layer.cc
+ *  @brief Tests for convolution_layer.
+ *  @author Markovtsev Vadim <v.markovtsev@samsung.com>
+ *  @version 1.0
+ *
+ *  @section Notes
+ *  This code partially conforms to <a href="http://google-styleguide.googlecode.com/svn/trunk/cppguide.xml">Google C++ Style Guide</a>.
+ *
+ *  @section Copyright
+ *  Copyright © 2013 Samsung R&D Institute Russia
+ *
+ *  @section License
+ *  Licensed to the Apache Software Foundation (ASF) under one
+ *  or more contributor license agreements.  See the NOTICE file
+ *  distributed with this work for additional information
+ *  regarding copyright ownership.  The ASF licenses this file
+ *  to you under the Apache License, Version 2.0 (the
+ *  "License"); you may not use this file except in compliance
+ *  with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an
+ *  "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ *  KIND, either express or implied.  See the License for the
+ *  specific language governing permissions and limitations
+ *  under the License.
+ */
+
+
+#include <math.h>
+#include <simd/convolution_layer.h>
+#include <simd/memory.h>
+#include <gtest/gtest.h>
+
+void convolution_layer_reference(const float *input, int channels, int width,
+                                 int height, const float *weights,
+                                 const float *bias, int outChannels, int k,
+                                 int stride, int padding, float *output) {
+  int ow = convolution_layer_output_size(width, k, stride, padding);
+  int oh = convolution_layer_output_size(height, k, stride, padding);
+  for (int o = 0; o < outChannels; o++) {
+    for (int y = 0; y < oh; y++) {
+      for (int x = 0; x < ow; x++) {
+        double sum = bias? bias[o] : 0;
+        for (int ky = 0; ky < k; ky++) {
+          for (int kx = 0; kx < k; kx++) {
+            int iy = y * stride + ky - padding;
+            int ix = x * stride + kx - padding;
+            if (iy < 0 || iy >= height || ix < 0 || ix >= width) {
+              continue;
+            }
+            for (int c = 0; c < channels; c++) {
+              sum += input[(c * height + iy) * width + ix] *
+                  weights[((ky * k + kx) * channels + c) * outChannels + o];
+            }
+          }
+        }
+        output[(o * oh + y) * ow + x] = sum;
+      }
+    }
+  }
+}
+
+struct LayerParams {
+  int channels, width, height, outChannels, kernelSize, stride, padding;
+};
+
+class ConvolutionLayerTest : public ::testing::TestWithParam<LayerParams> {
+};
+
+TEST_P(ConvolutionLayerTest, Reference) {
+  auto p = GetParam();
+  int ow = convolution_layer_output_size(p.width, p.kernelSize, p.stride,
+                                         p.padding);
+  int oh = convolution_layer_output_size(p.height, p.kernelSize, p.stride,
+                                         p.padding);
+  int inputSize = p.channels * p.width * p.height;
+  int weightsSize = p.kernelSize * p.kernelSize * p.channels * p.outChannels;
+  int outputSize = p.outChannels * ow * oh;
+  float *input = mallocf(inputSize);
+  float *weights = mallocf(weightsSize);
+  float *bias = mallocf(p.outChannels);
+  for (int i = 0; i < inputSize; i++) {
+    input[i] = sinf(i * 0.1f);
+  }
+  for (int i = 0; i < weightsSize; i++) {
+    weights[i] = cosf(i * 0.7f) / p.kernelSize;
+  }
+  for (int i = 0; i < p.outChannels; i++) {
+    bias[i] = i * 0.25f - 1;
+  }
+  float *verif = mallocf(outputSize);
+  float *output = mallocf(outputSize);
+  for (int withBias = 0; withBias < 2; withBias++) {
+    convolution_layer_reference(input, p.channels, p.width, p.height, weights,
+                                withBias? bias : nullptr, p.outChannels,
+                                p.kernelSize, p.stride, p.padding, verif);
+    for (int simd = 0; simd < 2; simd++) {
+      memsetf(output, 1000.f, outputSize);
+      convolution_layer(simd, input, p.channels, p.width, p.height, weights,
+                        withBias? bias : nullptr, p.outChannels, p.kernelSize,
+                        p.stride, p.padding, output);
+      for (int i = 0; i < outputSize; i++) {
+        ASSERT_NEAR(verif[i], output[i], 1E-4) << i;
+      }
+    }
+  }
+  free(output);
+  free(verif);
+  free(bias);
+  free(weights);
+  free(input);
+}
+
+INSTANTIATE_TEST_CASE_P(
+    ConvolutionLayerTests, ConvolutionLayerTest, ::testing::Values(
+        LayerParams { 1, 8, 8, 1, 3, 1, 0 },
+        LayerParams { 3, 32, 24, 16, 3, 1, 1 },
+        LayerParams { 4, 29, 17, 5, 5, 2, 2 },
+        LayerParams { 8, 64, 64, 12, 3, 1, 1 },
+        LayerParams { 2, 10, 7, 3, 1, 3, 0 },
+        LayerParams { 3, 15, 15, 4, 7, 2, 3 },
+        // The kernel is wider than the padded input
+        LayerParams { 2, 1, 6, 3, 5, 1, 2 },
+        LayerParams { 3, 2, 1, 2, 7, 1, 3 }));
+
+#include "tests/google/src/gtest_main.cc"
@@ -29,12 +29,13 @@
  */
 
 #include <gtest/gtest.h>
-#ifndef NO_FFTF
 #include <cmath>
 #include <simd/convolve.h>
 #include <simd/memory.h>
 #include <simd/arithmetic-inl.h>
+#ifndef NO_FFTF
 #include <fftf/api.h>
+#endif
 
 void convolve_reference(const float *__restrict x, size_t xLength,
                         const float *__restrict h, size_t hLength,
@@ -70,8 +71,8 @@ TEST(convolve, convolve_reference) {
   ASSERT_NEAR(z[10], 56, 0.0001f);
 }
 
-TEST(convolve, convolve_fft) {
-  const int xlen = 1020;
+TEST(convolve, convolve_simd) {
+  const int xlen = 1024;
   const int hlen = 50;
 
   float x[xlen];
@@ -80,18 +81,14 @@ TEST(convolve, convolve_fft) {
   }
   float h[hlen];
   for (int i = 0; i < hlen; i++) {
-    h[i] = i / (hlen- 1.0f);
+    h[i] = i / (hlen - 1.0f);
   }
 
   float verif[xlen + hlen - 1];
   convolve_reference(x, xlen, h, hlen, verif);
-  DebugPrintConvolution("REFERENCE", verif);
 
   float res[xlen + hlen - 1];
-  auto handle = convolve_fft_initialize(xlen, hlen);
-  convolve_fft(handle, x, h, res);
-  convolve_fft_finalize(handle);
-  DebugPrintConvolution("FFT\t", res);
+  convolve_simd(true, x, xlen, h, hlen, res);
 
   int firstDifferenceIndex = -1;
   for (int i = 0; i < xlen + hlen - 1; i++) {
@@ -103,8 +100,41 @@ TEST(convolve, convolve_fft) {
   ASSERT_EQ(-1, firstDifferenceIndex);
 }
 
-TEST(convolve, convolve_overlap_save) {
-  const int xlen = 1021;
+TEST(convolve, convolve_simd_double) {
+  const int xlen = 1023;
+  const int hlen = 51;
+
+  double x[xlen];
+  for (int i = 0; i < xlen; i++) {
+    x[i] = sin(i) * 100;
+  }
+  double h[hlen];
+  for (int i = 0; i < hlen; i++) {
+    h[i] = i / (hlen - 1.0);
+  }
+
+  double verif[xlen + hlen - 1];
+  for (int i = 0; i < xlen + hlen - 1; i++) {
+    verif[i] = 0;
+    for (int k = 0; k < hlen; k++) {
+      if (i - k >= 0 && i - k < xlen) {
+        verif[i] += x[i - k] * h[k];
+      }
+    }
+  }
+  double res[xlen + hlen - 1];
+  for (int simd = 0; simd < 2; simd++) {
+    convolve_simd_double(simd, x, xlen, h, hlen, res);
+    for (int i = 0; i < xlen + hlen - 1; i++) {
+      ASSERT_NEAR(verif[i], res[i], 1E-10) << simd << " " << i;
+    }
+  }
+}
+
+#ifndef NO_FFTF
+
+TEST(convolve, convolve_fft) {
+  const int xlen = 1020;
   const int hlen = 50;
 
   float x[xlen];
@@ -121,10 +151,10 @@ TEST(convolve, convolve_overlap_save) {
   DebugPrintConvolution("REFERENCE", verif);
 
   float res[xlen + hlen - 1];
-  auto handle = convolve_overlap_save_initialize(xlen, hlen);
-  convolve_overlap_save(handle, x, h, res);
-  convolve_overlap_save_finalize(handle);
-  DebugPrintConvolution("OVERLAP-SAVE", res);
+  auto handle = convolve_fft_initialize(xlen, hlen);
+  convolve_fft(handle, x, h, res);
+  convolve_fft_finalize(handle);
+  DebugPrintConvolution("FFT\t", res);
 
   int firstDifferenceIndex = -1;
   for (int i = 0; i < xlen + hlen - 1; i++) {
@@ -136,8 +166,8 @@ TEST(convolve, convolve_overlap_save) {
   ASSERT_EQ(-1, firstDifferenceIndex);
 }
 
-TEST(convolve, convolve_simd) {
-  const int xlen = 1024;
+TEST(convolve, convolve_overlap_save) {
+  const int xlen = 1021;
   const int hlen = 50;
 
   float x[xlen];
@@ -146,14 +176,18 @@ TEST(convolve, convolve_simd) {
   }
   float h[hlen];
   for (int i = 0; i < hlen; i++) {
-    h[i] = i / (hlen - 1.0f);
+    h[i] = i / (hlen- 1.0f);
   }
 
   float verif[xlen + hlen - 1];
   convolve_reference(x, xlen, h, hlen, verif);
+  DebugPrintConvolution("REFERENCE", verif);
 
   float res[xlen + hlen - 1];
-  convolve_simd(true, x, xlen, h, hlen, res);
+  auto handle = convolve_overlap_save_initialize(xlen, hlen);
+  convolve_overlap_save(handle, x, h, res);
+  convolve_overlap_save_finalize(handle);
+  DebugPrintConvolution("OVERLAP-SAVE", res);
 
   int firstDifferenceIndex = -1;
   for (int i = 0; i < xlen + hlen - 1; i++) {
@@ -0,0 +1,170 @@
+/*! @file convolve2D.cc
+ *  @brief Tests for 2D convolution.
+ *  @author Markovtsev Vadim <v.markovtsev@samsung.com>
+ *  @version 1.0
+ *
+ *  @section Notes
+ *  This code partially conforms to <a href="http://google-styleguide.googlecode.com/svn/trunk/cppguide.xml">Google C++ Style Guide</a>.
+ *
+ *  @section Copyright
+ *  Copyright © 2013 Samsung R&D Institute Russia
+ *
+ *  @section License
+ *  Licensed to the Apache Software Foundation (ASF) under one
+ *  or more contributor license agreements.  See the NOTICE file
+ *  distributed with this work for additional information
+ *  regarding copyright ownership.  The ASF licenses this file
+ *  to you under the Apache License, Version 2.0 (the
+ *  "License"); you may not use this file except in compliance
+ *  with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an
+ *  "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ *  KIND, either express or implied.  See the License for the
+ *  specific language governing permissions and limitations
+ *  under the License.
+ */
+
+
+#include <math.h>
+#include <simd/convolve2D.h>
+#include <gtest/gtest.h>
+
+int reference_index(int i, int length, ExtensionType ext) {
+  while (i < 0 || i >= length) {
+    switch (ext) {
+      case EXTENSION_TYPE_PERIODIC:
+        i = i < 0? i + length : i - length;
+        break;
+      case EXTENSION_TYPE_MIRROR:
+        i = i < 0? -i - 1 : 2 * length - 1 - i;
+        break;
+      case EXTENSION_TYPE_CONSTANT:
+        i = i < 0? 0 : length - 1;
+        break;
+      case EXTENSION_TYPE_ZERO:
+        return -1;
+    }
+  }
+  return i;
+}
+
+void convolve2D_reference(const float *src, int stride, int width, int height,
+                          const float *kernel, int kw, int kh,
+                          ExtensionType ext, float *dst) {
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      double sum = 0;
+      for (int i = 0; i < kh; i++) {
+        for (int j = 0; j < kw; j++) {
+          int sy = reference_index(y + kh / 2 - i, height, ext);
+          int sx = reference_index(x + kw / 2 - j, width, ext);
+          if (sy >= 0 && sx >= 0) {
+            sum += kernel[i * kw + j] * src[sy * stride + sx];
+          }
+        }
+      }
+      dst[y * width + x] = sum;
+    }
+  }
+}
+
+class Convolve2DTest : public ::testing::TestWithParam<ExtensionType> {
+ protected:
+  static const int kWidth = 45;
+  static const int kHeight = 31;
+  static const int kStride = 48;
+
+  virtual void SetUp() override {
+    for (int i = 0; i < kHeight * kStride; i++) {
+      src_[i] = sinf(i * 0.37f) + (i % 7) * 0.1f;
+    }
+  }
+
+  void Check(const float *kernel, int kw, int kh) {
+    float verif[kWidth * kHeight];
+    convolve2D_reference(src_, kStride, kWidth, kHeight, kernel, kw, kh,
+                         GetParam(), verif);
+    float res[kHeight * kStride];
+    auto handle = convolve2D_initialize(kWidth, kHeight, kernel, kw, kh,
+                                        GetParam());
+    convolve2D(handle, src_, kStride, res, kStride);
+    convolve2D_finalize(handle);
+    for (int y = 0; y < kHeight; y++) {
+      for (int x = 0; x < kWidth; x++) {
+        ASSERT_NEAR(verif[y * kWidth + x], res[y * kStride + x], 1E-3)
+            << x << ", " << y;
+      }
+    }
+    for (int simd = 0; simd < 2; simd++) {
+      convolve2D_simd(simd, src_, kStride, kWidth, kHeight, kernel, kw, kh,
+                      GetParam(), res, kStride);
+      for (int y = 0; y < kHeight; y++) {
+        for (int x = 0; x < kWidth; x++) {
+          ASSERT_NEAR(verif[y * kWidth + x], res[y * kStride + x], 1E-3)
+              << x << ", " << y;
+        }
+      }
+    }
+  }
+
+  float src_[kHeight * kStride];
+};
+
+TEST_P(Convolve2DTest, Separable) {
+  const float row[] = { 1, 4, 6, 4, 1 };
+  const float column[] = { -1, 0, 2 };
+  float kernel[3 * 5];
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j < 5; j++) {
+      kernel[i * 5 + j] = column[i] * row[j] / 16;
+    }
+  }
+  Check(kernel, 5, 3);
+
+  float verif[kWidth * kHeight];
+  convolve2D_reference(src_, kStride, kWidth, kHeight, kernel, 5, 3,
+                       GetParam(), verif);
+  for (int simd = 0; simd < 2; simd++) {
+    float res[kHeight * kStride];
+    memcpy(res, src_, sizeof(src_));
+    // In place
+    convolve2D_separable(simd, res, kStride, kWidth, kHeight, row, 5,
+                         column, 3, GetParam(), res, kStride);
+    for (int y = 0; y < kHeight; y++) {
+      for (int x = 0; x < kWidth; x++) {
+        ASSERT_NEAR(verif[y * kWidth + x] * 16, res[y * kStride + x], 1E-3)
+            << x << ", " << y;
+      }
+    }
+  }
+}
+
+TEST_P(Convolve2DTest, Direct) {
+  const float sobel[] = { 1, 2, 1, 0, 0, 0, -1, -2, -1 };
+  Check(sobel, 3, 3);
+  const float laplace[] = { 0, 1, 0, 1, -4, 1, 0, 1, 0 };
+  Check(laplace, 3, 3);
+  const float asymmetric[] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+  Check(asymmetric, 4, 2);
+}
+
+TEST_P(Convolve2DTest, FFT) {
+  const int kw = 17, kh = 15;
+  float kernel[kw * kh];
+  for (int i = 0; i < kw * kh; i++) {
+    kernel[i] = cosf(i * 1.3f) / (kw * kh);
+  }
+  Check(kernel, kw, kh);
+}
+
+INSTANTIATE_TEST_CASE_P(Convolve2DTests, Convolve2DTest,
+                        ::testing::Values(EXTENSION_TYPE_PERIODIC,
+                                          EXTENSION_TYPE_MIRROR,
+                                          EXTENSION_TYPE_CONSTANT,
+                                          EXTENSION_TYPE_ZERO));
+
+#include "tests/google/src/gtest_main.cc"
@@ -29,12 +29,13 @@
  */
 
 #include <gtest/gtest.h>
-#ifndef NO_FFTF
 #include <cmath>
 #include <simd/correlate.h>
 #include <simd/memory.h>
 #include <simd/arithmetic-inl.h>
+#ifndef NO_FFTF
 #include <fftf/api.h>
+#endif
 
 void cross_correlate_reference(const float *__restrict x, size_t xLength,
                          const float *__restrict h, size_t hLength,
@@ -70,6 +71,64 @@ TEST(correlate, cross_correlate_reference) {
   ASSERT_NEAR(z[10], 80, 0.0001f);
 }
 
+TEST(correlate, cross_correlate_simd) {
+  const int xlen = 1024;
+  const int hlen = 50;
+
+  float x[xlen];
+  for (int i = 0; i < xlen; i++) {
+    x[i] = sinf(i) * 100;
+  }
+  float h[hlen];
+  for (int i = 0; i < hlen; i++) {
+    h[i] = i / (hlen - 1.0f);
+  }
+
+  float verif[xlen + hlen - 1];
+  cross_correlate_reference(x, xlen, h, hlen, verif);
+
+  float res[xlen + hlen - 1];
+  cross_correlate_simd(true, x, xlen, h, hlen, res);
+
+  for (int i = 0; i < xlen + hlen - 1; i++) {
+    ASSERT_NEAR(res[i], verif[i], 1E-3) << i;
+  }
+}
+
+TEST(correlate, cross_correlate_simd_double) {
+  const int xlen = 1023;
+  const int hlen = 51;
+
+  double x[xlen];
+  for (int i = 0; i < xlen; i++) {
+    x[i] = sin(i) * 100;
+  }
+  double h[hlen];
+  for (int i = 0; i < hlen; i++) {
+    h[i] = i / (hlen - 1.0);
+  }
+
+  double verif[xlen + hlen - 1];
+  for (int i = 0; i < xlen + hlen - 1; i++) {
+    verif[i] = 0;
+    for (int m = 0; m < xlen; m++) {
+      int k = m + hlen - 1 - i;
+      if (k >= 0 && k < hlen) {
+        verif[i] += x[m] * h[k];
+      }
+    }
+  }
+  double res[xlen + hlen - 1];
+  for (int simd = 0; simd < 2; simd++) {
+    cross_correlate_simd_double(simd, x, xlen, h, hlen, res);
+    for (int i = 0; i < xlen + hlen - 1; i++) {
+      ASSERT_NEAR(verif[i], res[i], 1E-10) << simd << " " << i;
+    }
+  }
+}
+
+#ifndef NO_FFTF
+
 TEST(correlate, cross_correlate_fft) {
   const int xlen = 1020;
   const int hlen = 50;
@@ -127,27 +186,56 @@ TEST(correlate, cross_correlate_overlap_save) {
   }
 }
 
-TEST(correlate, cross_correlate_simd) {
-  const int xlen = 1024;
-  const int hlen = 50;
+TEST(correlate, cross_correlate_batch) {
+  const int xlen = 300;
+  const int hlen = 40;
+  const int count = 7;
 
-  float x[xlen];
-  for (int i = 0; i < xlen; i++) {
-    x[i] = sinf(i) * 100;
-  }
   float h[hlen];
   for (int i = 0; i < hlen; i++) {
-    h[i] = i / (hlen - 1.0f);
+    h[i] = sinf(i * 0.3f);
+  }
+  float signals[count][xlen];
+  const float *x[count];
+  for (int s = 0; s < count; s++) {
+    for (int i = 0; i < xlen; i++) {
+      signals[s][i] = cosf(i * (s + 1)) * 0.1f;
+    }
+    // Hide the template at a different offset in every signal
+    for (int i = 0; i < hlen; i++) {
+      signals[s][s * 37 + i] += h[i];
+    }
+    x[s] = signals[s];
   }
 
-  float verif[xlen + hlen - 1];
-  cross_correlate_reference(x, xlen, h, hlen, verif);
-
-  float res[xlen + hlen - 1];
-  cross_correlate_simd(true, x, xlen, h, hlen, res);
+  float res[count][xlen + hlen - 1];
+  float *results[count];
+  for (int s = 0; s < count; s++) {
+    results[s] = res[s];
+  }
+  float maxValues[count];
+  int maxLags[count];
+  // 7 signals do not fit evenly into batches of 3
+  auto handle = cross_correlate_batch_initialize(xlen, h, hlen, 3);
+  cross_correlate_batch(handle, x, count, results, maxValues, maxLags);
+  float maxOnly[count];
+  cross_correlate_batch(handle, x, count, nullptr, maxOnly, nullptr);
+  cross_correlate_batch_finalize(handle);
 
-  for (int i = 0; i < xlen + hlen - 1; i++) {
-    ASSERT_NEAR(res[i], verif[i], 1E-3) << i;
+  float verif[xlen + hlen - 1];
+  for (int s = 0; s < count; s++) {
+    cross_correlate_reference(x[s], xlen, h, hlen, verif);
+    int lag = 0;
+    for (int i = 0; i < xlen + hlen - 1; i++) {
+      ASSERT_NEAR(res[s][i], verif[i], 1E-3) << s << " " << i;
+      if (verif[i] > verif[lag]) {
+        lag = i;
+      }
+    }
+    EXPECT_EQ(s * 37, maxLags[s]);
+    EXPECT_EQ(lag - (hlen - 1), maxLags[s]);
+    EXPECT_NEAR(verif[lag], maxValues[s], 1E-3);
+    EXPECT_FLOAT_EQ(maxValues[s], maxOnly[s]);
   }
 }
 
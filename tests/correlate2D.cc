@@ -0,0 +1,169 @@
+/*! @file correlate2D.cc
+ *  @brief Tests for 2D cross-correlation.
+ *  @author Markovtsev Vadim <v.markovtsev@samsung.com>
+ *  @version 1.0
+ *
+ *  @section Notes
+ *  This code partially conforms to <a href="http://google-styleguide.googlecode.com/svn/trunk/cppguide.xml">Google C++ Style Guide</a>.
+ *
+ *  @section Copyright
+ *  Copyright © 2013 Samsung R&D Institute Russia
+ *
+ *  @section License
+ *  Licensed to the Apache Software Foundation (ASF) under one
+ *  or more contributor license agreements.  See the NOTICE file
+ *  distributed with this work for additional information
+ *  regarding copyright ownership.  The ASF licenses this file
+ *  to you under the Apache License, Version 2.0 (the
+ *  "License"); you may not use this file except in compliance
+ *  with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an
+ *  "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ *  KIND, either express or implied.  See the License for the
+ *  specific language governing permissions and limitations
+ *  under the License.
+ */
+
+
+#include <math.h>
+#include <simd/correlate2D.h>
+#include <gtest/gtest.h>
+
+void correlate2D_reference(const float *src, int stride, int width,
+                           int height, const float *templ, int tw, int th,
+                           bool normalized, float *dst) {
+  double tmean = 0;
+  for (int i = 0; i < tw * th; i++) {
+    tmean += templ[i];
+  }
+  tmean /= tw * th;
+  for (int y = 0; y <= height - th; y++) {
+    for (int x = 0; x <= width - tw; x++) {
+      double mean = 0;
+      for (int i = 0; i < th; i++) {
+        for (int j = 0; j < tw; j++) {
+          mean += src[(y + i) * stride + x + j];
+        }
+      }
+      mean /= tw * th;
+      double dot = 0, snorm = 0, tnorm = 0;
+      for (int i = 0; i < th; i++) {
+        for (int j = 0; j < tw; j++) {
+          double s = src[(y + i) * stride + x + j];
+          double t = templ[i * tw + j];
+          if (normalized) {
+            s -= mean;
+            t -= tmean;
+          }
+          dot += s * t;
+          snorm += s * s;
+          tnorm += t * t;
+        }
+      }
+      dst[y * (width - tw + 1) + x] =
+          normalized? dot / sqrt(snorm * tnorm) : dot;
+    }
+  }
+}
+
+class Correlate2DTest : public ::testing::TestWithParam<bool> {
+ protected:
+  static const int kWidth = 70;
+  static const int kHeight = 50;
+  static const int kStride = 72;
+
+  virtual void SetUp() override {
+    for (int i = 0; i < kHeight * kStride; i++) {
+      src_[i] = sinf(i * 0.61f) * 40 + (i % 13) + 100;
+    }
+  }
+
+  void Check(int tw, int th, int tx, int ty) {
+    float templ[tw * th];
+    for (int i = 0; i < th; i++) {
+      for (int j = 0; j < tw; j++) {
+        templ[i * tw + j] = src_[(ty + i) * kStride + tx + j];
+      }
+    }
+    int ow = kWidth - tw + 1, oh = kHeight - th + 1;
+    float verif[ow * oh];
+    correlate2D_reference(src_, kStride, kWidth, kHeight, templ, tw, th,
+                          GetParam(), verif);
+    float res[oh * kStride];
+    auto handle = cross_correlate2D_initialize(kWidth, kHeight, templ, tw, th,
+                                               GetParam());
+    cross_correlate2D(handle, src_, kStride, res, kStride);
+    cross_correlate2D_finalize(handle);
+    int best = 0;
+    float tolerance = GetParam()? 1E-3 : 1E-4 * verif[0];
+    for (int y = 0; y < oh; y++) {
+      for (int x = 0; x < ow; x++) {
+        ASSERT_NEAR(verif[y * ow + x], res[y * kStride + x], tolerance)
+            << x << ", " << y;
+        if (res[y * kStride + x] > res[best]) {
+          best = y * kStride + x;
+        }
+      }
+    }
+    if (GetParam()) {
+      EXPECT_NEAR(1, res[ty * kStride + tx], 1E-3);
+      EXPECT_EQ(ty * kStride + tx, best);
+    }
+  }
+
+  float src_[kHeight * kStride];
+};
+
+TEST_P(Correlate2DTest, Direct) {
+  Check(5, 4, 31, 17);
+}
+
+TEST_P(Correlate2DTest, FFT) {
+  Check(16, 12, 9, 30);
+}
+
+TEST_P(Correlate2DTest, ConstantWindows) {
+  float plane[16 * 16];
+  for (int i = 0; i < 16 * 16; i++) {
+    plane[i] = i < 16 * 8? 3 : i % 5;
+  }
+  float templ[4 * 4];
+  for (int i = 0; i < 16; i++) {
+    templ[i] = i % 3;
+  }
+  float res[13 * 13];
+  auto handle = cross_correlate2D_initialize(16, 16, templ, 4, 4, true);
+  cross_correlate2D(handle, plane, 16, res, 13);
+  cross_correlate2D_finalize(handle);
+  for (int i = 0; i < 13 * 5; i++) {
+    EXPECT_EQ(0, res[i]) << i;
+  }
+  for (int i = 0; i < 13 * 13; i++) {
+    EXPECT_LE(fabsf(res[i]), 1.0001f) << i;
+  }
+}
+
+TEST(Correlate2D, cross_correlate2D_simd) {
+  const int width = 37, height = 21;
+  float plane[width * height];
+  for (int i = 0; i < width * height; i++) {
+    plane[i] = cosf(i);
+  }
+  const float templ[] = { 1, -2, 3, 0.5f, 0, -1 };
+  float res[2][(width - 2) * (height - 1)];
+  for (int simd = 0; simd < 2; simd++) {
+    cross_correlate2D_simd(simd, plane, width, width, height, templ, 3, 2,
+                           res[simd], width - 2);
+  }
+  for (int i = 0; i < (width - 2) * (height - 1); i++) {
+    ASSERT_NEAR(res[0][i], res[1][i], 1E-5) << i;
+  }
+}
+
+INSTANTIATE_TEST_CASE_P(Correlate2DTests, Correlate2DTest, ::testing::Bool());
+
+#include "tests/google/src/gtest_main.cc"
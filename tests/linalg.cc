@@ -0,0 +1,329 @@
+/*! @file linalg.cc
+ *  @brief Tests for linalg.
+ *  @author Markovtsev Vadim <v.markovtsev@samsung.com>
+ *  @version 1.0
+ *
+ *  @section Notes
+ *  This code partially conforms to <a href="http://google-styleguide.googlecode.com/svn/trunk/cppguide.xml">Google C++ Style Guide</a>.
+ *
+ *  @section Copyright
+ *  Copyright © 2013 Samsung R&D Institute Russia
+ *
+ *  @section License
+ *  Licensed to the Apache Software Foundation (ASF) under one
+ *  or more contributor license agreements.  See the NOTICE file
+ *  distributed with this work for additional information
+ *  regarding copyright ownership.  The ASF licenses this file
+ *  to you under the Apache License, Version 2.0 (the
+ *  "License"); you may not use this file except in compliance
+ *  with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an
+ *  "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ *  KIND, either express or implied.  See the License for the
+ *  specific language governing permissions and limitations
+ *  under the License.
+ */
+
+
+#include <math.h>
+#include <vector>
+#include <simd/memory.h>
+#include <simd/linalg.h>
+#include <simd/matrix.h>
+#include <gtest/gtest.h>
+
+/// @brief Deterministic pseudo random numbers in [-1, 1).
+static float next_random(unsigned *state) {
+  *state = *state * 1103515245 + 12345;
+  return ((*state >> 8) & 0xFFFF) / 32768.f - 1;
+}
+
+/// @brief Fills a well conditioned triangular matrix; the other triangle
+/// is filled with garbage which must not be read.
+static void fill_triangular(float *t, int n, int ld, int lower) {
+  unsigned state = n;
+  for (int i = 0; i < n; i++) {
+    for (int j = 0; j < ld; j++) {
+      bool inside = lower? j < i : j > i && j < n;
+      t[i * ld + j] = inside? next_random(&state) / n : NAN;
+    }
+    t[i * ld + i] = 2 + next_random(&state);
+  }
+}
+
+/// @brief op(T)[i][k], the unit diagonal and the triangle being applied.
+static double op_element(const float *t, int ld, int lower, int trans,
+                         int unit, int i, int k) {
+  if (trans) {
+    std::swap(i, k);
+  }
+  if (i == k) {
+    return unit? 1 : t[i * ld + i];
+  }
+  return (lower? k < i : k > i)? t[i * ld + k] : 0;
+}
+
+TEST(Linalg, Trsm) {
+  const int m = 150, n = 37, pad = 3;
+  for (int right = 0; right < 2; right++) {
+    int tn = right? n : m;
+    int ldt = tn + pad, ldb = n + pad;
+    float *t = mallocf(tn * ldt);
+    float *b = mallocf(m * ldb);
+    for (int lower = 0; lower < 2; lower++) {
+      fill_triangular(t, tn, ldt, lower);
+      for (int trans = 0; trans < 2; trans++) {
+        for (int unit = 0; unit < 2; unit++) {
+          for (int simd = 0; simd < 2; simd++) {
+            unsigned state = 7;
+            for (int i = 0; i < m * ldb; i++) {
+              b[i] = next_random(&state);
+            }
+            std::vector<float> orig(b, b + m * ldb);
+            linalg_trsm(simd, right, lower, trans, unit, m, n, 0.5f,
+                        t, ldt, b, ldb);
+            for (int i = 0; i < m; i++) {
+              for (int j = 0; j < n; j++) {
+                double sum = 0;
+                for (int k = 0; k < tn; k++) {
+                  sum += right?
+                      b[i * ldb + k] *
+                          op_element(t, ldt, lower, trans, unit, k, j) :
+                      op_element(t, ldt, lower, trans, unit, i, k) *
+                          b[k * ldb + j];
+                }
+                ASSERT_NEAR(0.5f * orig[i * ldb + j], sum, 1e-4)
+                    << right << lower << trans << unit << simd << " "
+                    << i << " " << j;
+              }
+              for (int j = n; j < ldb; j++) {
+                ASSERT_EQ(orig[i * ldb + j], b[i * ldb + j]);
+              }
+            }
+          }
+        }
+      }
+    }
+    free(b);
+    free(t);
+  }
+}
+
+TEST(Linalg, Trsv) {
+  const int n = 131, ldt = n + 5;
+  float *t = mallocf(n * ldt);
+  float x[n], orig[n];
+  for (int lower = 0; lower < 2; lower++) {
+    fill_triangular(t, n, ldt, lower);
+    for (int trans = 0; trans < 2; trans++) {
+      for (int unit = 0; unit < 2; unit++) {
+        for (int simd = 0; simd < 2; simd++) {
+          for (int i = 0; i < n; i++) {
+            x[i] = orig[i] = i % 7 - 3;
+          }
+          linalg_trsv(simd, lower, trans, unit, n, t, ldt, x);
+          for (int i = 0; i < n; i++) {
+            double sum = 0;
+            for (int k = 0; k < n; k++) {
+              sum += op_element(t, ldt, lower, trans, unit, i, k) * x[k];
+            }
+            ASSERT_NEAR(orig[i], sum, 1e-4)
+                << lower << trans << unit << simd << " " << i;
+          }
+        }
+      }
+    }
+  }
+  free(t);
+}
+
+/// @brief Fills a symmetric positive definite matrix.
+static void fill_spd(float *a, int n, int lda) {
+  unsigned state = n + 1;
+  std::vector<float> m(n * n);
+  for (auto& v : m) {
+    v = next_random(&state);
+  }
+  for (int i = 0; i < n; i++) {
+    for (int j = 0; j < lda; j++) {
+      double sum = i == j? n : 0;
+      for (int k = 0; j < n && k < n; k++) {
+        sum += m[i * n + k] * m[j * n + k];
+      }
+      a[i * lda + j] = sum;
+    }
+  }
+}
+
+TEST(Linalg, Cholesky) {
+  for (int n : { 1, 5, 64, 65, 200 }) {
+    const int lda = n + 2, nrhs = 3;
+    float *a = mallocf(n * lda);
+    float *l = mallocf(n * lda);
+    float *b = mallocf(n * nrhs);
+    fill_spd(a, n, lda);
+    for (int simd = 0; simd < 2; simd++) {
+      memcpy(l, a, n * lda * sizeof(float));
+      ASSERT_EQ(0, linalg_cholesky(simd, l, n, lda));
+      for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+          if (j > i) {
+            ASSERT_EQ(0, l[i * lda + j]);
+            continue;
+          }
+          double sum = 0;
+          for (int k = 0; k <= j; k++) {
+            sum += l[i * lda + k] * l[j * lda + k];
+          }
+          ASSERT_NEAR(a[i * lda + j], sum, 1e-3 * n)
+              << n << " " << simd << " " << i << " " << j;
+        }
+      }
+      for (int i = 0; i < n * nrhs; i++) {
+        b[i] = i % 5 - 2;
+      }
+      linalg_cholesky_solve(simd, l, n, lda, b, nrhs, nrhs);
+      for (int i = 0; i < n; i++) {
+        for (int r = 0; r < nrhs; r++) {
+          double sum = 0;
+          for (int k = 0; k < n; k++) {
+            sum += a[i * lda + k] * b[k * nrhs + r];
+          }
+          ASSERT_NEAR((i * nrhs + r) % 5 - 2, sum, 1e-3)
+              << n << " " << simd << " " << i << " " << r;
+        }
+      }
+    }
+    free(b);
+    free(l);
+    free(a);
+  }
+  // Not positive definite
+  float a[16] = { 4, 0, 0, 0,
+                  2, 5, 0, 0,
+                  0, 1, 1, 0,
+                  1, 1, 1, -1 };
+  ASSERT_EQ(4, linalg_cholesky(true, a, 4, 4));
+}
+
+TEST(Linalg, LU) {
+  for (int n : { 1, 7, 64, 65, 150 }) {
+    const int lda = n + 3, nrhs = 4;
+    float *a = mallocf(n * lda);
+    float *lu = mallocf(n * lda);
+    float *b = mallocf(n * nrhs);
+    int *pivots = new int[n];
+    unsigned state = n;
+    for (int i = 0; i < n * lda; i++) {
+      a[i] = next_random(&state);
+    }
+    for (int simd = 0; simd < 2; simd++) {
+      memcpy(lu, a, n * lda * sizeof(float));
+      ASSERT_EQ(0, linalg_lu(simd, lu, n, lda, pivots));
+      // Apply the interchanges to A and compare with L U
+      std::vector<float> pa(a, a + n * lda);
+      for (int i = 0; i < n; i++) {
+        ASSERT_GE(pivots[i], i);
+        ASSERT_LT(pivots[i], n);
+        for (int j = 0; j < n; j++) {
+          std::swap(pa[i * lda + j], pa[pivots[i] * lda + j]);
+        }
+      }
+      for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+          double sum = 0;
+          for (int k = 0; k <= i && k <= j; k++) {
+            sum += (k == i? 1 : lu[i * lda + k]) * lu[k * lda + j];
+          }
+          ASSERT_NEAR(pa[i * lda + j], sum, 1e-4 * n)
+              << n << " " << simd << " " << i << " " << j;
+        }
+        // Partial pivoting keeps L bounded
+        for (int k = 0; k < i; k++) {
+          ASSERT_LE(fabsf(lu[i * lda + k]), 1);
+        }
+      }
+      for (int i = 0; i < n * nrhs; i++) {
+        b[i] = i % 5 - 2;
+      }
+      linalg_lu_solve(simd, lu, n, lda, pivots, b, nrhs, nrhs);
+      for (int i = 0; i < n; i++) {
+        for (int r = 0; r < nrhs; r++) {
+          double sum = 0;
+          for (int k = 0; k < n; k++) {
+            sum += a[i * lda + k] * b[k * nrhs + r];
+          }
+          ASSERT_NEAR((i * nrhs + r) % 5 - 2, sum, 1e-3 * n)
+              << n << " " << simd << " " << i << " " << r;
+        }
+      }
+    }
+    delete[] pivots;
+    free(b);
+    free(lu);
+    free(a);
+  }
+  // Singular: the second column is twice the first one
+  float a[9] = { 2, 4, 1,
+                 1, 2, 3,
+                 4, 8, 5 };
+  int pivots[3];
+  ASSERT_EQ(2, linalg_lu(true, a, 3, 3, pivots));
+  ASSERT_EQ(2, pivots[0]);
+}
+
+TEST(Linalg, Batch) {
+  const int n = 6, count = 1300, nrhs = 2;
+  std::vector<float> a(n * n * count), b(n * nrhs * count);
+  for (int i = 0; i < count; i++) {
+    fill_spd(&a[i * n * n], n, n);
+    a[i * n * n] += i;
+  }
+  for (int i = 0; i < n * nrhs * count; i++) {
+    b[i] = i % 9 - 4;
+  }
+  for (int threads = 0; threads < 4; threads++) {
+    matrix_set_threads(threads);
+    for (int lu = 0; lu < 2; lu++) {
+      for (int simd = 0; simd < 2; simd++) {
+        std::vector<float> fa(a), xb(b), verif(a), verifb(b);
+        std::vector<int> info(count), pivots(n * count), verifp(n);
+        if (lu) {
+          linalg_lu_batch(simd, &fa[0], n, count, &pivots[0], &info[0]);
+          linalg_lu_solve_batch(simd, &fa[0], n, count, &pivots[0], &xb[0],
+                                nrhs);
+        } else {
+          linalg_cholesky_batch(simd, &fa[0], n, count, &info[0]);
+          linalg_cholesky_solve_batch(simd, &fa[0], n, count, &xb[0], nrhs);
+        }
+        for (int i = 0; i < count; i++) {
+          float *va = &verif[i * n * n], *vb = &verifb[i * n * nrhs];
+          if (lu) {
+            ASSERT_EQ(0, linalg_lu(simd, va, n, n, &verifp[0]));
+            linalg_lu_solve(simd, va, n, n, &verifp[0], vb, nrhs, nrhs);
+            for (int j = 0; j < n; j++) {
+              ASSERT_EQ(verifp[j], pivots[i * n + j]);
+            }
+          } else {
+            ASSERT_EQ(0, linalg_cholesky(simd, va, n, n));
+            linalg_cholesky_solve(simd, va, n, n, vb, nrhs, nrhs);
+          }
+          ASSERT_EQ(0, info[i]);
+          for (int j = 0; j < n * n; j++) {
+            ASSERT_EQ(va[j], fa[i * n * n + j]) << lu << simd << " " << i;
+          }
+          for (int j = 0; j < n * nrhs; j++) {
+            ASSERT_EQ(vb[j], xb[i * n * nrhs + j]) << lu << simd << " " << i;
+          }
+        }
+      }
+    }
+  }
+  matrix_set_threads(0);
+}
+
+#include "tests/google/src/gtest_main.cc"
@@ -28,6 +28,8 @@
  *  under the License.
  */
 
+#include <cmath>
+#include <cstring>
 #include <simd/memory.h>
 #include <simd/matrix.h>
 #include "tests/matrix.h"
@@ -125,6 +127,164 @@ TEST(Sub, Validate) {
   }
 }
 
+TEST(Broadcast, Validate) {
+  // 19 columns of a 24 wide matrix, so the tails are exercised
+  const int w = 19, h = 5, stride = 24;
+  float m[h * stride], res[h * stride], v[w];
+  for (int i = 0; i < h * stride; i++) {
+    m[i] = i % 17 - 8;
+  }
+  for (int j = 0; j < w; j++) {
+    v[j] = j % 3 + 1;
+  }
+  for (auto op : { kMatrixOperationAdd, kMatrixOperationSub,
+                   kMatrixOperationMul, kMatrixOperationDiv }) {
+    for (auto direction : { kMatrixPerRow, kMatrixPerColumn }) {
+      for (int simd = 0; simd < 2; simd++) {
+        for (int i = 0; i < h * stride; i++) {
+          res[i] = NAN;
+        }
+        matrix_broadcast(simd, op, direction, m, w, h, stride, v, res,
+                         stride);
+        for (int i = 0; i < h; i++) {
+          for (int j = 0; j < stride; j++) {
+            if (j >= w) {
+              ASSERT_TRUE(std::isnan(res[i * stride + j]));
+              continue;
+            }
+            float x = m[i * stride + j];
+            float y = v[direction == kMatrixPerRow? i : j];
+            float expected = op == kMatrixOperationAdd? x + y :
+                             op == kMatrixOperationSub? x - y :
+                             op == kMatrixOperationMul? x * y : x / y;
+            ASSERT_NEAR(expected, res[i * stride + j], 1e-5)
+                << op << direction << simd << " " << i << " " << j;
+          }
+        }
+      }
+    }
+  }
+  // In place
+  matrix_broadcast(true, kMatrixOperationSub, kMatrixPerColumn, m, w, h,
+                   stride, v, m, stride);
+  ASSERT_EQ(-8 - 1, m[0]);
+  ASSERT_EQ((stride + 1) % 17 - 8 - 2, m[stride + 1]);
+}
+
+TEST(Reduce, Validate) {
+  const int w = 37, h = 21, stride = 40;
+  float m[h * stride], res[w];
+  for (int i = 0; i < h * stride; i++) {
+    m[i] = (i * 7) % 23 - 11.5f;
+  }
+  m[3 * stride + 5] = NAN;
+  for (auto op : { kMatrixReductionSum, kMatrixReductionMean,
+                   kMatrixReductionMin, kMatrixReductionMax,
+                   kMatrixReductionNorm2 }) {
+    for (auto direction : { kMatrixPerRow, kMatrixPerColumn }) {
+      for (int simd = 0; simd < 2; simd++) {
+        matrix_reduce(simd, op, direction, m, w, h, stride, res);
+        int count = direction == kMatrixPerRow? h : w;
+        int length = direction == kMatrixPerRow? w : h;
+        for (int k = 0; k < count; k++) {
+          double sum = 0, squares = 0;
+          float min = INFINITY, max = -INFINITY;
+          bool nan = false;
+          for (int l = 0; l < length; l++) {
+            float x = direction == kMatrixPerRow? m[k * stride + l] :
+                                                  m[l * stride + k];
+            nan |= std::isnan(x);
+            sum += x;
+            squares += x * x;
+            min = x < min? x : min;
+            max = x > max? x : max;
+          }
+          float expected = op == kMatrixReductionSum? sum :
+                           op == kMatrixReductionMean? sum / length :
+                           op == kMatrixReductionMin? min :
+                           op == kMatrixReductionMax? max : sqrt(squares);
+          if (nan && (op == kMatrixReductionSum ||
+                      op == kMatrixReductionMean ||
+                      op == kMatrixReductionNorm2)) {
+            ASSERT_TRUE(std::isnan(res[k]));
+          } else {
+            ASSERT_NEAR(expected, res[k], 1e-3)
+                << op << direction << simd << " " << k;
+          }
+        }
+      }
+    }
+  }
+  // The norms do not overflow in the intermediate sums
+  float big[8];
+  for (int i = 0; i < 8; i++) {
+    big[i] = 1e30f;
+  }
+  matrix_reduce(true, kMatrixReductionNorm2, kMatrixPerColumn, big, 2, 4, 2,
+                res);
+  ASSERT_NEAR(2e30f, res[0], 1e24f);
+  matrix_reduce(true, kMatrixReductionNorm2, kMatrixPerRow, big, 4, 2, 4,
+                res);
+  ASSERT_NEAR(2e30f, res[1], 1e24f);
+}
+
+TEST(Argmax, Validate) {
+  const int w = 29, h = 23, stride = 32;
+  float m[h * stride];
+  int res[w];
+  for (int i = 0; i < h * stride; i++) {
+    m[i] = (i * 13) % 31;
+  }
+  // NaN-s, -INFINITY and the ties
+  for (int i = 0; i < h; i++) {
+    m[i * stride + 2] = NAN;
+    m[i * stride + 4] = -INFINITY;
+  }
+  m[5 * stride + 4] = -INFINITY;
+  m[7 * stride + 10] = m[7 * stride + 20] = 100;
+  for (auto direction : { kMatrixPerRow, kMatrixPerColumn }) {
+    for (int simd = 0; simd < 2; simd++) {
+      matrix_argmax(simd, direction, m, w, h, stride, res);
+      int count = direction == kMatrixPerRow? h : w;
+      int length = direction == kMatrixPerRow? w : h;
+      for (int k = 0; k < count; k++) {
+        int expected = -1;
+        float best = -INFINITY;
+        for (int l = 0; l < length; l++) {
+          float x = direction == kMatrixPerRow? m[k * stride + l] :
+                                                m[l * stride + k];
+          if (x > best || (expected < 0 && x == best)) {
+            best = x;
+            expected = l;
+          }
+        }
+        ASSERT_EQ(expected, res[k]) << direction << simd << " " << k;
+      }
+    }
+  }
+  matrix_argmax(true, kMatrixPerRow, m, w, h, stride, res);
+  ASSERT_EQ(10, res[7]);
+  matrix_argmax(true, kMatrixPerColumn, m, w, h, stride, res);
+  ASSERT_EQ(-1, res[2]);
+  ASSERT_EQ(0, res[4]);
+  // The vectorised loops and their tails agree with the scalar code
+  const int bw = 67, bh = 41;
+  float big[bw * bh];
+  int verif[bw], vec[bw];
+  for (int i = 0; i < bw * bh; i++) {
+    big[i] = (i * 7919) % 1021;
+  }
+  big[13] = NAN;
+  for (auto direction : { kMatrixPerRow, kMatrixPerColumn }) {
+    matrix_argmax(false, direction, big, bw, bh, bw, verif);
+    matrix_argmax(true, direction, big, bw, bh, bw, vec);
+    int count = direction == kMatrixPerRow? bh : bw;
+    for (int k = 0; k < count; k++) {
+      ASSERT_EQ(verif[k], vec[k]) << direction << " " << k;
+    }
+  }
+}
+
 TEST(Multiply, Validate) {
   float m1[6] = { 1, 2, 3,
                  -2, 0, 4 };
@@ -156,6 +316,973 @@ TEST(MultiplyTransposed, Validate) {
   }
 }
 
+TEST(Multiply, Double) {
+  // KC-sized depth plus the edge tiles in every direction
+  const int w1 = 301, h1 = 131, w2 = 83;
+  double *m1 = new double[w1 * h1];
+  double *m2 = new double[w2 * w1];
+  double *m2t = new double[w2 * w1];
+  for (int i = 0; i < w1 * h1; i++) {
+    m1[i] = sin(i) * 3;
+  }
+  for (int i = 0; i < w1; i++) {
+    for (int j = 0; j < w2; j++) {
+      m2[i * w2 + j] = cos(i * w2 + j) / 7;
+      m2t[j * w1 + i] = m2[i * w2 + j];
+    }
+  }
+  double *verif = new double[w2 * h1];
+  double *res = new double[w2 * h1];
+  matrix_multiply_double(false, m1, m2, w1, h1, w2, w1, verif);
+  for (int i = 0; i < h1; i += 13) {
+    for (int j = 0; j < w2; j += 7) {
+      double sum = 0;
+      for (int k = 0; k < w1; k++) {
+        sum += m1[i * w1 + k] * m2[k * w2 + j];
+      }
+      ASSERT_NEAR(sum, verif[i * w2 + j], 1E-12);
+    }
+  }
+  matrix_multiply_double(true, m1, m2, w1, h1, w2, w1, res);
+  for (int i = 0; i < w2 * h1; i++) {
+    ASSERT_NEAR(verif[i], res[i], 1E-12) << i;
+  }
+  matrix_multiply_transposed_double(false, m1, m2t, w1, h1, w1, w2, res);
+  for (int i = 0; i < w2 * h1; i++) {
+    ASSERT_EQ(verif[i], res[i]) << i;
+  }
+  matrix_multiply_transposed_double(true, m1, m2t, w1, h1, w1, w2, res);
+  for (int i = 0; i < w2 * h1; i++) {
+    ASSERT_NEAR(verif[i], res[i], 1E-12) << i;
+  }
+  delete[] res;
+  delete[] verif;
+  delete[] m2t;
+  delete[] m2;
+  delete[] m1;
+}
+
+TEST(Multiply, Threads) {
+  // Few row blocks make the threads split the columns as well
+  const int w1 = 300, h1 = 37, w2 = 1100;
+  float *m1 = mallocf(w1 * h1);
+  float *m2 = mallocf(w2 * w1);
+  for (int i = 0; i < w1 * h1; i++) {
+    m1[i] = i % 19 - 9;
+  }
+  for (int i = 0; i < w2 * w1; i++) {
+    m2[i] = i % 7 - 3;
+  }
+  float *verif = mallocf(w2 * h1);
+  float *res = mallocf(w2 * h1);
+  matrix_multiply(false, m1, m2, w1, h1, w2, w1, verif);
+  for (int threads = 1; threads <= 8; threads *= 2) {
+    matrix_set_threads(threads);
+    matrix_multiply(true, m1, m2, w1, h1, w2, w1, res);
+    for (int i = 0; i < w2 * h1; i++) {
+      ASSERT_EQ(verif[i], res[i]) << threads << " " << i;
+    }
+  }
+  matrix_set_threads(0);
+  free(res);
+  free(verif);
+  free(m2);
+  free(m1);
+}
+
+TEST(Gemm, Validate) {
+  // The operands are the views into larger matrices
+  const int M = 37, N = 53, K = 70, pad = 5;
+  const int ld = K + N + M + pad;
+  float *a = mallocf(K * ld);
+  float *b = mallocf(K * ld);
+  float *c = mallocf(M * ld);
+  float *verif = mallocf(M * N);
+  for (int i = 0; i < K * ld; i++) {
+    a[i] = i % 13 - 6;
+    b[i] = i % 11 - 5;
+  }
+  for (int transA = 0; transA < 2; transA++) {
+    for (int transB = 0; transB < 2; transB++) {
+      for (float beta : { 0.f, 1.f, -0.5f }) {
+        for (int simd = 0; simd < 2; simd++) {
+          for (int i = 0; i < M * ld; i++) {
+            c[i] = beta == 0? NAN : i % 5;
+          }
+          for (int i = 0; i < M; i++) {
+            for (int j = 0; j < N; j++) {
+              float sum = 0;
+              for (int p = 0; p < K; p++) {
+                sum += (transA? a[p * ld + i] : a[i * ld + p]) *
+                       (transB? b[j * ld + p] : b[p * ld + j]);
+              }
+              verif[i * N + j] = 0.5f * sum +
+                  (beta == 0? 0 : beta * c[i * ld + j]);
+            }
+          }
+          matrix_gemm(simd, transA, transB, M, N, K, 0.5f, a, ld, b, ld,
+                      beta, c, ld);
+          for (int i = 0; i < M; i++) {
+            for (int j = 0; j < N; j++) {
+              ASSERT_NEAR(verif[i * N + j], c[i * ld + j], 0.01)
+                  << transA << transB << " " << beta << " " << simd
+                  << " " << i << " " << j;
+            }
+            // The columns past N are not touched
+            for (int j = N; j < ld; j++) {
+              if (beta == 0) {
+                ASSERT_TRUE(std::isnan(c[i * ld + j]));
+              } else {
+                ASSERT_EQ((i * ld + j) % 5, c[i * ld + j]);
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+  // alpha == 0 only scales C
+  for (int i = 0; i < M * ld; i++) {
+    c[i] = i % 5;
+  }
+  matrix_gemm(true, false, false, M, N, K, 0, a, ld, b, ld, 2, c, ld);
+  for (int i = 0; i < M; i++) {
+    for (int j = 0; j < N; j++) {
+      ASSERT_EQ(2 * ((i * ld + j) % 5), c[i * ld + j]);
+    }
+  }
+  free(verif);
+  free(c);
+  free(b);
+  free(a);
+}
+
+static float activate(float x, ActivationFunction activation) {
+  switch (activation) {
+    case kActivationRelu:
+      return x > 0? x : 0;
+    case kActivationTanh:
+      return std::tanh(x);
+    case kActivationSigmoid:
+      return 1 / (1 + std::exp(-x));
+    default:
+      return x;
+  }
+}
+
+TEST(Gemm, Activate) {
+  // K exceeds the block of K, so the epilogue must wait for the last one
+  const int M = 29, N = 45, K = 600, pad = 3;
+  const int ldc = N + pad;
+  float *a = mallocf(M * K);
+  float *b = mallocf(K * N);
+  float *bias = mallocf(N);
+  float *c = mallocf(M * ldc);
+  float *verif = mallocf(M * N);
+  for (int i = 0; i < M * K; i++) {
+    a[i] = (i % 13 - 6) * 0.01f;
+  }
+  for (int i = 0; i < K * N; i++) {
+    b[i] = (i % 11 - 5) * 0.01f;
+  }
+  for (int i = 0; i < N; i++) {
+    bias[i] = (i % 7 - 3) * 0.1f;
+  }
+  for (auto activation : { kActivationIdentity, kActivationRelu,
+                           kActivationTanh, kActivationSigmoid }) {
+    for (int withBias = 0; withBias < 2; withBias++) {
+      for (float beta : { 0.f, 0.5f }) {
+        for (int simd = 0; simd < 2; simd++) {
+          for (int i = 0; i < M * ldc; i++) {
+            c[i] = beta == 0? NAN : (i % 5) * 0.1f;
+          }
+          for (int i = 0; i < M; i++) {
+            for (int j = 0; j < N; j++) {
+              float sum = 0;
+              for (int p = 0; p < K; p++) {
+                sum += a[i * K + p] * b[p * N + j];
+              }
+              verif[i * N + j] = activate(
+                  sum + (beta == 0? 0 : beta * c[i * ldc + j]) +
+                  (withBias? bias[j] : 0), activation);
+            }
+          }
+          matrix_gemm_activate(simd, false, false, M, N, K, 1, a, K, b, N,
+                               beta, withBias? bias : nullptr, activation,
+                               c, ldc);
+          for (int i = 0; i < M; i++) {
+            for (int j = 0; j < N; j++) {
+              ASSERT_NEAR(verif[i * N + j], c[i * ldc + j], 1e-5)
+                  << activation << withBias << " " << beta << " " << simd
+                  << " " << i << " " << j;
+            }
+            for (int j = N; j < ldc; j++) {
+              if (beta == 0) {
+                ASSERT_TRUE(std::isnan(c[i * ldc + j]));
+              } else {
+                ASSERT_EQ(((i * ldc + j) % 5) * 0.1f, c[i * ldc + j]);
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+  // matrix_multiply_activate() of the small and the large matrices
+  for (int h1 : { 4, M }) {
+    matrix_multiply(false, a, b, K, h1, N, K, verif);
+    matrix_multiply_activate(true, a, b, K, h1, N, K, bias, kActivationRelu,
+                             c);
+    for (int i = 0; i < h1 * N; i++) {
+      ASSERT_NEAR(activate(verif[i] + bias[i % N], kActivationRelu), c[i],
+                  1e-5) << h1 << " " << i;
+    }
+  }
+  free(verif);
+  free(c);
+  free(bias);
+  free(b);
+  free(a);
+}
+
+TEST(Gemm, ActivationAccuracy) {
+  // C = x * 1^T, so the epilogue sees every x, including the special ones
+  const int M = 203, N = 19;
+  float *x = mallocf(M);
+  float *ones = mallocf(N);
+  float *c = mallocf(M * N);
+  for (int i = 0; i < M - 3; i++) {
+    x[i] = (i - 100) * (i % 2? 0.17f : 1e-3f);
+  }
+  x[M - 3] = INFINITY;
+  x[M - 2] = -INFINITY;
+  x[M - 1] = NAN;
+  for (int j = 0; j < N; j++) {
+    ones[j] = 1;
+  }
+  for (auto activation : { kActivationRelu, kActivationTanh,
+                           kActivationSigmoid }) {
+    matrix_gemm_activate(true, false, false, M, N, 1, 1, x, 1, ones, N, 0,
+                         nullptr, activation, c, N);
+    for (int i = 0; i < M; i++) {
+      float expected = activate(x[i], activation);
+      for (int j = 0; j < N; j++) {
+        if (std::isnan(x[i])) {
+          if (activation != kActivationRelu) {
+            ASSERT_TRUE(std::isnan(c[i * N + j])) << activation;
+          }
+          continue;
+        }
+        if (std::isinf(expected)) {
+          ASSERT_EQ(expected, c[i * N + j]);
+          continue;
+        }
+        ASSERT_NEAR(expected, c[i * N + j],
+                    1e-6f + std::abs(expected) * 1e-5f)
+            << activation << " " << x[i];
+      }
+    }
+  }
+  free(c);
+  free(ones);
+  free(x);
+}
+
+TEST(Strassen, Validate) {
+  // The small crossover makes several levels with the odd sizes; the
+  // integer elements make all the sums exact
+  const int M = 67, N = 45, K = 51, pad = 3;
+  const int lda = K + pad, ldb = N + pad, ldc = N + pad;
+  float *a = mallocf(M * lda);
+  float *b = mallocf(K * ldb);
+  float *c = mallocf(M * ldc);
+  float *verif = mallocf(M * N);
+  for (int i = 0; i < M * lda; i++) {
+    a[i] = i % 13 - 6;
+  }
+  for (int i = 0; i < K * ldb; i++) {
+    b[i] = i % 11 - 5;
+  }
+  matrix_gemm(false, false, false, M, N, K, 1, a, lda, b, ldb, 0, verif, N);
+  ASSERT_EQ(0u, matrix_multiply_strassen_workspace(M, N, K, 0));
+  size_t size = matrix_multiply_strassen_workspace(M, N, K, 5);
+  ASSERT_GT(size, 0u);
+  float *workspace = mallocf(size);
+  for (int simd = 0; simd < 2; simd++) {
+    for (size_t crossover : { 5, 11, 0 }) {
+      for (int i = 0; i < M * ldc; i++) {
+        c[i] = NAN;
+      }
+      matrix_multiply_strassen(simd, M, N, K, a, lda, b, ldb, c, ldc,
+                               crossover, crossover == 5? workspace : nullptr);
+      for (int i = 0; i < M; i++) {
+        for (int j = 0; j < N; j++) {
+          ASSERT_EQ(verif[i * N + j], c[i * ldc + j])
+              << simd << " " << crossover << " " << i << " " << j;
+        }
+        for (int j = N; j < ldc; j++) {
+          ASSERT_TRUE(std::isnan(c[i * ldc + j]));
+        }
+      }
+    }
+  }
+  free(workspace);
+  free(verif);
+  free(c);
+  free(b);
+  free(a);
+}
+
+TEST(Gram, Validate) {
+  const int N = 150, K = 83, pad = 3;
+  const int lda = N + K + pad, ldc = N + pad;
+  float *a = mallocf(lda * (N + K));
+  float *c = mallocf(N * ldc);
+  float *means = mallocf(N);
+  for (int i = 0; i < lda * (N + K); i++) {
+    a[i] = i % 13 - 6;
+  }
+  for (int i = 0; i < N; i++) {
+    means[i] = i % 5 - 2;
+  }
+  for (int transA = 0; transA < 2; transA++) {
+    for (int centre = 0; centre < 2; centre++) {
+      for (float beta : { 0.f, 0.5f }) {
+        for (int mirror = 0; mirror < 2; mirror++) {
+          for (int simd = 0; simd < 2; simd++) {
+            for (int i = 0; i < N * ldc; i++) {
+              c[i] = beta == 0? NAN : i % 7;
+            }
+            matrix_gram(simd, transA, N, K, 2, a, lda,
+                        centre? means : nullptr, beta, c, ldc, mirror);
+            for (int i = 0; i < N; i++) {
+              for (int j = 0; j < ldc; j++) {
+                float initial = (i * ldc + j) % 7;
+                if (j >= N || (j < i && !mirror)) {
+                  // Not touched
+                  if (beta == 0) {
+                    ASSERT_TRUE(std::isnan(c[i * ldc + j]));
+                  } else {
+                    ASSERT_EQ(initial, c[i * ldc + j]);
+                  }
+                  continue;
+                }
+                int r = j < i? j : i, q = j < i? i : j;
+                float sum = 0;
+                for (int p = 0; p < K; p++) {
+                  float x = transA? a[p * lda + r] : a[r * lda + p];
+                  float y = transA? a[p * lda + q] : a[q * lda + p];
+                  if (centre) {
+                    x -= means[r];
+                    y -= means[q];
+                  }
+                  sum += x * y;
+                }
+                float expected = 2 * sum +
+                    (beta == 0? 0 : beta * ((r * ldc + q) % 7));
+                ASSERT_EQ(expected, c[i * ldc + j])
+                    << transA << centre << beta << mirror << simd << " "
+                    << i << " " << j;
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+  // matrix_multiply_transposed() of a matrix by itself is symmetric
+  float *res = mallocf(N * N);
+  float *verif = mallocf(N * N);
+  matrix_multiply_transposed(false, a, a, K, N, K, N, verif);
+  matrix_multiply_transposed(true, a, a, K, N, K, N, res);
+  for (int i = 0; i < N * N; i++) {
+    ASSERT_EQ(verif[i], res[i]) << i;
+  }
+  free(verif);
+  free(res);
+  free(means);
+  free(c);
+  free(a);
+}
+
+TEST(Gram, Degenerate) {
+  const int N = 37, K = 5, ldc = N + 3;
+  float a[N * K];
+  float c[N * ldc];
+  for (int i = 0; i < N * K; i++) {
+    a[i] = i % 13 - 6;
+  }
+  // K == 0 and alpha == 0 only scale C
+  for (int zeroK = 0; zeroK < 2; zeroK++) {
+    for (float beta : { 0.f, 0.5f }) {
+      for (int mirror = 0; mirror < 2; mirror++) {
+        for (int simd = 0; simd < 2; simd++) {
+          for (int i = 0; i < N * ldc; i++) {
+            c[i] = i % 7;
+          }
+          matrix_gram(simd, false, N, zeroK? 0 : K, zeroK? 1 : 0, a, K,
+                      nullptr, beta, c, ldc, mirror);
+          for (int i = 0; i < N; i++) {
+            for (int j = 0; j < ldc; j++) {
+              float expected = (i * ldc + j) % 7;
+              if (j < N && j >= i) {
+                expected *= beta;
+              } else if (j < i && mirror) {
+                expected = beta * ((j * ldc + i) % 7);
+              }
+              ASSERT_EQ(expected, c[i * ldc + j])
+                  << zeroK << beta << mirror << simd << " " << i << " " << j;
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+/// @brief Encodes a float which is exactly representable in the given
+/// 16-bit format.
+static uint16_t float_to_half(float value, HalfFloatType type) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  if (type == kHalfFloatBFloat16) {
+    return bits >> 16;
+  }
+  uint16_t sign = (bits >> 16) & 0x8000;
+  if ((bits & 0x7FFFFFFF) == 0) {
+    return sign;
+  }
+  int exponent = ((bits >> 23) & 0xFF) - 127 + 15;
+  return sign | (exponent << 10) | ((bits >> 13) & 0x3FF);
+}
+
+TEST(GemmHalf, Validate) {
+  const int M = 29, N = 45, K = 67, pad = 3;
+  const int ld = K + N + pad;
+  float *a = mallocf(M * ld > K * ld? M * ld : K * ld);
+  float *b = mallocf(K * ld);
+  uint16_t *bh = new uint16_t[K * ld];
+  float *c = mallocf(M * ld);
+  float *verif = mallocf(M * ld);
+  for (int i = 0; i < K * ld; i++) {
+    a[i] = i % 13 - 6;
+    b[i] = (i % 11 - 5) * 0.125f;
+  }
+  for (HalfFloatType type : { kHalfFloatIEEE, kHalfFloatBFloat16 }) {
+    for (int i = 0; i < K * ld; i++) {
+      bh[i] = float_to_half(b[i], type);
+    }
+    for (int transA = 0; transA < 2; transA++) {
+      for (int transB = 0; transB < 2; transB++) {
+        for (float beta : { 0.f, -0.5f }) {
+          for (int i = 0; i < M * ld; i++) {
+            verif[i] = i % 5;
+          }
+          matrix_gemm(false, transA, transB, M, N, K, 2, a, ld, b, ld,
+                      beta, verif, ld);
+          for (int simd = 0; simd < 2; simd++) {
+            for (int i = 0; i < M * ld; i++) {
+              c[i] = beta == 0? NAN : i % 5;
+            }
+            matrix_gemm_half(simd, type, transA, transB, M, N, K, 2, a, ld,
+                             bh, ld, beta, c, ld);
+            for (int i = 0; i < M; i++) {
+              for (int j = 0; j < N; j++) {
+                ASSERT_EQ(verif[i * ld + j], c[i * ld + j])
+                    << type << " " << transA << transB << " " << beta
+                    << " " << simd << " " << i << " " << j;
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+  delete[] bh;
+  free(verif);
+  free(c);
+  free(b);
+  free(a);
+}
+
+TEST(VectorMultiply, Validate) {
+  for (int w : { 1, 7, 8, 33, 1000 }) {
+    for (int h : { 1, 5, 8, 13, 71 }) {
+      // The matrix is a view into a wider one
+      int stride = w + 3;
+      float *m = mallocf(stride * h);
+      float *v = mallocf(w > h? w : h);
+      float *res = mallocf(w > h? w : h);
+      float *verif = mallocf(w > h? w : h);
+      for (int i = 0; i < stride * h; i++) {
+        m[i] = i % 13 - 6;
+      }
+      for (int i = 0; i < (w > h? w : h); i++) {
+        v[i] = i % 7 - 3;
+      }
+      matrix_vector_multiply(false, m, w, h, stride, v, verif);
+      matrix_vector_multiply(true, m, w, h, stride, v, res);
+      for (int i = 0; i < h; i++) {
+        ASSERT_EQ(verif[i], res[i]) << w << " " << h << " " << i;
+      }
+      matrix_transposed_vector_multiply(false, m, w, h, stride, v, verif);
+      matrix_transposed_vector_multiply(true, m, w, h, stride, v, res);
+      for (int j = 0; j < w; j++) {
+        float sum = 0;
+        for (int i = 0; i < h; i++) {
+          sum += m[i * stride + j] * v[i];
+        }
+        ASSERT_EQ(sum, verif[j]) << w << " " << h << " " << j;
+        ASSERT_EQ(sum, res[j]) << w << " " << h << " " << j;
+      }
+      free(verif);
+      free(res);
+      free(v);
+      free(m);
+    }
+  }
+}
+
+TEST(VectorMultiplyHalf, Validate) {
+  for (HalfFloatType type : { kHalfFloatIEEE, kHalfFloatBFloat16 }) {
+    for (int w : { 1, 7, 8, 33, 1000 }) {
+      for (int h : { 1, 5, 8, 13, 71 }) {
+        int stride = w + 3;
+        float *m = mallocf(stride * h);
+        uint16_t *mh = new uint16_t[stride * h];
+        float *v = mallocf(w);
+        float *res = mallocf(h);
+        float *verif = mallocf(h);
+        for (int i = 0; i < stride * h; i++) {
+          m[i] = (i % 13 - 6) * 0.25f;
+          mh[i] = float_to_half(m[i], type);
+        }
+        for (int i = 0; i < w; i++) {
+          v[i] = i % 7 - 3;
+        }
+        matrix_vector_multiply(false, m, w, h, stride, v, verif);
+        for (int simd = 0; simd < 2; simd++) {
+          matrix_vector_multiply_half(simd, type, mh, w, h, stride, v, res);
+          for (int i = 0; i < h; i++) {
+            ASSERT_EQ(verif[i], res[i]) << type << " " << simd << " "
+                                        << w << " " << h << " " << i;
+          }
+        }
+        free(verif);
+        free(res);
+        free(v);
+        delete[] mh;
+        free(m);
+      }
+    }
+  }
+  // Special values: zero, subnormals, infinities and NaN
+  const uint16_t specials[] = {
+    0x0000, 0x8000, 0x0001, 0x83FF, 0x0400, 0x3C00, 0xC000, 0x7BFF,
+    0x7C00, 0xFC00, 0x7E00
+  };
+  const float expected[] = {
+    0.f, -0.f, ldexpf(1, -24), -1023 * ldexpf(1, -24), ldexpf(1, -14),
+    1.f, -2.f, 65504.f, INFINITY, -INFINITY, NAN
+  };
+  const int count = sizeof(specials) / sizeof(specials[0]);
+  float one = 1, res[count];
+  for (int simd = 0; simd < 2; simd++) {
+    matrix_vector_multiply_half(simd, kHalfFloatIEEE, specials, 1, count, 1,
+                                &one, res);
+    for (int i = 0; i < count; i++) {
+      if (std::isnan(expected[i])) {
+        ASSERT_TRUE(std::isnan(res[i])) << simd << " " << i;
+      } else {
+        ASSERT_EQ(expected[i], res[i]) << simd << " " << i;
+      }
+    }
+  }
+}
+
+TEST(VectorMultiply, Threads) {
+  const int w = 500, h = 1200;
+  float *m = mallocf(w * h);
+  float *v = mallocf(h);
+  float *verif = mallocf(h);
+  float *res = mallocf(h);
+  for (int i = 0; i < w * h; i++) {
+    m[i] = i % 17 - 8;
+  }
+  for (int i = 0; i < h; i++) {
+    v[i] = i % 5 - 2;
+  }
+  for (int threads = 1; threads <= 8; threads *= 2) {
+    matrix_set_threads(threads);
+    matrix_vector_multiply(false, m, w, h, w, v, verif);
+    matrix_vector_multiply(true, m, w, h, w, v, res);
+    for (int i = 0; i < h; i++) {
+      ASSERT_EQ(verif[i], res[i]) << threads << " " << i;
+    }
+    matrix_transposed_vector_multiply(false, m, w, h, w, v, verif);
+    matrix_transposed_vector_multiply(true, m, w, h, w, v, res);
+    for (int i = 0; i < w; i++) {
+      ASSERT_EQ(verif[i], res[i]) << threads << " " << i;
+    }
+  }
+  matrix_set_threads(0);
+  free(res);
+  free(verif);
+  free(v);
+  free(m);
+}
+
+/// @brief Fills a matrix with mostly zeros, a few rows being dense and
+/// a few being empty.
+static void fill_sparse(float *m, int w, int h) {
+  for (int i = 0; i < h; i++) {
+    for (int j = 0; j < w; j++) {
+      int k = i * w + j;
+      bool nonzero = i % 23 == 3 || (i % 7 != 5 && (k * 7919) % 97 < 5);
+      m[k] = nonzero? k % 9 - 4 : 0;
+    }
+  }
+}
+
+TEST(Sparse, FromDense) {
+  const int w = 41, h = 30, stride = 45;
+  float *m = mallocf(stride * h);
+  fill_sparse(m, stride, h);
+  SparseMatrix sm = matrix_sparse_from_dense(m, w, h, stride);
+  ASSERT_EQ(static_cast<size_t>(w), sm.width);
+  ASSERT_EQ(static_cast<size_t>(h), sm.height);
+  ASSERT_EQ(0u, sm.row_offsets[0]);
+  for (int i = 0; i < h; i++) {
+    size_t p = sm.row_offsets[i];
+    for (int j = 0; j < w; j++) {
+      if (m[i * stride + j] != 0) {
+        ASSERT_LT(p, sm.row_offsets[i + 1]);
+        ASSERT_EQ(j, sm.columns[p]);
+        ASSERT_EQ(m[i * stride + j], sm.values[p]);
+        p++;
+      }
+    }
+    ASSERT_EQ(p, sm.row_offsets[i + 1]) << i;
+  }
+  matrix_sparse_finalize(sm);
+  memsetf(m, 0.f, stride * h);
+  sm = matrix_sparse_from_dense(m, w, h, stride);
+  ASSERT_EQ(0u, sm.row_offsets[h]);
+  float v[w], res[h];
+  for (int i = 0; i < w; i++) {
+    v[i] = 1;
+  }
+  matrix_sparse_vector_multiply(true, &sm, v, res);
+  for (int i = 0; i < h; i++) {
+    ASSERT_EQ(0, res[i]);
+  }
+  matrix_sparse_finalize(sm);
+  free(m);
+}
+
+TEST(Sparse, Multiply) {
+  for (int w : { 1, 37, 300 }) {
+    for (int h : { 1, 19, 200 }) {
+      float *m = mallocf(w * h);
+      fill_sparse(m, w, h);
+      SparseMatrix sm = matrix_sparse_from_dense(m, w, h, w);
+      for (int w2 : { 1, 7, 8, 40, 77 }) {
+        float *m2 = mallocf(w * w2);
+        float *verif = mallocf(h * w2);
+        float *res = mallocf(h * w2);
+        for (int i = 0; i < w * w2; i++) {
+          m2[i] = i % 11 - 5;
+        }
+        matrix_multiply(false, m, m2, w, h, w2, w, verif);
+        for (int simd = 0; simd < 2; simd++) {
+          matrix_sparse_multiply(simd, &sm, m2, w2, res);
+          for (int i = 0; i < h * w2; i++) {
+            ASSERT_EQ(verif[i], res[i]) << w << " " << h << " " << w2
+                                        << " " << simd << " " << i;
+          }
+          if (w2 == 1) {
+            memsetf(res, NAN, h);
+            matrix_sparse_vector_multiply(simd, &sm, m2, res);
+            for (int i = 0; i < h; i++) {
+              ASSERT_EQ(verif[i], res[i]) << w << " " << h << " "
+                                          << simd << " " << i;
+            }
+          }
+        }
+        free(res);
+        free(verif);
+        free(m2);
+      }
+      matrix_sparse_finalize(sm);
+      free(m);
+    }
+  }
+}
+
+TEST(Sparse, Threads) {
+  const int w = 3000, h = 2000, w2 = 24;
+  float *m = mallocf(w * h);
+  fill_sparse(m, w, h);
+  SparseMatrix sm = matrix_sparse_from_dense(m, w, h, w);
+  float *m2 = mallocf(w * w2);
+  for (int i = 0; i < w * w2; i++) {
+    m2[i] = i % 11 - 5;
+  }
+  float *verif = mallocf(h * w2);
+  float *res = mallocf(h * w2);
+  matrix_sparse_multiply(false, &sm, m2, w2, verif);
+  float *verifv = mallocf(h);
+  matrix_sparse_vector_multiply(false, &sm, m2, verifv);
+  for (int threads = 1; threads <= 8; threads *= 2) {
+    matrix_set_threads(threads);
+    matrix_sparse_multiply(true, &sm, m2, w2, res);
+    for (int i = 0; i < h * w2; i++) {
+      ASSERT_EQ(verif[i], res[i]) << threads << " " << i;
+    }
+    matrix_sparse_vector_multiply(true, &sm, m2, res);
+    for (int i = 0; i < h; i++) {
+      ASSERT_EQ(verifv[i], res[i]) << threads << " " << i;
+    }
+  }
+  matrix_set_threads(0);
+  free(verifv);
+  free(res);
+  free(verif);
+  free(m2);
+  matrix_sparse_finalize(sm);
+  free(m);
+}
+
+TEST(MultiplyBatch, Validate) {
+  const int shapes[][3] = {
+    { 2, 2, 2 }, { 3, 3, 3 }, { 4, 4, 4 }, { 5, 5, 5 }, { 8, 8, 8 },
+    { 16, 16, 16 }, { 3, 2, 4 }, { 7, 5, 8 }, { 3, 6, 16 }, { 6, 4, 7 }
+  };
+  const int count = 19;
+  for (auto& shape : shapes) {
+    int w1 = shape[0], h1 = shape[1], w2 = shape[2];
+    float *m1 = mallocf(w1 * h1 * count);
+    float *m2 = mallocf(w2 * w1 * count);
+    float *res = mallocf(w2 * h1 * count);
+    float *verif = mallocf(w2 * h1 * count);
+    for (int i = 0; i < w1 * h1 * count; i++) {
+      m1[i] = i % 11 - 5;
+    }
+    for (int i = 0; i < w2 * w1 * count; i++) {
+      m2[i] = i % 7 - 3;
+    }
+    for (int layout = kMatrixBatchLayoutContiguous;
+         layout <= kMatrixBatchLayoutInterleaved; layout++) {
+      bool interleaved = layout == kMatrixBatchLayoutInterleaved;
+      // Index of element e of matrix n in a matrix of size elements
+      auto index = [=](int n, int e, int size) {
+        return interleaved? e * count + n : n * size + e;
+      };
+      for (int n = 0; n < count; n++) {
+        for (int i = 0; i < h1; i++) {
+          for (int j = 0; j < w2; j++) {
+            float sum = 0;
+            for (int k = 0; k < w1; k++) {
+              sum += m1[index(n, i * w1 + k, w1 * h1)] *
+                     m2[index(n, k * w2 + j, w2 * w1)];
+            }
+            verif[index(n, i * w2 + j, w2 * h1)] = sum;
+          }
+        }
+      }
+      for (int simd = 0; simd < 2; simd++) {
+        matrix_multiply_batch(simd, static_cast<MatrixBatchLayout>(layout),
+                              m1, m2, w1, h1, w2, count, res);
+        for (int i = 0; i < w2 * h1 * count; i++) {
+          ASSERT_EQ(verif[i], res[i]) << w1 << "x" << h1 << "x" << w2
+              << " " << layout << " " << simd << " " << i;
+        }
+      }
+    }
+    free(verif);
+    free(res);
+    free(m2);
+    free(m1);
+  }
+}
+
+TEST(Transpose, Validate) {
+  const int sizes[][2] = {
+    { 1, 1 }, { 7, 13 }, { 8, 8 }, { 33, 65 }, { 100, 3 }, { 300, 257 }
+  };
+  for (auto& size : sizes) {
+    int w = size[0], h = size[1];
+    float *src = mallocf(w * h);
+    float *dst = mallocf(w * h);
+    for (int i = 0; i < w * h; i++) {
+      src[i] = i;
+    }
+    for (int simd = 0; simd < 2; simd++) {
+      memsetf(dst, 0.f, w * h);
+      matrix_transpose(simd, src, w, h, dst);
+      for (int i = 0; i < h; i++) {
+        for (int j = 0; j < w; j++) {
+          ASSERT_EQ(src[i * w + j], dst[j * h + i])
+              << w << "x" << h << " " << simd << " " << i << " " << j;
+        }
+      }
+    }
+    free(dst);
+    free(src);
+  }
+}
+
+TEST(Transpose, InPlace) {
+  for (int n : { 1, 7, 8, 31, 32, 33, 100, 513 }) {
+    float *m = mallocf(n * n);
+    for (int simd = 0; simd < 2; simd++) {
+      for (int i = 0; i < n * n; i++) {
+        m[i] = i;
+      }
+      matrix_transpose_inplace(simd, m, n);
+      for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+          ASSERT_EQ(j * n + i, m[i * n + j])
+              << n << " " << simd << " " << i << " " << j;
+        }
+      }
+    }
+    free(m);
+  }
+}
+
+TEST(Transpose, Threads) {
+  const int w = 1000, h = 777;
+  float *src = mallocf(w * h);
+  float *dst = mallocf(w * h);
+  float *square = mallocf(w * w);
+  for (int i = 0; i < w * h; i++) {
+    src[i] = i;
+  }
+  for (int threads = 1; threads <= 8; threads *= 2) {
+    matrix_set_threads(threads);
+    matrix_transpose(true, src, w, h, dst);
+    for (int i = 0; i < w * h; i++) {
+      ASSERT_EQ(src[(i % h) * w + i / h], dst[i]) << threads << " " << i;
+    }
+    for (int i = 0; i < w * w; i++) {
+      square[i] = i;
+    }
+    matrix_transpose_inplace(true, square, w);
+    for (int i = 0; i < w * w; i++) {
+      ASSERT_EQ((i % w) * w + i / w, square[i]) << threads << " " << i;
+    }
+  }
+  matrix_set_threads(0);
+  free(square);
+  free(dst);
+  free(src);
+}
+
+TEST(MultiplyU8S8, Validate) {
+  const int shapes[][3] = {
+    { 1, 1, 1 }, { 7, 5, 3 }, { 37, 53, 101 }, { 200, 301, 1500 }
+  };
+  const int zero_points[][2] = { { 0, 0 }, { 128, 0 }, { 3, -7 } };
+  for (auto& shape : shapes) {
+    int M = shape[0], N = shape[1], K = shape[2];
+    uint8_t *a = new uint8_t[M * K];
+    int8_t *b = new int8_t[K * N];
+    int32_t *verif = new int32_t[M * N];
+    int32_t *res = new int32_t[M * N];
+    // The full range of values, so that any int16 saturation would show up
+    for (int i = 0; i < M * K; i++) {
+      a[i] = (i * 97) % 256;
+    }
+    for (int i = 0; i < K * N; i++) {
+      b[i] = (i * 89) % 256 - 128;
+    }
+    for (auto& zp : zero_points) {
+      for (int i = 0; i < M; i++) {
+        for (int j = 0; j < N; j++) {
+          int32_t sum = 0;
+          for (int k = 0; k < K; k++) {
+            sum += (a[i * K + k] - zp[0]) * (b[k * N + j] - zp[1]);
+          }
+          verif[i * N + j] = sum;
+        }
+      }
+      for (int simd = 0; simd < 2; simd++) {
+        matrix_multiply_u8s8(simd, a, zp[0], b, zp[1], M, N, K, res);
+        for (int i = 0; i < M * N; i++) {
+          ASSERT_EQ(verif[i], res[i]) << M << "x" << N << "x" << K << " "
+              << zp[0] << " " << zp[1] << " " << simd << " " << i;
+        }
+      }
+    }
+    delete[] res;
+    delete[] verif;
+    delete[] b;
+    delete[] a;
+  }
+}
+
+TEST(MultiplyU8S8, Epilogues) {
+  const int M = 45, N = 70, K = 130, za = 120, zb = -3, zc = 100;
+  uint8_t *a = new uint8_t[M * K];
+  int8_t *b = new int8_t[K * N];
+  int32_t *sums = new int32_t[M * N];
+  float *resf = new float[M * N];
+  uint8_t *resq = new uint8_t[M * N];
+  for (int i = 0; i < M * K; i++) {
+    a[i] = (i * 31) % 256;
+  }
+  for (int i = 0; i < K * N; i++) {
+    b[i] = (i * 13) % 256 - 128;
+  }
+  float scales[N], bias[N];
+  for (int i = 0; i < N; i++) {
+    scales[i] = 1E-5f * (i + 1);
+    bias[i] = i - 35;
+  }
+  matrix_multiply_u8s8(false, a, za, b, zb, M, N, K, sums);
+  for (auto type : { kQuantizationScalePerTensor, kQuantizationScalePerRow,
+                     kQuantizationScalePerColumn }) {
+    for (int simd = 0; simd < 2; simd++) {
+      matrix_multiply_u8s8_dequantize(simd, a, za, b, zb, M, N, K, type,
+                                      scales, bias, resf);
+      matrix_multiply_u8s8_requantize(simd, a, za, b, zb, M, N, K, type,
+                                      scales, zc, resq);
+      int saturated = 0;
+      for (int i = 0; i < M; i++) {
+        for (int j = 0; j < N; j++) {
+          float scale = scales[type == kQuantizationScalePerRow? i :
+                               type == kQuantizationScalePerColumn? j : 0];
+          float dequantized = sums[i * N + j] * scale;
+          ASSERT_FLOAT_EQ(dequantized + bias[j], resf[i * N + j])
+              << type << " " << simd << " " << i << " " << j;
+          int q = static_cast<int>(lrintf(dequantized)) + zc;
+          saturated += q < 0 || q > 255;
+          q = q < 0? 0 : q > 255? 255 : q;
+          ASSERT_EQ(q, resq[i * N + j])
+              << type << " " << simd << " " << i << " " << j;
+        }
+      }
+      ASSERT_LT(saturated, M * N / 2);
+      matrix_multiply_u8s8_dequantize(simd, a, za, b, zb, M, N, K, type,
+                                      scales, nullptr, resf);
+      for (int i = 0; i < M; i++) {
+        for (int j = 0; j < N; j++) {
+          float scale = scales[type == kQuantizationScalePerRow? i :
+                               type == kQuantizationScalePerColumn? j : 0];
+          ASSERT_FLOAT_EQ(sums[i * N + j] * scale, resf[i * N + j])
+              << type << " " << simd << " " << i << " " << j;
+        }
+      }
+    }
+  }
+  delete[] resq;
+  delete[] resf;
+  delete[] sums;
+  delete[] b;
+  delete[] a;
+}
+
 INSTANTIATE_TEST_CASE_P(
     Common, MatrixTest,
     ::testing::Combine(
@@ -195,7 +1322,12 @@ INSTANTIATE_TEST_CASE_P(
     ::testing::Combine(
         ::testing::Values(
             std::make_tuple(128, 300, 1000, 128),
-            std::make_tuple(125, 299, 999, 125)
+            std::make_tuple(125, 299, 999, 125),
+            // Spans several blocks along every dimension
+            std::make_tuple(601, 197, 2100, 601),
+            // Matrix-vector products
+            std::make_tuple(333, 517, 1, 333),
+            std::make_tuple(333, 1, 517, 333)
         ),
         ::testing::Values(
             std::make_tuple(matrix_multiply, false),
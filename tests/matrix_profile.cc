@@ -0,0 +1,152 @@
+/*! @file matrix_profile.cc
+ *  @brief Tests for matrix_profile.
+ *  @author Markovtsev Vadim <v.markovtsev@samsung.com>
+ *  @version 1.0
+ *
+ *  @section Notes
+ *  This code partially conforms to <a href="http://google-styleguide.googlecode.com/svn/trunk/cppguide.xml">Google C++ Style Guide</a>.
+ *
+ *  @section Copyright
+ *  Copyright © 2013 Samsung R&D Institute Russia
+ *
+ *  @section License
+ *  Licensed to the Apache Software Foundation (ASF) under one
+ *  or more contributor license agreements.  See the NOTICE file
+ *  distributed with this work for additional information
+ *  regarding copyright ownership.  The ASF licenses this file
+ *  to you under the Apache License, Version 2.0 (the
+ *  "License"); you may not use this file except in compliance
+ *  with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an
+ *  "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ *  KIND, either express or implied.  See the License for the
+ *  specific language governing permissions and limitations
+ *  under the License.
+ */
+
+
+#include <math.h>
+#include <simd/matrix_profile.h>
+#include <gtest/gtest.h>
+
+void matrix_profile_reference(const float *series, int length, int window,
+                              float *profile) {
+  int l = length - window + 1;
+  int excl = matrix_profile_exclusion_zone(window);
+  for (int i = 0; i < l; i++) {
+    double best = INFINITY;
+    for (int j = 0; j < l; j++) {
+      if (abs(i - j) < excl) {
+        continue;
+      }
+      double mi = 0, mj = 0;
+      for (int t = 0; t < window; t++) {
+        mi += series[i + t];
+        mj += series[j + t];
+      }
+      mi /= window;
+      mj /= window;
+      double si = 0, sj = 0;
+      for (int t = 0; t < window; t++) {
+        si += (series[i + t] - mi) * (series[i + t] - mi);
+        sj += (series[j + t] - mj) * (series[j + t] - mj);
+      }
+      si = sqrt(si / window);
+      sj = sqrt(sj / window);
+      double dist = 0;
+      for (int t = 0; t < window; t++) {
+        double d = (series[i + t] - mi) / si - (series[j + t] - mj) / sj;
+        dist += d * d;
+      }
+      dist = sqrt(dist);
+      if (dist < best) {
+        best = dist;
+      }
+    }
+    profile[i] = best;
+  }
+}
+
+class MatrixProfileTest : public ::testing::TestWithParam<bool> {
+ protected:
+  bool is_simd() {
+    return GetParam();
+  }
+};
+
+TEST_P(MatrixProfileTest, Reference) {
+  const int length = 517;
+  const int window = 23;
+  const int l = length - window + 1;
+  float series[length];
+  srand(7);
+  float walk = 0;
+  for (int i = 0; i < length; i++) {
+    walk += rand() / (RAND_MAX + 1.f) - 0.5f;
+    series[i] = walk + sinf(i / 5.f);
+  }
+  float verif[l];
+  matrix_profile_reference(series, length, window, verif);
+  for (int threads = 1; threads <= 4; threads += 3) {
+    float profile[l];
+    int index[l];
+    matrix_profile(is_simd(), series, length, window, threads,
+                   profile, index);
+    for (int i = 0; i < l; i++) {
+      ASSERT_NEAR(verif[i], profile[i], 2E-2) << i;
+      ASSERT_GE(abs(index[i] - i), matrix_profile_exclusion_zone(window));
+    }
+  }
+}
+
+TEST_P(MatrixProfileTest, Motif) {
+  const int length = 1000;
+  const int window = 32;
+  const int l = length - window + 1;
+  float series[length];
+  srand(42);
+  for (int i = 0; i < length; i++) {
+    series[i] = rand() / (RAND_MAX + 1.f);
+  }
+  // Plant the same scaled and shifted pattern twice
+  for (int t = 0; t < window; t++) {
+    float pattern = sinf(t * 0.4f) * cosf(t * 0.15f);
+    series[100 + t] = pattern;
+    series[700 + t] = 3 * pattern + 10;
+  }
+  float profile[l];
+  int index[l];
+  matrix_profile(is_simd(), series, length, window, 0, profile, index);
+  EXPECT_NEAR(0, profile[100], 1E-2);
+  EXPECT_NEAR(0, profile[700], 1E-2);
+  EXPECT_EQ(700, index[100]);
+  EXPECT_EQ(100, index[700]);
+  // Without the index
+  float profile2[l];
+  matrix_profile(is_simd(), series, length, window, 1, profile2, nullptr);
+  for (int i = 0; i < l; i++) {
+    ASSERT_NEAR(profile[i], profile2[i], 1E-4) << i;
+  }
+}
+
+TEST_P(MatrixProfileTest, NoNeighbours) {
+  const int length = 11;
+  const int window = 9;
+  float series[length] = { 1, 2, 3, 4, 3, 2, 1, 0, 1, 2, 3 };
+  float profile[3];
+  int index[3];
+  matrix_profile(is_simd(), series, length, window, 1, profile, index);
+  for (int i = 0; i < 3; i++) {
+    EXPECT_TRUE(isinf(profile[i])) << i;
+    EXPECT_EQ(-1, index[i]);
+  }
+}
+
+INSTANTIATE_TEST_CASE_P(MatrixProfileTests, MatrixProfileTest,
+                        ::testing::Bool());
+
+#include "tests/google/src/gtest_main.cc"
@@ -86,6 +86,15 @@ TEST(Memory, memsetf) {
   for (int i = 3; i < 99; i++) {
     ASSERT_EQ(3.0f, ptr[i]);
   }
+  // Shorter than the distance to the aligned address
+  ptr[6] = 0.0f;
+  memsetf(&ptr[1], 5.0f, 5);
+  for (int i = 1; i < 6; i++) {
+    ASSERT_EQ(5.0f, ptr[i]);
+  }
+  ASSERT_EQ(0.0f, ptr[6]);
+  memsetf(&ptr[6], 5.0f, 0);
+  ASSERT_EQ(0.0f, ptr[6]);
 }
 
 TEST(Memory, zeropadding) {
@@ -29,6 +29,7 @@
  */
 
 
+#include <cmath>
 #include <simd/normalize.h>
 #include <simd/memory.h>
 #include <gtest/gtest.h>
@@ -80,6 +81,191 @@ TEST_P(SimdTest, minmax1D) {
   EXPECT_FLOAT_EQ(252, max);
 }
 
+TEST_P(SimdTest, normalize2D_parallel) {
+  // Large enough to be split between the threads
+  const int width = 701, height = 400, src_stride = 720, dst_stride = 710;
+  uint8_t *array = new uint8_t[src_stride * height];
+  for (int i = 0; i < src_stride * height; i++) {
+    array[i] = 10 + (i * 37 + i / 1000) % 200;
+  }
+  array[399 * src_stride + 700] = 250;
+  array[src_stride * 200] = 3;
+  float *verif = mallocf(dst_stride * height);
+  float *res = mallocf(dst_stride * height);
+  normalize2D(is_simd(), array, src_stride, width, height, verif, dst_stride);
+  for (int threads = 0; threads <= 3; threads++) {
+    uint8_t min = 0, max = 0;
+    minmax2D_parallel(is_simd(), threads, array, src_stride, width, height,
+                      &min, &max);
+    ASSERT_EQ(3, min);
+    ASSERT_EQ(250, max);
+    memsetf(res, -10.f, dst_stride * height);
+    normalize2D_parallel(is_simd(), threads, array, src_stride, width, height,
+                         res, dst_stride);
+    for (int y = 0; y < height; y++) {
+      for (int x = 0; x < dst_stride; x++) {
+        if (x < width) {
+          ASSERT_NEAR(verif[y * dst_stride + x], res[y * dst_stride + x],
+                      1e-6) << threads << " " << x << " " << y;
+        } else {
+          ASSERT_EQ(-10.f, res[y * dst_stride + x]);
+        }
+      }
+    }
+  }
+  // The streaming stores, with the unaligned heads which vary between rows
+  normalize2D_set_stream_threshold(1);
+  for (int threads = 1; threads <= 2; threads++) {
+    memsetf(res, -10.f, dst_stride * height);
+    normalize2D_minmax_parallel(is_simd(), threads, 3, 250, array, src_stride,
+                                width, height, res + 1, dst_stride);
+    ASSERT_EQ(-10.f, res[0]);
+    for (int y = 0; y < height; y++) {
+      for (int x = 0; x < width; x++) {
+        ASSERT_NEAR(verif[y * dst_stride + x], res[y * dst_stride + x + 1],
+                    1e-6) << threads << " " << x << " " << y;
+      }
+      if (y < height - 1) {
+        ASSERT_EQ(-10.f, res[y * dst_stride + width + 1]);
+      }
+    }
+  }
+  normalize2D_set_stream_threshold(0);
+  // Constant plane must not touch the padding
+  memsetf(res, -10.f, dst_stride * height);
+  normalize2D_minmax_parallel(is_simd(), 2, 5, 5, array, src_stride, width,
+                              height, res, dst_stride);
+  ASSERT_EQ(0.f, res[(height - 1) * dst_stride + width - 1]);
+  ASSERT_EQ(-10.f, res[(height - 1) * dst_stride + width]);
+  free(res);
+  free(verif);
+  delete[] array;
+}
+
+TEST_P(SimdTest, normalize2D_u16) {
+  const int width = 45, height = 7, stride = 50;
+  uint16_t array[stride * height];
+  for (int i = 0; i < stride * height; i++) {
+    array[i] = 1000 + (i * 7919) % 30000;
+  }
+  array[3 * stride + 44] = 65000;
+  array[5 * stride + 2] = 300;
+  // Outside of the plane
+  array[6 * stride + 47] = 65535;
+  array[2 * stride + 46] = 0;
+  uint16_t min, max;
+  minmax2D_u16(is_simd(), array, stride, width, height, &min, &max);
+  ASSERT_EQ(300, min);
+  ASSERT_EQ(65000, max);
+  minmax2D_u16(is_simd(), array, stride, width, height, nullptr, &max);
+  ASSERT_EQ(65000, max);
+  float res[stride * height];
+  normalize2D_u16(is_simd(), array, stride, width, height, res, stride);
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      ASSERT_NEAR(2.f * (array[y * stride + x] - 300) / (65000 - 300) - 1,
+                  res[y * stride + x], 1e-6) << x << " " << y;
+    }
+  }
+  normalize2D_minmax_u16(is_simd(), 5, 5, array, stride, width, height,
+                         res, stride);
+  ASSERT_EQ(0.f, res[6 * stride + 44]);
+}
+
+TEST_P(SimdTest, normalize2D_f32) {
+  const int width = 45, height = 7, stride = 50;
+  float array[stride * height];
+  for (int i = 0; i < stride * height; i++) {
+    array[i] = sinf(i) * 10;
+  }
+  array[3 * stride + 44] = 12;
+  array[5 * stride + 2] = -11;
+  // Outside of the plane
+  array[6 * stride + 47] = 100;
+  array[2 * stride + 46] = -100;
+  float min, max;
+  minmax2D_f32(is_simd(), array, stride, width, height, &min, &max);
+  ASSERT_EQ(-11, min);
+  ASSERT_EQ(12, max);
+  minmax2D_f32(is_simd(), array, stride, width, height, &min, nullptr);
+  ASSERT_EQ(-11, min);
+  float res[stride * height];
+  normalize2D_f32(is_simd(), array, stride, width, height, res, stride);
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      ASSERT_NEAR(2.f * (array[y * stride + x] + 11) / 23 - 1,
+                  res[y * stride + x], 1e-6) << x << " " << y;
+    }
+  }
+  // In place
+  normalize2D_f32(is_simd(), array, stride, width, height, array, stride);
+  for (int i = 0; i < stride * height; i++) {
+    if (i % stride < width) {
+      ASSERT_EQ(res[i], array[i]) << i;
+    }
+  }
+  ASSERT_EQ(100, array[6 * stride + 47]);
+}
+
+TEST_P(SimdTest, normalize2D_interleaved) {
+  // 37 pixels leave a tail after every group of 16
+  const int width = 37, height = 5, src_stride = 160, dst_stride = 150;
+  uint8_t array[src_stride * height];
+  for (int i = 0; i < src_stride * height; i++) {
+    array[i] = (i * 37 + i / 7) % 200 + 20;
+  }
+  float res[4 * dst_stride * height];
+  for (int channels = 1; channels <= 4; channels++) {
+    // The last channel is constant
+    for (int y = 0; y < height; y++) {
+      for (int x = 0; x < width; x++) {
+        array[y * src_stride + x * channels + channels - 1] = 77;
+      }
+    }
+    array[3 * src_stride + 35 * channels] = 255;
+    array[src_stride + 2 * channels] = 0;
+    uint8_t min[4], max[4];
+    minmax2D_interleaved(is_simd(), array, src_stride, width, height,
+                         channels, min, max);
+    for (int c = 0; c < channels; c++) {
+      uint8_t vmin = 255, vmax = 0;
+      for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+          uint8_t val = array[y * src_stride + x * channels + c];
+          vmin = val < vmin? val : vmin;
+          vmax = val > vmax? val : vmax;
+        }
+      }
+      ASSERT_EQ(vmin, min[c]) << channels << " " << c;
+      ASSERT_EQ(vmax, max[c]) << channels << " " << c;
+    }
+    for (int joint = 0; joint < 2; joint++) {
+      for (int planar = 0; planar < 2; planar++) {
+        NormalizeLayout layout = planar? kNormalizePlanar
+                                       : kNormalizeInterleaved;
+        normalize2D_interleaved(is_simd(), array, src_stride, width, height,
+                                channels, joint, layout, res, dst_stride);
+        for (int c = 0; c < channels; c++) {
+          float cmin = joint? 0 : min[c], cmax = joint? 255 : max[c];
+          for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+              float expected = 0;
+              if (cmax != cmin) {
+                expected = 2.f * (array[y * src_stride + x * channels + c] -
+                                  cmin) / (cmax - cmin) - 1;
+              }
+              float val = planar? res[(c * height + y) * dst_stride + x]
+                                : res[y * dst_stride + x * channels + c];
+              ASSERT_NEAR(expected, val, 1e-6) << channels << " " << joint
+                  << planar << " " << c << " " << x << " " << y;
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
 INSTANTIATE_TEST_CASE_P(NormalizeTests, SimdTest, ::testing::Bool());
 
 #include "tests/google/src/gtest_main.cc"
@@ -0,0 +1,164 @@
+/*! @file pairwise_distances.cc
+ *  @brief Tests for pairwise_distances.
+ *  @author Markovtsev Vadim <v.markovtsev@samsung.com>
+ *  @version 1.0
+ *
+ *  @section Notes
+ *  This code partially conforms to <a href="http://google-styleguide.googlecode.com/svn/trunk/cppguide.xml">Google C++ Style Guide</a>.
+ *
+ *  @section Copyright
+ *  Copyright © 2013 Samsung R&D Institute Russia
+ *
+ *  @section License
+ *  Licensed to the Apache Software Foundation (ASF) under one
+ *  or more contributor license agreements.  See the NOTICE file
+ *  distributed with this work for additional information
+ *  regarding copyright ownership.  The ASF licenses this file
+ *  to you under the Apache License, Version 2.0 (the
+ *  "License"); you may not use this file except in compliance
+ *  with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an
+ *  "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ *  KIND, either express or implied.  See the License for the
+ *  specific language governing permissions and limitations
+ *  under the License.
+ */
+
+
+#include <math.h>
+#include <algorithm>
+#include <utility>
+#include <vector>
+#include <simd/matrix.h>
+#include <simd/memory.h>
+#include <simd/pairwise_distances.h>
+#include <gtest/gtest.h>
+
+static double reference_distance(DistanceMetric metric, const float *a,
+                                 const float *b, int dim) {
+  double sq = 0, dot = 0, na = 0, nb = 0;
+  for (int i = 0; i < dim; i++) {
+    sq += (a[i] - b[i]) * (a[i] - b[i]);
+    dot += a[i] * b[i];
+    na += a[i] * a[i];
+    nb += b[i] * b[i];
+  }
+  switch (metric) {
+    case kDistanceSquaredEuclidean:
+      return sq;
+    case kDistanceEuclidean:
+      return sqrt(sq);
+    case kDistanceCosine:
+      return na == 0 || nb == 0? 1 : 1 - dot / sqrt(na * nb);
+  }
+  return 0;
+}
+
+/// @brief Small integer coordinates, so that there are exact ties.
+static std::vector<float> make_points(int count, int dim, int seed) {
+  std::vector<float> points(count * dim);
+  for (int i = 0; i < count * dim; i++) {
+    points[i] = (i * 7 + seed) % 11 - 5;
+  }
+  return points;
+}
+
+TEST(PairwiseDistances, Validate) {
+  const int na = 37, nb = 300;
+  for (int dim : { 1, 7, 64 }) {
+    auto a = make_points(na, dim, 1), b = make_points(nb, dim, 4);
+    // A zero vector
+    std::fill(b.begin(), b.begin() + dim, 0);
+    std::vector<float> res(nb * nb);
+    for (auto metric : { kDistanceSquaredEuclidean, kDistanceEuclidean,
+                         kDistanceCosine }) {
+      for (int simd = 0; simd < 2; simd++) {
+        pairwise_distances(simd, metric, &a[0], na, &b[0], nb, dim, &res[0]);
+        for (int i = 0; i < na; i++) {
+          for (int j = 0; j < nb; j++) {
+            double expected = reference_distance(metric, &a[i * dim],
+                                                 &b[j * dim], dim);
+            ASSERT_NEAR(expected, res[i * nb + j], 1e-5 * (1 + expected))
+                << dim << " " << metric << " " << simd << " " << i << " "
+                << j;
+          }
+        }
+        // The same set
+        pairwise_distances(simd, metric, &b[0], nb, &b[0], nb, dim,
+                           &res[0]);
+        for (int i = 0; i < nb; i++) {
+          ASSERT_EQ(0, res[i * nb + i]);
+          for (int j = 0; j < i; j++) {
+            ASSERT_EQ(res[j * nb + i], res[i * nb + j]);
+          }
+        }
+      }
+    }
+  }
+}
+
+TEST(PairwiseDistances, TopK) {
+  const int na = 70, nb = 2500, dim = 5;
+  auto a = make_points(na, dim, 2), b = make_points(nb, dim, 3);
+  std::vector<float> full(na * nb);
+  for (auto metric : { kDistanceSquaredEuclidean, kDistanceEuclidean,
+                       kDistanceCosine }) {
+    for (int simd = 0; simd < 2; simd++) {
+      pairwise_distances(simd, metric, &a[0], na, &b[0], nb, dim, &full[0]);
+      for (int k : { 1, 10, 100 }) {
+        std::vector<float> distances(na * k);
+        std::vector<int> indices(na * k);
+        pairwise_distances_topk(simd, metric, &a[0], na, &b[0], nb, dim, k,
+                                &distances[0], &indices[0]);
+        for (int i = 0; i < na; i++) {
+          std::vector<std::pair<float, int>> row(nb);
+          for (int j = 0; j < nb; j++) {
+            row[j] = { full[i * nb + j], j };
+          }
+          std::partial_sort(row.begin(), row.begin() + k, row.end());
+          for (int j = 0; j < k; j++) {
+            ASSERT_EQ(row[j].first, distances[i * k + j])
+                << metric << " " << simd << " " << k << " " << i << " " << j;
+            ASSERT_EQ(row[j].second, indices[i * k + j])
+                << metric << " " << simd << " " << k << " " << i << " " << j;
+          }
+        }
+      }
+    }
+  }
+  // The nearest point of the same set is the point itself
+  std::vector<float> distances(na);
+  std::vector<int> indices(na);
+  auto points = make_points(na, 64, 5);
+  for (int i = 0; i < na; i++) {
+    points[i * 64] += i * 0.5f;
+  }
+  pairwise_distances_topk(true, kDistanceEuclidean, &points[0], na,
+                          &points[0], na, 64, 1, &distances[0], &indices[0]);
+  for (int i = 0; i < na; i++) {
+    ASSERT_EQ(0, distances[i]);
+    ASSERT_EQ(i, indices[i]);
+  }
+  // The blocks are split between matrix_set_threads() threads
+  const int k = 10;
+  std::vector<float> verif(na * k), split(na * k);
+  std::vector<int> verifi(na * k), spliti(na * k);
+  pairwise_distances_topk(true, kDistanceSquaredEuclidean, &a[0], na, &b[0],
+                          nb, dim, k, &verif[0], &verifi[0]);
+  for (int threads = 1; threads < 4; threads++) {
+    matrix_set_threads(threads);
+    pairwise_distances_topk(true, kDistanceSquaredEuclidean, &a[0], na,
+                            &b[0], nb, dim, k, &split[0], &spliti[0]);
+    for (int i = 0; i < na * k; i++) {
+      ASSERT_EQ(verif[i], split[i]) << threads << " " << i;
+      ASSERT_EQ(verifi[i], spliti[i]) << threads << " " << i;
+    }
+  }
+  matrix_set_threads(0);
+}
+
+#include "tests/google/src/gtest_main.cc"